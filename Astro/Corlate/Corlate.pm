@@ -59,9 +59,22 @@ Astro::Corlate - Object a catalog corelation
   # get probability histogram file
   my $histogram = $corlate->histogram();
 
+  # or correlate catalogues held in memory, without any files
+  my $result = $corlate->run_corlate_data( Reference   => \@lines,
+                                           Observation => $text );
+
+  # or correlate a night's frames against the reference catalogue
+  my $results = $corlate->run_corlate_batch( Observations => \@frames );
+
+  # or correlate a wide field mosaic in tiles, four at a time
+  my $mosaic = $corlate->run_corlate_tiled( TileSize => 2, Workers => 4 );
+
   # get the useful information file
   my $information = $corlate->information();
 
+  # how long each stage of the last run took, and how much it did
+  my $metrics = $corlate->metrics();
+
 =head1 DESCRIPTION
 
 This module is an object-orientated interface to the Astro::Corlate::Wrapper
@@ -76,8 +89,13 @@ environment variable is not defined.
 use strict;
 use vars qw/ $VERSION /;
 
-use Astro::Corlate::Wrapper qw / corlate /;
+use Astro::Corlate::Wrapper qw / corlate corlate_cached corlate_buffers
+                                  corlate_batch corlate_metrics set_threads
+                                  set_preset set_option get_option /;
 use File::Spec;
+use File::Temp qw / tempdir /;
+use Storable qw / nstore retrieve /;
+use POSIX qw / floor ceil /;
 use Carp;
 
 '$Revision: 1.6 $ ' =~ /.*:\s(.*)\s\$/ && ($VERSION = $1);
@@ -111,6 +129,12 @@ sub new {
 
   # bless the query hash into the class
   my $block = bless { DATADIR => undef,
+                      THREADS => 0,
+                      CACHE   => undef,
+                      PRESET  => 'default',
+                      CONFIG  => {},
+                      METRICS => undef,
+                      METRICSFILE => undef,
                       FILES   => {} }, $class;
 
   # Configure the object
@@ -132,7 +156,10 @@ sub new {
 
 Runs the catalog corelation subroutine
 
-   $corlate->run_corlate();
+   $metrics = $corlate->run_corlate();
+
+returns a reference to a hash of how long each stage took and how much it
+did, as for the metrics method.
 
 =cut
 
@@ -152,16 +179,31 @@ sub run_corlate {
   # declare status
   my $status;
 
+  # set up the Fortran engine
+  $self->_set_engine();
+
   # call the corlate sub-routine
   eval {
-    $status = corlate( ${$self->{FILES}}{reference},
-                       ${$self->{FILES}}{observation},
-                       ${$self->{FILES}}{logfile},
-                       ${$self->{FILES}}{variables},
-                       ${$self->{FILES}}{data},
-                       ${$self->{FILES}}{fit},
-                       ${$self->{FILES}}{histogram},
-                       ${$self->{FILES}}{information} );
+    if ( defined $self->{CACHE} ) {
+       $status = corlate_cached( ${$self->{FILES}}{reference},
+                                 $self->{CACHE},
+                                 ${$self->{FILES}}{observation},
+                                 ${$self->{FILES}}{logfile},
+                                 ${$self->{FILES}}{variables},
+                                 ${$self->{FILES}}{data},
+                                 ${$self->{FILES}}{fit},
+                                 ${$self->{FILES}}{histogram},
+                                 ${$self->{FILES}}{information} );
+    } else {
+       $status = corlate( ${$self->{FILES}}{reference},
+                          ${$self->{FILES}}{observation},
+                          ${$self->{FILES}}{logfile},
+                          ${$self->{FILES}}{variables},
+                          ${$self->{FILES}}{data},
+                          ${$self->{FILES}}{fit},
+                          ${$self->{FILES}}{histogram},
+                          ${$self->{FILES}}{information} );
+    }
   };
 
   # check for errors
@@ -170,6 +212,9 @@ sub run_corlate {
      croak ( "Error: Unknown error running catalogue corelation" );
   }
 
+  # keep the metrics, even if it failed
+  $self->_record_metrics( $status, ${$self->{FILES}}{observation} );
+
   # Run through possible status values
   if ( $status == -1 ) {
      croak ( "Error: Failed to open reference catalogue file" );
@@ -180,7 +225,342 @@ sub run_corlate {
   }
 
   # Should have good status?
-  return $status;
+  return $self->{METRICS};
+}
+
+=item B<run_corlate_data>
+
+Runs the catalog corelation on catalogues held in memory
+
+   $result = $corlate->run_corlate_data( Reference   => \@reference,
+                                         Observation => $observation );
+
+each catalogue is in CLUSTER format, either as a string or as a reference
+to an array of lines. Nothing is read from or written to disk, instead the
+results which run_corlate writes to its files are returned as a hash
+reference
+
+   status        0, or as for run_corlate if it doesn't croak
+   first_pass    the number of pairs used to find the shift
+   shift         [ RA, Dec ] modal shift between catalogues in arcsec
+   separation    RMS separation of the paired stars in arcsec
+   colours       [ names of the four colours of each pair ]
+   pairs         [ { field, ccd, id, ra, dec, x, y, colours } ]
+   fit           { a, b, chisq, nclip, line => [ x1, y1, x2, y2 ] }
+   variables     [ { star, delta_mag, error, probability } ]
+   histogram     [ counts of -log10 probability, from 0 to histogram_max ]
+   histogram_max
+   metrics       { time, stars_observation, candidates, pairs, clipped }
+
+where the colours of each pair are [ data, error, flag ] in the same order
+as the colour names, and the star of each variable is one of the pairs.
+The fit is mag_diff = b*colour + a. The metrics are those of the metrics
+method, for the observation alone. The Reference and Observation set here
+are not kept, so don't change the file names used by run_corlate.
+
+=cut
+
+sub run_corlate_data {
+  my $self = shift;
+  my %args = @_;
+
+  # Check that both catalogues have been supplied
+  unless ( defined $args{Reference} ) {
+     croak( "Error: No reference catalogue supplied" );
+  }
+  unless ( defined $args{Observation} ) {
+     croak( "Error: No observation catalogue supplied" );
+  }
+
+  # join arrays of lines, with or without newlines, into a single buffer
+  my @buffers;
+  for my $catalogue ( $args{Reference}, $args{Observation} ) {
+     if ( ref($catalogue) eq 'ARRAY' ) {
+        my @lines = @{$catalogue};
+        s/\n\z// for @lines;
+        push @buffers, join( "\n", @lines );
+     } else {
+        push @buffers, $catalogue;
+     }
+  }
+
+  # declare result
+  my $result;
+
+  # set up the Fortran engine
+  $self->_set_engine();
+
+  # call the corlate sub-routine
+  eval {
+    $result = corlate_buffers( $buffers[0], $buffers[1] );
+  };
+
+  # check for errors
+  if($@) {
+     print "$@\n";
+     croak ( "Error: Unknown error running catalogue corelation" );
+  }
+
+  $self->_record_metrics( ${$result}{status}, 'memory' );
+
+  if ( ${$result}{status} == -3 ) {
+     croak ( "Error: Too few stars paired between catalogues" );
+  }
+
+  return $result;
+}
+
+=item B<run_corlate_batch>
+
+Runs the catalog corelation on many observations of the same field
+
+   $results = $corlate->run_corlate_batch( Observations => \@observations,
+                                           ByFrame      => 1 );
+
+the reference catalogue (and its cache, if there is one) is read and
+indexed only once, and each of the observations correlated against it.
+Each observation is a CLUSTER format file name, or a reference to an
+array of lines or to a string holding the catalogue. If ByFrame is true
+the observations are done in parallel, rather than the stars within each,
+which is faster when there are many small frames.
+
+Nothing is written to disk, instead a reference to an array of results is
+returned, one for each observation in order, each as for run_corlate_data.
+The metrics method returns those for the whole batch, with the times of
+the frames summed.
+Unlike run_corlate_data a frame with too few stars paired doesn't croak,
+but has a status of -3.
+
+=cut
+
+sub run_corlate_batch {
+  my $self = shift;
+  my %args = @_;
+
+  # Check that the reference catalogue files has been supplied
+  unless ( defined ${$self->{FILES}}{"reference"} ) {
+     croak( "Error: No reference catalogue supplied" );
+  }
+
+  # Check that the observation catalogues have been supplied
+  unless ( ref($args{Observations}) eq 'ARRAY' && @{$args{Observations}} ) {
+     croak( "Error: No observation catalogues supplied" );
+  }
+
+  # read each observation into a single buffer
+  my @buffers;
+  for my $catalogue ( @{$args{Observations}} ) {
+     if ( ref($catalogue) eq 'ARRAY' ) {
+        my @lines = @{$catalogue};
+        s/\n\z// for @lines;
+        push @buffers, join( "\n", @lines );
+     } elsif ( ref($catalogue) eq 'SCALAR' ) {
+        push @buffers, ${$catalogue};
+     } else {
+        open( CAT, $catalogue )
+           or croak( "Error: Failed to open observation catalogue file" );
+        local $/ = undef;
+        push @buffers, <CAT>;
+        close( CAT );
+     }
+  }
+
+  # declare results
+  my $results;
+
+  # set up the Fortran engine
+  $self->_set_engine();
+
+  # call the corlate sub-routine
+  eval {
+    $results = corlate_batch( ${$self->{FILES}}{reference},
+                              defined $self->{CACHE} ? $self->{CACHE} : '',
+                              \@buffers, $args{ByFrame} ? 1 : 0 );
+  };
+
+  # check for errors
+  if($@) {
+     print "$@\n";
+     croak ( "Error: Unknown error running catalogue corelation" );
+  }
+
+  $self->_record_metrics( defined $results ? 0 : -1,
+                          scalar( @buffers ) . ' frames' );
+
+  unless ( defined $results ) {
+     croak ( "Error: Failed to open reference catalogue file" );
+  }
+
+  return $results;
+}
+
+=item B<run_corlate_tiled>
+
+Runs the catalog corelation on a wide field, one tile at a time
+
+   $result = $corlate->run_corlate_tiled( TileSize => 1.0,
+                                          Overlap  => 30,
+                                          Workers  => 4 );
+
+the reference and observation catalogues are split into tiles TileSize
+degrees high (and about as wide), in declination zones, each extended by
+Overlap arcsec so stars near its edges still find their counterparts.
+Each tile with observed stars in it is correlated on its own, so has its
+own shift and fit, and only ever needs the memory for that tile. Up to
+Workers tiles are done at once, each in a process of its own. The
+defaults are 1 degree tiles, an overlap of 30 arcsec and a single worker,
+in which case no processes are started.
+
+Nothing is written to disk apart from the tiles themselves, which are
+kept in a temporary directory. Instead a reference to a hash is returned,
+
+   status     0, or -3 if no tile paired enough stars
+   colours    [ names of the four colours of each pair ]
+   pairs      [ pairs from every tile ]
+   variables  [ variables from every tile ]
+   tiles      [ { ra, dec, npair, status, first_pass, shift, separation,
+                  fit, metrics } ]
+
+where the pairs and variables are as for run_corlate_data, and are kept
+only from the tile whose core (i.e. without the overlap) has the star's
+reference position in it, and then only once, so those in the overlaps
+are not repeated. Tiles which failed, such as those with too few stars
+paired to fit (a status of -3), are listed with their status but none of
+their pairs or variables are kept. The false alarm probability of each
+variable, which is worked out for the pairs in its tile, is scaled up to
+all the pairs in the mosaic, and those variables which are then no longer
+below accept_prob are dropped. The ra and dec of each tile are the
+[ lower, upper ] bounds of its core in degrees, npair is the number of
+pairs in the tile (overlap and all) and the rest are as for
+run_corlate_data.
+
+=cut
+
+sub run_corlate_tiled {
+  my $self = shift;
+  my %args = @_;
+
+  # Check that the catalogue files have been supplied
+  unless ( defined ${$self->{FILES}}{"reference"} ) {
+     croak( "Error: No reference catalogue supplied" );
+  }
+  unless ( defined ${$self->{FILES}}{"observation"} ) {
+     croak( "Error: No observation catalogue supplied" );
+  }
+
+  my $size = defined $args{TileSize} ? $args{TileSize} : 1.0;
+  my $overlap = ( defined $args{Overlap} ? $args{Overlap} : 30 )/3600.0;
+  my $workers = $args{Workers} || 1;
+  croak( "Error: Tile size must be between 0 and 180 degrees" )
+     unless $size > 0 && $size <= 180;
+  croak( "Error: Overlap must be smaller than the tiles" )
+     unless $overlap >= 0 && $overlap < $size;
+
+  # split the catalogues, working only on tiles with stars observed in
+  my $dir = tempdir( CLEANUP => 1 );
+  my %observed = _split_tiles( ${$self->{FILES}}{observation}, 'obs',
+                               $dir, $size, $overlap );
+  _split_tiles( ${$self->{FILES}}{reference}, 'ref', $dir, $size,
+                $overlap, \%observed );
+  my @tiles = sort { $a->[0] <=> $b->[0] || $a->[1] <=> $b->[1] }
+              map { [ split ' ' ] } keys %observed;
+
+  # set up the Fortran engine, which the workers inherit
+  $self->_set_engine();
+
+  # do each tile, in as many processes as we are allowed
+  my ( %running, %exit );
+  for my $i ( 0 .. $#tiles ) {
+     if ( $workers <= 1 ) {
+        _run_tile( $dir, $i, $size, @{$tiles[$i]} );
+        next;
+     }
+     if ( keys %running >= $workers ) {
+        my $pid = wait();
+        $exit{$running{$pid}} = $?;
+        delete $running{$pid};
+     }
+     my $pid = fork();
+     croak( "Error: Cannot start a process for tile $i" )
+        unless defined $pid;
+     if ( $pid == 0 ) {
+        # don't let the temporary directory be cleaned up from here
+        eval { _run_tile( $dir, $i, $size, @{$tiles[$i]} ) };
+
+        # pass the reason it failed back to the parent
+        if ( $@ && open( ERROR, ">" . File::Spec->catfile( $dir,
+                                                           "error_$i" ) ) ) {
+           print ERROR $@;
+           close( ERROR );
+        }
+        POSIX::_exit( $@ ? 1 : 0 );
+     }
+     $running{$pid} = $i;
+  }
+  while ( keys %running ) {
+     my $pid = wait();
+     last if $pid < 0;
+     $exit{$running{$pid}} = $?;
+     delete $running{$pid};
+  }
+
+  # merge the tiles, dropping stars already found in an earlier tile
+  my %merged = ( status => -3, colours => [], pairs => [], variables => [],
+                 tiles => [] );
+  my ( %seen, @variables );
+  for my $i ( 0 .. $#tiles ) {
+     my $file = File::Spec->catfile( $dir, "result_$i" );
+     unless ( -e $file ) {
+        my $error = File::Spec->catfile( $dir, "error_$i" );
+        if ( open( ERROR, $error ) ) {
+           local $/ = undef;
+           my $reason = <ERROR>;
+           close( ERROR );
+           chomp( $reason );
+           croak( "Error: Catalogue corelation of tile $i failed: $reason" );
+        }
+        croak( "Error: Catalogue corelation of tile $i failed, " .
+               "its process exiting with status " .
+               ( defined $exit{$i} ? $exit{$i} : "unknown" ) );
+     }
+     my $tile = retrieve( $file );
+
+     # a tile which couldn't be fitted has nothing worth keeping
+     if ( ${$tile}{status} != 0 ) {
+        ${$tile}{pairs} = [];
+        ${$tile}{variables} = [];
+     }
+
+     my %kept;
+     for my $pair ( @{${$tile}{pairs}} ) {
+        my $key = join( ' ', @{$pair}{ qw / field ccd id / } );
+        next if $seen{$key}++;
+        $kept{$pair} = 1;
+        push @{$merged{pairs}}, $pair;
+     }
+     push @variables, map { [ $_, ${$tile}{npair} ] }
+                      grep { $kept{${$_}{star}} } @{${$tile}{variables}};
+
+     if ( ${$tile}{status} == 0 ) {
+        $merged{status} = 0;
+        $merged{colours} = ${$tile}{colours} unless @{$merged{colours}};
+     }
+     delete @{$tile}{ qw / pairs variables colours histogram
+                           histogram_max / };
+     push @{$merged{tiles}}, $tile;
+  }
+
+  # the chance of a change as big as each variable's in any of the pairs
+  my $npair = scalar( @{$merged{pairs}} );
+  my $accept = get_option( 'accept_prob' );
+  for my $variable ( @variables ) {
+     my ( $star, $tile_pairs ) = @{$variable};
+     ${$star}{probability} =
+        1.0 - ( 1.0 - ${$star}{probability} )**( $npair/$tile_pairs );
+     push @{$merged{variables}}, $star if ${$star}{probability} < $accept;
+  }
+
+  return \%merged;
 }
 
 # O T H E R   M E T H O D S ------------------------------------------------
@@ -334,6 +714,155 @@ sub information {
    return ${$self->{FILES}}{"information"};
 }
 
+=item B<Threads>
+
+Sets (or returns) the number of threads used to match the catalogues
+
+   $threads = $corlate->threads( );
+   $corlate->threads( 4 );
+
+the default of 0 uses as many as OpenMP thinks best. The output files are
+the same however many threads are used, and only one is ever used if the
+Fortran library was not compiled with OpenMP.
+
+=cut
+
+sub threads {
+  my $self = shift;
+
+  if (@_) {
+    $self->{THREADS} = shift;
+  }
+
+  return $self->{THREADS};
+}
+
+=item B<Cache>
+
+Sets (or returns) the name of a cache file for the reference catalogue
+
+   $cache_file = $corlate->cache( );
+   $corlate->cache( $cache_file );
+
+the parsed and indexed reference catalogue is kept in this file, and read
+back instead of the reference catalogue whenever the contents of that
+catalogue have not changed. The cache is rebuilt if it is missing or out
+of date, so it is safe to share one cache between runs against the same
+reference. By default no cache is used.
+
+=cut
+
+sub cache {
+  my $self = shift;
+
+  if (@_) {
+    $self->{CACHE} = shift;
+  }
+
+  return $self->{CACHE};
+}
+
+=item B<Preset>
+
+Sets (or returns) the survey profile the catalogues are correlated with
+
+   $preset = $corlate->preset( );
+   $corlate->preset( 'usno-a2_lx200' );
+
+the profiles are 'default', which is what CORLATE was written with,
+'2mass_ukirt' and 'usno-a2_lx200'. Any settings made with the config
+method are applied on top of the profile.
+
+=cut
+
+sub preset {
+  my $self = shift;
+
+  if (@_) {
+    $self->{PRESET} = shift;
+  }
+
+  return $self->{PRESET};
+}
+
+=item B<Config>
+
+Sets (or returns) a hash reference of settings which override those of
+the survey profile
+
+   $config = $corlate->config( );
+   $corlate->config( { accept_prob => 0.05, allow_fading => 1 } );
+
+the settings are minpair, lowest_sn, accept_prob, allow_fading,
+inital_rad, modal_shift, shift_step, final_rad, rms_rad, min_mag_change,
+clip, var_mag_change and write_histogram, and are described in
+F<Wrapper/Fortran/corlate.f90>. True and false settings take 1 or 0.
+Unknown settings, and values out of range for a setting (such as a
+minpair or shift_step of zero), croak when the correlation is run.
+
+=cut
+
+sub config {
+  my $self = shift;
+
+  if (@_) {
+    $self->{CONFIG} = shift;
+  }
+
+  return $self->{CONFIG};
+}
+
+=item B<Metrics>
+
+Returns how long each stage of the last run took, and how much it did
+
+   $metrics = $corlate->metrics( );
+
+as a reference to a hash
+
+   status             as returned by the Fortran
+   time               { read, index, first_pass, second_pass, fit,
+                        probability, output } in seconds of wall clock time
+   stars_reference    number of stars in the reference catalogue
+   stars_observation  number of stars in the observation(s)
+   candidates         reference stars tested for a match, on both passes
+   pairs              number of pairs kept for the fit
+   clipped            number of pairs clipped out of the fit
+   peak_memory        most memory the process has used so far, in kb
+
+peak_memory is zero where /proc is not available.
+
+=cut
+
+sub metrics {
+  my $self = shift;
+
+  return $self->{METRICS};
+}
+
+=item B<MetricsFile>
+
+Sets (or returns) the name of a file to append metrics to
+
+   $file_name = $corlate->metricsfile( );
+   $corlate->metricsfile( $file_name );
+
+after every run the metrics are appended to the file as a single line of
+JSON, along with the date and the catalogues used, so slow frames can be
+found later. By default no file is written.
+
+=cut
+
+sub metricsfile {
+  my $self = shift;
+
+  if (@_) {
+    $self->{METRICSFILE} = shift;
+  }
+
+  return $self->{METRICSFILE};
+}
+
 # C O N F I G U R E -------------------------------------------------------
 
 =back
@@ -402,13 +931,332 @@ sub configure {
   my %args = @_;
 
   # Loop over the allowed keys and modify the default query options
-  for my $key (qw / Reference Observation / ) {
+  for my $key (qw / Reference Observation Threads Cache
+                     Preset Config MetricsFile / ) {
       my $method = lc($key);
       $self->$method( $args{$key} ) if exists $args{$key};
   }
 
 }
 
+# P R I V A T E   M E T H O D S ------------------------------------------
+
+=back
+
+=begin __PRIVATE_METHODS__
+
+=head2 Private methods
+
+These methods are for internal use only.
+
+=over 4
+
+=item B<_set_engine>
+
+Passes the number of threads, the survey profile and any settings which
+override it to the Fortran engine, croaking on any it doesn't know or
+which are out of range.
+
+=cut
+
+sub _set_engine {
+  my $self = shift;
+
+  set_threads( $self->{THREADS} );
+
+  if ( set_preset( lc( $self->{PRESET} ) ) != 0 ) {
+     croak( "Error: Unknown survey profile $self->{PRESET}" );
+  }
+
+  for my $key ( sort keys %{$self->{CONFIG}} ) {
+     my $status = set_option( lc($key), ${$self->{CONFIG}}{$key} );
+     if ( $status == -2 ) {
+        croak( "Error: Corlate setting $key out of range " .
+               "(${$self->{CONFIG}}{$key})" );
+     } elsif ( $status != 0 ) {
+        croak( "Error: Unknown corlate setting $key" );
+     }
+  }
+}
+
+=item B<_tile_bounds>
+
+Returns the number of RA tiles in declination zone $zone, and the bounds
+of that zone in degrees, for tiles $size degrees high.
+
+   ( $nra, $dec_min, $dec_max ) = _tile_bounds( $zone, $size );
+
+=cut
+
+sub _tile_bounds {
+  my $zone = shift;
+  my $size = shift;
+
+  my $dec_min = -90.0 + $zone*$size;
+  my $dec_max = $dec_min + $size;
+  $dec_max = 90.0 if $dec_max > 90.0;
+
+  # as wide as they are high where the zone is narrowest
+  my $widest = abs($dec_min) > abs($dec_max) ? abs($dec_min) : abs($dec_max);
+  my $nra = floor( 360.0*cos( $widest*atan2(1,1)/45.0 )/$size );
+  $nra = 1 if $nra < 1;
+
+  return ( $nra, $dec_min, $dec_max );
+}
+
+=item B<_tile_keys>
+
+Returns the tiles (as "zone ra" strings) a position in degrees should go
+into, the first being the one whose core it is in.
+
+   @keys = _tile_keys( $ra, $dec, $size, $overlap );
+
+=cut
+
+sub _tile_keys {
+  my ( $ra, $dec, $size, $overlap ) = @_;
+
+  my $nzone = ceil( 180.0/$size - 1.0e-9 );
+  my $zone = floor( ( $dec + 90.0 )/$size );
+  $zone = $nzone - 1 if $zone >= $nzone;
+  $zone = 0 if $zone < 0;
+
+  # how far the overlap reaches in RA at this declination
+  my $cosdec = cos( $dec*atan2(1,1)/45.0 );
+  my $ra_overlap = $cosdec > 1.0e-6 ? $overlap/$cosdec : 360.0;
+
+  # most stars are well inside a tile, so only go into that one
+  my ( $nra, $dec_min, $dec_max ) = _tile_bounds( $zone, $size );
+  my $width = 360.0/$nra;
+  my $home = floor( $ra/$width ) % $nra;
+  my $offset = $ra - $home*$width;
+  return ( "$zone $home" )
+     if $dec - $dec_min >= $overlap && $dec_max - $dec >= $overlap &&
+        $offset >= $ra_overlap && $width - $offset >= $ra_overlap;
+
+  my ( @keys, %done );
+  for my $z ( $zone, $zone - 1, $zone + 1 ) {
+     next if $z < 0 || $z >= $nzone;
+     my ( $nra, $dec_min, $dec_max ) = _tile_bounds( $z, $size );
+     next if $dec < $dec_min - $overlap || $dec > $dec_max + $overlap;
+
+     my $width = 360.0/$nra;
+     my $home = floor( $ra/$width ) % $nra;
+     for my $r ( $home, $home - 1, $home + 1 ) {
+        my $tile = $r % $nra;
+        next if $done{"$z $tile"}++;
+
+        # the RA gap between the position and the tile
+        my $offset = $ra - $tile*$width;
+        $offset -= 360.0*floor( $offset/360.0 );
+        my $gap = $offset < $width ? 0.0 : $offset - $width;
+        $gap = 360.0 - $offset if 360.0 - $offset < $gap;
+
+        push @keys, "$z $tile" if $gap <= $ra_overlap;
+     }
+  }
+
+  return @keys;
+}
+
+=item B<_split_tiles>
+
+Splits a CLUSTER format catalogue into a file for each tile, which has
+the same header, in directory $dir. Only tiles in the hash %$wanted are
+written, if it is given. Returns a hash of the tiles whose cores have
+stars in them.
+
+   %tiles = _split_tiles( $file, $prefix, $dir, $size, $overlap, \%wanted );
+
+=cut
+
+sub _split_tiles {
+  my ( $file, $prefix, $dir, $size, $overlap, $wanted ) = @_;
+
+  open( CAT, $file ) or croak( "Error: Failed to open catalogue $file" );
+  local $/ = "\n";
+  my @header = map { scalar(<CAT>) } 1 .. 3;
+  @header = map { defined $_ ? $_ : "\n" } @header;
+  $header[2] .= "\n" unless $header[2] =~ /\n\z/;
+
+  # lines are kept for each tile until there are enough to write out, so
+  # there are never too many files open, nor too much in memory
+  my ( %lines, %cores, %started );
+  my $flush = sub {
+     my $tile = shift;
+     my $name = File::Spec->catfile( $dir, join( '_', $prefix,
+                                                 split( ' ', $tile ) ) );
+     open( TILE, $started{$tile}++ ? ">>$name" : ">$name" )
+        or croak( "Error: Cannot write tile file $name" );
+     print TILE @header unless $started{$tile} > 1;
+     print TILE @{$lines{$tile}};
+     close( TILE );
+     delete $lines{$tile};
+  };
+
+  while ( my $line = <CAT> ) {
+     my @field = split ' ', $line;
+     next if @field < 8;
+
+     my $ra = 15.0*( $field[2] + $field[3]/60.0 + $field[4]/3600.0 );
+     my $dec = _dec_degrees( @field[5..7] );
+     $line .= "\n" unless $line =~ /\n\z/;
+
+     my @keys = _tile_keys( $ra, $dec, $size, $overlap );
+     $cores{$keys[0]} = 1 if @keys;
+     for my $tile ( @keys ) {
+        next if defined $wanted && !exists ${$wanted}{$tile};
+        push @{$lines{$tile}}, $line;
+        &$flush( $tile ) if @{$lines{$tile}} >= 1000;
+     }
+  }
+  close( CAT );
+  &$flush( $_ ) for keys %lines;
+
+  # make sure every wanted tile has a file, even if it is only a header
+  for my $tile ( keys %{ $wanted || {} } ) {
+     unless ( $started{$tile} ) {
+        $lines{$tile} = [];
+        &$flush( $tile );
+     }
+  }
+
+  return %cores;
+}
+
+=item B<_dec_degrees>
+
+Returns the declination in degrees from its degrees, minutes and seconds,
+which is southern if any of them are negative (so both "-00 10 00.0" and
+"-12 -30 -05.0" are read properly).
+
+   $dec = _dec_degrees( $d, $m, $s );
+
+=cut
+
+sub _dec_degrees {
+  my ( $d, $m, $s ) = @_;
+
+  my $sign = ( $d =~ /^-/ || $m < 0 || $s < 0 ) ? -1.0 : 1.0;
+  return $sign*( abs($d) + abs($m)/60.0 + abs($s)/3600.0 );
+}
+
+=item B<_run_tile>
+
+Correlates tile number $i, which is zone $zone, RA tile $ra_tile, and
+keeps the pairs whose reference positions are in its core. The result,
+as for run_corlate_data but with the bounds of the tile, is stored in
+$dir for run_corlate_tiled to pick up.
+
+   _run_tile( $dir, $i, $size, $zone, $ra_tile );
+
+=cut
+
+sub _run_tile {
+  my ( $dir, $i, $size, $zone, $ra_tile ) = @_;
+
+  my @buffers;
+  for my $prefix ( qw / ref obs / ) {
+     my $name = File::Spec->catfile( $dir, "${prefix}_${zone}_${ra_tile}" );
+     open( TILE, $name ) or croak( "Error: Cannot read tile file $name" );
+     local $/ = undef;
+     push @buffers, <TILE>;
+     close( TILE );
+  }
+
+  my $result = corlate_buffers( $buffers[0], $buffers[1] );
+  ${$result}{metrics} = corlate_metrics();
+  ${$result}{npair} = scalar( @{${$result}{pairs}} );
+
+  my ( $nra, $dec_min, $dec_max ) = _tile_bounds( $zone, $size );
+  my $width = 360.0/$nra;
+  ${$result}{ra} = [ $ra_tile*$width, ( $ra_tile + 1 )*$width ];
+  ${$result}{dec} = [ $dec_min, $dec_max ];
+
+  # keep only the pairs whose reference stars are in the core
+  my %kept;
+  my @pairs;
+  for my $pair ( @{${$result}{pairs}} ) {
+     my @ra = split ' ', ${$pair}{ra};
+     my @dec = split ' ', ${$pair}{dec};
+     my $ra = 15.0*( $ra[0] + $ra[1]/60.0 + $ra[2]/3600.0 );
+     my $dec = _dec_degrees( @dec );
+     my @keys = _tile_keys( $ra, $dec, $size, 0.0 );
+     next unless @keys && $keys[0] eq "$zone $ra_tile";
+     $kept{$pair} = 1;
+     push @pairs, $pair;
+  }
+  ${$result}{pairs} = \@pairs;
+  ${$result}{variables} = [ grep { $kept{${$_}{star}} }
+                                  @{${$result}{variables}} ];
+
+  nstore( $result, File::Spec->catfile( $dir, "result_$i" ) );
+}
+
+=item B<_record_metrics>
+
+Keeps the metrics of the run just made, with its status, and appends them
+to the metrics file (if there is one) along with the date and the names of
+the catalogues.
+
+=cut
+
+sub _record_metrics {
+  my $self = shift;
+  my $status = shift;
+  my $observation = shift;
+
+  $self->{METRICS} = corlate_metrics();
+  ${$self->{METRICS}}{status} = $status;
+
+  return unless defined $self->{METRICSFILE};
+
+  my @time = gmtime();
+  my %line = ( %{$self->{METRICS}},
+               date        => sprintf( "%04d-%02d-%02dT%02d:%02d:%02dZ",
+                                       $time[5]+1900, $time[4]+1,
+                                       @time[3,2,1,0] ),
+               reference   => ${$self->{FILES}}{reference},
+               observation => $observation );
+
+  open( METRICS, ">>$self->{METRICSFILE}" )
+     or croak( "Error: Cannot open metrics file $self->{METRICSFILE}" );
+  print METRICS _json( \%line ) . "\n";
+  close( METRICS );
+}
+
+=item B<_json>
+
+Turns a hash reference, whose values are numbers, strings or more hash
+references, into a single line of JSON.
+
+=cut
+
+sub _json {
+  my $hash = shift;
+
+  my @pairs;
+  for my $key ( sort keys %{$hash} ) {
+     my $value = ${$hash}{$key};
+     if ( ref($value) eq 'HASH' ) {
+        $value = _json( $value );
+     } elsif ( $value !~ /^-?\d+(\.\d+)?([eE][-+]?\d+)?$/ ) {
+        $value =~ s/(["\\])/\\$1/g;
+        $value =~ s/([\x00-\x1f])/sprintf("\\u%04x", ord($1))/ge;
+        $value = qq/"$value"/;
+     }
+     push @pairs, qq/"$key":$value/;
+  }
+
+  return '{' . join( ',', @pairs ) . '}';
+}
+
+=back
+
+=end __PRIVATE_METHODS__
+
+=cut
+
 # L A S T  O R D E R S ------------------------------------------------------
 
 =head1 COPYRIGHT
@@ -0,0 +1,362 @@
+   ! Benchmark and regression test for corlate.
+
+   ! First the catalogues in archive.cat and new.cat are correlated with
+   ! the default settings, and the variable stars found checked against
+   ! old_corlate.cat.  Then a synthetic two colour catalogue, and a one
+   ! colour observation of some of its stars, are made and correlated,
+   ! and the time taken to parse, index, match, fit and write them out
+   ! reported.  The variables found are checked against those put in;
+   ! at least 95% of them must be found (some are paired with the wrong
+   ! star where the catalogue is crowded), and no more than one pair in a
+   ! thousand found variable when it isn't.
+
+   ! The arguments, all of which are optional, are
+   !   1. The number of stars in the two colour catalogue (10000).
+   !   2. The density of stars, per square degree (10000).
+   !   3. The shift of the observation in RA and dec, in arcsec (2.0).
+   !   4. The number of stars observed (a tenth of the catalogue, but no
+   !      more than 10000, as the smallest false alarm probability corlate
+   !      works out is 5.861e-07, so with more pairs than about 17000 no
+   !      star is ever found to be variable).
+   !   5. The number of them made variable (one in fifty, plus one).
+   !   6. The fraction of them which are outliers, i.e. spurious
+   !      detections at random positions (0.02).
+   !   7. The seed for the random numbers (1).
+
+   ! The synthetic catalogues are written to bench_archive.cat and
+   ! bench_new.cat, and what corlate makes of them to bench_corlate.log
+   ! and so on.  The program stops with a non-zero status if either check
+   ! fails.
+
+    program benchmark
+
+      use define_star
+      use cluster_match_subs
+      use corlate_subs
+
+      implicit none
+
+      ! The synthetic catalogue.
+      integer :: nstars, nobs, nvar, seed
+      real :: density, shift, outliers
+      ! Which of the observed stars are variable, or outliers.
+      logical, dimension(:), allocatable :: injected, outlier
+
+      type(a_catalogue) :: cat
+      type(a_star), dimension(:), allocatable :: star2
+      character(len=3), dimension(mcol) :: colstr2
+      character(len=:), allocatable :: buffer
+      type(a_corlate_result) :: result
+      integer :: nstars2, ncol2, iostat, ivar, iobs
+      integer :: nfound, nmissed, nfalse, nflagged
+      real :: a, b, chisq
+      integer :: nclip
+      double precision :: t0, t_parse, t_index, t_match, t_fit, t_output
+      logical :: ok
+
+      ok=golden_check()
+
+      nstars=int(argument(1, 10000.0))
+      density=argument(2, 10000.0)
+      shift=argument(3, 2.0)
+      nobs=int(argument(4, real(min(max(nstars/10, 1), 10000))))
+      nobs=min(nobs, nstars)
+      nvar=int(argument(5, real(nobs/50+1)))
+      outliers=argument(6, 0.02)
+      seed=int(argument(7, 1.0))
+
+      allocate(injected(nobs), outlier(nobs))
+      call make_catalogues(nstars, density, shift, nobs, nvar, outliers, &
+      seed, injected, outlier)
+
+      ! Parse the two catalogues.
+      t0=wall_time()
+      call read_whole_file('bench_archive.cat', buffer, iostat)
+      call parse_cluster_buffer(buffer, cat%nstars, ncol2, cat%colstr, &
+      cat%star)
+      deallocate(buffer)
+      call load_cluster_file('bench_new.cat', nstars2, ncol2, colstr2, &
+      star2, iostat)
+      t_parse=wall_time()-t0
+
+      ! Index the two colour one.
+      t0=wall_time()
+      call finish_catalogue(cat, config%inital_rad)
+      t_index=wall_time()-t0
+
+      ! Match them, which includes the fit.
+      t0=wall_time()
+      call corlate_match(cat, star2(1:nstars2), colstr2, result)
+      t_match=wall_time()-t0
+
+      ! So do the fit again on its own.
+      t_fit=0.0d0
+      if (result%status == 0) then
+        t0=wall_time()
+        call fit(result%pair(1:result%npair)%col(2)%data, &
+        result%pair(1:result%npair)%col(1)%data, &
+        result%pair(1:result%npair)%col(1)%err, result%npair, &
+        config%clip, a, b, chisq, nclip)
+        t_fit=wall_time()-t0
+      end if
+
+      t0=wall_time()
+      call write_corlate_result(result, 'bench_corlate.log', &
+      'bench_corlate.cat', 'bench_colfit.cat', 'bench_colfit.fit', &
+      'bench_hist.dat', 'bench_info.dat')
+      t_output=wall_time()-t0
+
+      ! Check the variables found against those put in.  Those paired
+      ! with an outlier don't count either way.
+      nfound=0
+      nfalse=0
+      nflagged=0
+      do ivar=1, result%nvar
+        iobs=result%pair(result%var(ivar))%id
+        if (outlier(iobs)) then
+          nflagged=nflagged+1
+        else if (injected(iobs)) then
+          nfound=nfound+1
+        else
+          nfalse=nfalse+1
+        end if
+      end do
+      nmissed=count(injected .and. .not.outlier)-nfound
+
+      write(*,*)
+      write(*,'(1x,a,t40,i10)') 'Stars in the catalogue', cat%nstars
+      write(*,'(1x,a,t40,i10)') 'Stars observed', nstars2
+      write(*,'(1x,a,t40,i10)') 'Pairs', result%npair
+      write(*,'(1x,a,t40,2f10.3)') 'Shift put in (arcsec)', shift, -shift
+      write(*,'(1x,a,t40,2f10.3)') 'Shift found (arcsec)', &
+      result%shift_alpha, result%shift_delta
+      write(*,'(1x,a,t40,f10.3)') 'Parse (s)', t_parse
+      write(*,'(1x,a,t40,f10.3)') 'Index (s)', t_index
+      write(*,'(1x,a,t40,f10.3)') 'Match, including the fit (s)', t_match
+      write(*,'(1x,a,t40,f10.3)') 'Fit (s)', t_fit
+      write(*,'(1x,a,t40,f10.3)') 'Output (s)', t_output
+      write(*,'(1x,a,t40,i10)') 'Variables put in', count(injected)
+      write(*,'(1x,a,t40,i10)') 'Variables found', nfound
+      write(*,'(1x,a,t40,i10)') 'Variables missed', nmissed
+      write(*,'(1x,a,t40,i10)') 'False variables', nfalse
+      write(*,'(1x,a,t40,i10)') 'Outliers found variable', nflagged
+
+      if (result%status /= 0 .or. 20*nmissed > nfound+nmissed &
+      .or. 1000*nfalse > result%npair) then
+        write(*,*) 'Synthetic catalogue: FAILED (status ', &
+        result%status, ')'
+        ok=.false.
+      else
+        write(*,*) 'Synthetic catalogue: ok'
+      end if
+
+      call free_catalogue(cat)
+      if (.not. ok) stop 1
+
+      contains
+
+
+      real function argument(i, default)
+
+        ! The i'th command line argument, or default if it isn't there.
+
+        integer, intent(in) :: i
+        real, intent(in) :: default
+
+        character(len=80) :: arg
+        integer :: iostat
+
+        argument=default
+        if (command_argument_count() < i) return
+        call get_command_argument(i, arg)
+        read(arg,*,iostat=iostat) argument
+        if (iostat /= 0) argument=default
+
+      end function argument
+
+
+      real function gauss()
+
+        ! A random number from a normal distribution of unit variance.
+
+        real :: u1, u2
+
+        call random_number(u1)
+        call random_number(u2)
+        gauss=sqrt(-2.0*log(1.0-u1))*cos(8.0*atan(1.0)*u2)
+
+      end function gauss
+
+
+      subroutine set_position(star, ra, dec)
+
+        ! Sets the position of star from an RA and dec in degrees.
+
+        type(a_star), intent(inout) :: star
+        double precision, intent(in) :: ra, dec
+
+        double precision :: value
+
+        value=modulo(ra, 360.0d0)/15.0d0
+        star%ra_h=int(value)
+        value=60.0d0*(value-star%ra_h)
+        star%ra_m=int(value)
+        star%ra_s=real(60.0d0*(value-star%ra_m))
+
+        value=abs(dec)
+        star%dc_d=int(value)
+        value=60.0d0*(value-star%dc_d)
+        star%dc_m=int(value)
+        star%dc_s=real(60.0d0*(value-star%dc_m))
+        star%dc_sign='+'
+        if (dec < 0.0d0) star%dc_sign='-'
+
+      end subroutine set_position
+
+
+      subroutine make_catalogues(nstars, density, shift, nobs, nvar, &
+      outliers, seed, injected, outlier)
+
+        ! Writes a synthetic two colour catalogue of nstars stars, with
+        ! R magnitudes from 12 to 19 and B-R colours from 0 to 3, spread
+        ! evenly over a square field centred on RA 12h, dec +30, big
+        ! enough to give the density asked for.  The first nobs of them
+        ! are observed in V, with V=R+0.3(B-R)-4.5, shifted by shift
+        ! arcsec in RA and -shift in dec, and with 0.3 arcsec of scatter.
+        ! nvar of the observed stars brighten by a magnitude, and a
+        ! fraction outliers of them are replaced by stars at random
+        ! positions in the field.
+
+        integer, intent(in) :: nstars, nobs, nvar, seed
+        real, intent(in) :: density, shift, outliers
+        logical, dimension(:), intent(out) :: injected, outlier
+
+        type(a_star) :: star
+        double precision :: width, ra, dec, cosdec
+        real :: r_mag, b_r, v_err, u
+        integer :: i, nseed
+        integer, dimension(:), allocatable :: seeds
+
+        call random_seed(size=nseed)
+        allocate(seeds(nseed))
+        seeds=seed+37*(/ (i, i=0, nseed-1) /)
+        call random_seed(put=seeds)
+
+        ! Spread the variables evenly through the observed stars.
+        injected=.false.
+        do i=1, nvar
+          injected(1+((i-1)*nobs)/nvar)=.true.
+        end do
+
+        width=sqrt(dble(nstars)/dble(density))
+        call zero_star(star)
+
+        open(unit=11, file='bench_archive.cat', status='replace')
+        write(11,'(a)') ' 2 colours were created.'
+        write(11,'(a)') '  R   B-R'
+        write(11,'(a)') ' A synthetic catalogue.'
+        open(unit=12, file='bench_new.cat', status='replace')
+        write(12,'(a)') ' 1  colours were created.'
+        write(12,'(a)') '  V'
+        write(12,'(a)') ' '
+
+        do i=1, nstars
+          call random_number(u)
+          dec=30.0d0+width*(dble(u)-0.5d0)
+          cosdec=cos(dec*atan(1.0d0)/45.0d0)
+          call random_number(u)
+          ra=180.0d0+width*(dble(u)-0.5d0)/cosdec
+          call random_number(u)
+          r_mag=12.0+7.0*u
+          call random_number(u)
+          b_r=3.0*u
+
+          star%field=1+(i-1)/999999
+          star%id=1+mod(i-1, 999999)
+          star%x=0.0
+          star%y=0.0
+          call set_position(star, ra, dec)
+          star%col(1)%data=r_mag+0.02*gauss()
+          star%col(1)%err=0.02
+          star%col(1)%flg='OO'
+          star%col(2)%data=b_r+0.03*gauss()
+          star%col(2)%err=0.03
+          star%col(2)%flg='OO'
+          call write_star(11, star, 2)
+
+          if (i <= nobs) then
+            star%field=1
+            star%id=i
+            call random_number(u)
+            outlier(i)=(u < outliers)
+            if (outlier(i)) then
+              call random_number(u)
+              dec=30.0d0+width*(dble(u)-0.5d0)
+              call random_number(u)
+              ra=180.0d0+width*(dble(u)-0.5d0)/cosdec
+              call random_number(u)
+              r_mag=12.0+7.0*u
+            end if
+            ra=ra+(shift+0.3*gauss())/(3600.0d0*cosdec)
+            dec=dec+(-shift+0.3*gauss())/3600.0d0
+            call set_position(star, ra, dec)
+            call random_number(u)
+            star%x=500.0*u
+            call random_number(u)
+            star%y=500.0*u
+            call random_number(u)
+            v_err=0.02+0.08*u
+            star%col(1)%data=r_mag+0.3*b_r-4.5+v_err*gauss()
+            if (injected(i)) star%col(1)%data=star%col(1)%data-1.0
+            star%col(1)%err=v_err
+            call write_star(12, star, 1)
+          end if
+        end do
+
+        close(11)
+        close(12)
+
+      end subroutine make_catalogues
+
+
+      logical function golden_check()
+
+        ! Correlates archive.cat and new.cat with the default settings,
+        ! and checks the variables found are those in old_corlate.cat,
+        ! with the same colours to within 0.002 magnitudes (the files
+        ! are written to 0.001).
+
+        type(a_star), dimension(:), allocatable :: old, new
+        character(len=3), dimension(mcol) :: colstr
+        integer :: nold, nnew, ncol, iostat, status, i
+
+        golden_check=.false.
+        status=set_corlate_preset('default')
+        status=corlate_files('archive.cat', 'new.cat', 'bench_corlate.log', &
+        'bench_corlate.cat', 'bench_colfit.cat', 'bench_colfit.fit', &
+        'bench_hist.dat', 'bench_info.dat')
+        call load_cluster_file('old_corlate.cat', nold, ncol, colstr, old, &
+        iostat)
+        if (status == 0 .and. iostat == 0) then
+          call load_cluster_file('bench_corlate.cat', nnew, ncol, colstr, &
+          new, iostat)
+          if (iostat == 0 .and. nnew == nold) then
+            golden_check=.true.
+            do i=1, nold
+              if (new(i)%id /= old(i)%id) golden_check=.false.
+              if (any(abs(new(i)%col(1:ncol)%data &
+                         -old(i)%col(1:ncol)%data) > 0.002)) &
+              golden_check=.false.
+            end do
+          end if
+        end if
+
+        if (golden_check) then
+          write(*,*) 'Variables against old_corlate.cat: ok'
+        else
+          write(*,*) 'Variables against old_corlate.cat: FAILED'
+        end if
+
+      end function golden_check
+
+    end program benchmark
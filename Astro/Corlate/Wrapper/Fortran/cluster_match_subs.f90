@@ -4,98 +4,514 @@
 
     implicit none
 
+    ! An index of a catalogue for match_them.  The stars are put into
+    ! declination zones, and sorted by RA within each zone, so a match only
+    ! has to look at the stars in a small RA range of the zones within the
+    ! matching radius, rather than at the whole catalogue.  The positions
+    ! are kept as double precision unit vectors, in zone order, so the
+    ! test for a match is a dot product, rather than the trigonometry
+    ! (in single precision) it used to be.
+    type a_match_index
+      ! The number of zones, their height and the declination of the
+      ! bottom of the first zone (all in radians).
+      integer :: nzone
+      double precision :: zone_height, dc_min
+      ! The stars in zone iz are order(zone_start(iz)+1:zone_start(iz+1)),
+      ! and their RAs and unit vectors are zone_alpha and x, y and z over 
+      ! the same range.
+      integer, dimension(:), allocatable :: zone_start
+      integer, dimension(:), allocatable :: order
+      double precision, dimension(:), allocatable :: zone_alpha
+      double precision, dimension(:), allocatable :: x, y, z
+    end type a_match_index
+
+    ! A catalogue ready to match against: the stars, their RAs and decs in
+    ! radians, and an index of them.  Only the first nstars elements of 
+    ! star are used.
+    type a_catalogue
+      integer :: nstars
+      character(len=3), dimension(mcol) :: colstr
+      type(a_star), dimension(:), allocatable :: star
+      real, dimension(:), allocatable :: alpha, delta
+      type(a_match_index) :: index
+      ! The zone height the index was made with.
+      real :: zone_rad
+    end type a_catalogue
+
+    ! Identifies a catalogue cache file, and the version of its layout.
+    character(len=8), parameter, private :: cache_magic='CORLATEC'
+    integer, parameter, private :: cache_version=1
+
+    ! An integer kind for counts which may not fit in a default integer.
+    integer, parameter :: long=selected_int_kind(18)
+
+    ! The C library's rename and getpid, so a cache can be written to a
+    ! file of its own and then moved into place in one step.
+    interface
+      integer(c_int) function c_rename(old, new) bind(c, name='rename')
+        use iso_c_binding, only : c_int, c_char
+        character(kind=c_char), dimension(*), intent(in) :: old, new
+      end function c_rename
+      integer(c_int) function c_getpid() bind(c, name='getpid')
+        use iso_c_binding, only : c_int
+      end function c_getpid
+    end interface
+
     contains
 
     subroutine read_cluster_file(file, nstars, ncol, colstr, star) 
 
-      ! Reads in a cluster format file on an already open unit.
+      ! Reads a cluster format file which has been read into an array of
+      ! lines.  star is allocated for every line after the header, but only
+      ! the first nstars are used, as blank lines are skipped and lines 
+      ! which can't be read are reported and skipped.
 
       character(len=*), dimension(:), intent(in) :: file
       integer, intent(out) :: nstars, ncol
       character(len=*), dimension(:), intent(out) :: colstr
       type(a_star), dimension(:), allocatable, intent(out) :: star
 
-      integer :: iostat, i, istar
-      character(len=30) :: tmpstr
+      integer :: i
 
-      ! Three lines of header.
+      call read_cluster_header(file(1), file(2), ncol, colstr)
       nstars=0
-      count_them: do i=4, size(file)
-        read(file(i),*, iostat=iostat)
-        if (iostat < 0) exit count_them
-        nstars=nstars+1
-      end do count_them
-      read(file(1),*,iostat=iostat) ncol
+      allocate(star(max(0, size(file)-3)))
+      do i=4, size(file)
+        call add_star(file(i), i, ncol, star, nstars)
+      end do
+
+    end subroutine read_cluster_file
+
+
+    subroutine load_cluster_file(file_name, nstars, ncol, colstr, star, &
+    iostat) 
+
+      ! Reads a cluster format file straight from disc.  The whole file is
+      ! read in one go, and the stars parsed out of it, so there is no
+      ! limit on the length of the lines.  Otherwise it behaves as
+      ! read_cluster_file.  iostat is non-zero if the file can't be read.
+
+      character(len=*), intent(in) :: file_name
+      integer, intent(out) :: nstars, ncol, iostat
+      character(len=*), dimension(:), intent(out) :: colstr
+      type(a_star), dimension(:), allocatable, intent(out) :: star
+
+      character(len=:), allocatable :: buffer
+
+      nstars=0
+      call read_whole_file(file_name, buffer, iostat)
+      if (iostat /= 0) return
+      call parse_cluster_buffer(buffer, nstars, ncol, colstr, star)
+
+    end subroutine load_cluster_file
+
+
+    subroutine read_whole_file(file_name, buffer, iostat)
+
+      ! Reads a file into a single string.
+
+      character(len=*), intent(in) :: file_name
+      character(len=:), allocatable, intent(out) :: buffer
+      integer, intent(out) :: iostat
+
+      integer :: nbyte
+
+      open(unit=1, file=file_name, status='old', action='read', &
+      access='stream', form='unformatted', iostat=iostat)
+      if (iostat /= 0) return
+      inquire(unit=1, size=nbyte)
+      allocate(character(len=max(0, nbyte)) :: buffer)
+      if (nbyte > 0) read(1, iostat=iostat) buffer
+      close(1)
+
+    end subroutine read_whole_file
+
+
+    subroutine parse_cluster_buffer(buffer, nstars, ncol, colstr, star)
+
+      ! Parses the contents of a cluster format file, held in a single
+      ! string with the lines separated by newlines.
+
+      character(len=*), intent(in) :: buffer
+      integer, intent(out) :: nstars, ncol
+      character(len=*), dimension(:), intent(out) :: colstr
+      type(a_star), dimension(:), allocatable, intent(out) :: star
+
+      integer :: nbyte, nline, iline, start, finish
+      character(len=1) :: newline
+      character(len=0) :: empty
+
+      newline=achar(10)
+      nbyte=len(buffer)
+
+      ! Count the lines, so the stars can be allocated.
+      nline=0
+      start=1
+      do while (start <= nbyte)
+        finish=index(buffer(start:), newline)
+        if (finish == 0) finish=nbyte-start+2
+        nline=nline+1
+        start=start+finish
+      end do
+      allocate(star(max(0, nline-3)))
+
+      ! And read them.
+      nstars=0
+      iline=0
+      start=1
+      empty=''
+      ncol=4
+      colstr=' '
+      do while (start <= nbyte)
+        finish=index(buffer(start:), newline)
+        if (finish == 0) then
+          finish=nbyte
+        else
+          finish=start+finish-2
+        end if
+        iline=iline+1
+        if (iline == 2) then
+          call read_cluster_header(buffer(1:start-2), &
+          buffer(start:line_end(buffer, start, finish)), ncol, colstr)
+        else if (iline > 3) then
+          call add_star(buffer(start:line_end(buffer, start, finish)), &
+          iline, ncol, star, nstars)
+        end if
+        start=finish+2
+      end do
+      if (iline == 1) call read_cluster_header(buffer, empty, ncol, colstr)
+
+    end subroutine parse_cluster_buffer
+
+
+    integer function line_end(buffer, start, finish)
+
+      ! The end of the line from start to finish in buffer, less any
+      ! carriage return.
+
+      character(len=*), intent(in) :: buffer
+      integer, intent(in) :: start, finish
+
+      line_end=finish
+      if (finish >= start) then
+        if (buffer(finish:finish) == achar(13)) line_end=finish-1
+      end if
+
+    end function line_end
+
+
+    subroutine read_cluster_header(line1, line2, ncol, colstr)
+
+      ! Reads the number of colours, and their names, from the first two
+      ! lines of a cluster format file.
+
+      character(len=*), intent(in) :: line1, line2
+      integer, intent(out) :: ncol
+      character(len=*), dimension(:), intent(out) :: colstr
+
+      integer :: iostat, i
+
+      read(line1,*,iostat=iostat) ncol
       if (iostat < 0) ncol=4
       ! The next line should have the names of the colours on it, but
       ! it may not.
-      read(file(2),*,iostat=iostat) (colstr(i),i=1,ncol)
+      read(line2,*,iostat=iostat) (colstr(i),i=1,ncol)
       if (iostat < 0) colstr=' '
-      allocate(star(nstars))
-      do istar=1, nstars
-        iostat=read_star(1, star(istar), ncol, file(istar+3))
-        if (iostat /= 0) then
-          print*, 'Error reading that file, iostat is', iostat
-          print*, 'For line number ', istar+3
-        end if
+
+    end subroutine read_cluster_header
+
+
+    subroutine add_star(line, iline, ncol, star, nstars)
+
+      ! Parses line number iline of a cluster format file into the next
+      ! element of star.
+
+      character(len=*), intent(in) :: line
+      integer, intent(in) :: iline, ncol
+      type(a_star), dimension(:), intent(inout) :: star
+      integer, intent(inout) :: nstars
+
+      integer :: ifield
+
+      if (len_trim(line) == 0) return
+      ifield=parse_star(line, star(nstars+1), ncol)
+      if (ifield == 0) then
+        nstars=nstars+1
+      else
+        print*, 'Error reading that file, at field ', ifield
+        print*, 'For line number ', iline
+      end if
+
+    end subroutine add_star
+
+
+    subroutine make_match_index(index, star, zone_rad)
+
+      ! Builds an index of a catalogue, for use by match_them.  The zones 
+      ! are zone_rad arcsec high, which should be about the largest 
+      ! matching radius.
+
+      use radec2rad_mod
+
+      type(a_match_index), intent(out) :: index
+      type(a_star), dimension(:), intent(in) :: star
+      real, intent(in) :: zone_rad
+
+      integer :: i, iz, nstars
+      integer, dimension(:), allocatable :: zone, fill
+      double precision, dimension(:), allocatable :: alpha, delta
+
+      nstars=size(star)
+      allocate(alpha(nstars), delta(nstars))
+      do i=1, nstars
+        call dradec2rad(star(i)%ra_h, star(i)%ra_m, star(i)%ra_s, &
+        star(i)%dc_d, star(i)%dc_m, star(i)%dc_s, alpha(i), delta(i))
       end do
 
-    end subroutine read_cluster_file
+      index%zone_height=dble(zone_rad)/206264.8d0
+      if (nstars > 0) then
+        index%dc_min=minval(delta)
+        ! Don't let a tiny radius make more zones than stars.
+        index%nzone=int((maxval(delta)-index%dc_min)/index%zone_height)+1
+        index%nzone=max(1, min(index%nzone, nstars))
+        index%zone_height=max(index%zone_height, &
+        (maxval(delta)-index%dc_min)/dble(index%nzone))
+      else
+        index%dc_min=0.0d0
+        index%nzone=1
+      end if
+      allocate(index%zone_start(0:index%nzone), index%order(nstars), &
+      index%zone_alpha(nstars), index%x(nstars), index%y(nstars), &
+      index%z(nstars))
+
+      ! Count the stars in each zone, then drop them into place.
+      allocate(zone(nstars), fill(0:index%nzone-1))
+      fill=0
+      do i=1, nstars
+        zone(i)=zone_number(index, delta(i))
+        fill(zone(i))=fill(zone(i))+1
+      end do
+      index%zone_start(0)=0
+      do iz=0, index%nzone-1
+        index%zone_start(iz+1)=index%zone_start(iz)+fill(iz)
+        fill(iz)=index%zone_start(iz)
+      end do
+      do i=1, nstars
+        fill(zone(i))=fill(zone(i))+1
+        index%order(fill(zone(i)))=i
+      end do
+      deallocate(zone, fill)
+
+      ! And sort each zone by RA.
+      do iz=0, index%nzone-1
+        call sort_by_alpha(alpha, &
+        index%order(index%zone_start(iz)+1:index%zone_start(iz+1)))
+      end do
+      index%zone_alpha=alpha(index%order)
+      index%x=cos(delta(index%order))*cos(alpha(index%order))
+      index%y=cos(delta(index%order))*sin(alpha(index%order))
+      index%z=sin(delta(index%order))
+      deallocate(alpha, delta)
+
+    end subroutine make_match_index
+
+
+    subroutine free_match_index(index)
+
+      type(a_match_index), intent(inout) :: index
+
+      if (allocated(index%zone_start)) deallocate(index%zone_start)
+      if (allocated(index%order)) deallocate(index%order)
+      if (allocated(index%zone_alpha)) deallocate(index%zone_alpha)
+      if (allocated(index%x)) deallocate(index%x, index%y, index%z)
+
+    end subroutine free_match_index
+
+
+    integer function zone_number(index, dec)
+
+      ! The zone a declination (in radians) falls in, clipped to the
+      ! zones there are.
+
+      type(a_match_index), intent(in) :: index
+      double precision, intent(in) :: dec
+
+      double precision :: work
+
+      work=(dec-index%dc_min)/index%zone_height
+      if (work < 0.0d0) then
+        zone_number=0
+      else if (work >= dble(index%nzone)) then
+        zone_number=index%nzone-1
+      else
+        zone_number=min(int(work), index%nzone-1)
+      end if
+
+    end function zone_number
+
+
+    subroutine sort_by_alpha(alpha, order)
+
+      ! Heapsorts the star numbers in order into increasing alpha.
+
+      double precision, dimension(:), intent(in) :: alpha
+      integer, dimension(:), intent(inout) :: order
+
+      integer :: n, i, iroot, ichild, swap
+
+      n=size(order)
+      do i=n/2, 1, -1
+        iroot=i
+        call sift(iroot, n)
+      end do
+      do i=n, 2, -1
+        swap=order(1)
+        order(1)=order(i)
+        order(i)=swap
+        iroot=1
+        call sift(iroot, i-1)
+      end do
+
+      contains
+
+      subroutine sift(iroot, nheap)
+
+        integer, intent(inout) :: iroot
+        integer, intent(in) :: nheap
+
+        do
+          ichild=2*iroot
+          if (ichild > nheap) exit
+          if (ichild < nheap) then
+            if (alpha(order(ichild+1)) > alpha(order(ichild))) ichild=ichild+1
+          end if
+          if (alpha(order(iroot)) >= alpha(order(ichild))) exit
+          swap=order(iroot)
+          order(iroot)=order(ichild)
+          order(ichild)=swap
+          iroot=ichild
+        end do
+
+      end subroutine sift
 
+    end subroutine sort_by_alpha
 
-    subroutine match_them(nstars1, star1, alpha, delta, another_star, &
-    fixrad, matches, n_matches)
+
+    subroutine match_them(index, star1, another_alpha, another_delta, &
+    fixrad, matches, n_matches, ntested)
 
       ! Originally the program cluster_match, but made into a subroutine
       ! so it could be used for the e-star project.
 
-      use radec2rad_mod
+      ! Finds the stars in star1 (via an index of it made by 
+      ! make_match_index) within fixrad arcsec of a position.  The matches
+      ! are returned in catalogue order, except that the brightest is 
+      ! swapped to the front.  If ntested is given, the number of stars
+      ! in star1 whose distance from the position was tested is added to
+      ! it.
 
       implicit none
 
-      ! The primary catalogue, its RAs and decs in radians, and the number of
-      ! stars. 
-      integer, intent(in) :: nstars1
-      type(a_star), dimension(nstars1), intent(in) :: star1
-      real, dimension(:), intent(in) :: alpha, delta
+      ! The index of the primary catalogue, and the catalogue itself.
+      type(a_match_index), intent(in) :: index
+      type(a_star), dimension(:), intent(in) :: star1
 
-      ! A star for which you want to find the matches.
-      type(a_star), intent(in) :: another_star
+      ! The position (in radians) for which you want to find the matches.
+      ! To allow for a shift between the catalogues, shift this rather
+      ! than the catalogue.
+      double precision, intent(in) :: another_alpha, another_delta
 
-      ! The matching radius (<0 if provided in another_star).
+      ! The matching radius.
       real, intent(in) :: fixrad
 
       ! The array element numbers from star1, which are possible counterparts
       ! to star2, and the number of possible matches.
-      integer, dimension(nstars1), intent(out) :: matches
+      integer, dimension(:), intent(out) :: matches
       integer, intent(out) :: n_matches
+      integer(kind=long), intent(inout), optional :: ntested
 
       ! Locals.
       integer :: i, ibright
-      real :: rad, dist, bright
-      real :: another_delta, another_alpha
-
-      call radec2rad(another_star%ra_h, another_star%ra_m, &
-      another_star%ra_s, another_star%dc_d, another_star%dc_m, &
-      another_star%dc_s, another_alpha, another_delta)
-      if (fixrad > 0) then
-        rad=fixrad
+      real :: bright
+      integer :: iz, k, kstart, kend, lo, hi, mid, iwrap
+      double precision :: rad, cos_rad, half_width, dc_far, twopi
+      double precision :: x, y, z, lower, upper
+
+      twopi=8.0d0*atan(1.0d0)
+      rad=dble(fixrad)/206264.8d0
+      cos_rad=cos(rad)
+      x=cos(another_delta)*cos(another_alpha)
+      y=cos(another_delta)*sin(another_alpha)
+      z=sin(another_delta)
+
+      ! The furthest from the equator a match can be sets how wide an RA 
+      ! range has to be looked at.  A little is added to allow for rounding,
+      ! as the exact test is done anyway.
+      dc_far=abs(another_delta)+rad
+      if (dc_far < 1.5d0) then
+        half_width=1.001d0*rad/cos(dc_far)+1.0d-12
       else
-        rad=another_star%col(1)%data
+        half_width=twopi
       end if
-      rad=rad/206264.8
+
       n_matches=0
-      do i=1, nstars1
-        if (abs(another_delta-delta(i)) < rad) then
-          dist=(another_alpha-alpha(i))
-          dist=dist*cos((another_delta+delta(i))/2.0)
-          dist=dist**2.0
-          dist=dist+(another_delta-delta(i))**2.0
-          if (dist < rad*rad) then
-            n_matches=n_matches+1
-            matches(n_matches)=i
+      do iz=zone_number(index, another_delta-rad), &
+      zone_number(index, another_delta+rad)
+        ! Look either side of RA zero, if the range crosses it.
+        do iwrap=-1, 1
+          if (half_width >= twopi) then
+            if (iwrap /= 0) cycle
+            kstart=index%zone_start(iz)+1
+            kend=index%zone_start(iz+1)
+          else
+            lower=another_alpha+dble(iwrap)*twopi-half_width
+            upper=another_alpha+dble(iwrap)*twopi+half_width
+            if (upper < 0.0d0 .or. lower > twopi) cycle
+            ! Find the first star in the zone in the RA range, and the
+            ! first after it.
+            lo=index%zone_start(iz)+1
+            hi=index%zone_start(iz+1)+1
+            do while (lo < hi)
+              mid=(lo+hi)/2
+              if (index%zone_alpha(mid) < lower) then
+                lo=mid+1
+              else
+                hi=mid
+              end if
+            end do
+            kstart=lo
+            hi=index%zone_start(iz+1)+1
+            do while (lo < hi)
+              mid=(lo+hi)/2
+              if (index%zone_alpha(mid) <= upper) then
+                lo=mid+1
+              else
+                hi=mid
+              end if
+            end do
+            kend=lo-1
           end if
-        end if
+          if (present(ntested)) ntested=ntested+max(0, kend-kstart+1)
+          do k=kstart, kend
+            if (index%x(k)*x+index%y(k)*y+index%z(k)*z > cos_rad) then
+              n_matches=n_matches+1
+              matches(n_matches)=index%order(k)
+            end if
+          end do
+        end do
+      end do
+
+      ! Put the matches back in catalogue order, as a search through the
+      ! whole catalogue would find them.
+      do k=2, n_matches
+        i=matches(k)
+        mid=k-1
+        do while (mid >= 1)
+          if (matches(mid) <= i) exit
+          matches(mid+1)=matches(mid)
+          mid=mid-1
+        end do
+        matches(mid+1)=i
       end do
 
       if (n_matches > 1) then
@@ -119,4 +535,360 @@
 
     end subroutine match_them
 
+    subroutine make_catalogue(cat, star, colstr, zone_rad)
+
+      ! Makes a catalogue to match against from an array of stars, with
+      ! its index's zones zone_rad arcsec high.
+
+      type(a_catalogue), intent(out) :: cat
+      type(a_star), dimension(:), intent(in) :: star
+      character(len=*), dimension(:), intent(in) :: colstr
+      real, intent(in) :: zone_rad
+
+      cat%nstars=size(star)
+      cat%colstr=' '
+      cat%colstr(1:min(mcol, size(colstr)))=colstr(1:min(mcol, size(colstr)))
+      allocate(cat%star(cat%nstars))
+      cat%star=star
+      call finish_catalogue(cat, zone_rad)
+
+    end subroutine make_catalogue
+
+
+    subroutine finish_catalogue(cat, zone_rad)
+
+      ! Works out the positions in radians, and the index, for a catalogue
+      ! whose stars have been read.
+
+      use radec2rad_mod
+
+      type(a_catalogue), intent(inout) :: cat
+      real, intent(in) :: zone_rad
+
+      integer :: i
+
+      allocate(cat%alpha(cat%nstars), cat%delta(cat%nstars))
+      do i=1, cat%nstars
+        call radec2rad(cat%star(i)%ra_h, cat%star(i)%ra_m, &
+        cat%star(i)%ra_s, cat%star(i)%dc_d, cat%star(i)%dc_m, &
+        cat%star(i)%dc_s, cat%alpha(i), cat%delta(i))
+      end do
+      cat%zone_rad=zone_rad
+      call make_match_index(cat%index, cat%star(1:cat%nstars), zone_rad)
+
+    end subroutine finish_catalogue
+
+
+    subroutine free_catalogue(cat)
+
+      type(a_catalogue), intent(inout) :: cat
+
+      if (allocated(cat%star)) deallocate(cat%star)
+      if (allocated(cat%alpha)) deallocate(cat%alpha, cat%delta)
+      call free_match_index(cat%index)
+
+    end subroutine free_catalogue
+
+
+    subroutine load_catalogue(file_name, cache_name, zone_rad, cat, iostat, &
+    t_index)
+
+      ! Reads a catalogue to match against from a cluster format file.
+      ! If cache_name isn't blank, it is the name of a binary cache of 
+      ! the catalogue, its positions and index.  If the cache was made from
+      ! a file with the same contents it is used instead of parsing the 
+      ! file, otherwise the cache is (re)written after the file is parsed.
+      ! iostat is non-zero if the cluster file can't be read.  If t_index
+      ! is given it is set to the time (in seconds) spent indexing the
+      ! catalogue, which is zero if it came from the cache.
+
+      character(len=*), intent(in) :: file_name, cache_name
+      real, intent(in) :: zone_rad
+      type(a_catalogue), intent(out) :: cat
+      integer, intent(out) :: iostat
+      double precision, intent(out), optional :: t_index
+
+      character(len=:), allocatable :: buffer
+      integer(kind=long), dimension(3) :: hash
+      integer :: ncol, cache_stat
+      double precision :: t0
+
+      if (present(t_index)) t_index=0.0d0
+      call read_whole_file(file_name, buffer, iostat)
+      if (iostat /= 0) return
+
+      if (len_trim(cache_name) > 0) then
+        call hash_buffer(buffer, hash)
+        call read_catalogue_cache(cache_name, hash, zone_rad, cat, cache_stat)
+        if (cache_stat == 0) return
+        call free_catalogue(cat)
+      end if
+
+      call parse_cluster_buffer(buffer, cat%nstars, ncol, cat%colstr, &
+      cat%star)
+      deallocate(buffer)
+      t0=wall_time()
+      call finish_catalogue(cat, zone_rad)
+      if (present(t_index)) t_index=wall_time()-t0
+
+      if (len_trim(cache_name) > 0) &
+      call write_catalogue_cache(cache_name, hash, cat)
+
+    end subroutine load_catalogue
+
+
+    double precision function wall_time()
+
+      ! The wall clock time in seconds, for timing things.
+
+      integer(kind=long) :: count, rate
+
+      call system_clock(count, rate)
+      wall_time=dble(count)/dble(rate)
+
+    end function wall_time
+
+
+    subroutine hash_buffer(buffer, hash)
+
+      ! A hash of the contents of a file, to tell if a cache is still 
+      ! valid.  Two 32 bit hashes (FNV-1a and sdbm) and the length, which
+      ! is plenty to spot a changed catalogue.
+
+      character(len=*), intent(in) :: buffer
+      integer(kind=long), dimension(3), intent(out) :: hash
+
+      integer(kind=long), parameter :: mask=4294967295_long
+      integer(kind=long) :: fnv, sdbm, byte
+      integer :: i
+
+      fnv=2166136261_long
+      sdbm=0
+      do i=1, len(buffer)
+        byte=int(ichar(buffer(i:i)), kind=long)
+        fnv=iand(ieor(fnv, byte)*16777619_long, mask)
+        sdbm=iand(byte+sdbm*65599_long, mask)
+      end do
+      hash(1)=fnv
+      hash(2)=sdbm
+      hash(3)=len(buffer)
+
+    end subroutine hash_buffer
+
+
+    subroutine write_catalogue_cache(cache_name, hash, cat)
+
+      ! Writes a catalogue, column by column, into a cache file.  The cache
+      ! is written to a file of its own in the same directory, which is
+      ! renamed over the cache when it's complete, so a process reading 
+      ! the cache (or writing it at the same time) never sees half of one.
+      ! The header is written last as well.  It doesn't matter if the 
+      ! cache can't be written.
+
+      use iso_c_binding, only : c_null_char
+
+      character(len=*), intent(in) :: cache_name
+      integer(kind=long), dimension(3), intent(in) :: hash
+      type(a_catalogue), intent(in) :: cat
+
+      integer :: iostat, icol, n
+      integer(kind=long), dimension(3) :: no_hash
+      character(len=len_trim(cache_name)+16) :: temp_name
+
+      n=cat%nstars
+      no_hash=-1
+      write(temp_name, '(a,a,i0)') trim(cache_name), '.tmp', c_getpid()
+      open(unit=1, file=temp_name, status='replace', access='stream', &
+      form='unformatted', iostat=iostat)
+      if (iostat /= 0) return
+      write(1, iostat=iostat) cache_magic, cache_version, no_hash, mcol, &
+      cat%zone_rad, n, cat%colstr
+      call put_ints(cat%star(1:n)%field)
+      call put_ints(cat%star(1:n)%id)
+      call put_ints(cat%star(1:n)%ccd)
+      call put_ints(cat%star(1:n)%ra_h)
+      call put_ints(cat%star(1:n)%ra_m)
+      call put_reals(cat%star(1:n)%ra_s)
+      call put_ints(cat%star(1:n)%dc_d)
+      call put_ints(cat%star(1:n)%dc_m)
+      call put_reals(cat%star(1:n)%dc_s)
+      call put_chars(cat%star(1:n)%dc_sign)
+      call put_reals(cat%star(1:n)%x)
+      call put_reals(cat%star(1:n)%y)
+      do icol=1, mcol
+        call put_reals(cat%star(1:n)%col(icol)%data)
+        call put_reals(cat%star(1:n)%col(icol)%err)
+        call put_chars(cat%star(1:n)%col(icol)%flg)
+      end do
+      call put_reals(cat%alpha(1:n))
+      call put_reals(cat%delta(1:n))
+      if (iostat == 0) write(1, iostat=iostat) cat%index%nzone, &
+      cat%index%zone_height, cat%index%dc_min, cat%index%zone_start, &
+      cat%index%order, cat%index%zone_alpha, cat%index%x, cat%index%y, &
+      cat%index%z
+      if (iostat == 0) write(1, pos=1, iostat=iostat) cache_magic, &
+      cache_version, hash
+      if (iostat == 0) then
+        close(1, iostat=iostat)
+        if (iostat == 0) iostat=c_rename(trim(temp_name)//c_null_char, &
+        trim(cache_name)//c_null_char)
+      end if
+      if (iostat /= 0) then
+        close(1, status='delete', iostat=icol)
+        open(unit=1, file=temp_name, status='old', iostat=icol)
+        if (icol == 0) close(1, status='delete')
+      end if
+
+      contains
+
+      ! The columns are passed as explicit shape arrays, so each is 
+      ! written from a contiguous copy, which is much faster than writing
+      ! a component of an array of stars directly.
+
+      subroutine put_ints(column)
+
+        integer, dimension(n), intent(in) :: column
+
+        if (iostat == 0) write(1, iostat=iostat) column
+
+      end subroutine put_ints
+
+      subroutine put_reals(column)
+
+        real, dimension(n), intent(in) :: column
+
+        if (iostat == 0) write(1, iostat=iostat) column
+
+      end subroutine put_reals
+
+      subroutine put_chars(column)
+
+        character(len=*), dimension(n), intent(in) :: column
+
+        if (iostat == 0) write(1, iostat=iostat) column
+
+      end subroutine put_chars
+
+    end subroutine write_catalogue_cache
+
+
+    subroutine read_catalogue_cache(cache_name, hash, zone_rad, cat, iostat)
+
+      ! Reads a catalogue from a cache file, if there is one which was made
+      ! from a file with the given hash, with the given zone height.  
+      ! Otherwise iostat is non-zero.  The index is checked before it's
+      ! used, as match_them trusts it to stay within the catalogue.
+
+      character(len=*), intent(in) :: cache_name
+      integer(kind=long), dimension(3), intent(in) :: hash
+      real, intent(in) :: zone_rad
+      type(a_catalogue), intent(inout) :: cat
+      integer, intent(out) :: iostat
+
+      character(len=len(cache_magic)) :: magic
+      integer :: version, ncol, icol, n, nzone, iz
+      integer(kind=long), dimension(3) :: cache_hash
+      real :: cache_zone_rad
+
+      open(unit=1, file=cache_name, status='old', action='read', &
+      access='stream', form='unformatted', iostat=iostat)
+      if (iostat /= 0) return
+      read(1, iostat=iostat) magic, version, cache_hash, ncol, &
+      cache_zone_rad, n
+      if (iostat == 0) then
+        if (magic /= cache_magic .or. version /= cache_version .or. &
+        any(cache_hash /= hash) .or. ncol /= mcol .or. &
+        cache_zone_rad /= zone_rad .or. n < 0) iostat=-1
+      end if
+      if (iostat /= 0) then
+        close(1)
+        return
+      end if
+
+      cat%nstars=n
+      cat%zone_rad=zone_rad
+      allocate(cat%star(n), cat%alpha(n), cat%delta(n), stat=iostat)
+      if (iostat /= 0) then
+        close(1)
+        return
+      end if
+      read(1, iostat=iostat) cat%colstr
+      call get_ints(cat%star%field)
+      call get_ints(cat%star%id)
+      call get_ints(cat%star%ccd)
+      call get_ints(cat%star%ra_h)
+      call get_ints(cat%star%ra_m)
+      call get_reals(cat%star%ra_s)
+      call get_ints(cat%star%dc_d)
+      call get_ints(cat%star%dc_m)
+      call get_reals(cat%star%dc_s)
+      call get_chars(cat%star%dc_sign)
+      call get_reals(cat%star%x)
+      call get_reals(cat%star%y)
+      do icol=1, mcol
+        call get_reals(cat%star%col(icol)%data)
+        call get_reals(cat%star%col(icol)%err)
+        call get_chars(cat%star%col(icol)%flg)
+      end do
+      call get_reals(cat%alpha)
+      call get_reals(cat%delta)
+      if (iostat == 0) read(1, iostat=iostat) nzone, &
+      cat%index%zone_height, cat%index%dc_min
+      if (iostat == 0 .and. nzone < 1) iostat=-1
+      if (iostat == 0) then
+        cat%index%nzone=nzone
+        allocate(cat%index%zone_start(0:nzone), cat%index%order(n), &
+        cat%index%zone_alpha(n), cat%index%x(n), cat%index%y(n), &
+        cat%index%z(n), stat=iostat)
+      end if
+      if (iostat == 0) read(1, iostat=iostat) cat%index%zone_start, &
+      cat%index%order, cat%index%zone_alpha, cat%index%x, cat%index%y, &
+      cat%index%z
+      close(1)
+
+      ! The zones must run in order from the first star to the last, and
+      ! every star in them must be in the catalogue.
+      if (iostat == 0) then
+        if (cat%index%zone_start(0) /= 0 .or. &
+        cat%index%zone_start(nzone) /= n) iostat=-1
+      end if
+      if (iostat == 0) then
+        do iz=1, nzone
+          if (cat%index%zone_start(iz) < cat%index%zone_start(iz-1)) &
+          iostat=-1
+        end do
+        if (any(cat%index%order < 1 .or. cat%index%order > n)) iostat=-1
+      end if
+
+      contains
+
+      ! As in write_catalogue_cache, the columns are read into contiguous
+      ! copies.
+
+      subroutine get_ints(column)
+
+        integer, dimension(n), intent(out) :: column
+
+        if (iostat == 0) read(1, iostat=iostat) column
+
+      end subroutine get_ints
+
+      subroutine get_reals(column)
+
+        real, dimension(n), intent(out) :: column
+
+        if (iostat == 0) read(1, iostat=iostat) column
+
+      end subroutine get_reals
+
+      subroutine get_chars(column)
+
+        character(len=*), dimension(n), intent(out) :: column
+
+        if (iostat == 0) read(1, iostat=iostat) column
+
+      end subroutine get_chars
+
+    end subroutine read_catalogue_cache
+
   end module cluster_match_subs
@@ -10,84 +10,374 @@
 
   module corlate_subs
 
+    use define_star
+    use cluster_match_subs, only : long
+
     implicit none
 
+    ! The number of threads to match stars with (0 for the OpenMP default).
+    ! Only used if compiled with OpenMP, otherwise corlate runs serially.
+    integer, save :: corlate_threads=0
+
+    ! Some things you may want to tweak, which are set at run time with
+    ! set_corlate_preset and set_corlate_option.  The defaults are those
+    ! corlate was originally written with; the presets are in 
+    ! corlate_preset.
+    type a_corlate_config
+      ! The minimum number of stars in common you must have.
+      integer :: minpair=10
+      ! The lowest signal-to-noise stars you will use in the correlation.
+      real :: lowest_sn=0.1
+      ! The false alarm probablility you are prepared to accept.
+      real :: accept_prob=0.01
+      ! Set this true if you want to find stars that have faded as well as
+      ! those which have brightened.
+      logical :: allow_fading=.false.
+      ! The initial search radius.
+      real :: inital_rad=8.0
+      ! Set this true to shift the catalogues by the modal separation 
+      ! between them on the first pass, found with a resolution (in 
+      ! arcsec) of shift_step.
+      logical :: modal_shift=.true.
+      real :: shift_step=1.0
+      ! Search radius after tweaking positions, to which rms_rad times the
+      ! RMS separation on the first pass is added in quadrature.
+      real :: final_rad=3.0
+      real :: rms_rad=0.0
+      ! Minimum change in magnitude to believe variable.
+      real :: min_mag_change=0.0
+      ! Points more than clip times the chi-squared from the fit are 
+      ! clipped out of it.
+      real :: clip=4.0
+      ! Set this true to replace colour one of the variable star catalogue
+      ! with the change in magnitude.
+      logical :: var_mag_change=.false.
+      ! Set this true to write the histogram of probabilities out, rather
+      ! than just its header.
+      logical :: write_histogram=.false.
+    end type a_corlate_config
+
+    ! The settings corlate runs with.
+    type(a_corlate_config), save :: config
+
+    ! The number of bins in the histogram of probabilities.
+    integer, parameter :: mprob=101
+
+    ! How long (in seconds of wall clock time) each stage of a call took,
+    ! and how much it did, for finding out which frames are slow.
+    type a_corlate_metrics
+      ! Reading the catalogues, indexing the two colour one, the first
+      ! and second passes through the matching, the fit, working out the
+      ! probabilities and writing the output files.
+      double precision :: t_read=0.0d0, t_index=0.0d0
+      double precision :: t_first=0.0d0, t_second=0.0d0
+      double precision :: t_fit=0.0d0, t_prob=0.0d0, t_output=0.0d0
+      ! The numbers of stars in the two catalogues, of stars from the two
+      ! colour catalogue whose distance from one in the other was tested
+      ! (on both passes), of pairs kept for the fit, and of those clipped
+      ! out of it.
+      integer :: nstars1=0, nstars2=0
+      integer(kind=long) :: ntested=0
+      integer :: npair=0, nclip=0
+    end type a_corlate_metrics
+
+    ! Everything corlate finds, before it is written out.
+    type a_corlate_result
+      ! The return value (see corlate_catalogue).
+      integer :: status
+      ! The names of the colours in the two catalogues.
+      character(len=3), dimension(mcol) :: colstr1, colstr2
+      ! The number of pairs on the first pass, and the modal separation 
+      ! (in arcsec) between the catalogues or the RMS separation (if 
+      ! config%modal_shift is false) which they gave.
+      integer :: npair_first
+      real :: shift_alpha, shift_delta, first_rms
+      ! The paired stars, with colours as in file_name_5 of 
+      ! corlate_catalogue, and their RMS separation in arcsec.
+      integer :: npair
+      type(a_star), dimension(:), allocatable :: pair
+      real :: dist_mean
+      ! The fit mag_diff = b*colour + a, and two points which define it.
+      real :: a, b, chisq
+      integer :: nclip
+      real, dimension(2) :: fit_x, fit_y
+      ! The variable stars, as indices into pair, with their increase in 
+      ! brightness, its error and the false alarm probability.
+      integer :: nvar
+      integer, dimension(:), allocatable :: var
+      real, dimension(:), allocatable :: var_delta_mag, var_err, var_prob
+      ! The histogram of -log10 of the false alarm probability for every
+      ! star which changed by more than min_mag_change, in mprob bins from
+      ! zero to prob_max.
+      integer :: nprob
+      real :: prob_max
+      real, dimension(mprob) :: bin
+      ! What it took to find all this.
+      type(a_corlate_metrics) :: metrics
+    end type a_corlate_result
+
+    ! The results of the last call to corlate_buffers or corlate_batch, 
+    ! one for each observation, which are kept until the next call so the
+    ! caller can copy them out.
+    type(a_corlate_result), dimension(:), allocatable, save :: last_results
+
+    ! The metrics for the whole of the last call to any of the corlate
+    ! functions.  For a batch the times are summed over the frames, so
+    ! when they are done in parallel may add up to more than the call took.
+    type(a_corlate_metrics), save :: last_metrics
+
     contains
 
-    real function pchisq(chisq)
+    subroutine set_corlate_threads(nthreads)
+
+      ! Sets the number of threads corlate uses to match stars.
+
+      integer, intent(in) :: nthreads
+
+      corlate_threads=max(0, nthreads)
+
+    end subroutine set_corlate_threads
+
+
+    subroutine corlate_preset(name, preset, status)
+
+      ! Returns the settings for the named survey profile, with status 
+      ! -1 if there is no such profile.
+
+      character(len=*), intent(in) :: name
+      type(a_corlate_config), intent(out) :: preset
+      integer, intent(out) :: status
+
+      status=0
+      select case (trim(name))
+      case ('default', '')
+        ! What corlate was written with.
+      case ('2mass_ukirt')
+        ! 2MASS + UKIRT, as used for the UKIRT tests in August 2003.
+        preset%minpair=3
+        preset%lowest_sn=0.2
+        preset%accept_prob=0.05
+        preset%allow_fading=.true.
+        preset%final_rad=1.0
+        preset%min_mag_change=0.5
+      case ('usno-a2_lx200')
+        ! USNO-A2 + LX200, as in the original eSTAR demonstrator.  There 
+        ! is no modal shift, but because some objects have significant 
+        ! proper motions the slop is 3 arcsec plus 3 times the RMS.
+        preset%minpair=11
+        preset%inital_rad=3.0
+        preset%modal_shift=.false.
+        preset%rms_rad=3.0
+        preset%clip=9.0
+        preset%var_mag_change=.true.
+        preset%write_histogram=.true.
+      case default
+        status=-1
+      end select
+
+    end subroutine corlate_preset
+
+
+    integer function set_corlate_preset(name)
+
+      ! Sets corlate up for the named survey profile, returning -1 (and 
+      ! leaving the settings alone) if there is no such profile.
+
+      character(len=*), intent(in) :: name
+
+      type(a_corlate_config) :: preset
+
+      call corlate_preset(name, preset, set_corlate_preset)
+      if (set_corlate_preset == 0) config=preset
+
+    end function set_corlate_preset
+
+
+    integer function set_corlate_option(name, value)
+
+      ! Overrides one of the settings in a_corlate_config, returning -1 
+      ! if there is no such setting, and -2 (leaving it alone) if value
+      ! is out of range for it.  Logical settings are true for any
+      ! non-zero value.
+
+      character(len=*), intent(in) :: name
+      real, intent(in) :: value
+
+      logical :: valid
+
+      ! The tests are written so that a NaN fails them.
+      set_corlate_option=0
+      valid=.true.
+      select case (trim(name))
+      case ('minpair')
+        valid=(value >= 0.5 .and. value < real(huge(config%minpair)))
+        if (valid) config%minpair=nint(value)
+      case ('lowest_sn')
+        valid=(value >= 0.0)
+        if (valid) config%lowest_sn=value
+      case ('accept_prob')
+        valid=(value > 0.0 .and. value <= 1.0)
+        if (valid) config%accept_prob=value
+      case ('allow_fading')
+        config%allow_fading=(value /= 0.0)
+      case ('inital_rad', 'initial_rad')
+        valid=(value > 0.0)
+        if (valid) config%inital_rad=value
+      case ('modal_shift')
+        config%modal_shift=(value /= 0.0)
+      case ('shift_step')
+        valid=(value > 0.0)
+        if (valid) config%shift_step=value
+      case ('final_rad')
+        valid=(value > 0.0)
+        if (valid) config%final_rad=value
+      case ('rms_rad')
+        valid=(value >= 0.0)
+        if (valid) config%rms_rad=value
+      case ('min_mag_change')
+        valid=(value >= 0.0)
+        if (valid) config%min_mag_change=value
+      case ('clip')
+        valid=(value > 0.0)
+        if (valid) config%clip=value
+      case ('var_mag_change')
+        config%var_mag_change=(value /= 0.0)
+      case ('write_histogram')
+        config%write_histogram=(value /= 0.0)
+      case default
+        set_corlate_option=-1
+      end select
+      if (.not. valid) set_corlate_option=-2
+
+    end function set_corlate_option
+
+
+    integer function get_corlate_option(name, value)
+
+      ! Returns one of the settings in a_corlate_config in value, as for
+      ! set_corlate_option, with logical settings as 1 or 0.  The return
+      ! value is -1 if there is no such setting.
+
+      character(len=*), intent(in) :: name
+      real, intent(out) :: value
+
+      get_corlate_option=0
+      value=0.0
+      select case (trim(name))
+      case ('minpair')
+        value=real(config%minpair)
+      case ('lowest_sn')
+        value=config%lowest_sn
+      case ('accept_prob')
+        value=config%accept_prob
+      case ('allow_fading')
+        value=merge(1.0, 0.0, config%allow_fading)
+      case ('inital_rad', 'initial_rad')
+        value=config%inital_rad
+      case ('modal_shift')
+        value=merge(1.0, 0.0, config%modal_shift)
+      case ('shift_step')
+        value=config%shift_step
+      case ('final_rad')
+        value=config%final_rad
+      case ('rms_rad')
+        value=config%rms_rad
+      case ('min_mag_change')
+        value=config%min_mag_change
+      case ('clip')
+        value=config%clip
+      case ('var_mag_change')
+        value=merge(1.0, 0.0, config%var_mag_change)
+      case ('write_histogram')
+        value=merge(1.0, 0.0, config%write_histogram)
+      case default
+        get_corlate_option=-1
+      end select
+
+    end function get_corlate_option
+
+
+    elemental double precision function pchisq(chisq)
+
+      ! The probability of a chi-squared (with one degree of freedom)
+      ! of chisq or more, which is erfc(sqrt(chisq/2)).  This used to be
+      ! summed as a series, which for chi-squareds over 25 was replaced
+      ! by the value at 25, and that floor is kept so the probabilities
+      ! of the most significant variables are as they were.
 
       real, intent(in) :: chisq
 
-      ! Locals.
-      double precision :: term, sum, z
-      integer :: i
-      double precision, parameter :: gamma=1.77245385d0
-
       if (chisq > 25.0) then
-        pchisq=5.861e-07
-      else  
-        z = dble(chisq/2.0)
-        term = 1.0d0
-        sum = 2.0d0*term
-        do i=1, 1000
-          term = -term * z/dble(i)
-          sum = sum + term/(0.5d0+dble(i))
-          if (dabs(term/sum) <= 0.00001d0) exit
-        end do
-        pchisq = 1.0 - (z**0.5)*real(sum/gamma)
+        pchisq=5.861d-07
+      else
+        pchisq=erfc(sqrt(dble(chisq)/2.0d0))
       end if
 
     end function pchisq
 
 
 
-    subroutine fit(xdata, ydata, yerr, ndata, a, b, chisq, nclip)
+    subroutine fit(xdata, ydata, yerr, ndata, clip, a, b, chisq, nclip)
+
+      ! Fits a straight line, clipping out points more than clip times
+      ! the chi-squared from it.  The weighted sums are only changed by
+      ! the points clipped out (or put back) each time round, rather than
+      ! being summed afresh.
 
       implicit none
 
       real, dimension(:), intent(in):: xdata, ydata, yerr
       integer, intent(in) :: ndata
+      real, intent(in) :: clip
       real, intent(out) :: a, b, chisq
       integer, intent(out) :: nclip
 
-      real :: ss, sx, sxoss, sy, st2
-      real, dimension(ndata) :: chi, weight
+      double precision :: ss, sx, sy, sxx, sxy, slope, change
+      double precision, dimension(ndata) :: chi, weight
+      logical, dimension(ndata) :: clipped, toggle
       integer :: nclip_old, i
 
-      chi = 0.0
+      weight=1.0d0/dble(yerr(1:ndata))**2
+      ss=sum(weight)
+      sx=sum(weight*xdata(1:ndata))
+      sy=sum(weight*ydata(1:ndata))
+      sxx=sum(weight*dble(xdata(1:ndata))**2)
+      sxy=sum(weight*dble(xdata(1:ndata))*ydata(1:ndata))
+
+      clipped=.false.
+      chi = 0.0d0
       chisq=huge(chisq)
       nclip = -1
-      weight=1.0/yerr(1:ndata)**2.0
 
       do
 
         nclip_old=nclip
-        nclip=0
+        toggle=(chi > dble(clip)*dble(chisq)) .neqv. clipped
+        nclip=count(clipped .neqv. toggle)
+        if (nclip_old == nclip) exit
+
+        ! Take out the points which are newly clipped, and put back
+        ! those which no longer are.
         do i=1, ndata
-          if (chi(i) > 4.0*chisq) then
-            weight(i) = 0.0
-            nclip=nclip+1
+          if (toggle(i)) then
+            change=merge(weight(i), -weight(i), clipped(i))
+            ss=ss+change
+            sx=sx+change*xdata(i)
+            sy=sy+change*ydata(i)
+            sxx=sxx+change*dble(xdata(i))**2
+            sxy=sxy+change*dble(xdata(i))*ydata(i)
           end if
         end do
-        if (nclip_old == nclip) exit
-
-        ss=sum(weight)
-        sx=sum(xdata(1:ndata)*weight)
-        sy=sum(ydata(1:ndata)*weight)
+        clipped=clipped .neqv. toggle
 
-        sxoss=sx/ss
-        b=sum(ydata(1:ndata)*(xdata(1:ndata)-sxoss)*weight)
-        st2=sum( ((xdata(1:ndata)-sxoss)**2.0)*weight)
-        b=b/st2
-        a=(sy-sx*b)/ss
+        slope=(sxy-sx*sy/ss)/(sxx-sx*sx/ss)
+        b=real(slope)
+        a=real((sy-sx*slope)/ss)
 
-        ! Work out chi and chisq without the zero weighted points.
-        chi = ((ydata(1:ndata)-a-b*xdata(1:ndata))**2.0)*weight
-        chisq=sum(chi)/real(ndata-nclip)
-
-        ! And now put all the points back.
-        weight=1.0/yerr(1:ndata)**2.0
-        chi = ((ydata(1:ndata)-a-b*xdata(1:ndata))**2.0)*weight
+        ! Work out chi for all the points, and chisq without the 
+        ! clipped ones.
+        chi=weight*(ydata(1:ndata)-a-b*xdata(1:ndata))**2
+        chisq=real(sum(chi, mask=.not.clipped)/dble(ndata-nclip))
 
       end do
 
@@ -97,32 +387,197 @@
                               file_name_4, file_name_5, file_name_6, &
                               file_name_7, file_name_8 ) 
 
-      ! Finds the nearest match between catalogues in cluster format.
+      ! Finds the nearest match between catalogues in cluster format, 
+      ! which have been read into arrays of lines.  See corlate_stars for
+      ! the rest of the arguments.
+
+      use define_star
+      use cluster_match_subs
+
+      implicit none
+
+      integer :: n_1, n_2
+      character(len=*), dimension(n_1), intent(in):: file_1
+      character(len=*), dimension(n_2), intent(in):: file_2
+      character(len=*), intent(in):: file_name_3
+      character(len=*), intent(in):: file_name_4
+      character(len=*), intent(in):: file_name_5
+      character(len=*), intent(in):: file_name_6
+      character(len=*), intent(in):: file_name_7
+      character(len=*), intent(in):: file_name_8
+
+      integer :: nstars1, nstars2, ncol1, ncol2
+      character(len=3), dimension(mcol) :: colstr1, colstr2
+      type(a_star), dimension(:), allocatable :: star1, star2
+
+      call read_cluster_file(file_1, nstars1, ncol1, colstr1, star1) 
+      call read_cluster_file(file_2, nstars2, ncol2, colstr2, star2) 
+
+      corlate=corlate_stars(star1(1:nstars1), colstr1, star2(1:nstars2), &
+      colstr2, file_name_3, file_name_4, file_name_5, file_name_6, &
+      file_name_7, file_name_8)
+
+    end function corlate
+
+    integer function corlate_files( file_name_1, file_name_2, file_name_3, &
+                                    file_name_4, file_name_5, file_name_6, &
+                                    file_name_7, file_name_8 ) 
+
+      ! Finds the nearest match between the catalogues in the cluster 
+      ! format files file_name_1 and file_name_2.  See corlate_catalogue for
+      ! the rest of the arguments.
+
+      implicit none
+
+      character(len=*), intent(in):: file_name_1
+      character(len=*), intent(in):: file_name_2
+      character(len=*), intent(in):: file_name_3
+      character(len=*), intent(in):: file_name_4
+      character(len=*), intent(in):: file_name_5
+      character(len=*), intent(in):: file_name_6
+      character(len=*), intent(in):: file_name_7
+      character(len=*), intent(in):: file_name_8
+
+      corlate_files=corlate_cached(file_name_1, ' ', file_name_2, &
+      file_name_3, file_name_4, file_name_5, file_name_6, file_name_7, &
+      file_name_8)
+
+    end function corlate_files
+
+    integer function corlate_cached( file_name_1, cache_name, file_name_2, &
+                                     file_name_3, file_name_4, file_name_5, &
+                                     file_name_6, file_name_7, file_name_8 ) 
+
+      ! As corlate_files, but with a binary cache of the two colour 
+      ! catalogue in cache_name (see load_catalogue), which saves parsing
+      ! and indexing it every time the same catalogue is used.  If 
+      ! cache_name is blank no cache is used.
+
+      use define_star
+      use cluster_match_subs
+
+      implicit none
+
+      character(len=*), intent(in):: file_name_1
+      character(len=*), intent(in):: cache_name
+      character(len=*), intent(in):: file_name_2
+      character(len=*), intent(in):: file_name_3
+      character(len=*), intent(in):: file_name_4
+      character(len=*), intent(in):: file_name_5
+      character(len=*), intent(in):: file_name_6
+      character(len=*), intent(in):: file_name_7
+      character(len=*), intent(in):: file_name_8
+
+      type(a_catalogue) :: cat
+      integer :: nstars2, ncol2, iostat
+      character(len=3), dimension(mcol) :: colstr2
+      type(a_star), dimension(:), allocatable :: star2
+      double precision :: t0, t_read, t_index
+
+      last_metrics=a_corlate_metrics()
+      t0=wall_time()
+      call load_catalogue(file_name_1, cache_name, config%inital_rad, cat, &
+      iostat, t_index)
+      last_metrics%t_read=wall_time()-t0-t_index
+      last_metrics%t_index=t_index
+      if (iostat /= 0) then
+        corlate_cached=-1
+        open(unit=2, file=file_name_3, status='unknown')
+        write(2,*) 'Failed to open archive file ', trim(file_name_1)
+        close(2)
+        return
+      end if
+      call load_cluster_file(file_name_2, nstars2, ncol2, colstr2, star2, &
+      iostat) 
+      t_read=wall_time()-t0-t_index
+      last_metrics%t_read=t_read
+      if (iostat /= 0) then
+        corlate_cached=-2
+        open(unit=2, file=file_name_3, status='unknown')
+        write(2,*) 'Failed to open new data file ', trim(file_name_2)
+        close(2)
+        call free_catalogue(cat)
+        return
+      end if
+
+      corlate_cached=corlate_catalogue(cat, star2(1:nstars2), colstr2, &
+      file_name_3, file_name_4, file_name_5, file_name_6, file_name_7, &
+      file_name_8)
+      last_metrics%t_read=t_read
+      last_metrics%t_index=t_index
+      call free_catalogue(cat)
+
+    end function corlate_cached
+
+    integer function corlate_stars( star1, colstr1, star2, colstr2, &
+                                    file_name_3, file_name_4, file_name_5, &
+                                    file_name_6, file_name_7, file_name_8 ) 
+
+      ! Finds the nearest match between catalogues held as arrays of stars,
+      ! star1 being the two colour catalogue.  See corlate_catalogue for
+      ! the rest of the arguments.
+
+      use define_star
+      use cluster_match_subs
+
+      implicit none
+
+      type(a_star), dimension(:), intent(in) :: star1
+      character(len=*), dimension(:), intent(in) :: colstr1
+      type(a_star), dimension(:), intent(inout) :: star2
+      character(len=*), dimension(:), intent(in) :: colstr2
+      character(len=*), intent(in):: file_name_3
+      character(len=*), intent(in):: file_name_4
+      character(len=*), intent(in):: file_name_5
+      character(len=*), intent(in):: file_name_6
+      character(len=*), intent(in):: file_name_7
+      character(len=*), intent(in):: file_name_8
+
+      type(a_catalogue) :: cat
+      double precision :: t0, t_index
+
+      t0=wall_time()
+      call make_catalogue(cat, star1, colstr1, config%inital_rad)
+      t_index=wall_time()-t0
+      corlate_stars=corlate_catalogue(cat, star2, colstr2, file_name_3, &
+      file_name_4, file_name_5, file_name_6, file_name_7, file_name_8)
+      last_metrics%t_index=t_index
+      call free_catalogue(cat)
+
+    end function corlate_stars
+
+
+    integer function corlate_catalogue( cat, star2, colstr2, &
+                                        file_name_3, file_name_4, &
+                                        file_name_5, file_name_6, &
+                                        file_name_7, file_name_8 )
+
+      ! Finds the nearest match between catalogues.
 
       use define_star
       use cluster_match_subs
-      use radec2rad_mod
 
       implicit none
 
       ! Inputs.
-      ! The names of the various input and output files are in an array.  
-      ! The elements are as follows, where catalogues are in cluster format.
-      ! 1. Input two colour catalogue (e.g. a digitised sky survey).
-      ! 2. Input one colour catalogue (e.g. a new observation).
+      ! 1. The two colour catalogue (e.g. a digitised sky survey), made
+      !    by make_catalogue or load_catalogue.
+      ! 2. The one colour catalogue (e.g. a new observation), and the
+      !    names of its colours.
+      ! The colours of star2 have any variability flags removed.
       ! And now the output files.
       ! 3. The log file.
       ! 4. A cluster catalogue of the variable stars.  The colours are;
-      !      1. The difference between colour 1 for the two catalogues, in 
+      !      1. The difference between colour 1 for the two catalogues, in
       !         the sense two colour catalogue minus one colour catalogue.
       !      2. Colour two from the two colour catalogue.
       !      3. Colour one fom the two colour catalogue.
       !      4. Colour one from the one colour catalogue.
-      !      The field and ID and X,Y are from the one colour catalogue, the 
+      !      The field and ID and X,Y are from the one colour catalogue, the
       !      RA and dec from the two colour catalogue.
-      !      The RMS separation between correlated positions in the two 
+      !      The RMS separation between correlated positions in the two
       !      catalogues is the third field on the first line.
-      ! 5. A cluster file of the fitted colour data.  The colours are as 
+      ! 5. A cluster file of the fitted colour data.  The colours are as
       !    for file_name_4.
       ! 6. Two points which define the fit to the above.  An X-Y file with
       !    three lines of header. X is colour two, Y is the difference in
@@ -131,9 +586,9 @@
       !    of header.
       ! 8. A file of useful information on the variable stars.
 
-      integer :: n_1, n_2
-      character(len=*), dimension(n_1), intent(in):: file_1
-      character(len=*), dimension(n_2), intent(in):: file_2
+      type(a_catalogue), intent(in) :: cat
+      type(a_star), dimension(:), intent(inout) :: star2
+      character(len=*), dimension(:), intent(in) :: colstr2
       character(len=*), intent(in):: file_name_3
       character(len=*), intent(in):: file_name_4
       character(len=*), intent(in):: file_name_5
@@ -147,19 +602,57 @@
       !   -2 = failed to open file_name_2
       !   -3 = Too few stars paired between catalogues.
 
+      type(a_corlate_result) :: result
+      double precision :: t0
 
-      integer :: nstars1, nstars2, ncol1, ncol2
-      character(len=3), dimension(mcol) :: colstr1, colstr2
-      type(a_star), dimension(:), allocatable :: star1, star2
-      real, dimension(:), allocatable :: alpha, delta
+      call corlate_match(cat, star2, colstr2, result)
+      t0=wall_time()
+      call write_corlate_result(result, file_name_3, file_name_4, &
+      file_name_5, file_name_6, file_name_7, file_name_8)
+      result%metrics%t_output=wall_time()-t0
+      last_metrics=a_corlate_metrics()
+      call add_metrics(last_metrics, result%metrics)
+      corlate_catalogue=result%status
+
+    end function corlate_catalogue
+
+
+    subroutine corlate_match(cat, star2, colstr2, result)
+
+      ! Does the work for corlate_catalogue, but rather than writing the
+      ! output files returns everything that would be written to them in
+      ! result.  Nothing is read or written.
+
+      use define_star
+      use cluster_match_subs
+      use radec2rad_mod
+!$    use omp_lib
+
+      implicit none
+
+      type(a_catalogue), intent(in) :: cat
+      type(a_star), dimension(:), intent(inout) :: star2
+      character(len=*), dimension(:), intent(in) :: colstr2
+      type(a_corlate_result), intent(out) :: result
+
+      integer :: nstars1, nstars2
+      ! The positions of star2 in radians, to match with.
+      double precision, dimension(:), allocatable :: alpha2, delta2
       ! Once the stars are paired, we can create a new star record.
       type(a_star), dimension(:), allocatable :: pair
       integer :: npair
+      ! The colour two from the two colour catalogue and the difference
+      ! between the colour ones (and their errors) for each pair, to fit.
+      real, dimension(:), allocatable :: fit_colour, fit_colour_err
+      real, dimension(:), allocatable :: fit_diff, fit_diff_err
 
-      integer :: i, iostat, istar
+      integer :: i, istar
       integer, dimension(:), allocatable :: matches
       integer :: n_matches
-      real :: work
+      ! The best match for each star in star2 (0 for none), which is
+      ! found in parallel, and the number of threads to use.
+      integer, dimension(:), allocatable :: best
+      integer :: nthreads
 
       ! For the fitting.
       real :: a, b, chisq
@@ -171,76 +664,109 @@
       real, dimension(:), allocatable :: dist_alpha, dist_delta
       ! For the mean.
       real :: dist_mean, dist
+      ! The search radius for the second pass.
+      real :: search_rad
+      ! Whether the stars in star2 are good enough to fit.
+      logical, dimension(:), allocatable :: usable
 
       ! For the probablility.
-      integer, parameter :: mprob=101
-      real, dimension(mprob) :: bin
-      integer :: nprob, iprob, ibin
+      integer :: nprob, iprob, ibin, nvar
       real, allocatable, dimension(:) :: prob
-      real :: delta_mag, abs_delta_mag
+      ! The change in magnitude of each pair, whether it is large enough
+      ! to be a candidate variable, and which pair each candidate is.
+      real, allocatable, dimension(:) :: delta_mag
+      logical, allocatable, dimension(:) :: candidate
+      integer, allocatable, dimension(:) :: which
+      real :: fade
 
-      ! Some things you may want to tweak.
-      ! The minimum number of stars in common you must have.
-      ! For 2MASS + UKIRT 3; for USNO-A2 + LX200 10.
-      integer, parameter :: minpair=10
-      ! The lowest signal-to-noise stars you will use in the correlation.
-      ! For 2MASS + UKIRT 0.2; for USNO A-2 + LX200 0.1.
-      real, parameter :: lowest_sn=0.1
-      ! The false alarm probablility you are prepared to accept.
-      ! For 2MASS + UKIRT 0.05; for USNO A-2 + LX200 0.01.
-      real, parameter :: accept_prob=0.01
-      ! Set this true if you want to find stars that have faded as well as
-      ! those which have brightened.
-      logical, parameter :: allow_fading=.false.
-      ! The initial search radius.
-      real, parameter :: inital_rad=8.0
-      ! Search radius after tweaking positions.
-      ! For 2MASS + UKIRT 1.0; for USNO-A2 + LX200 used to use sum (in 
-      ! quadrature) of RMS of fit + 3.0.
-      real, parameter :: final_rad=3.0
-      ! Minimum change in magnitude to believe variable.
-      ! For 2MASS + UKIRT started with 0.5, but 0.0 is intellectually correct
-      ! (which is what USNO-A2 + LX200 used).
-      real, parameter :: min_mag_change=0.0
+      ! For the metrics.
+      double precision :: t0
+      integer(kind=long) :: ntested
 
-      ! Start as we mean to go on.
-      corlate=0
-      open(unit=2, file=file_name_3, status='unknown')
 
-      call read_cluster_file(file_1, nstars1, ncol1, colstr1, star1) 
-
-      ! Make the ra and dec arrays.
-      allocate(alpha(nstars1), delta(nstars1))
-      do i=1, nstars1
-        call radec2rad(star1(i)%ra_h, star1(i)%ra_m, star1(i)%ra_s, &
-        star1(i)%dc_d, star1(i)%dc_m, star1(i)%dc_s, alpha(i), delta(i))
+      ! Start as we mean to go on.
+      result%status=0
+      result%colstr1=' '
+      result%colstr1(1:size(cat%colstr))=cat%colstr
+      result%colstr2=' '
+      result%colstr2(1:size(colstr2))=colstr2
+      result%npair_first=0
+      result%shift_alpha=0.0
+      result%shift_delta=0.0
+      result%first_rms=0.0
+      result%npair=0
+      result%dist_mean=0.0
+      result%a=0.0
+      result%b=0.0
+      result%chisq=0.0
+      result%nclip=0
+      result%fit_x=0.0
+      result%fit_y=0.0
+      result%nvar=0
+      result%nprob=0
+      result%prob_max=0.0
+      result%bin=0.0
+
+      nstars1=cat%nstars
+      nstars2=size(star2)
+      result%metrics%nstars1=nstars1
+      result%metrics%nstars2=nstars2
+      t0=wall_time()
+      ntested=0
+
+      allocate(alpha2(nstars2), delta2(nstars2))
+      do i=1, nstars2
+        call dradec2rad(star2(i)%ra_h, star2(i)%ra_m, star2(i)%ra_s, &
+        star2(i)%dc_d, star2(i)%dc_m, star2(i)%dc_s, alpha2(i), delta2(i))
       end do
 
-      call read_cluster_file(file_2, nstars2, ncol2, colstr2, star2) 
-
       ! Remove any variability flags.
       where(star2%col(1)%flg(1:1) == 'V') star2%col(1)%flg(1:1)='O'
       where(star2%col(1)%flg(2:2) == 'V') star2%col(1)%flg(2:2)='O'
 
+      ! The tests on star2 are the same for both passes, so are done once.
+      allocate(usable(nstars2))
+      usable=(.not. (star2%col(1)%err > config%lowest_sn)) .and. &
+      star2%col(1)%flg == 'OO'
+
+      ! The matching is independent for each star, so is done in
+      ! parallel, filling in the best match for each star.  Everything
+      ! else is then done in the order of the stars, so the results are the
+      ! same however many threads there are.
+      nthreads=1
+!$    nthreads=omp_get_max_threads()
+      if (corlate_threads > 0) nthreads=corlate_threads
+      allocate(best(nstars2))
+
       ! A first run through to tweak up the matching radius.
 
+      !$omp parallel num_threads(nthreads) private(matches, n_matches) &
+      !$omp reduction(+:ntested)
       allocate(matches(nstars1))
+      !$omp do schedule(dynamic, 64)
+      do istar=1, nstars2
+        call match_them(cat%index, cat%star, alpha2(istar), delta2(istar), &
+        config%inital_rad, matches, n_matches, ntested)
+        best(istar)=0
+        if (n_matches > 0) best(istar)=matches(1)
+      end do
+      !$omp end do
+      deallocate(matches)
+      !$omp end parallel
+
       npair=0
+      dist_mean=0.0
 
       allocate(dist_alpha(nstars2), dist_delta(nstars2))
 
       rad: do istar=1, nstars2
 
-        call match_them(nstars1, star1, alpha, delta, star2(istar), &
-        inital_rad, matches, n_matches)
-
-        if (n_matches > 0) then
+        if (best(istar) > 0) then
 
           ! Now, go through the reasons for not fitting this star.
-          if (star2(istar)%col(1)%err > lowest_sn) cycle rad
-          if (star2(istar)%col(1)%flg /= 'OO') cycle rad
-          if (star1(matches(1))%col(1)%flg /= 'OO') cycle rad
-          if (star1(matches(1))%col(2)%flg /= 'OO') cycle rad
+          if (.not. usable(istar)) cycle rad
+          if (cat%star(best(istar))%col(1)%flg /= 'OO') cycle rad
+          if (cat%star(best(istar))%col(2)%flg /= 'OO') cycle rad
 
           ! O.K., its one we want.
 
@@ -250,61 +776,86 @@
           call radec2rad(star2(istar)%ra_h, star2(istar)%ra_m, &
           star2(istar)%ra_s, star2(istar)%dc_d, star2(istar)%dc_m, &
           star2(istar)%dc_s, another_alpha, another_delta)
-          dist_alpha(npair)=(another_alpha-alpha(matches(1)))
-          dist_delta(npair)=(another_delta-delta(matches(1)))
+          dist_alpha(npair)=(another_alpha-cat%alpha(best(istar)))
+          dist_delta(npair)=(another_delta-cat%delta(best(istar)))
+          ! And the distance, for the RMS.
+          dist=dist_alpha(npair)
+          dist=dist*cos((another_delta+cat%delta(best(istar)))/2.0)
+          dist=dist**2.0
+          dist=dist+dist_delta(npair)**2.0
+          dist=sqrt(dist)*206264.8
+          dist_mean=dist_mean+(dist*dist)
 
         end if
 
       end do rad
 
-      write(2,*) 'Number of pairs for first pass was ', npair
+      result%npair_first=npair
 
-      if (npair < minpair) then
-        write(2,*) 'Too few pairs to continue.'
-        corlate=-3
-        deallocate(matches)
-        close(2)
+      if (npair < config%minpair) then
+        result%status=-3
+        result%metrics%ntested=ntested
+        result%metrics%t_first=wall_time()-t0
+        deallocate(best, alpha2, delta2, usable)
         return
       end if
 
-      dist_alpha=dist_alpha*206264.8
-      dist_delta=dist_delta*206264.8*cos(delta(1))
-      mod_shift_alpha=median(dist_alpha, npair)
-      mod_shift_delta=median(dist_delta, npair)
+      if (config%modal_shift) then
+        dist_alpha=dist_alpha*206264.8
+        dist_delta=dist_delta*206264.8*cos(cat%delta(1))
+        mod_shift_alpha=median(dist_alpha, npair, config%shift_step)
+        mod_shift_delta=median(dist_delta, npair, config%shift_step)
+      else
+        mod_shift_alpha=0.0
+        mod_shift_delta=0.0
+      end if
 
       deallocate(dist_alpha, dist_delta)
 
-      write(2,*) 'Which gave a modal separations in RA and dec of ', &
-      mod_shift_alpha, mod_shift_delta, ' arcseconds.'
+      result%shift_alpha=mod_shift_alpha
+      result%shift_delta=mod_shift_delta
+      result%first_rms=sqrt(dist_mean/real(npair))
+      search_rad=sqrt((config%rms_rad*result%first_rms)**2.0 + &
+      config%final_rad**2.0)
 
       mod_shift_alpha=mod_shift_alpha/206264.8
-      mod_shift_delta=mod_shift_delta/(206264.8*cos(delta(1)))
+      mod_shift_delta=mod_shift_delta/(206264.8*cos(cat%delta(1)))
+      result%metrics%t_first=wall_time()-t0
+      t0=wall_time()
 
-      allocate(pair(nstars2))
+      allocate(pair(nstars2), fit_colour(nstars2), fit_colour_err(nstars2), &
+      fit_diff(nstars2), fit_diff_err(nstars2))
       npair=0
       dist_mean=0.0
 
-      open(unit=1, file=file_name_5, status='unknown') 
-      write(1,*) '4 colours were created'
-      write(1,*) trim(colstr1(1))//'-'//trim(colstr2(1)), ' ', &
-      trim(colstr1(2)), ' ', trim(colstr2(1)), ' ', trim(colstr1(1)) 
-      write(1,*)
+      !$omp parallel num_threads(nthreads) private(matches, n_matches) &
+      !$omp reduction(+:ntested)
+      allocate(matches(nstars1))
+      !$omp do schedule(dynamic, 64)
+      do istar=1, nstars2
+        ! Shift the new star back, rather than the catalogue onto it.
+        call match_them(cat%index, cat%star, &
+        alpha2(istar)-dble(mod_shift_alpha), &
+        delta2(istar)-dble(mod_shift_delta), search_rad, matches, n_matches, &
+        ntested)
+        best(istar)=0
+        if (n_matches > 0) best(istar)=matches(1)
+      end do
+      !$omp end do
+      deallocate(matches)
+      !$omp end parallel
 
       new_star: do istar=1, nstars2
 
-        call match_them(nstars1, star1, alpha+mod_shift_alpha, delta+mod_shift_delta, star2(istar), &
-        final_rad, matches, n_matches)
-
-        if (n_matches == 0) then
+        if (best(istar) == 0) then
           ! Not found any match.
           ! call write_star(24, star2(istar), ncol2)
         else
 
           ! Now, go through the reasons for not fitting this star.
-          if (star2(istar)%col(1)%err > lowest_sn) cycle new_star
-          if (star2(istar)%col(1)%flg /= 'OO') cycle new_star
-          if (star1(matches(1))%col(1)%flg /= 'OO') cycle new_star
-          if (star1(matches(1))%col(2)%flg /= 'OO') cycle new_star
+          if (.not. usable(istar)) cycle new_star
+          if (cat%star(best(istar))%col(1)%flg /= 'OO') cycle new_star
+          if (cat%star(best(istar))%col(2)%flg /= 'OO') cycle new_star
 
           ! O.K., its one we want.
 
@@ -312,10 +863,10 @@
           call radec2rad(star2(istar)%ra_h, star2(istar)%ra_m, &
           star2(istar)%ra_s, star2(istar)%dc_d, star2(istar)%dc_m, &
           star2(istar)%dc_s, another_alpha, another_delta)
-          dist=(another_alpha-alpha(matches(1))-mod_shift_alpha)
-          dist=dist*cos((another_delta+delta(matches(1)))/2.0)
+          dist=(another_alpha-cat%alpha(best(istar))-mod_shift_alpha)
+          dist=dist*cos((another_delta+cat%delta(best(istar)))/2.0)
           dist=dist**2.0
-          dist=dist+(another_delta-delta(matches(1))-mod_shift_delta)**2.0
+          dist=dist+(another_delta-cat%delta(best(istar))-mod_shift_delta)**2.0
           dist=sqrt(dist)*206264.8
           dist_mean=dist_mean+(dist*dist)
 
@@ -323,179 +874,703 @@
 
           ! Set the field and id to those from the new data.
           pair(npair)%field=star2(istar)%field
+          pair(npair)%ccd  =star2(istar)%ccd
           pair(npair)%id   =star2(istar)%id
 
           ! Set the RA and Dec to those from the catalogue.
-          pair(npair)%ra_h=star1(matches(1))%ra_h
-          pair(npair)%ra_m=star1(matches(1))%ra_m
-          pair(npair)%ra_s=star1(matches(1))%ra_s
-          pair(npair)%dc_d=star1(matches(1))%dc_d
-          pair(npair)%dc_m=star1(matches(1))%dc_m
-          pair(npair)%dc_s=star1(matches(1))%dc_s
+          pair(npair)%ra_h=cat%star(best(istar))%ra_h
+          pair(npair)%ra_m=cat%star(best(istar))%ra_m
+          pair(npair)%ra_s=cat%star(best(istar))%ra_s
+          pair(npair)%dc_d=cat%star(best(istar))%dc_d
+          pair(npair)%dc_m=cat%star(best(istar))%dc_m
+          pair(npair)%dc_s=cat%star(best(istar))%dc_s
+          pair(npair)%dc_sign=cat%star(best(istar))%dc_sign
 
           ! Set X and Y to those in the image.
           pair(npair)%x = star2(istar)%x
           pair(npair)%y = star2(istar)%y
 
           ! Set the colours.
-          pair(npair)%col(2)=star1(matches(1))%col(2)
+          pair(npair)%col(2)=cat%star(best(istar))%col(2)
           pair(npair)%col(3)=star2(istar)%col(1)
-          pair(npair)%col(4)=star1(matches(1))%col(1)
+          pair(npair)%col(4)=cat%star(best(istar))%col(1)
           ! Set colour 1 to be the difference between the colour 1s.
-          pair%col(1)%data=pair%col(4)%data - pair%col(3)%data
+          pair(npair)%col(1)%data=pair(npair)%col(4)%data &
+                                 -pair(npair)%col(3)%data
           pair(npair)%col(1)%err = &
           sqrt(pair(npair)%col(3)%err**2.0 + pair(npair)%col(4)%err**2.0)
-          pair(1:npair)%col(1)%flg='OO'
+          pair(npair)%col(1)%flg='OO'
 
-          call write_star(1, pair(npair), 4)
+          ! And keep what is fitted in arrays of their own.
+          fit_colour(npair)=pair(npair)%col(2)%data
+          fit_colour_err(npair)=pair(npair)%col(2)%err
+          fit_diff(npair)=pair(npair)%col(1)%data
+          fit_diff_err(npair)=pair(npair)%col(1)%err
 
         end if
 
       end do new_star
-      close(1)
 
-      deallocate(star1, alpha, delta, matches)
+      deallocate(best, alpha2, delta2, usable)
+
+      result%npair=npair
+      allocate(result%pair(npair))
+      result%pair=pair(1:npair)
+      result%metrics%ntested=ntested
+      result%metrics%npair=npair
+      result%metrics%t_second=wall_time()-t0
+
+      if (npair < config%minpair) then
+        result%status=-3
+        deallocate(pair, fit_colour, fit_colour_err, fit_diff, fit_diff_err)
+        return
+      end if
+
+      dist_mean=sqrt(dist_mean/real(npair))
+      result%dist_mean=dist_mean
+
+      t0=wall_time()
+      call fit(fit_colour, fit_diff, fit_diff_err, npair, config%clip, &
+      a, b, chisq, nclip)
+      result%a=a
+      result%b=b
+      result%chisq=chisq
+      result%nclip=nclip
+
+      result%fit_x(1)=minval(fit_colour(1:npair)-fit_colour_err(1:npair))
+      result%fit_x(2)=maxval(fit_colour(1:npair)+fit_colour_err(1:npair))
+      result%fit_y=a+b*result%fit_x
+      result%metrics%nclip=nclip
+      result%metrics%t_fit=wall_time()-t0
+
+      t0=wall_time()
+      allocate(prob(npair), result%var(npair), result%var_delta_mag(npair), &
+      result%var_err(npair), result%var_prob(npair))
+      allocate(delta_mag(npair), candidate(npair), which(npair))
+      ! Rather than test allow_fading for every star, the change in 
+      ! magnitude used is the larger of it and fade times it, which is its
+      ! absolute value if fading is allowed, and the change otherwise.
+      fade=1.0
+      if (config%allow_fading) fade=-1.0
+      delta_mag=fit_diff(1:npair)-a-b*fit_colour(1:npair)
+      candidate=max(delta_mag, fade*delta_mag) > config%min_mag_change
+      nprob=count(candidate)
+      ! Work out the probablility, after scaling the error bar by chisq,
+      ! that a change this large would be seen in any of the pairs.
+      ! One day we should correct this to be two sided if (allow_fading).
+      prob(1:nprob)=pack((delta_mag/fit_diff_err(1:npair))**2/chisq, &
+      candidate)
+      prob(1:nprob)=real(1.0d0-(1.0d0-pchisq(prob(1:nprob)))**npair)
+      which(1:nprob)=pack( (/ (istar, istar=1, npair) /), candidate)
+      nvar=count(prob(1:nprob) < config%accept_prob)
+      result%var(1:nvar)=pack(which(1:nprob), &
+      prob(1:nprob) < config%accept_prob)
+      result%var_delta_mag(1:nvar)=delta_mag(result%var(1:nvar))
+      result%var_prob(1:nvar)=pack(prob(1:nprob), &
+      prob(1:nprob) < config%accept_prob)
+      do i=1, nvar
+        istar=result%var(i)
+        result%var_err(i)=sqrt(pair(istar)%col(3)%err**2.0 &
+                             + pair(istar)%col(4)%err**2.0)
+      end do
+      result%nvar=nvar
+
+      where(prob(1:nprob) > tiny(prob(1))) prob(1:nprob)=-log10(prob(1:nprob))
+
+      ! Now make a histogram.
+      result%nprob=nprob
+      if (nprob > 0) result%prob_max=maxval(prob(1:nprob))
+      do iprob=1, nprob
+        ibin=int(real(mprob-1)*prob(iprob)/result%prob_max)+1
+        result%bin(ibin)=result%bin(ibin)+1
+      end do
+
+      deallocate(prob, delta_mag, candidate, which)
+      deallocate(pair, fit_colour, fit_colour_err, fit_diff, fit_diff_err)
+      result%metrics%t_prob=wall_time()-t0
+
+    end subroutine corlate_match
+
+
+    subroutine write_corlate_result(result, file_name_3, file_name_4, &
+                                    file_name_5, file_name_6, &
+                                    file_name_7, file_name_8)
+
+      ! Writes the files described in corlate_catalogue from what
+      ! corlate_match found.
+
+      use define_star
+      use cluster_match_subs
+
+      implicit none
+
+      type(a_corlate_result), intent(in) :: result
+      character(len=*), intent(in):: file_name_3
+      character(len=*), intent(in):: file_name_4
+      character(len=*), intent(in):: file_name_5
+      character(len=*), intent(in):: file_name_6
+      character(len=*), intent(in):: file_name_7
+      character(len=*), intent(in):: file_name_8
+
+      integer :: i, istar, ivar
+      type(a_star) :: var_star
+
+      open(unit=2, file=file_name_3, status='unknown')
+
+      write(2,*) 'Number of pairs for first pass was ', result%npair_first
+
+      if (result%npair_first < config%minpair) then
+        write(2,*) 'Too few pairs to continue.'
+        close(2)
+        return
+      end if
+
+      if (config%modal_shift) then
+        write(2,*) 'Which gave a modal separations in RA and dec of ', &
+        result%shift_alpha, result%shift_delta, ' arcseconds.'
+      else
+        write(2,*) 'Which gave a mean separation of ', result%first_rms
+      end if
 
-      write(2,*) 'Number of pairs for fitting is ', npair
+      open(unit=1, file=file_name_5, status='unknown')
+      write(1,*) '4 colours were created'
+      write(1,*) trim(result%colstr1(1))//'-'//trim(result%colstr2(1)), &
+      ' ', trim(result%colstr1(2)), ' ', trim(result%colstr2(1)), ' ', &
+      trim(result%colstr1(1))
+      write(1,*)
+      do istar=1, result%npair
+        call write_star(1, result%pair(istar), 4)
+      end do
+      close(1)
 
-      if (npair >= minpair) then
+      write(2,*) 'Number of pairs for fitting is ', result%npair
 
-        dist_mean=sqrt(dist_mean/real(npair))
-        write(2,*) 'Whose mean separation is ', dist_mean, ' arcsec.'
+      if (result%npair >= config%minpair) then
 
-        call fit(pair%col(2)%data, pair%col(4)%data - pair%col(3)%data, &
-        pair%col(1)%err, npair, a, b, chisq, nclip)
+        write(2,*) 'Whose mean separation is ', result%dist_mean, ' arcsec.'
 
-        write(2,*) 'Fit was mag_diff = ', b, '(B-R) + ', a
-        write(2,*) 'With a chi-squared of ', chisq
-        write(2,*) 'Number of points clipped out was ', nclip
+        write(2,*) 'Fit was mag_diff = ', result%b, '(B-R) + ', result%a
+        write(2,*) 'With a chi-squared of ', result%chisq
+        write(2,*) 'Number of points clipped out was ', result%nclip
 
         open(unit=1, file=file_name_6, status='unknown')
         write(1,'(/,/)')
-        work=minval(pair(1:npair)%col(2)%data-pair(1:npair)%col(2)%err)
-        write(1,*) work, a+b*work
-        work=maxval(pair(1:npair)%col(2)%data+pair(1:npair)%col(2)%err)
-        write(1,*) work, a+b*work
+        write(1,*) result%fit_x(1), result%fit_y(1)
+        write(1,*) result%fit_x(2), result%fit_y(2)
         close(1)
 
         open(unit=1, file=file_name_4, status='unknown')
-        write(1,*) '4 colours, ', dist_mean, ' arcsec RMS separation.'
-        write(1,*) 'd'//colstr2(1), ' ', colstr1(2), ' ', &
-        colstr2(1), ' ', colstr1(1)
+        write(1,*) '4 colours, ', result%dist_mean, ' arcsec RMS separation.'
+        write(1,*) 'd'//result%colstr2(1), ' ', result%colstr1(2), ' ', &
+        result%colstr2(1), ' ', result%colstr1(1)
         write(1,*)
         open(unit=3, file=file_name_8, status='unknown')
-        write(3,*) dist_mean, &
+        write(3,*) result%dist_mean, &
         '! Mean separation in arcsec of stars successfully paired.'
-        allocate(prob(npair)) 
-        nprob=0
-        do istar=1, npair
-          delta_mag = pair(istar)%col(1)%data - a-b*pair(istar)%col(2)%data
-          !print*, delta_mag
-          if (allow_fading) then
-            abs_delta_mag=abs(delta_mag)
-          else
-            abs_delta_mag=delta_mag
-          end if
-          if (abs_delta_mag > min_mag_change) then
-            nprob=nprob+1
-            ! Work out the probablility, after scaling the error bar by chisq.
-            prob(nprob)= &
-            pchisq(((abs_delta_mag/pair(istar)%col(1)%err)**2.0)/chisq)
-            prob(nprob)=1.0-(1.0-prob(nprob))**real(npair)
-            ! One day we should correct the above to be two 
-            ! sided if (allow_fading).
-            if (prob(nprob) < accept_prob) then
-              ! Change colour 1 to be the change in magnitde.
-              ! pair(istar)%col(1)%data = -delta_mag
-              call write_star(1, pair(istar), 4)
-              write(3,*) '!! Begining of new star description.'
-              write(3,*) colstr2(1), '! Filter observed in.'
-              write(3,*) delta_mag, '! Increase brightness in magnitudes.'
-              write(3,*) sqrt(pair(istar)%col(3)%err**2.0 &
-                            + pair(istar)%col(4)%err**2.0), '! Error in above.'
-              write(3,*) prob(nprob), '! False alarm probability.'
-              write(3,*) pair(istar)%ra_h, pair(istar)%ra_m, &
-              pair(istar)%ra_s, '! Target RA from archive catalogue.'
-              write(3,*) pair(istar)%dc_d, pair(istar)%dc_m, &
-              pair(istar)%dc_s, '! Target Declination from archive catalogue.'
-            end if
-          end if
+        do ivar=1, result%nvar
+          istar=result%var(ivar)
+          var_star=result%pair(istar)
+          ! Change colour 1 to be the change in magnitde.
+          if (config%var_mag_change) &
+          var_star%col(1)%data = -result%var_delta_mag(ivar)
+          call write_star(1, var_star, 4)
+          write(3,*) '!! Begining of new star description.'
+          write(3,*) result%colstr2(1), '! Filter observed in.'
+          write(3,*) result%var_delta_mag(ivar), &
+          '! Increase brightness in magnitudes.'
+          write(3,*) result%var_err(ivar), '! Error in above.'
+          write(3,*) result%var_prob(ivar), '! False alarm probability.'
+          write(3,*) result%pair(istar)%ra_h, result%pair(istar)%ra_m, &
+          result%pair(istar)%ra_s, '! Target RA from archive catalogue.'
+          write(3,*) result%pair(istar)%dc_d, result%pair(istar)%dc_m, &
+          result%pair(istar)%dc_s, &
+          '! Target Declination from archive catalogue.'
         end do
         close(1)
         close(3)
 
-        where(prob(1:nprob) > tiny(prob(1))) prob(1:nprob)=-log10(prob(1:nprob))
-
-        ! Now make a histogram.
-        bin=0.0
-        do iprob=1, nprob
-          ibin=int(real(mprob-1)*prob(iprob)/maxval(prob(1:nprob)))+1
-          bin(ibin)=bin(ibin)+1
-        end do
-
         open(unit=1, file=file_name_7, status='unknown')
         write(1,'(/,/)')
-        !write(1,*) &
-        !  10.0**(((           0.5)/real(-mprob))*maxval(prob(1:nprob))), &
-        !  0.0
-        !do i=1, mprob
-        !  write(1,*) &
-        !  10.0**(((real(i    )+0.5)/real(-mprob))*maxval(prob(1:nprob))), &
-        !  bin(i)
-        !end do
-        !write(1,*) &
-        !  10.0**(((real(mprob)+1.5)/real(-mprob))*maxval(prob(1:nprob))), &
-        !  0.0
+        if (config%write_histogram) then
+          write(1,*) &
+            10.0**(((           0.5)/real(-mprob))*result%prob_max), &
+            0.0
+          do i=1, mprob
+            write(1,*) &
+            10.0**(((real(i    )+0.5)/real(-mprob))*result%prob_max), &
+            result%bin(i)
+          end do
+          write(1,*) &
+            10.0**(((real(mprob)+1.5)/real(-mprob))*result%prob_max), &
+            0.0
+        end if
         close(1)
 
-        deallocate(prob)
-
       else
 
         write(2,*) 'Too few pairs to continue.'
-        corlate=-3
 
       end if
-      
-      deallocate(pair)
+
       close(2)
 
-            
-    end function corlate
+    end subroutine write_corlate_result
 
-    real function median(srtbuf, nfile)
 
-      ! Finds the median value in steps of 1.  Needs generalising.
+    integer function corlate_buffers(buffer_1, buffer_2)
 
-      real, intent(out), dimension(:) :: srtbuf
-      integer, intent(in) :: nfile
+      ! Finds the nearest match between two catalogues in cluster format,
+      ! held in strings with the lines separated by newlines, buffer_1
+      ! being the two colour catalogue.  Nothing is read or written;
+      ! instead the result is kept in last_results(1), from where it can be
+      ! copied with the get_result routines below.  The return value is
+      ! as for corlate_catalogue.
+
+      use define_star
+      use cluster_match_subs
+
+      implicit none
+
+      character(len=*), intent(in) :: buffer_1, buffer_2
+
+      type(a_catalogue) :: cat
+      integer :: nstars1, ncol1
+      character(len=3), dimension(mcol) :: colstr1
+      type(a_star), dimension(:), allocatable :: star1
+      double precision :: t0
+
+      last_metrics=a_corlate_metrics()
+      t0=wall_time()
+      call parse_cluster_buffer(buffer_1, nstars1, ncol1, colstr1, star1)
+      last_metrics%t_read=wall_time()-t0
+      t0=wall_time()
+      call make_catalogue(cat, star1(1:nstars1), colstr1, &
+      config%inital_rad)
+      last_metrics%t_index=wall_time()-t0
+      deallocate(star1)
+
+      if (allocated(last_results)) deallocate(last_results)
+      allocate(last_results(1))
+      call corlate_frame(cat, buffer_2, last_results(1))
+      call add_metrics(last_metrics, last_results(1)%metrics)
+      call free_catalogue(cat)
+      corlate_buffers=last_results(1)%status
+
+    end function corlate_buffers
+
+
+    integer function corlate_batch(file_name_1, cache_name, nframe, &
+                                   frame_len, frames, by_frame)
+
+      ! Matches many one colour catalogues (e.g. the frames of a night's
+      ! observing) against the two colour catalogue in the cluster format
+      ! file file_name_1, which is read (or taken from the cache in 
+      ! cache_name, see load_catalogue) and indexed only once.  The 
+      ! nframe catalogues are held one after the other in frames, the
+      ! lengths of each being in frame_len, as for buffer_2 of 
+      ! corlate_buffers.  If by_frame is non-zero the frames are done in 
+      ! parallel, rather than matching the stars of each in parallel, 
+      ! which is faster for small frames.  As for corlate_buffers nothing
+      ! is written; the result for each frame is kept in last_results.  
+      ! The return value is -1 if file_name_1 can't be read, -2 if there
+      ! are no frames, and 0 otherwise, whatever happened with the frames.
+
+      use define_star
+      use cluster_match_subs
+!$    use omp_lib
+
+      implicit none
+
+      character(len=*), intent(in) :: file_name_1, cache_name
+      integer, intent(in) :: nframe
+      integer, dimension(nframe), intent(in) :: frame_len
+      character(len=*), intent(in) :: frames
+      integer, intent(in) :: by_frame
+
+      type(a_catalogue) :: cat
+      integer :: iframe, iostat, nthreads
+      integer, dimension(nframe) :: start
+      double precision :: t0
+      logical :: parallel_frames
+
+      if (allocated(last_results)) deallocate(last_results)
+      last_metrics=a_corlate_metrics()
+      if (nframe < 1) then
+        corlate_batch=-2
+        return
+      end if
+      t0=wall_time()
+      call load_catalogue(file_name_1, cache_name, config%inital_rad, cat, &
+      iostat, last_metrics%t_index)
+      last_metrics%t_read=wall_time()-t0-last_metrics%t_index
+      if (iostat /= 0) then
+        corlate_batch=-1
+        return
+      end if
+      corlate_batch=0
+
+      start(1)=1
+      do iframe=2, nframe
+        start(iframe)=start(iframe-1)+frame_len(iframe-1)
+      end do
+
+      nthreads=1
+!$    nthreads=omp_get_max_threads()
+      if (corlate_threads > 0) nthreads=corlate_threads
+      ! Without OpenMP the frames are always done one after the other.
+      parallel_frames=(by_frame /= 0)
+
+      ! When the frames are done in parallel, the parallel matching inside 
+      ! each of them is done by a single thread (unless nested parallelism
+      ! has been turned on).
+      allocate(last_results(nframe))
+      !$omp parallel do num_threads(nthreads) if(parallel_frames) &
+      !$omp schedule(dynamic, 1)
+      do iframe=1, nframe
+        call corlate_frame(cat, &
+        frames(start(iframe):start(iframe)+frame_len(iframe)-1), &
+        last_results(iframe))
+      end do
+      !$omp end parallel do
+      do iframe=1, nframe
+        call add_metrics(last_metrics, last_results(iframe)%metrics)
+      end do
+      call free_catalogue(cat)
+
+    end function corlate_batch
+
+
+    subroutine corlate_frame(cat, buffer, result)
+
+      ! Matches the one colour catalogue in buffer (as for corlate_buffers)
+      ! against cat.
+
+      use define_star
+      use cluster_match_subs
+
+      implicit none
+
+      type(a_catalogue), intent(in) :: cat
+      character(len=*), intent(in) :: buffer
+      type(a_corlate_result), intent(out) :: result
+
+      integer :: nstars2, ncol2
+      character(len=3), dimension(mcol) :: colstr2
+      type(a_star), dimension(:), allocatable :: star2
+      double precision :: t0, t_read
+
+      t0=wall_time()
+      call parse_cluster_buffer(buffer, nstars2, ncol2, colstr2, star2)
+      t_read=wall_time()-t0
+      call corlate_match(cat, star2(1:nstars2), colstr2, result)
+      result%metrics%t_read=t_read
+      deallocate(star2)
+
+    end subroutine corlate_frame
+
+
+    subroutine add_metrics(total, part)
+
+      ! Adds the metrics for part of a call (e.g. a frame of a batch) to
+      ! those for the whole of it.
+
+      type(a_corlate_metrics), intent(inout) :: total
+      type(a_corlate_metrics), intent(in) :: part
+
+      total%t_read=total%t_read+part%t_read
+      total%t_index=total%t_index+part%t_index
+      total%t_first=total%t_first+part%t_first
+      total%t_second=total%t_second+part%t_second
+      total%t_fit=total%t_fit+part%t_fit
+      total%t_prob=total%t_prob+part%t_prob
+      total%t_output=total%t_output+part%t_output
+      total%nstars1=max(total%nstars1, part%nstars1)
+      total%nstars2=total%nstars2+part%nstars2
+      total%ntested=total%ntested+part%ntested
+      total%npair=total%npair+part%npair
+      total%nclip=total%nclip+part%nclip
 
-      integer :: k, l, m
-      real :: aval
-      integer, dimension(:), allocatable :: count
-
-      do 140 k=2, nfile
-        aval=srtbuf(k)
-        do l=1, k-1
-          if (aval .lt. srtbuf(l)) then
-            do m=k, l+1, -1
-              srtbuf(m)=srtbuf(m-1)
-            end do
-            srtbuf(l)=aval
-            goto 140
-          endif
+    end subroutine add_metrics
+
+
+    ! The get_result routines copy the result for frame iframe of 
+    ! last_results into plain arrays, for callers which can't use a 
+    ! Fortran derived type.
+
+    subroutine get_result_counts(iframe, counts)
+
+      ! The return value, the number of pairs on the first and second
+      ! passes, the number of points clipped from the fit, the numbers of
+      ! variables and probabilities, and the number of histogram bins.
+
+      integer, intent(in) :: iframe
+      integer, dimension(7), intent(out) :: counts
+
+      counts(1)=last_results(iframe)%status
+      counts(2)=last_results(iframe)%npair_first
+      counts(3)=last_results(iframe)%npair
+      counts(4)=last_results(iframe)%nclip
+      counts(5)=last_results(iframe)%nvar
+      counts(6)=last_results(iframe)%nprob
+      counts(7)=mprob
+
+    end subroutine get_result_counts
+
+
+    subroutine get_result_values(iframe, values)
+
+      ! The modal shift in RA and dec, the RMS separation, the fit (a, b
+      ! and chi-squared), the two points defining it, and the top of the
+      ! histogram.
+
+      integer, intent(in) :: iframe
+      real, dimension(11), intent(out) :: values
+
+      values(1)=last_results(iframe)%shift_alpha
+      values(2)=last_results(iframe)%shift_delta
+      values(3)=last_results(iframe)%dist_mean
+      values(4)=last_results(iframe)%a
+      values(5)=last_results(iframe)%b
+      values(6)=last_results(iframe)%chisq
+      values(7)=last_results(iframe)%fit_x(1)
+      values(8)=last_results(iframe)%fit_y(1)
+      values(9)=last_results(iframe)%fit_x(2)
+      values(10)=last_results(iframe)%fit_y(2)
+      values(11)=last_results(iframe)%prob_max
+
+    end subroutine get_result_values
+
+
+    subroutine get_result_colours(iframe, names)
+
+      ! The names of the four colours of the pairs, each padded to eight
+      ! characters.
+
+      integer, intent(in) :: iframe
+      character(len=*), intent(out) :: names
+
+      names=' '
+      names(1:8)=trim(last_results(iframe)%colstr1(1))//'-'// &
+      trim(last_results(iframe)%colstr2(1))
+      names(9:16)=last_results(iframe)%colstr1(2)
+      names(17:24)=last_results(iframe)%colstr2(1)
+      names(25:32)=last_results(iframe)%colstr1(1)
+
+    end subroutine get_result_colours
+
+
+    subroutine get_result_pairs(iframe, ints, reals, chars)
+
+      ! For each pair the field, CCD, ID, RA hours and minutes, and dec
+      ! degrees and minutes in ints; the RA and dec seconds, X, Y, and the
+      ! data and error for each of the four colours in reals; and the
+      ! sign of the dec followed by the four flags in chars.
+
+      integer, intent(in) :: iframe
+      integer, dimension(7,*), intent(out) :: ints
+      real, dimension(12,*), intent(out) :: reals
+      character(len=*), intent(out) :: chars
+
+      integer :: i, icol, ipos
+
+      chars=' '
+      do i=1, last_results(iframe)%npair
+        ints(1,i)=last_results(iframe)%pair(i)%field
+        ints(2,i)=last_results(iframe)%pair(i)%ccd
+        ints(3,i)=last_results(iframe)%pair(i)%id
+        ints(4,i)=last_results(iframe)%pair(i)%ra_h
+        ints(5,i)=last_results(iframe)%pair(i)%ra_m
+        ints(6,i)=last_results(iframe)%pair(i)%dc_d
+        ints(7,i)=last_results(iframe)%pair(i)%dc_m
+        reals(1,i)=last_results(iframe)%pair(i)%ra_s
+        reals(2,i)=last_results(iframe)%pair(i)%dc_s
+        reals(3,i)=last_results(iframe)%pair(i)%x
+        reals(4,i)=last_results(iframe)%pair(i)%y
+        ipos=9*(i-1)+1
+        chars(ipos:ipos)=last_results(iframe)%pair(i)%dc_sign
+        do icol=1, 4
+          reals(3+2*icol,i)=last_results(iframe)%pair(i)%col(icol)%data
+          reals(4+2*icol,i)=last_results(iframe)%pair(i)%col(icol)%err
+          chars(ipos+2*icol-1:ipos+2*icol)= &
+          last_results(iframe)%pair(i)%col(icol)%flg
         end do
-140   continue
+      end do
+
+    end subroutine get_result_pairs
+
+
+    subroutine get_result_variables(iframe, var, reals)
+
+      ! For each variable its index in the pairs, and its increase in
+      ! brightness, the error in that and the false alarm probability.
+
+      integer, intent(in) :: iframe
+      integer, dimension(*), intent(out) :: var
+      real, dimension(3,*), intent(out) :: reals
+
+      integer :: i
+
+      do i=1, last_results(iframe)%nvar
+        var(i)=last_results(iframe)%var(i)
+        reals(1,i)=last_results(iframe)%var_delta_mag(i)
+        reals(2,i)=last_results(iframe)%var_err(i)
+        reals(3,i)=last_results(iframe)%var_prob(i)
+      end do
+
+    end subroutine get_result_variables
+
+
+    subroutine get_result_histogram(iframe, bin)
+
+      ! The histogram of probabilities.
+
+      integer, intent(in) :: iframe
+      real, dimension(mprob), intent(out) :: bin
+
+      bin=last_results(iframe)%bin
 
-      allocate(count(nint(srtbuf(1)):nint(srtbuf(nfile))))
+    end subroutine get_result_histogram
+
+
+    subroutine get_metrics(iframe, times, counts)
+
+      ! The metrics for frame iframe of last_results, or for the whole of
+      ! the last call if iframe is zero.  The times are for each stage in
+      ! the order of a_corlate_metrics, and the counts are the numbers of
+      ! stars in each catalogue, of stars tested, of pairs and of points
+      ! clipped, followed by the peak memory (see peak_memory).  They are
+      ! all double precision, as the number tested can be large.
+
+      integer, intent(in) :: iframe
+      double precision, dimension(7), intent(out) :: times
+      double precision, dimension(6), intent(out) :: counts
+
+      type(a_corlate_metrics) :: metrics
+
+      if (iframe == 0) then
+        metrics=last_metrics
+      else
+        metrics=last_results(iframe)%metrics
+      end if
+      times=(/ metrics%t_read, metrics%t_index, metrics%t_first, &
+      metrics%t_second, metrics%t_fit, metrics%t_prob, metrics%t_output /)
+      counts=(/ dble(metrics%nstars1), dble(metrics%nstars2), &
+      dble(metrics%ntested), dble(metrics%npair), dble(metrics%nclip), &
+      dble(peak_memory()) /)
+
+    end subroutine get_metrics
+
+
+    integer function peak_memory()
+
+      ! The most memory the process has used so far, in kilobytes, which
+      ! is read from /proc/self/status.  Zero if that can't be read.
+
+      character(len=80) :: line
+      integer :: iostat
+
+      peak_memory=0
+      open(unit=1, file='/proc/self/status', status='old', action='read', &
+      iostat=iostat)
+      if (iostat /= 0) return
+      do
+        read(1,'(a)',iostat=iostat) line
+        if (iostat /= 0) exit
+        if (line(1:6) == 'VmHWM:') then
+          read(line(7:),*,iostat=iostat) peak_memory
+          exit
+        end if
+      end do
+      close(1)
+
+    end function peak_memory
+
+    real function median(srtbuf, nfile, step)
+
+      ! Finds the most common value, in steps of step, taking the lowest
+      ! if there is a tie.  To keep the histogram a fixed size however
+      ! far out the outliers are, it only covers mbin steps either side of
+      ! the median, which is found by selection rather than sorting.
+      ! The contents of srtbuf are reordered.
+
+      real, intent(inout), dimension(:) :: srtbuf
+      integer, intent(in) :: nfile
+      real, intent(in) :: step
+
+      integer, parameter :: mbin=2000
+      integer, dimension(-mbin:mbin) :: count
+      integer :: k, kmid
+
+      kmid=nint(select(srtbuf, nfile, (nfile+1)/2)/step)
       count=0
       do k=1, nfile
-        l=nint(srtbuf(k))
-        count(l)=count(l)+1
+        if (abs(srtbuf(k)/step-real(kmid)) < real(mbin)) then
+          count(nint(srtbuf(k)/step)-kmid)=count(nint(srtbuf(k)/step)-kmid)+1
+        end if
       end do
-      median=real(minval(maxloc(count)))+nint(srtbuf(1))-1
-      deallocate(count)
+      median=real(kmid+minval(maxloc(count))-mbin-1)*step
 
     end function median
 
+
+    real function select(buf, n, k)
+
+      ! Returns the k'th smallest of the first n values in buf, partially
+      ! sorting them as it goes (Hoare's selection, with a median of
+      ! three pivot).
+
+      real, intent(inout), dimension(:) :: buf
+      integer, intent(in) :: n, k
+
+      integer :: left, right, i, j
+      real :: pivot, swap
+
+      left=1
+      right=n
+      do while (right > left)
+        ! Order the first, middle and last, and use the middle as the pivot.
+        i=(left+right)/2
+        if (buf(i) < buf(left)) call swap_them(i, left)
+        if (buf(right) < buf(left)) call swap_them(right, left)
+        if (buf(right) < buf(i)) call swap_them(right, i)
+        pivot=buf(i)
+        i=left
+        j=right
+        do while (i <= j)
+          do while (buf(i) < pivot)
+            i=i+1
+          end do
+          do while (buf(j) > pivot)
+            j=j-1
+          end do
+          if (i <= j) then
+            call swap_them(i, j)
+            i=i+1
+            j=j-1
+          end if
+        end do
+        if (k <= j) then
+          right=j
+        else if (k >= i) then
+          left=i
+        else
+          exit
+        end if
+      end do
+      select=buf(k)
+
+      contains
+
+      subroutine swap_them(i1, i2)
+
+        integer, intent(in) :: i1, i2
+
+        swap=buf(i1)
+        buf(i1)=buf(i2)
+        buf(i2)=swap
+
+      end subroutine swap_them
+
+    end function select
+
   end module corlate_subs
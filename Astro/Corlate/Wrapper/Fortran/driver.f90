@@ -2,48 +2,16 @@
    
    ! This writes out a series of files with new_ in front of the file 
    ! names, which should be compared with the similar files with old_
-   ! at the front.  Makes sure you use the LX200 + USNO-A2 parameters
-   ! in corlate.
+   ! at the front, which were made with the default settings in corlate
+   ! (see set_corlate_preset).
 
    ! The graph file colfit.grf then allows you a graphical check of the
    ! results.
    
-    module driver_subs
-
-    implicit none
-
-    contains
-
-    subroutine file_in(file_name, file)
-
-      character(len=*), intent(in) :: file_name
-      character(len=*), allocatable, dimension(:), intent(out) :: file
-
-      integer :: i, line, iostat
-
-      open(unit=1, file=file_name, status='old', action='read')
-      line=0
-      do
-        read(1,*,iostat=iostat)
-        if (iostat < 0) exit
-        line=line+1
-      end do
-      rewind(1)
-      allocate(file(line))
-      do i=1, line
-        read(1,'(a120)') file(i)
-      end do
-      close(1)
-
-    end subroutine file_in
-
-    end module driver_subs
-
     program driver
 
       use corlate_subs
       use f90_unix_env
-      use driver_subs
 
       implicit none
       
@@ -57,8 +25,6 @@
       character(len=50), parameter :: file_name_7="new_hist.dat"
       character(len=50), parameter :: file_name_8="new_info.dat"
 
-      character(len=120), dimension(:), allocatable :: file_1, file_2
-      
       ! Return STATUS
       !    0 = success
       !   -1 = failed to open file_name_1
@@ -66,12 +32,9 @@
       !   -3 = Too few stars paired between catalogues.
       integer :: status
 
-      call file_in(file_name_1, file_1)
-      call file_in(file_name_2, file_2)
-
-      status = corlate( file_1, size(file_1), file_2, size(file_2), file_name_3, &
-                        file_name_4, file_name_5, file_name_6, &
-                        file_name_7, file_name_8 )
+      status = corlate_files( file_name_1, file_name_2, file_name_3, &
+                              file_name_4, file_name_5, file_name_6, &
+                              file_name_7, file_name_8 )
 
       write(*,*) 'Status: ', status
 
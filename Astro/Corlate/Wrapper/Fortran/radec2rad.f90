@@ -27,6 +27,31 @@
  19   return
       end subroutine radec2rad
 
+      subroutine dradec2rad(ra1,ra2,ra3,dec1,dec2,dec3,  &
+           alpha,delta)
+!
+!     As radec2rad, but in double precision, which is needed to resolve
+!     arcsecond separations.
+!
+      implicit none
+
+      integer, intent(in) :: ra1, ra2, dec1, dec2
+      double precision, intent(out) :: alpha, delta
+      real, intent(in) :: ra3, dec3
+      double precision twopi,dsign
+!
+      twopi=8.0d0*atan(1.0d0)
+!
+      alpha=twopi*(ra1+ra2/60.0d0+dble(ra3)/3600.0d0)/24.0d0
+      if(dec1 > 0.0)dsign=1.0d0
+      if (dec1.lt.0.0)dsign=-1.0d0
+      if (dec1.eq.-0.0)dsign=-1.0d0
+      if (dec2.lt.0.0)dsign=-1.0d0
+      if (dec3.lt.0.0)dsign=-1.0d0
+      delta=dsign*twopi*(abs(dec1)+abs(dec2)/60.0d0+abs(dble(dec3))/3600.0d0)/360.0d0
+      return
+      end subroutine dradec2rad
+
       end module radec2rad_mod
 
 
@@ -11,6 +11,33 @@ Astro::Corlate::Wrapper - Perl extension for wrapping the F95 CORLATE routine.
   corlate( $catalog, $observation, $log_file $variables,
            $fit_data, $fit_to_data, $histogram, $output );
 
+  # keep the parsed and indexed reference catalogue in $cache_file
+  corlate_cached( $catalog, $cache_file, $observation, $log_file,
+                  $variables, $fit_data, $fit_to_data, $histogram, $output );
+
+  # correlate catalogues held in strings, returning the results as a hash
+  $result = corlate_buffers( $catalog_text, $observation_text );
+
+  # correlate many observations, held in strings, against the same
+  # catalogue, reading and indexing it only once
+  $results = corlate_batch( $catalog, $cache_file, \@observations, $by_frame );
+
+  # how long each stage of the last call took, and how much it did
+  $metrics = corlate_metrics( );
+
+  # match the catalogues using 4 threads
+  set_threads( 4 );
+
+  # use the USNO-A2 + LX200 settings, but accept a 5% false alarm rate
+  set_preset( 'usno-a2_lx200' );
+  set_option( 'accept_prob', 0.05 );
+
+  # settings it doesn't know return -1, and values out of range -2
+  $status = set_option( 'minpair', 0 );
+
+  # and find out what a setting is
+  $accept_prob = get_option( 'accept_prob' );
+
 =head1 DESCRIPTION
 
 A wrapper module for the Fortran95 CORLATE subroutine. Shouldn't be used
@@ -41,9 +68,13 @@ our @ISA = qw(Exporter DynaLoader);
 # This allows declaration	use Wrapper ':all';
 # If you do not need this, moving things directly into @EXPORT or @EXPORT_OK
 # will save memory.
-our %EXPORT_TAGS = ( 'all' => [ qw( corlate ) ] );
+our %EXPORT_TAGS = ( 'all' => [ qw( corlate corlate_cached corlate_buffers corlate_batch
+                                  corlate_metrics set_threads
+                                  set_preset set_option get_option ) ] );
 
-our @EXPORT_OK = qw / corlate /;
+our @EXPORT_OK = qw / corlate corlate_cached corlate_buffers corlate_batch
+                    corlate_metrics set_threads set_preset set_option
+                    get_option /;
 
 our @EXPORT = qw / /;
 
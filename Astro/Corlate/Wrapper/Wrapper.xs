@@ -2,7 +2,164 @@
 #include "perl.h"
 #include "XSUB.h"
 
-#define corlate corlate_subs_MP_corlate
+#define corlate corlate_subs_MP_corlate_files
+
+/* Stores a Perl array of the given floats in a hash */
+static void store_floats( HV * hash, char * key, float * values, int n )
+{
+   AV * array = newAV();
+   int i;
+
+   for ( i = 0; i < n; i++ ) {
+      av_push( array, newSVnv( values[i] ) );
+   }
+   hv_store( hash, key, strlen(key), newRV_noinc( (SV *) array ), 0 );
+}
+
+/* Copies the metrics for one frame (or for the whole of the last call if
+   iframe is zero) out of the Fortran, as a Perl hash */
+static SV * get_metrics( int iframe )
+{
+   static char * stages[7] = { "read", "index", "first_pass", "second_pass",
+                               "fit", "probability", "output" };
+   static char * names[6] = { "stars_reference", "stars_observation",
+                              "candidates", "pairs", "clipped",
+                              "peak_memory" };
+   double times[7];
+   double counts[6];
+   HV * metrics;
+   HV * time;
+   int i;
+
+   corlate_subs_MP_get_metrics( &iframe, times, counts );
+
+   metrics = newHV();
+   time = newHV();
+   for ( i = 0; i < 7; i++ ) {
+      hv_store( time, stages[i], strlen(stages[i]), newSVnv( times[i] ), 0 );
+   }
+   hv_store( metrics, "time", 4, newRV_noinc( (SV *) time ), 0 );
+   for ( i = 0; i < 6; i++ ) {
+      hv_store( metrics, names[i], strlen(names[i]), newSVnv( counts[i] ), 0 );
+   }
+
+   return newRV_noinc( (SV *) metrics );
+}
+
+/* Copies the result for one frame out of the Fortran, as a Perl hash */
+static SV * get_result( int iframe )
+{
+   int counts[7];
+   float values[11];
+   char names[32];
+   int * ints;
+   float * reals;
+   char * chars;
+   int * var;
+   float * histogram;
+   HV * result;
+   HV * fit;
+   HV * star;
+   AV * colours;
+   AV * pairs;
+   AV * variables;
+   AV * colour;
+   int npair, nvar, i, j;
+   char sign;
+
+   corlate_subs_MP_get_result_counts( &iframe, counts );
+   corlate_subs_MP_get_result_values( &iframe, values );
+   corlate_subs_MP_get_result_colours( &iframe, names, 32 );
+   npair = counts[2];
+   nvar = counts[4];
+
+   result = newHV();
+   hv_store( result, "status", 6, newSViv( counts[0] ), 0 );
+   hv_store( result, "first_pass", 10, newSViv( counts[1] ), 0 );
+   store_floats( result, "shift", values, 2 );
+   hv_store( result, "separation", 10, newSVnv( values[2] ), 0 );
+
+   colours = newAV();
+   for ( j = 0; j < 4; j++ ) {
+      for ( i = 8; i > 0 && names[8*j+i-1] == ' '; i-- );
+      av_push( colours, newSVpvn( names + 8*j, i ) );
+   }
+   hv_store( result, "colours", 7, newRV_noinc( (SV *) colours ), 0 );
+
+   /* the pairs, each a hash like those from Astro::Catalog */
+   Newz( 0, ints, 7*npair + 1, int );
+   Newz( 0, reals, 12*npair + 1, float );
+   Newz( 0, chars, 9*npair + 1, char );
+   corlate_subs_MP_get_result_pairs( &iframe, ints, reals, chars, 9*npair );
+   pairs = newAV();
+   for ( i = 0; i < npair; i++ ) {
+      star = newHV();
+      hv_store( star, "field", 5, newSViv( ints[7*i] ), 0 );
+      hv_store( star, "ccd", 3, newSViv( ints[7*i+1] ), 0 );
+      hv_store( star, "id", 2, newSViv( ints[7*i+2] ), 0 );
+      hv_store( star, "ra", 2, newSVpvf( "%02d %02d %06.3f",
+                ints[7*i+3], ints[7*i+4], reals[12*i] ), 0 );
+      /* tidy_star makes every part of a southern dec negative, so as in
+         write_star the sign comes first and the parts are unsigned */
+      sign = chars[9*i] == '-' || ints[7*i+5] < 0 || ints[7*i+6] < 0 ||
+             reals[12*i+1] < 0.0 ? '-' : '+';
+      hv_store( star, "dec", 3, newSVpvf( "%c%02d %02d %05.2f", sign,
+                abs( ints[7*i+5] ), abs( ints[7*i+6] ),
+                fabs( reals[12*i+1] ) ), 0 );
+      hv_store( star, "x", 1, newSVnv( reals[12*i+2] ), 0 );
+      hv_store( star, "y", 1, newSVnv( reals[12*i+3] ), 0 );
+      colours = newAV();
+      for ( j = 0; j < 4; j++ ) {
+         colour = newAV();
+         av_push( colour, newSVnv( reals[12*i+4+2*j] ) );
+         av_push( colour, newSVnv( reals[12*i+5+2*j] ) );
+         av_push( colour, newSVpvn( chars + 9*i+1+2*j, 2 ) );
+         av_push( colours, newRV_noinc( (SV *) colour ) );
+      }
+      hv_store( star, "colours", 7, newRV_noinc( (SV *) colours ), 0 );
+      av_push( pairs, newRV_noinc( (SV *) star ) );
+   }
+   hv_store( result, "pairs", 5, newRV_noinc( (SV *) pairs ), 0 );
+   Safefree( ints );
+   Safefree( reals );
+   Safefree( chars );
+
+   fit = newHV();
+   hv_store( fit, "a", 1, newSVnv( values[3] ), 0 );
+   hv_store( fit, "b", 1, newSVnv( values[4] ), 0 );
+   hv_store( fit, "chisq", 5, newSVnv( values[5] ), 0 );
+   hv_store( fit, "nclip", 5, newSViv( counts[3] ), 0 );
+   store_floats( fit, "line", values + 6, 4 );
+   hv_store( result, "fit", 3, newRV_noinc( (SV *) fit ), 0 );
+
+   /* the variables refer to the same hashes as the pairs */
+   Newz( 0, var, nvar + 1, int );
+   Newz( 0, reals, 3*nvar + 1, float );
+   corlate_subs_MP_get_result_variables( &iframe, var, reals );
+   variables = newAV();
+   for ( i = 0; i < nvar; i++ ) {
+      star = newHV();
+      hv_store( star, "star", 4, 
+                newSVsv( *av_fetch( pairs, var[i]-1, 0 ) ), 0 );
+      hv_store( star, "delta_mag", 9, newSVnv( reals[3*i] ), 0 );
+      hv_store( star, "error", 5, newSVnv( reals[3*i+1] ), 0 );
+      hv_store( star, "probability", 11, newSVnv( reals[3*i+2] ), 0 );
+      av_push( variables, newRV_noinc( (SV *) star ) );
+   }
+   hv_store( result, "variables", 9, newRV_noinc( (SV *) variables ), 0 );
+   Safefree( var );
+   Safefree( reals );
+
+   Newz( 0, histogram, counts[6], float );
+   corlate_subs_MP_get_result_histogram( &iframe, histogram );
+   store_floats( result, "histogram", histogram, counts[6] );
+   hv_store( result, "histogram_max", 13, newSVnv( values[10] ), 0 );
+   Safefree( histogram );
+
+   hv_store( result, "metrics", 7, get_metrics( iframe ), 0 );
+
+   return newRV_noinc( (SV *) result );
+}
 
 MODULE = Astro::Corlate::Wrapper	PACKAGE = Astro::Corlate::Wrapper
 
@@ -17,9 +174,139 @@ corlate( str1, str2, str3, str4, str5, str6, str7, str8 )
    char * str7 
    char * str8 
 CODE:
-   RETVAL = corlate_subs_MP_corlate( 
+   RETVAL = corlate_subs_MP_corlate_files( 
                 str1, str2, str3, str4, str5, str6, str7, str8,
                 strlen(str1), strlen(str2), strlen(str3), strlen(str4),
                 strlen(str5), strlen(str6), strlen(str7), strlen(str8)    );
 OUTPUT:
    RETVAL              
+
+int
+corlate_cached( str1, cache, str2, str3, str4, str5, str6, str7, str8 )
+   char * str1 
+   char * cache 
+   char * str2 
+   char * str3 
+   char * str4 
+   char * str5 
+   char * str6 
+   char * str7 
+   char * str8 
+CODE:
+   RETVAL = corlate_subs_MP_corlate_cached( 
+                str1, cache, str2, str3, str4, str5, str6, str7, str8,
+                strlen(str1), strlen(cache), strlen(str2), strlen(str3),
+                strlen(str4), strlen(str5), strlen(str6), strlen(str7),
+                strlen(str8)    );
+OUTPUT:
+   RETVAL              
+
+SV *
+corlate_buffers( reference, observation )
+   SV * reference
+   SV * observation
+PREINIT:
+   char * buffer1;
+   char * buffer2;
+   STRLEN length1, length2;
+CODE:
+   buffer1 = SvPV( reference, length1 );
+   buffer2 = SvPV( observation, length2 );
+   corlate_subs_MP_corlate_buffers( buffer1, buffer2, length1, length2 );
+   RETVAL = get_result( 1 );
+OUTPUT:
+   RETVAL
+
+SV *
+corlate_batch( reference, cache, observations, by_frame )
+   char * reference
+   char * cache
+   AV * observations
+   int by_frame
+PREINIT:
+   int nframe, iframe;
+   int * frame_len;
+   char * frames;
+   char * buffer;
+   STRLEN length, total;
+   AV * results;
+CODE:
+   /* join the frames into one buffer for the Fortran */
+   nframe = av_len( observations ) + 1;
+   if ( nframe < 1 ) {
+      croak( "corlate_batch: no observations given" );
+   }
+   Newz( 0, frame_len, nframe + 1, int );
+   total = 0;
+   for ( iframe = 0; iframe < nframe; iframe++ ) {
+      SvPV( *av_fetch( observations, iframe, 0 ), length );
+      frame_len[iframe] = length;
+      total += length;
+   }
+   New( 0, frames, total + 1, char );
+   total = 0;
+   for ( iframe = 0; iframe < nframe; iframe++ ) {
+      buffer = SvPV( *av_fetch( observations, iframe, 0 ), length );
+      Copy( buffer, frames + total, length, char );
+      total += length;
+   }
+
+   if ( corlate_subs_MP_corlate_batch( reference, cache, &nframe, frame_len,
+                                       frames, &by_frame, strlen(reference),
+                                       strlen(cache), total ) == 0 ) {
+      results = newAV();
+      for ( iframe = 1; iframe <= nframe; iframe++ ) {
+         av_push( results, get_result( iframe ) );
+      }
+      RETVAL = newRV_noinc( (SV *) results );
+   } else {
+      RETVAL = &PL_sv_undef;
+   }
+   Safefree( frame_len );
+   Safefree( frames );
+OUTPUT:
+   RETVAL
+
+SV *
+corlate_metrics()
+CODE:
+   RETVAL = get_metrics( 0 );
+OUTPUT:
+   RETVAL
+
+void
+set_threads( nthreads )
+   int nthreads
+CODE:
+   corlate_subs_MP_set_corlate_threads( &nthreads );
+
+int
+set_preset( name )
+   char * name
+CODE:
+   RETVAL = corlate_subs_MP_set_corlate_preset( name, strlen(name) );
+OUTPUT:
+   RETVAL
+
+int
+set_option( name, value )
+   char * name
+   float value
+CODE:
+   RETVAL = corlate_subs_MP_set_corlate_option( name, &value, strlen(name) );
+OUTPUT:
+   RETVAL
+
+SV *
+get_option( name )
+   char * name
+PREINIT:
+   float value;
+CODE:
+   if ( corlate_subs_MP_get_corlate_option( name, &value, strlen(name) ) == 0 ) {
+      RETVAL = newSVnv( value );
+   } else {
+      RETVAL = &PL_sv_undef;
+   }
+OUTPUT:
+   RETVAL
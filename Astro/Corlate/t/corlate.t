@@ -5,7 +5,7 @@ use strict;
 
 #load test
 use Test;
-BEGIN { plan tests => 9 };
+BEGIN { plan tests => 27 };
 
 # load modules
 use Astro::Corlate;
@@ -25,9 +25,16 @@ $ENV{"ESTAR_DATA"} = File::Spec->tmpdir();
 my $ref = File::Spec->catfile(File::Spec->curdir(),'t','archive.cat');
 my $obs = File::Spec->catfile(File::Spec->curdir(),'t','new.cat');
 
+# Metrics file
+my $metrics_file =
+   File::Spec->catfile(File::Spec->tmpdir(),'corlate_metrics.log');
+unlink $metrics_file;
+
 my $corlate = new Astro::Corlate( Reference   =>  $ref,
-                                  Observation =>  $obs );
-$corlate->run_corlate();
+                                  Observation =>  $obs,
+                                  Preset      =>  '2mass_ukirt',
+                                  MetricsFile =>  $metrics_file );
+my $metrics = $corlate->run_corlate();
 
 # grab comparison data
 my @info = <DATA>;
@@ -40,11 +47,139 @@ chomp @file;
 
 # check info file has the right values
 for my $i (0 .. $#info) {
-   ok( $file[$i], $info[$i] );
+   ok( agree( $file[$i], $info[$i] ), $info[$i] );
+}
+
+# run again on the catalogues in memory, which should agree with the files
+open(CAT, $ref);
+my @reference = <CAT>;
+close(CAT);
+open(CAT, $obs);
+my @observation = <CAT>;
+close(CAT);
+
+my $result = $corlate->run_corlate_data( Reference   => \@reference,
+                                         Observation => \@observation );
+my @variables = @{${$result}{variables}};
+
+ok( scalar(@variables), scalar( grep { /Begining of new star/ } @file ) );
+ok( sprintf( "%.5f", ${$variables[0]}{delta_mag} ),
+    sprintf( "%.5f", (split ' ', $file[3])[0] ) );
+ok( sprintf( "%.4e", ${$variables[0]}{probability} ),
+    sprintf( "%.4e", (split ' ', $file[5])[0] ) );
+
+# and as a batch, once from the file and once from memory
+my $results = $corlate->run_corlate_batch(
+                        Observations => [ $obs, \@observation ] );
+for my $batch ( @{$results} ) {
+   ok( scalar( @{${$batch}{variables}} ), scalar(@variables) );
+}
+
+# and in tiles, which should find the same variables as the field is small
+my $tiled = $corlate->run_corlate_tiled( TileSize => 1, Overlap => 30 );
+ok( scalar( @{${$tiled}{variables}} ), scalar(@variables) );
+
+# the metrics of the first run, and one line in the file for each run
+ok( ${$metrics}{pairs}, scalar( @{${$result}{pairs}} ) );
+ok( ${$metrics}{stars_observation}, ${${$result}{metrics}}{stars_observation} );
+open(FILE, $metrics_file);
+my @lines = <FILE>;
+close(FILE);
+ok( scalar( grep { /^\{.*"pairs":\d+.*\}$/ } @lines ), 3 );
+
+# the same field moved onto the equator, so the southern stars have a dec
+# of -00, and should come back with the sign and dec they went in with
+my ( @south_reference, @south_observation, %south );
+foreach my $line ( @reference ) {
+   push @south_reference, south( $line );
+}
+foreach my $line ( @observation ) {
+   my $south = south( $line );
+   push @south_observation, $south;
+   $south{$1} = $2 if $south =~ /^\s*\S+\s+(\d+)(?:\s+\S+){3}\s+(\S+ \S+ \S+)/;
+}
+my $equator = $corlate->run_corlate_data( Reference   => \@south_reference,
+                                          Observation => \@south_observation );
+my @pairs = @{${$equator}{pairs}};
+ok( scalar( grep { ${$_}{dec} eq $south{${$_}{id}} } @pairs ),
+    scalar(@pairs) );
+ok( scalar( grep { ${$_}{dec} =~ /^-00 \d\d \d\d\.\d\d$/ } @pairs ) > 0 );
+
+# settings out of range are refused before anything is run
+my $broken = new Astro::Corlate( Reference   =>  $ref,
+                                 Observation =>  $obs,
+                                 Config      =>  { minpair => 0 } );
+eval { $broken->run_corlate(); };
+ok( $@ =~ /minpair out of range/ );
+
+# a batch has to have something in it
+eval { $corlate->run_corlate_batch( Observations => [ ] ); };
+ok( $@ =~ /No observation catalogues supplied/ );
+
+# the tiles read southern decs either way they're written
+ok( Astro::Corlate::_dec_degrees( split ' ', '-00 30 00.00' ), -0.5 );
+ok( Astro::Corlate::_dec_degrees( split ' ', '-12 -30 -00.00' ), -12.5 );
+
+# tiles which can't be fitted keep none of their pairs
+my $unfitted = new Astro::Corlate( Reference   =>  $ref,
+                                   Observation =>  $obs,
+                                   Config      =>  { minpair => 1000 } );
+$tiled = $unfitted->run_corlate_tiled( TileSize => 1, Workers => 2 );
+ok( ${$tiled}{status}, -3 );
+ok( scalar( @{${$tiled}{pairs}} ), 0 );
+
+# and the reason a worker failed gets back to the caller
+{
+   no warnings 'redefine';
+   local *Astro::Corlate::corlate_buffers = sub { die "no tile today\n" };
+   eval { $corlate->run_corlate_tiled( TileSize => 1, Workers => 2 ); };
+}
+ok( $@ =~ /tile 0 failed: no tile today/ );
+
+# returns the expected info file line if the line got agrees with it, or
+# the line got if it doesn't.  The numbers have to agree to 5e-6, or 2%
+# for a false alarm probability, as they depend on the compiler's rounding,
+# and the compiler chooses how they are written
+sub agree {
+   my ( $got, $expected ) = @_;
+   my ( $got_values, $got_text ) = split /\s*!\s*/, $got, 2;
+   my ( $values, $text ) = split /\s*!\s*/, $expected, 2;
+   return $got unless defined $text && defined $got_text && $got_text eq $text;
+   my @got = split ' ', $got_values;
+   my @expected = split ' ', $values;
+   return $got unless scalar(@got) == scalar(@expected);
+   for my $i ( 0 .. $#expected ) {
+      my $tolerance = $text =~ /probability/ ? 0.02*abs($expected[$i]) : 5e-6;
+      if ( $expected[$i] =~ /^[+-]?\d*\.?\d+(?:E[+-]?\d+)?$/i ) {
+         return $got unless $got[$i] =~ /^[+-]?\d*\.?\d+(?:E[+-]?\d+)?$/i &&
+           abs( $got[$i] - $expected[$i] ) <= $tolerance;
+      } else {
+         return $got unless $got[$i] eq $expected[$i];
+      }
+   }
+   return $expected;
+}
+
+# moves a catalogue line 43 35 00 south
+sub south {
+   my $line = shift;
+   return $line unless $line =~
+      /^(\s*\S+\s+\S+\s+\d+\s+\d+\s+[\d.]+\s+)([+-]?)(\d+)\s+(\d+)\s+([\d.]+)(.*)$/s;
+   my ( $start, $end ) = ( $1, $6 );
+   my $dec = ( $3*3600 + $4*60 + $5 ) * ( $2 eq '-' ? -1 : 1 ) - 156900;
+   my $sign = $dec < 0 ? '-' : '+';
+   $dec = abs( $dec );
+   my $d = int( $dec/3600 );
+   my $m = int( ( $dec - 3600*$d )/60 );
+   return sprintf( "%s%s%02d %02d %05.2f%s", $start, $sign, $d, $m,
+                   $dec - 3600*$d - 60*$m, $end );
 }
 
 # CLEAN UP
 END {
+  # get the metrics file
+  my $metrics_log = $corlate->metricsfile();
+
   # get the log file
   my $log = $corlate->logfile();
   
@@ -73,7 +208,7 @@ END {
   print "# Deleting: " . $inf ."\n";
  
   # unlink the files
-  my @list = ( $log, $var, $dat, $fit, $his, $inf );
+  my @list = ( $log, $var, $dat, $fit, $his, $inf, $metrics_log );
   unlink(@list); 
 }         
 
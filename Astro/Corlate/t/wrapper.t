@@ -5,10 +5,11 @@ use strict;
 
 #load test
 use Test;
-BEGIN { plan tests => 10 };
+BEGIN { plan tests => 17 };
 
 # load modules
-use Astro::Corlate::Wrapper qw / corlate /;
+use Astro::Corlate::Wrapper qw / corlate set_preset set_option
+                                   get_option /;
 use File::Spec;
 
 # debugging
@@ -29,6 +30,9 @@ my $file_name_6 = File::Spec->catfile(File::Spec->curdir(),'t','colfit.fit');
 my $file_name_7 = File::Spec->catfile(File::Spec->curdir(),'t','hist.dat');
 my $file_name_8 = File::Spec->catfile(File::Spec->curdir(),'t','info.dat');
 
+# the test catalogues are from 2MASS and UKIRT
+set_preset( '2mass_ukirt' );
+
 my $status = corlate( $file_name_1, $file_name_2, $file_name_3,
                       $file_name_4, $file_name_5, $file_name_6, 
                       $file_name_7, $file_name_8 );
@@ -45,8 +49,20 @@ my @file = <FILE>;
 chomp @file;
 
 for my $i (0 .. $#info) {
-   ok( $file[$i], $info[$i] );
+   ok( agree( $file[$i], $info[$i] ), $info[$i] );
 }
+
+# out of range settings are refused, and leave the setting alone
+ok( set_option( 'minpair', 0 ), -2 );
+ok( set_option( 'shift_step', -1.0 ), -2 );
+ok( set_option( 'accept_prob', 1.5 ), -2 );
+ok( get_option( 'minpair' ), 3 );
+ok( set_option( 'minpair', 5 ), 0 );
+ok( set_option( 'no_such_setting', 1 ), -1 );
+
+# and a batch with no observations is refused
+eval { Astro::Corlate::Wrapper::corlate_batch( 'nothing.cat', '', [ ], 0 ); };
+ok( $@ =~ /no observations/ );
   
 # clean up after ourselves
 print "# Cleaning up temporary files\n";
@@ -58,6 +74,30 @@ print "# Deleting: " . $file_name_7 ."\n";
 print "# Deleting: " . $file_name_8 ."\n";
 exit;
 
+# returns the expected info file line if the line got agrees with it, or
+# the line got if it doesn't.  The numbers have to agree to 5e-6, or 2%
+# for a false alarm probability, as they depend on the compiler's rounding,
+# and the compiler chooses how they are written
+sub agree {
+   my ( $got, $expected ) = @_;
+   my ( $got_values, $got_text ) = split /\s*!\s*/, $got, 2;
+   my ( $values, $text ) = split /\s*!\s*/, $expected, 2;
+   return $got unless defined $text && defined $got_text && $got_text eq $text;
+   my @got = split ' ', $got_values;
+   my @expected = split ' ', $values;
+   return $got unless scalar(@got) == scalar(@expected);
+   for my $i ( 0 .. $#expected ) {
+      my $tolerance = $text =~ /probability/ ? 0.02*abs($expected[$i]) : 5e-6;
+      if ( $expected[$i] =~ /^[+-]?\d*\.?\d+(?:E[+-]?\d+)?$/i ) {
+         return $got unless $got[$i] =~ /^[+-]?\d*\.?\d+(?:E[+-]?\d+)?$/i &&
+           abs( $got[$i] - $expected[$i] ) <= $tolerance;
+      } else {
+         return $got unless $got[$i] eq $expected[$i];
+      }
+   }
+   return $expected;
+}
+
 # --------------------------------------------------------------------------
 
 __DATA__
@@ -0,0 +1,284 @@
+package Astro::GCN::Parse::Batch;
+
+=head1 NAME
+
+Astro::GCN::Parse::Batch - decodes a stream of GCN binary packets in one go
+
+=head1 SYNOPSIS
+
+   use Astro::GCN::Constants qw(:packet_types);
+
+   $batch = new Astro::GCN::Parse::Batch( File  => $packet_log,
+                                          Types => [
+                                             TYPE_SWIFT_BAT_GRB_POS_ACK_SRC ] );
+
+   while ( my $message = $batch->next() ) {
+      print $message->ra_degrees() . " " . $message->dec_degrees() . "\n";
+   }
+
+=head1 DESCRIPTION
+
+The module decodes a buffer, or a file, holding any number of GCN binary
+packets back to back, as read from the GCN socket or an archived packet
+log. The packets are converted to local format in a single pass in C,
+the file being read in large chunks, and only the packet types asked
+for are kept.
+
+Each packet is handed back as an Astro::GCN::Parse object, which only
+unpacks the fields its accessor methods are asked for.
+
+=cut
+
+# L O A D   M O D U L E S --------------------------------------------------
+
+use strict;
+use vars qw/ $VERSION @ISA /;
+
+use Carp;
+
+use Astro::GCN::Parse;
+
+require DynaLoader;
+@ISA = qw/ DynaLoader /;
+
+$VERSION = '0.01';
+
+bootstrap Astro::GCN::Parse::Batch $VERSION;
+
+# Each decoded packet is 40 native unsigned longs
+use constant PACKET_BYTES => 160;
+
+# C O N S T R U C T O R ----------------------------------------------------
+
+=head1 REVISION
+
+$Id$
+
+=head1 METHODS
+
+=head2 Constructor
+
+=over 4
+
+=item B<new>
+
+Create a new instance from a hash of options
+
+  $batch = new Astro::GCN::Parse::Batch( Buffer => $packets );
+  $batch = new Astro::GCN::Parse::Batch( File => $packet_log,
+                                         Types => [ 61, 67 ] );
+
+returns a reference to a batch object. If Types is given only packets
+of those types are kept, otherwise all of them are. Any partial packet at
+the end of the buffer or file is ignored.
+
+=cut
+
+sub new {
+  my $proto = shift;
+  my $class = ref($proto) || $proto;
+
+  # bless the query hash into the class
+  my $block = bless { WORDS  => '',
+                      TYPES  => undef,
+                      NEXT   => 0 }, $class;
+
+  # Configure the object
+  $block->configure( @_ );
+
+  return $block;
+
+}
+
+# A C C E S S O R   M E T H O D S --------------------------------------------
+
+=back
+
+=head2 Accessor Methods
+
+=over 4
+
+=item B<count>
+
+Return the number of packets kept
+
+  $number = $batch->count();
+
+=cut
+
+sub count {
+  my $self = shift;
+  return length( $self->{WORDS} ) / PACKET_BYTES;
+}
+
+=item B<types>
+
+Return the type of each packet kept, in order
+
+  @types = $batch->types();
+
+=cut
+
+sub types {
+  my $self = shift;
+  return map { unpack( "L", substr( $self->{WORDS}, $_ * PACKET_BYTES, 4 ) ) }
+             0 .. $self->count() - 1;
+}
+
+=item B<packet>
+
+Return the n'th packet kept, counting from zero, as an Astro::GCN::Parse
+object
+
+  $message = $batch->packet( $n );
+
+returns undef if there is no such packet.
+
+=cut
+
+sub packet {
+  my $self = shift;
+  my $n = shift;
+
+  return undef if $n < 0 || $n >= $self->count();
+  return new Astro::GCN::Parse(
+            Words => substr( $self->{WORDS}, $n * PACKET_BYTES, PACKET_BYTES ) );
+}
+
+=item B<next>
+
+Return the next packet, as an Astro::GCN::Parse object, or undef once they
+have all been returned
+
+  while ( my $message = $batch->next() ) {
+     .
+     .
+     .
+  }
+
+=cut
+
+sub next {
+  my $self = shift;
+
+  my $message = $self->packet( $self->{NEXT} );
+  $self->{NEXT}++ if defined $message;
+  return $message;
+}
+
+=item B<reset>
+
+Start returning packets from the first one again
+
+  $batch->reset();
+
+=cut
+
+sub reset {
+  my $self = shift;
+  $self->{NEXT} = 0;
+}
+
+# C O N F I G U R E ----------------------------------------------------------
+
+=back
+
+=head2 General Methods
+
+=over 4
+
+=item B<configure>
+
+Configures the object, takes an options hash as an argument
+
+  $batch->configure( %options );
+
+Does nothing if the hash is not supplied. This is called directly from
+the constructor during object creation
+
+=cut
+
+sub configure {
+  my $self = shift;
+
+  # CONFIGURE FROM ARGUEMENTS
+  # -------------------------
+
+  # return unless we have arguments
+  return undef unless @_;
+
+  # grab the argument list
+  my %args = @_;
+
+  # the filter has to be known before anything is decoded
+  $self->{TYPES} = $args{Types} if exists $args{Types};
+
+  # Loop over the allowed keys and modify the default query options
+  for my $key (qw / Buffer File / ) {
+      my $method = lc($key);
+         # normal configuration methods (if needed)
+         $self->$method( $args{$key} ) if exists $args{$key};
+  }
+
+}
+
+# M E T H O D S -------------------------------------------------------------
+
+=item B<buffer>
+
+Decode the packets held in a string
+
+   $batch->buffer( $packets );
+
+replacing any decoded before.
+
+=cut
+
+sub buffer {
+  my $self = shift;
+  my $buffer = shift;
+
+  $self->{WORDS} = decode_buffer( $buffer, $self->{TYPES} );
+  $self->{NEXT} = 0;
+}
+
+=item B<file>
+
+Decode the packets held in a file
+
+   $batch->file( $packet_log );
+
+replacing any decoded before.
+
+=cut
+
+sub file {
+  my $self = shift;
+  my $file = shift;
+
+  croak( "Astro::GCN::Parse::Batch: $file does not exist" ) unless -f $file;
+  $self->{WORDS} = decode_file( $file, $self->{TYPES} );
+  $self->{NEXT} = 0;
+}
+
+# T I M E   A T   T H E   B A R  --------------------------------------------
+
+=back
+
+=head1 COPYRIGHT
+
+Copyright (C) 2026 the eSTAR project contributors.
+
+This program was written as part of the eSTAR project and is free software;
+you can redistribute it and/or modify it under the terms of the GNU Public
+License.
+
+=head1 AUTHORS
+
+The eSTAR project contributors.
+
+=cut
+
+# L A S T  O R D E R S ------------------------------------------------------
+
+1;
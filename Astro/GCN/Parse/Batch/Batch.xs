@@ -0,0 +1,192 @@
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+/* A GCN packet is 40 big-endian 32 bit words, the first being its type */
+#define PACKET_WORDS 40
+#define PACKET_BYTES ( PACKET_WORDS * 4 )
+
+/* Packet types run from 1 to a little over 100, anything outside this
+   can never be asked for */
+#define MAX_TYPES 1024
+
+/* Files are read 4096 packets at a time */
+#define READ_BYTES ( 4096 * PACKET_BYTES )
+
+/* Fills keep[] from a reference to an array of packet types, returns
+   false if there is no filter, in which case all packets are kept */
+static int get_filter( SV * types, char * keep )
+{
+   AV * array;
+   I32 i;
+   IV type;
+
+   if ( !SvOK( types ) ) {
+      return 0;
+   }
+   if ( !SvROK( types ) || SvTYPE( SvRV( types ) ) != SVt_PVAV ) {
+      croak( "Astro::GCN::Parse::Batch: the packet types must be an "
+             "array reference" );
+   }
+
+   memset( keep, 0, MAX_TYPES );
+   array = (AV *) SvRV( types );
+   for ( i = 0; i <= av_len( array ); i++ ) {
+      SV ** item = av_fetch( array, i, 0 );
+      if ( item == NULL ) {
+         continue;
+      }
+      type = SvIV( *item );
+      if ( type >= 0 && type < MAX_TYPES ) {
+         keep[type] = 1;
+      }
+   }
+   return 1;
+}
+
+static U32 get_word( const unsigned char * bytes )
+{
+   return ( (U32) bytes[0] << 24 ) | ( (U32) bytes[1] << 16 ) |
+          ( (U32) bytes[2] << 8 ) | (U32) bytes[3];
+}
+
+/* Converts the npacket packets in bytes to native byte order in one
+   pass, dropping those whose type isn't wanted, and appends them to
+   decoded as 40 native unsigned longs per packet. */
+static void decode_append( SV * decoded, const unsigned char * bytes,
+                           STRLEN npacket, const char * keep, int filter )
+{
+   STRLEN nkept, i;
+   const unsigned char * packet;
+   U32 * words;
+   U32 type;
+   int j;
+
+   /* count what we keep first, so the output is grown just once */
+   nkept = npacket;
+   if ( filter ) {
+      nkept = 0;
+      for ( i = 0; i < npacket; i++ ) {
+         type = get_word( bytes + i * PACKET_BYTES );
+         if ( type < MAX_TYPES && keep[type] ) {
+            nkept++;
+         }
+      }
+   }
+   if ( nkept == 0 ) {
+      return;
+   }
+
+   SvGROW( decoded, SvCUR( decoded ) + nkept * PACKET_BYTES + 1 );
+   words = (U32 *) SvEND( decoded );
+   for ( i = 0; i < npacket; i++ ) {
+      packet = bytes + i * PACKET_BYTES;
+      if ( filter ) {
+         type = get_word( packet );
+         if ( type >= MAX_TYPES || !keep[type] ) {
+            continue;
+         }
+      }
+      for ( j = 0; j < PACKET_WORDS; j++ ) {
+         *words++ = get_word( packet + 4 * j );
+      }
+   }
+   SvCUR_set( decoded, SvCUR( decoded ) + nkept * PACKET_BYTES );
+   *SvEND( decoded ) = '\0';
+}
+
+/* Decodes the packets in bytes[0..length), as for decode_append, into a
+   new string. Any partial packet at the end is ignored. */
+static SV * decode( const unsigned char * bytes, STRLEN length, SV * types )
+{
+   char keep[MAX_TYPES];
+   int filter;
+   SV * decoded;
+
+   filter = get_filter( types, keep );
+   decoded = newSVpvn( "", 0 );
+   decode_append( decoded, bytes, length / PACKET_BYTES, keep, filter );
+   return decoded;
+}
+
+MODULE = Astro::GCN::Parse::Batch		PACKAGE = Astro::GCN::Parse::Batch
+
+PROTOTYPES: DISABLE
+
+SV *
+decode_buffer( buffer, types = &PL_sv_undef )
+   SV * buffer
+   SV * types
+ PREINIT:
+   const char * bytes;
+   STRLEN length;
+ CODE:
+   bytes = SvPVbyte( buffer, length );
+   RETVAL = decode( (const unsigned char *) bytes, length, types );
+ OUTPUT:
+   RETVAL
+
+SV *
+decode_file( file, types = &PL_sv_undef )
+   char * file
+   SV * types
+ PREINIT:
+   char keep[MAX_TYPES];
+   int filter;
+   int fd;
+   struct stat info;
+   unsigned char * chunk;
+   STRLEN have, npacket;
+   ssize_t got;
+ CODE:
+   /* The file is read rather than mapped, as a packet log which is
+      truncated while it is being decoded would raise SIGBUS on a
+      mapping, where read() just stops early. */
+   filter = get_filter( types, keep );
+   fd = open( file, O_RDONLY );
+   if ( fd < 0 ) {
+      croak( "Astro::GCN::Parse::Batch: cannot open %s: %s", file,
+             strerror( errno ) );
+   }
+   RETVAL = newSVpvn( "", 0 );
+   if ( !filter && fstat( fd, &info ) == 0 && info.st_size > 0 ) {
+      SvGROW( RETVAL, info.st_size / PACKET_BYTES * PACKET_BYTES + 1 );
+   }
+
+   /* whole packets are decoded from each chunk, and what is left of a
+      packet carried over to the start of the next */
+   New( 0, chunk, READ_BYTES, unsigned char );
+   have = 0;
+   for ( ;; ) {
+      got = read( fd, chunk + have, READ_BYTES - have );
+      if ( got < 0 && errno == EINTR ) {
+         continue;
+      }
+      if ( got < 0 ) {
+         int error = errno;
+         Safefree( chunk );
+         close( fd );
+         SvREFCNT_dec( RETVAL );
+         croak( "Astro::GCN::Parse::Batch: cannot read %s: %s", file,
+                strerror( error ) );
+      }
+      if ( got == 0 ) {
+         break;
+      }
+      have += got;
+      npacket = have / PACKET_BYTES;
+      decode_append( RETVAL, chunk, npacket, keep, filter );
+      have -= npacket * PACKET_BYTES;
+      memmove( chunk, chunk + npacket * PACKET_BYTES, have );
+   }
+   Safefree( chunk );
+   close( fd );
+ OUTPUT:
+   RETVAL
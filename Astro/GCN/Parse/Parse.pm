@@ -13,6 +13,9 @@ GCN::Packet::Parse - module which parses valid GCN binary messages
 The module parses incoming GCN binary packet and parses it, it will
 correct parse TYPE_IM_ALIVE and all (most?) SWIFT related packets.
 
+To decode a large number of packets at once, e.g. an archived packet log,
+see Astro::GCN::Parse::Batch.
+
 =cut
 
 # L O A D   M O D U L E S --------------------------------------------------
@@ -49,6 +52,7 @@ $Id: Parse.pm,v 1.3 2005/04/22 13:36:06 aa Exp $
 Create a new instance from a hash of options
 
   $message = new Astro::GCN::Parse( Packet => $packet );
+  $message = new Astro::GCN::Parse( Words => $words );
 
 returns a reference to an message object.
 
@@ -60,6 +64,7 @@ sub new {
 
   # bless the query hash into the class
   my $block = bless { BUFFER  => undef,
+                      WORDS   => undef,
                       MESSAGE => [],
                       TYPE    => undef  }, $class;
 
@@ -103,7 +108,7 @@ Return the packet serial number
 
 sub serial_number {
   my $self = shift;
-  return $self->{MESSAGE}[1];
+  return $self->_word( 1 );
 }
 
 
@@ -117,7 +122,7 @@ Return the packet hop count which is incremented by each node
 
 sub hop_count {
   my $self = shift;
-  return $self->{MESSAGE}[2];
+  return $self->_word( 2 );
 }
 
 =item B<gcn_sod>
@@ -130,7 +135,7 @@ Return the time (seconds of day) when the packet was sent from the GCN.
 
 sub gcn_sod {
   my $self = shift;
-  return ( $self->{MESSAGE}[3] / 100.0 );
+  return ( $self->_word( 3 ) / 100.0 );
 }
 
 # S W I F T   R E L A T E D   M E T H O D S ---------------------------------
@@ -171,7 +176,7 @@ sub trigger_num {
   return undef unless $self->is_swift();
 
   my ( $trig_num, $obs_num ) =
-    Astro::GCN::Util::SWIFT::convert_trig_obs_num( $self->{MESSAGE}[4] );
+    Astro::GCN::Util::SWIFT::convert_trig_obs_num( $self->_word( 4 ) );
   return $trig_num;
 
 }
@@ -189,7 +194,7 @@ sub obs_num {
   return undef unless $self->is_swift();
 
   my ( $trig_num, $obs_num ) =
-    Astro::GCN::Util::SWIFT::convert_trig_obs_num( $self->{MESSAGE}[4] );
+    Astro::GCN::Util::SWIFT::convert_trig_obs_num( $self->_word( 4 ) );
   return $obs_num;
 
 }
@@ -213,7 +218,7 @@ sub tjd {
      return undef;
   }
 
-  return $self->{MESSAGE}[5];
+  return $self->_word( 5 );
 
 }
 
@@ -236,7 +241,7 @@ sub data_sod {
   if ( $self->type() >= 74 && $self->type <= 75 ) {
      return undef;
   }
-  return ( $self->{MESSAGE}[6] / 100.0 );
+  return ( $self->_word( 6 ) / 100.0 );
 }
 
 =item B<ra>
@@ -258,7 +263,7 @@ sub ra {
      return undef;
   }
 
-  my $ra = Astro::GCN::Util::convert_ra_to_sextuplets( $self->{MESSAGE}[7] );
+  my $ra = Astro::GCN::Util::convert_ra_to_sextuplets( $self->_word( 7 ) );
   return $ra;
 
 }
@@ -282,7 +287,7 @@ sub dec {
      return undef;
   }
 
-  my $dec = Astro::GCN::Util::convert_dec_to_sextuplets( $self->{MESSAGE}[8] );
+  my $dec = Astro::GCN::Util::convert_dec_to_sextuplets( $self->_word( 8 ) );
   return $dec;
 
 }
@@ -309,7 +314,7 @@ sub burst_error {
   }
 
   my $error =
-    Astro::GCN::Util::convert_burst_error_to_arcmin ( $self->{MESSAGE}[11] );
+    Astro::GCN::Util::convert_burst_error_to_arcmin ( $self->_word( 11 ) );
 
   return $error;
 
@@ -335,7 +340,7 @@ sub ra_degrees {
      return undef;
   }
 
-  my $ra = Astro::GCN::Util::convert_ra_to_degrees( $self->{MESSAGE}[7] );
+  my $ra = Astro::GCN::Util::convert_ra_to_degrees( $self->_word( 7 ) );
   return $ra;
 
 }
@@ -359,7 +364,7 @@ sub dec_degrees {
      return undef;
   }
 
-  my $dec = Astro::GCN::Util::convert_dec_to_degrees( $self->{MESSAGE}[8] );
+  my $dec = Astro::GCN::Util::convert_dec_to_degrees( $self->_word( 8 ) );
   return $dec;
 
 }
@@ -386,7 +391,7 @@ sub burst_error_degrees {
   }
 
   my $error =
-    Astro::GCN::Util::convert_burst_error_to_degrees ( $self->{MESSAGE}[11] );
+    Astro::GCN::Util::convert_burst_error_to_degrees ( $self->_word( 11 ) );
 
   return $error;
 
@@ -412,7 +417,7 @@ sub solution_status {
   }
 
   my %soln_status =
-    Astro::GCN::Util::SWIFT::convert_soln_status ( $self->{MESSAGE}[18] );
+    Astro::GCN::Util::SWIFT::convert_soln_status ( $self->_word( 18 ) );
 
   return %soln_status;
 
@@ -435,7 +440,7 @@ sub bat_ipeak {
      return undef;
   }
 
-  return $self->{MESSAGE}[10];
+  return $self->_word( 10 );
 
 }
 
@@ -456,7 +461,7 @@ sub uvot_mag {
      return undef;
   }
 
-  return ( $self->{MESSAGE}[9] / 100.0 );
+  return ( $self->_word( 9 ) / 100.0 );
 
 }
 
@@ -492,7 +497,7 @@ sub configure {
   my %args = @_;
 
   # Loop over the allowed keys and modify the default query options
-  for my $key (qw / Packet / ) {
+  for my $key (qw / Packet Words / ) {
       my $method = lc($key);
          # normal configuration methods (if needed)
          $self->$method( $args{$key} ) if exists $args{$key};
@@ -519,9 +524,45 @@ sub packet {
   $self->{BUFFER} = shift;
 
   # parse the document using private methods.
-  push @{$self->{MESSAGE}}, unpack( "N40", $self->{BUFFER} );
-  $self->{TYPE} = $self->{MESSAGE}[0];
+  $self->{WORDS} = undef;
+  $self->{MESSAGE} = [ unpack( "N40", $self->{BUFFER} ) ];
+  $self->{TYPE} = $self->_word( 0 );
+
+}
+
+=item B<words>
+
+Take a packet which has already been converted to local format, as 40
+native unsigned longs, e.g. by Astro::GCN::Parse::Batch
+
+   $message->words( $words );
+
+the fields are only unpacked as the accessor methods ask for them.
+
+=cut
 
+sub words {
+  my $self = shift;
+  $self->{WORDS} = shift;
+
+  $self->{BUFFER} = undef;
+  $self->{MESSAGE} = [];
+  $self->{TYPE} = $self->_word( 0 );
+
+}
+
+# P R I V A T E   M E T H O D S ---------------------------------------------
+
+# Returns the n'th word of the packet, unpacking it from a packet given to
+# words() the first time it's asked for
+sub _word {
+  my $self = shift;
+  my $n = shift;
+
+  if ( !defined $self->{MESSAGE}[$n] && defined $self->{WORDS} ) {
+     $self->{MESSAGE}[$n] = unpack( "L", substr( $self->{WORDS}, 4*$n, 4 ) );
+  }
+  return $self->{MESSAGE}[$n];
 }
 
 
@@ -0,0 +1,98 @@
+# Astro::GCN::Parse::Batch test harness
+
+# strict
+use strict;
+
+#load test
+use Test;
+BEGIN { plan tests => 16 };
+
+# load modules
+use Astro::GCN::Parse;
+use Astro::GCN::Parse::Batch;
+use Astro::GCN::Constants qw(:packet_types);
+
+# debugging
+use Data::Dumper;
+
+# T E S T   H A R N E S S --------------------------------------------------
+
+# a SWIFT BAT position, at RA 180.5, Dec 12.25 with a 3 arcmin error
+my @bat = ( 0 ) x 40;
+$bat[0] = TYPE_SWIFT_BAT_GRB_POS_ACK_SRC;
+$bat[1] = 42;
+$bat[5] = 13500;
+$bat[7] = 1805000;
+$bat[8] = 122500;
+$bat[10] = 250;
+$bat[11] = 500;
+
+# and an imalive
+my @alive = ( 0 ) x 40;
+$alive[0] = TYPE_IM_ALIVE;
+$alive[1] = 43;
+
+my $packets = pack( "N40", @alive ) . pack( "N40", @bat ) .
+              pack( "N40", @alive ) . pack( "N40", @bat ) . "\0" x 10;
+
+# one packet at a time, the second packet shouldn't see the first
+my $message = new Astro::GCN::Parse( Packet => pack( "N40", @alive ) );
+$message->packet( pack( "N40", @bat ) );
+ok( $message->type(), TYPE_SWIFT_BAT_GRB_POS_ACK_SRC );
+ok( scalar( @{$message->{MESSAGE}} ), 40 );
+
+# all of them
+my $batch = new Astro::GCN::Parse::Batch( Buffer => $packets );
+ok( $batch->count(), 4 );
+ok( join( " ", $batch->types() ), "3 61 3 61" );
+
+# just the BAT positions
+$batch = new Astro::GCN::Parse::Batch(
+            Buffer => $packets, Types => [ TYPE_SWIFT_BAT_GRB_POS_ACK_SRC ] );
+ok( $batch->count(), 2 );
+
+my $count = 0;
+while ( my $bat = $batch->next() ) {
+   $count++;
+}
+ok( $count, 2 );
+$batch->reset();
+
+# which decode the same as a packet parsed on its own
+$message = new Astro::GCN::Parse( Packet => pack( "N40", @bat ) );
+my $bat = $batch->next();
+ok( $bat->type(), $message->type() );
+ok( $bat->serial_number(), 42 );
+ok( $bat->tjd(), 13500 );
+ok( $bat->ra_degrees(), $message->ra_degrees() );
+ok( $bat->dec_degrees(), $message->dec_degrees() );
+ok( $bat->burst_error_degrees(), $message->burst_error_degrees() );
+ok( $bat->bat_ipeak(), 250 );
+
+# and from a file
+my $file = "t/batch.dat";
+open( FILE, ">$file" ) or die "Cannot open $file: $!";
+binmode( FILE );
+print FILE $packets;
+close( FILE );
+$batch = new Astro::GCN::Parse::Batch( File => $file, Types => [ 3 ] );
+unlink( $file );
+ok( join( " ", map { $batch->packet( $_ )->serial_number() } 0 .. 1 ),
+    "43 43" );
+
+# a file longer than the chunks it's read in, with packets split across
+# them and a partial one at the end
+open( FILE, ">$file" ) or die "Cannot open $file: $!";
+binmode( FILE );
+foreach my $serial ( 1 .. 5000 ) {
+   $alive[1] = $serial;
+   print FILE pack( "N40", @alive );
+}
+print FILE "\0" x 10;
+close( FILE );
+$batch = new Astro::GCN::Parse::Batch( File => $file );
+unlink( $file );
+ok( $batch->count(), 5000 );
+ok( join( " ", map { $batch->packet( $_ )->serial_number() } 0, 4095, 4096,
+                                                              4999 ),
+    "1 4096 4097 5000" );
@@ -37,6 +37,11 @@ scalar, or directly from a file on local disk.
    my $object = new XML::Document::RTML( XML => $xml );
    my $object = new XML::Document::RTML( File => $file );
 
+large documents can be read in a single pass, leaving any embedded
+catalogues and FITS headers where they are,
+
+   my $object = new XML::Document::RTML( File => $file, Stream => 1 );
+
 or via the build method,
 
    my $object = new XML::Document::RTML()
@@ -105,7 +110,9 @@ sub new {
                       WRITER   => undef,  # reference to an XML::Writer
                       BUFFER   => undef,  # reference to an XML::Writer::String
 		      DTD      => undef,
-		      OBS      => 0       # The current <Observation> tag we're inspecting
+		      OBS      => 0,      # The current <Observation> tag we're inspecting
+		      STREAM   => undef,  # XML::Document::RTML::Stream, if one was used
+		      PAYLOADS => []      # payloads it left in the document
 		    }, $class;
 
   # Configure the object
@@ -2055,6 +2062,72 @@ sub header_type {
   return @output;
 }
 
+=item B<payloads>
+
+Returns the payloads left in the document when it was parsed with the
+Stream option,
+
+   my $object = new XML::Document::RTML( File => $file, Stream => 1 );
+   my @payloads = $object->payloads( );
+
+as a list of hashes, e.g.
+
+   { Name        => 'FITSHeader',
+     Path        => 'RTML/Observation/ImageData/FITSHeader',
+     Observation => 0,
+     Attributes  => { type => 'all' },
+     Offset      => 2048,
+     Length      => 8640 }
+
+where the Offset and Length are those of the element's content in the
+document, and Observation is the <Observation> block it's in, if any.
+The ObjectList and FITSHeader elements are always left as payloads, as
+is any other text longer than 4096 bytes. Their content isn't available
+from C<data( )>, C<headers( )> or C<catalogues( )>.
+
+The rest of the document is read into the same hash as XML::Simple would
+build, with lists of elements which have a name, key or id attribute
+folded into a hash keyed by it, and the text decoded from UTF-8, or from
+ISO-8859-1 if the XML declaration says so. The differences are that
+
+   * payloads are returned as bytes, just as they are in the document
+   * only the predefined and numeric character entities are replaced,
+     the DTD isn't read, so entities it declares are left as they are
+   * documents declared as anything other than ISO-8859-1 or US-ASCII
+     are read as UTF-8, and UTF-16 documents aren't read at all
+   * the US_ASCII encoding some documents were sent with is read as
+     ISO-8859-1 in a file too, rather than being refused by the parser
+   * the document is checked less strictly than by XML::Parser, e.g.
+     repeated attributes and bad characters in names aren't noticed
+
+which is why it has to be asked for.
+
+=cut
+
+sub payloads {
+  my $self = shift;
+  return @{$self->{PAYLOADS}};
+}
+
+=item B<payload>
+
+Returns the content of one of the payloads listed by C<payloads( )>,
+
+   my $header = $object->payload( $n );
+
+as it is in the document, the entities aren't replaced.
+
+=cut
+
+sub payload {
+  my $self = shift;
+  my $n = shift;
+
+  my $payload = $self->{PAYLOADS}[$n];
+  return undef unless defined $payload;
+  return $self->{STREAM}->payload( $payload->{Offset}, $payload->{Length} );
+}
+
 # G E N E R A L ------------------------------------------------------------
 
 =back
@@ -2230,17 +2303,19 @@ sub configure {
   # grab the argument list
   my %args = @_;
 
-  # Loop over the keys that mean we're parsing a document
+  # Loop over the keys that mean we're parsing a document, in a single
+  # pass if we've been asked to
+  my $parse = $args{Stream} ? "_stream" : "_parse";
   for my $key (qw / File XML / ) {
      if ( lc($key) eq "file" && exists $args{$key} ) {
-        eval { $self->_parse( File => $args{$key} ); };
+        eval { $self->$parse( File => $args{$key} ); };
 	if ( $@ ) {
 	   die "$@";
 	}
 	last;
 
      } elsif ( lc($key) eq "xml"  && exists $args{$key} ) {
-        eval { $self->_parse( XML => $args{$key} ); };
+        eval { $self->$parse( XML => $args{$key} ); };
 	if ( $@ ) {
 	   die "$@";
 	}
@@ -2303,6 +2378,134 @@ sub _parse {
   return;
 }
 
+# Parses the document with XML::Document::RTML::Stream, building the same
+# hash XML::Simple would, but leaving the payloads in the document
+sub _stream {
+  my $self = shift;
+
+  # return unless we have arguments
+  return undef unless @_;
+
+  # grab the argument list
+  my %args = @_;
+
+  require XML::Document::RTML::Stream;
+  my $stream;
+  if ( exists $args{File} ) {
+     $stream = new XML::Document::RTML::Stream( File => $args{File} );
+  } elsif ( exists $args{XML} ) {
+     $args{XML} =~ s/US_ASCII/ISO-8859-1/;
+     $stream = new XML::Document::RTML::Stream( XML => $args{XML} );
+  }
+  return undef unless defined $stream;
+
+  # each element we're inside is [ name, hash, text, in text ], its text
+  # being split by its child elements
+  my @stack = ( [ undef, {}, [], 0 ] );
+  my @payloads;
+  foreach my $event ( $stream->events() ) {
+     my ( $type, @args ) = @$event;
+
+     if ( $type eq 'start' ) {
+        $stack[-1][3] = 0;
+        push @stack, [ $args[0], $args[1], [], 0 ];
+
+     } elsif ( $type eq 'text' ) {
+        if ( $stack[-1][3] ) {
+           $stack[-1][2][-1] .= $args[0];
+        } else {
+           push @{$stack[-1][2]}, $args[0];
+           $stack[-1][3] = 1;
+        }
+
+     } elsif ( $type eq 'range' ) {
+        my @path = map { $$_[0] } @stack[ 1 .. $#stack ];
+        push @payloads, $self->_stream_payload( \@stack, \@path,
+                                                { %{$stack[-1][1]} }, @args );
+
+     } elsif ( $type eq 'payload' ) {
+        my ( $name, $attributes, $offset, $length ) = @args;
+        $stack[-1][3] = 0;
+        my @path = ( ( map { $$_[0] } @stack[ 1 .. $#stack ] ), $name );
+        push @payloads, $self->_stream_payload( \@stack, \@path, $attributes,
+                                                $offset, $length );
+        _stream_add( $stack[-1][1], $name, { %$attributes } );
+
+     } elsif ( $type eq 'end' ) {
+        my ( $name, $hash, $text ) = @{ pop @stack };
+        _stream_fold( $hash );
+        my $value = $hash;
+        if ( @$text ) {
+           my $content = @$text == 1 ? $$text[0] : $text;
+           if ( keys %$hash ) {
+              $hash->{content} = $content;
+           } else {
+              $value = $content;
+           }
+        }
+        _stream_add( $stack[-1][1], $name, $value );
+     }
+  }
+
+  my ( $root ) = values %{$stack[0][1]};
+  $self->{DOCUMENT} = $root;
+  $self->{STREAM} = $stream;
+  $self->{PAYLOADS} = \@payloads;
+  return;
+}
+
+# Adds an element to its parent's hash, as XML::Simple would
+sub _stream_add {
+  my ( $hash, $name, $value ) = @_;
+
+  if ( $name eq "ImageData" || $name eq "Observation" ) {
+     push @{$hash->{$name}}, $value;
+  } elsif ( exists $hash->{$name} ) {
+     $hash->{$name} = [ $hash->{$name} ] unless ref( $hash->{$name} ) eq "ARRAY";
+     push @{$hash->{$name}}, $value;
+  } else {
+     $hash->{$name} = $value;
+  }
+}
+
+# Turns each list of elements in a hash into a hash keyed by their name,
+# key or id attribute, as XML::Simple's default KeyAttr does, unless one
+# of them has none of these
+sub _stream_fold {
+  my $hash = shift;
+
+  LIST: foreach my $name ( keys %$hash ) {
+     next unless ref( $hash->{$name} ) eq "ARRAY";
+     my %folded;
+     foreach my $element ( @{$hash->{$name}} ) {
+        next LIST unless ref( $element ) eq "HASH";
+        my ( $key ) = grep { defined $element->{$_} } qw/ name key id /;
+        next LIST unless defined $key && !ref( $element->{$key} );
+        my %copy = %$element;
+        delete $copy{$key};
+        $folded{ $element->{$key} } = \%copy;
+     }
+     $hash->{$name} = \%folded;
+  }
+}
+
+# Describes a payload found by _stream(), the path being the names of the
+# elements it's in, starting with <RTML>
+sub _stream_payload {
+  my $self = shift;
+  my ( $stack, $path, $attributes, $offset, $length ) = @_;
+
+  my %payload = ( Name       => $$path[-1],
+                  Path       => join( "/", @$path ),
+                  Attributes => $attributes,
+                  Offset     => $offset,
+                  Length     => $length );
+  if ( @$path > 1 && $$path[1] eq "Observation" ) {
+     $payload{Observation} = scalar( @{ $$stack[1][1]{Observation} || [] } );
+  }
+  return \%payload;
+}
+
 # L A S T  O R D E R S ------------------------------------------------------
 
 1;
@@ -0,0 +1,270 @@
+package XML::Document::RTML::Stream;
+# ---------------------------------------------------------------------------
+
+#+
+#  Name:
+#    XML::Document::RTML::Stream
+
+#  Purposes:
+#    Perl module to read RTML documents in a single pass
+
+#  Language:
+#    Perl module
+
+#  Authors:
+#    eSTAR project contributors
+
+#  Revision:
+#     $Id$
+
+#  Copyright:
+#     Copyright (C) 2026 the eSTAR project contributors.
+
+#-
+
+# ---------------------------------------------------------------------------
+
+=head1 NAME
+
+XML::Document::RTML::Stream - reads RTML documents in a single pass
+
+=head1 SYNOPSIS
+
+   my $stream = new XML::Document::RTML::Stream( File => $file );
+   my $stream = new XML::Document::RTML::Stream( XML => $xml );
+
+   foreach my $event ( $stream->events() ) {
+      my ( $type, @args ) = @$event;
+      .
+      .
+      .
+   }
+
+=head1 DESCRIPTION
+
+The module reads an RTML (or any other XML) document with a tokenizer
+written in C, and returns it as a list of SAX style events rather than as
+a tree. It is used by the C<Stream> option of L<XML::Document::RTML> and
+L<eSTAR::RTML::Parse>.
+
+Large payloads, the embedded catalogues and FITS headers, are not copied
+into Perl strings. Instead their position in the document is returned,
+and they can be read with C<payload( )> if they're wanted, from the file
+if the document was read from one. A file is only held in memory while
+it is tokenized.
+
+=cut
+
+# L O A D   M O D U L E S --------------------------------------------------
+
+use strict;
+use vars qw/ $VERSION @ISA /;
+
+use Carp;
+
+require DynaLoader;
+@ISA = qw/ DynaLoader /;
+
+$VERSION = '0.01';
+
+bootstrap XML::Document::RTML::Stream $VERSION;
+
+# C O N S T R U C T O R ----------------------------------------------------
+
+=head1 REVISION
+
+$Id$
+
+=head1 METHODS
+
+=head2 Constructor
+
+=over 4
+
+=item B<new>
+
+Create a new instance from a hash of options
+
+  my $stream = new XML::Document::RTML::Stream( File => $file );
+  my $stream = new XML::Document::RTML::Stream( XML => $xml,
+                                                Skip => [ 'ObjectList' ],
+                                                Payload => 65536 );
+
+the contents of the elements named by Skip, by default ObjectList and
+FITSHeader, are never looked at. Nor is any other text longer than
+Payload bytes, 4096 by default. Element names are matched regardless of
+case.
+
+Returns a reference to a stream object, croaking if the document isn't
+well formed.
+
+=cut
+
+sub new {
+  my $proto = shift;
+  my $class = ref($proto) || $proto;
+
+  # bless the query hash into the class
+  my $block = bless { XML     => undef,  # the document, unless it's in
+                      FILE    => undef,  # a file
+                      SKIP    => [ qw/ ObjectList FITSHeader / ],
+                      PAYLOAD => 4096,
+                      EVENTS  => []      # what we found in the document
+                    }, $class;
+
+  # Configure the object
+  $block->configure( @_ );
+
+  return $block;
+
+}
+
+# A C C E S S O R   M E T H O D S --------------------------------------------
+
+=back
+
+=head2 Accessor Methods
+
+=over 4
+
+=item B<events>
+
+Return the events found in the document, in order,
+
+   my @events = $stream->events();
+
+each event is a reference to an array, one of
+
+   [ 'start', $name, \%attributes ]
+   [ 'end', $name ]
+   [ 'text', $text ]
+   [ 'range', $offset, $length ]
+   [ 'payload', $name, \%attributes, $offset, $length ]
+
+Text is only returned if it's more than whitespace, and comes with the
+entities replaced. It, the attributes and the names are all characters,
+decoded from UTF-8 or from ISO-8859-1 (which US-ASCII is taken to be)
+as the XML declaration says, with numeric character references of any
+size turned into the character. As an XML parser does, line ends in the
+text become newlines, and line ends, tabs and newlines in attributes
+become spaces. A 'range' is text longer than the Payload option, which
+is left in the document. A 'payload' replaces all the events for
+a skipped element, the offset and length being those of its content.
+
+=cut
+
+sub events {
+  my $self = shift;
+  return @{$self->{EVENTS}};
+}
+
+=item B<payload>
+
+Return part of the document, usually the content of a 'payload' or a
+'range' event
+
+   my $catalogue = $stream->payload( $offset, $length );
+
+the bytes are returned as they are in the document, no entities are
+replaced and nothing is decoded.
+
+=cut
+
+sub payload {
+  my $self = shift;
+  my ( $offset, $length ) = @_;
+
+  if ( defined $self->{XML} ) {
+     return substr( $self->{XML}, $offset, $length );
+  }
+
+  my ( $FILE, $bytes );
+  croak( "XML::Document::RTML::Stream: Cannot open $self->{FILE}: $!" )
+     unless open( $FILE, "<$self->{FILE}" );
+  binmode( $FILE );
+  seek( $FILE, $offset, 0 );
+  read( $FILE, $bytes, $length );
+  close( $FILE );
+  return $bytes;
+}
+
+# C O N F I G U R E ---------------------------------------------------------
+
+=back
+
+=head2 General Methods
+
+=over 4
+
+=item B<configure>
+
+Configures the object, takes an options hash as an argument
+
+  $stream->configure( %options );
+
+Does nothing if the hash is not supplied. This is called directly from
+the constructor during object creation
+
+=cut
+
+sub configure {
+  my $self = shift;
+
+  # return unless we have arguments
+  return undef unless @_;
+
+  # grab the argument list
+  my %args = @_;
+
+  # these have to be known before the document is read
+  $self->{SKIP} = $args{Skip} if exists $args{Skip};
+  $self->{PAYLOAD} = $args{Payload} if exists $args{Payload};
+
+  # Loop over the keys that mean we're reading a document
+  for my $key (qw / File XML / ) {
+     my $method = lc($key);
+     $self->$method( $args{$key} ) if exists $args{$key};
+  }
+
+}
+
+# M E T H O D S -------------------------------------------------------------
+
+=item B<file>
+
+Read the document in a file
+
+   $stream->file( $file );
+
+=cut
+
+sub file {
+  my $self = shift;
+  my $file = shift;
+
+  croak( "XML::Document::RTML::Stream: Cannot open $file" ) unless -f $file;
+  $self->{XML} = undef;
+  $self->{FILE} = $file;
+  $self->{EVENTS} = tokenize_file( $file, $self->{SKIP}, $self->{PAYLOAD} );
+}
+
+=item B<xml>
+
+Read the document in a scalar
+
+   $stream->xml( $xml );
+
+=cut
+
+sub xml {
+  my $self = shift;
+
+  $self->{FILE} = undef;
+  $self->{XML} = shift;
+  $self->{EVENTS} =
+     tokenize_string( $self->{XML}, $self->{SKIP}, $self->{PAYLOAD} );
+}
+
+# L A S T  O R D E R S ------------------------------------------------------
+
+1;
@@ -0,0 +1,682 @@
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+
+/* How much of a file is read at a time */
+#define READ_BYTES 65536
+
+/* The state of a scan through one document */
+typedef struct {
+   const char * start;     /* the document */
+   const char * end;
+   const char * p;         /* where we've got to */
+   AV * events;            /* what we've found */
+   AV * skip;              /* names of the elements to skip */
+   STRLEN threshold;       /* text longer than this is left where it is */
+   const char ** names;    /* the elements we're inside */
+   STRLEN * lengths;
+   int depth;
+   int size;
+   int skipping;           /* depth of the element being skipped, or 0 */
+   const char * payload;   /* where its content starts */
+   HV * attrs;             /* and its attributes */
+   HV * building;          /* the attributes of the tag being read */
+   int latin1;             /* whether it's ISO-8859-1 rather than UTF-8 */
+} scan_t;
+
+static void fail( scan_t * scan, const char * why )
+{
+   Safefree( scan->names );
+   Safefree( scan->lengths );
+   if ( scan->attrs != NULL ) {
+      SvREFCNT_dec( (SV *) scan->attrs );
+   }
+   if ( scan->building != NULL ) {
+      SvREFCNT_dec( (SV *) scan->building );
+   }
+   SvREFCNT_dec( (SV *) scan->events );
+   croak( "XML::Document::RTML::Stream: %s at byte %lu", why,
+          (unsigned long) ( scan->p - scan->start ) );
+}
+
+static int is_space( char c )
+{
+   return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int is_name( char c )
+{
+   return !is_space( c ) && c != '>' && c != '/' && c != '=' && c != '<' &&
+          c != '"' && c != '\'';
+}
+
+/* Moves on past the next occurence of what, which is n characters long */
+static void skip_past( scan_t * scan, const char * what, STRLEN n )
+{
+   const char * p = scan->p;
+
+   while ( p + n <= scan->end ) {
+      p = memchr( p, what[0], scan->end - p );
+      if ( p == NULL || p + n > scan->end ) {
+         break;
+      }
+      if ( memcmp( p, what, n ) == 0 ) {
+         scan->p = p + n;
+         return;
+      }
+      p++;
+   }
+   fail( scan, "unexpected end of document" );
+}
+
+/* Appends the n bytes at p to sv, re-encoding them as UTF-8 if the
+   document is in ISO-8859-1. Line ends become "\n", as an XML parser
+   makes them, or spaces in an attribute value, along with its tabs and
+   newlines. */
+static void add_bytes( scan_t * scan, SV * sv, const char * p, STRLEN n,
+                       int attribute )
+{
+   U8 buffer[UTF8_MAXBYTES + 1];
+   STRLEN i, from;
+   U8 c;
+
+   if ( !scan->latin1 && !attribute && memchr( p, '\r', n ) == NULL ) {
+      sv_catpvn( sv, p, n );
+      return;
+   }
+   from = 0;
+   for ( i = 0; i < n; i++ ) {
+      c = (U8) p[i];
+      if ( c >= 0x80 && scan->latin1 ) {
+         sv_catpvn( sv, p + from, i - from );
+         sv_catpvn( sv, (char *) buffer,
+                    uvchr_to_utf8( buffer, c ) - buffer );
+         from = i + 1;
+      } else if ( c == '\r' || ( attribute && ( c == '\n' || c == '\t' ) ) ) {
+         sv_catpvn( sv, p + from, i - from );
+         sv_catpvn( sv, attribute ? " " : "\n", 1 );
+         if ( c == '\r' && i + 1 < n && p[i+1] == '\n' ) {
+            i++;
+         }
+         from = i + 1;
+      }
+   }
+   sv_catpvn( sv, p + from, n - from );
+}
+
+/* Marks sv, which holds text read from the document, as characters
+   rather than bytes, returning false if it isn't valid UTF-8 */
+static int decode_text( SV * sv )
+{
+   STRLEN n, i;
+   const U8 * bytes = (const U8 *) SvPV( sv, n );
+
+   for ( i = 0; i < n && bytes[i] < 0x80; i++ ) {
+   }
+   if ( i == n ) {
+      return 1;
+   }
+   if ( !is_utf8_string( (U8 *) bytes, n ) ) {
+      return 0;
+   }
+   SvUTF8_on( sv );
+   return 1;
+}
+
+/* Returns the name of an element or attribute as a new SV */
+static SV * new_name( scan_t * scan, const char * name, STRLEN n )
+{
+   SV * sv = newSVpvs( "" );
+
+   add_bytes( scan, sv, name, n, 0 );
+   if ( !decode_text( sv ) ) {
+      SvREFCNT_dec( sv );
+      fail( scan, "invalid UTF-8" );
+   }
+   return sv;
+}
+
+/* Returns the character the numeric reference between the "&#" at p and
+   the ';' at end refers to, or 0 if it isn't one XML allows, such as a
+   surrogate, or isn't a reference at all */
+static UV char_ref( const char * p, const char * end )
+{
+   UV code = 0;
+   UV base = 10;
+   UV digit;
+
+   if ( p < end && *p == 'x' ) {
+      base = 16;
+      p++;
+   }
+   if ( p == end ) {
+      return 0;
+   }
+   for ( ; p < end; p++ ) {
+      if ( *p >= '0' && *p <= '9' ) {
+         digit = *p - '0';
+      } else if ( base == 16 && *p >= 'a' && *p <= 'f' ) {
+         digit = *p - 'a' + 10;
+      } else if ( base == 16 && *p >= 'A' && *p <= 'F' ) {
+         digit = *p - 'A' + 10;
+      } else {
+         return 0;
+      }
+      code = code * base + digit;
+      if ( code > 0x10FFFF ) {
+         return 0;
+      }
+   }
+   if ( code >= 0xD800 && code <= 0xDFFF ) {
+      return 0;
+   }
+   return code;
+}
+
+/* Appends text to sv, replacing the predefined and numeric entities, the
+   latter being encoded in UTF-8. The caller decodes it with decode_text
+   once it's all there. */
+static void add_text( scan_t * scan, SV * sv, const char * p,
+                      const char * end, int attribute )
+{
+   U8 buffer[UTF8_MAXBYTES + 1];
+   const char * amp;
+   const char * semi;
+   STRLEN n;
+   UV code;
+   char c;
+
+   while ( p < end ) {
+      amp = memchr( p, '&', end - p );
+      if ( amp == NULL ) {
+         add_bytes( scan, sv, p, end - p, attribute );
+         return;
+      }
+      add_bytes( scan, sv, p, amp - p, attribute );
+      semi = memchr( amp, ';', end - amp );
+      if ( semi == NULL ) {
+         add_bytes( scan, sv, amp, end - amp, attribute );
+         return;
+      }
+      n = semi - amp - 1;
+      c = 0;
+      code = 0;
+      if ( n == 2 && memcmp( amp + 1, "lt", 2 ) == 0 ) {
+         c = '<';
+      } else if ( n == 2 && memcmp( amp + 1, "gt", 2 ) == 0 ) {
+         c = '>';
+      } else if ( n == 3 && memcmp( amp + 1, "amp", 3 ) == 0 ) {
+         c = '&';
+      } else if ( n == 4 && memcmp( amp + 1, "quot", 4 ) == 0 ) {
+         c = '"';
+      } else if ( n == 4 && memcmp( amp + 1, "apos", 4 ) == 0 ) {
+         c = '\'';
+      } else if ( n > 1 && amp[1] == '#' ) {
+         code = char_ref( amp + 2, semi );
+      }
+      if ( c != 0 ) {
+         sv_catpvn( sv, &c, 1 );
+      } else if ( code != 0 ) {
+         sv_catpvn( sv, (char *) buffer,
+                    uvchr_to_utf8( buffer, code ) - buffer );
+      } else {
+         add_bytes( scan, sv, amp, semi - amp + 1, attribute );
+      }
+      p = semi + 1;
+   }
+}
+
+static void add_event( scan_t * scan, SV * first, SV * second, SV * third,
+                       SV * fourth, SV * fifth )
+{
+   AV * event = newAV();
+
+   av_push( event, first );
+   av_push( event, second );
+   if ( third != NULL ) av_push( event, third );
+   if ( fourth != NULL ) av_push( event, fourth );
+   if ( fifth != NULL ) av_push( event, fifth );
+   av_push( scan->events, newRV_noinc( (SV *) event ) );
+}
+
+/* Handles the text between two tags, raw for CDATA sections */
+static void text( scan_t * scan, const char * p, const char * end, int raw )
+{
+   const char * q;
+   SV * sv;
+
+   if ( scan->skipping || scan->depth == 0 ) {
+      return;
+   }
+
+   /* ignore the whitespace between tags */
+   for ( q = p; q < end && is_space( *q ); q++ ) {
+   }
+   if ( q == end ) {
+      return;
+   }
+
+   if ( (STRLEN) ( end - p ) > scan->threshold ) {
+      add_event( scan, newSVpvs( "range" ), newSVuv( p - scan->start ),
+                 newSVuv( end - p ), NULL, NULL );
+      return;
+   }
+
+   sv = newSVpvs( "" );
+   if ( raw ) {
+      add_bytes( scan, sv, p, end - p, 0 );
+   } else {
+      add_text( scan, sv, p, end, 0 );
+   }
+   if ( !decode_text( sv ) ) {
+      SvREFCNT_dec( sv );
+      fail( scan, "invalid UTF-8" );
+   }
+   add_event( scan, newSVpvs( "text" ), sv, NULL, NULL, NULL );
+}
+
+static int is_skipped( scan_t * scan, const char * name, STRLEN n )
+{
+   I32 i;
+   STRLEN length;
+   const char * skip;
+
+   for ( i = 0; i <= av_len( scan->skip ); i++ ) {
+      SV ** item = av_fetch( scan->skip, i, 0 );
+      if ( item == NULL ) {
+         continue;
+      }
+      skip = SvPV( *item, length );
+      if ( length == n && strncasecmp( skip, name, n ) == 0 ) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/* Handles a start tag, scan->p being just after the '<' */
+static void start_tag( scan_t * scan )
+{
+   const char * name = scan->p;
+   const char * key;
+   const char * value;
+   STRLEN n, nkey;
+   char quote;
+   HV * attrs = NULL;
+   SV * sv;
+   SV * keysv;
+   SV * namesv;
+   int empty = 0;
+
+   while ( scan->p < scan->end && is_name( *scan->p ) ) scan->p++;
+   n = scan->p - name;
+   if ( n == 0 ) {
+      fail( scan, "bad start tag" );
+   }
+
+   /* we only need the attributes of elements we aren't skipping */
+   if ( !scan->skipping ) {
+      attrs = newHV();
+      scan->building = attrs;
+   }
+
+   for ( ;; ) {
+      while ( scan->p < scan->end && is_space( *scan->p ) ) scan->p++;
+      if ( scan->p >= scan->end ) {
+         fail( scan, "unexpected end of document" );
+      }
+      if ( *scan->p == '>' ) {
+         scan->p++;
+         break;
+      }
+      if ( *scan->p == '/' && scan->p + 1 < scan->end &&
+           scan->p[1] == '>' ) {
+         scan->p += 2;
+         empty = 1;
+         break;
+      }
+
+      key = scan->p;
+      while ( scan->p < scan->end && is_name( *scan->p ) ) scan->p++;
+      nkey = scan->p - key;
+      while ( scan->p < scan->end && is_space( *scan->p ) ) scan->p++;
+      if ( nkey == 0 || scan->p >= scan->end || *scan->p != '=' ) {
+         fail( scan, "bad attribute" );
+      }
+      scan->p++;
+      while ( scan->p < scan->end && is_space( *scan->p ) ) scan->p++;
+      if ( scan->p >= scan->end || ( *scan->p != '"' && *scan->p != '\'' ) ) {
+         fail( scan, "bad attribute" );
+      }
+      quote = *scan->p++;
+      value = scan->p;
+      scan->p = memchr( scan->p, quote, scan->end - scan->p );
+      if ( scan->p == NULL ) {
+         scan->p = scan->end;
+         fail( scan, "unexpected end of document" );
+      }
+      if ( attrs != NULL ) {
+         keysv = new_name( scan, key, nkey );
+         sv = newSVpvs( "" );
+         add_text( scan, sv, value, scan->p, 1 );
+         if ( !decode_text( sv ) ) {
+            SvREFCNT_dec( sv );
+            SvREFCNT_dec( keysv );
+            fail( scan, "invalid UTF-8" );
+         }
+         hv_store_ent( attrs, keysv, sv, 0 );
+         SvREFCNT_dec( keysv );
+      }
+      scan->p++;
+   }
+
+   /* the attributes are left in scan->building, for fail to free, until
+      something else has them */
+   if ( scan->skipping ) {
+      if ( empty ) {
+         return;
+      }
+   } else if ( is_skipped( scan, name, n ) ) {
+      if ( empty ) {
+         namesv = new_name( scan, name, n );
+         scan->building = NULL;
+         add_event( scan, newSVpvs( "payload" ), namesv,
+                    newRV_noinc( (SV *) attrs ), newSVuv( scan->p - scan->start ),
+                    newSVuv( 0 ) );
+         return;
+      }
+      scan->skipping = scan->depth + 1;
+      scan->payload = scan->p;
+      scan->attrs = attrs;
+      scan->building = NULL;
+   } else {
+      namesv = new_name( scan, name, n );
+      scan->building = NULL;
+      add_event( scan, newSVpvs( "start" ), namesv,
+                 newRV_noinc( (SV *) attrs ), NULL, NULL );
+      if ( empty ) {
+         add_event( scan, newSVpvs( "end" ), new_name( scan, name, n ),
+                    NULL, NULL, NULL );
+         return;
+      }
+   }
+
+   if ( scan->depth == scan->size ) {
+      scan->size = scan->size * 2;
+      Renew( scan->names, scan->size, const char * );
+      Renew( scan->lengths, scan->size, STRLEN );
+   }
+   scan->names[scan->depth] = name;
+   scan->lengths[scan->depth] = n;
+   scan->depth++;
+}
+
+/* Handles an end tag, scan->p being just after the "</" */
+static void end_tag( scan_t * scan )
+{
+   const char * tag = scan->p - 2;
+   const char * name = scan->p;
+   STRLEN n;
+   HV * attrs;
+   SV * namesv;
+
+   while ( scan->p < scan->end && is_name( *scan->p ) ) scan->p++;
+   n = scan->p - name;
+   while ( scan->p < scan->end && is_space( *scan->p ) ) scan->p++;
+   if ( scan->p >= scan->end || *scan->p != '>' ) {
+      fail( scan, "bad end tag" );
+   }
+   scan->p++;
+
+   if ( scan->depth == 0 || scan->lengths[scan->depth-1] != n ||
+        memcmp( scan->names[scan->depth-1], name, n ) != 0 ) {
+      fail( scan, "mismatched end tag" );
+   }
+
+   if ( scan->skipping == scan->depth ) {
+      namesv = new_name( scan, name, n );
+      attrs = scan->attrs;
+      scan->attrs = NULL;
+      add_event( scan, newSVpvs( "payload" ), namesv,
+                 newRV_noinc( (SV *) attrs ),
+                 newSVuv( scan->payload - scan->start ),
+                 newSVuv( tag - scan->payload ) );
+      scan->skipping = 0;
+   } else if ( !scan->skipping ) {
+      add_event( scan, newSVpvs( "end" ), new_name( scan, name, n ),
+                 NULL, NULL, NULL );
+   }
+   scan->depth--;
+}
+
+/* Returns true if the XML declaration at p, just after the "<?", says
+   the document is in ISO-8859-1 or US-ASCII rather than UTF-8. The
+   US_ASCII some RTML documents were sent in is taken as ISO-8859-1, as
+   XML::Document::RTML has always done. */
+static int is_latin1( const char * p, const char * end )
+{
+   static const char * names[] = { "ISO-8859-1", "ISO_8859-1", "latin1",
+                                   "US-ASCII", "US_ASCII", "ASCII", NULL };
+   const char * close;
+   const char * value;
+   char quote;
+   int i;
+
+   if ( end - p < 4 || memcmp( p, "xml", 3 ) != 0 || !is_space( p[3] ) ) {
+      return 0;
+   }
+   close = memchr( p, '>', end - p );
+   if ( close == NULL ) {
+      return 0;
+   }
+   for ( ; p + 8 <= close; p++ ) {
+      if ( memcmp( p, "encoding", 8 ) == 0 ) {
+         break;
+      }
+   }
+   for ( p = p + 8; p < close && ( is_space( *p ) || *p == '=' ); p++ ) {
+   }
+   if ( p >= close || ( *p != '"' && *p != '\'' ) ) {
+      return 0;
+   }
+   quote = *p++;
+   value = p;
+   while ( p < close && *p != quote ) p++;
+   for ( i = 0; names[i] != NULL; i++ ) {
+      if ( strlen( names[i] ) == (STRLEN) ( p - value ) &&
+           strncasecmp( names[i], value, p - value ) == 0 ) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/* Tokenizes the document in start[0..length), returning the events */
+static AV * tokenize( const char * start, STRLEN length, AV * skip,
+                      STRLEN threshold )
+{
+   scan_t scan;
+   const char * lt;
+   const char * p;
+   int seen = 0;
+
+   scan.start = start;
+   scan.end = start + length;
+   scan.p = start;
+   scan.events = newAV();
+   scan.skip = skip;
+   scan.threshold = threshold;
+   scan.depth = 0;
+   scan.size = 16;
+   scan.skipping = 0;
+   scan.payload = NULL;
+   scan.attrs = NULL;
+   scan.building = NULL;
+   scan.latin1 = 0;
+   New( 0, scan.names, scan.size, const char * );
+   New( 0, scan.lengths, scan.size, STRLEN );
+
+   /* a UTF-8 byte order mark is skipped, UTF-16 isn't read at all */
+   if ( length >= 3 && memcmp( start, "\xEF\xBB\xBF", 3 ) == 0 ) {
+      scan.p += 3;
+   } else if ( length >= 2 && ( memcmp( start, "\xFE\xFF", 2 ) == 0 ||
+                                memcmp( start, "\xFF\xFE", 2 ) == 0 ) ) {
+      fail( &scan, "UTF-16 documents are not supported" );
+   }
+
+   while ( scan.p < scan.end ) {
+      lt = memchr( scan.p, '<', scan.end - scan.p );
+      if ( lt == NULL ) {
+         lt = scan.end;
+      }
+      text( &scan, scan.p, lt, 0 );
+      scan.p = lt;
+      if ( lt == scan.end ) {
+         break;
+      }
+
+      scan.p = lt + 1;
+      if ( scan.p < scan.end && *scan.p == '?' ) {
+         if ( !seen && is_latin1( scan.p + 1, scan.end ) ) {
+            scan.latin1 = 1;
+         }
+         skip_past( &scan, "?>", 2 );
+      } else if ( scan.end - scan.p >= 3 && memcmp( scan.p, "!--", 3 ) == 0 ) {
+         skip_past( &scan, "-->", 3 );
+      } else if ( scan.end - scan.p >= 8 &&
+                  memcmp( scan.p, "![CDATA[", 8 ) == 0 ) {
+         p = scan.p + 8;
+         scan.p = p;
+         skip_past( &scan, "]]>", 3 );
+         text( &scan, p, scan.p - 3, 1 );
+      } else if ( scan.p < scan.end && *scan.p == '!' ) {
+         /* a DOCTYPE, which may have an internal subset */
+         while ( scan.p < scan.end && *scan.p != '>' && *scan.p != '[' ) {
+            scan.p++;
+         }
+         if ( scan.p < scan.end && *scan.p == '[' ) {
+            skip_past( &scan, "]", 1 );
+         }
+         skip_past( &scan, ">", 1 );
+      } else if ( scan.p < scan.end && *scan.p == '/' ) {
+         scan.p++;
+         end_tag( &scan );
+      } else {
+         if ( seen && scan.depth == 0 ) {
+            fail( &scan, "more than one root element" );
+         }
+         seen = 1;
+         start_tag( &scan );
+      }
+   }
+
+   if ( !seen || scan.depth != 0 ) {
+      fail( &scan, "unexpected end of document" );
+   }
+
+   Safefree( scan.names );
+   Safefree( scan.lengths );
+   return scan.events;
+}
+
+static AV * get_skip( SV * skip )
+{
+   if ( !SvOK( skip ) ) {
+      return (AV *) sv_2mortal( (SV *) newAV() );
+   }
+   if ( !SvROK( skip ) || SvTYPE( SvRV( skip ) ) != SVt_PVAV ) {
+      croak( "XML::Document::RTML::Stream: the elements to skip must be an "
+             "array reference" );
+   }
+   return (AV *) SvRV( skip );
+}
+
+MODULE = XML::Document::RTML::Stream		PACKAGE = XML::Document::RTML::Stream
+
+PROTOTYPES: DISABLE
+
+SV *
+tokenize_string( xml, skip, threshold )
+   SV * xml
+   SV * skip
+   UV threshold
+ PREINIT:
+   const char * bytes;
+   STRLEN length;
+ CODE:
+   bytes = SvPVbyte( xml, length );
+   RETVAL = newRV_noinc( (SV *) tokenize( bytes, length, get_skip( skip ),
+                                          threshold ) );
+ OUTPUT:
+   RETVAL
+
+SV *
+tokenize_file( file, skip, threshold )
+   char * file
+   SV * skip
+   UV threshold
+ PREINIT:
+   int fd;
+   struct stat info;
+   SV * buffer;
+   STRLEN length, chunk;
+   ssize_t got;
+   AV * events;
+   AV * names;
+ CODE:
+   /* The file is read rather than mapped, as a document which is
+      truncated while it is being read would raise SIGBUS on a mapping,
+      where read() just stops early. The buffer is mortal, so it goes
+      even if the document is bad. */
+   names = get_skip( skip );
+   fd = open( file, O_RDONLY );
+   if ( fd < 0 ) {
+      croak( "XML::Document::RTML::Stream: cannot open %s: %s", file,
+             strerror( errno ) );
+   }
+   buffer = sv_2mortal( newSVpvn( "", 0 ) );
+   if ( fstat( fd, &info ) == 0 && info.st_size > 0 ) {
+      SvGROW( buffer, (STRLEN) info.st_size + 1 );
+   }
+   length = 0;
+   for ( ;; ) {
+      if ( SvLEN( buffer ) <= length + 1 ) {
+         SvGROW( buffer, length + READ_BYTES + 1 );
+      }
+      chunk = SvLEN( buffer ) - length - 1;
+      if ( chunk > READ_BYTES ) {
+         chunk = READ_BYTES;
+      }
+      got = read( fd, SvPVX( buffer ) + length, chunk );
+      if ( got < 0 && errno == EINTR ) {
+         continue;
+      }
+      if ( got < 0 ) {
+         int error = errno;
+         close( fd );
+         croak( "XML::Document::RTML::Stream: cannot read %s: %s", file,
+                strerror( error ) );
+      }
+      if ( got == 0 ) {
+         break;
+      }
+      length += got;
+   }
+   close( fd );
+   if ( length == 0 ) {
+      croak( "XML::Document::RTML::Stream: %s is empty", file );
+   }
+   SvCUR_set( buffer, length );
+
+   events = tokenize( SvPVX( buffer ), length, names, threshold );
+   RETVAL = newRV_noinc( (SV *) events );
+ OUTPUT:
+   RETVAL
@@ -0,0 +1,177 @@
+# XML::Document::RTML test harness
+
+# strict
+use strict;
+
+#load test
+use Test::More tests => 43;
+
+# load modules
+BEGIN {
+   use_ok("XML::Document::RTML");
+}
+
+# debugging
+use Data::Dumper;
+
+# T E S T   H A R N E S S --------------------------------------------------
+
+# test the test system
+ok(1, "Testing the test harness");
+
+# the same tree as XML::Simple gives us, if it can parse anything here
+SKIP: {
+   skip "XML::Simple can't parse documents", 4
+      unless eval { require XML::Simple; XML::Simple::XMLin( '<RTML/>' ); 1 };
+
+   foreach my $file ( qw{ t/rtml2.2/example_score.xml
+                          t/rtml2.2/example_multiple_observe.xml
+                          t/rtml2.2/example_score_reply_scores.rtml
+                          t/rtml2.2/supircam.rtml } ) {
+      my $simple = new XML::Document::RTML( File => $file );
+      my $stream = new XML::Document::RTML( File => $file, Stream => 1 );
+      is_deeply( $stream->dump_tree(), $simple->dump_tree(),
+                 "Comparing the trees for $file" );
+   }
+}
+
+# an observation with an embedded FITS header and catalogue
+my $header = "";
+foreach my $i ( 1 .. 100 ) {
+   $header = $header . sprintf( "%-80s", "COMMENT card $i" ) . "\n";
+}
+my $catalogue = "<VOTABLE><RESOURCE><TABLE><DATA><TABLEDATA>";
+foreach my $i ( 1 .. 100 ) {
+   $catalogue = $catalogue . "<TR><TD>$i</TD><TD>18.5</TD></TR>";
+}
+$catalogue = $catalogue . "</TABLEDATA></DATA></TABLE></RESOURCE></VOTABLE>";
+
+my $xml = '<?xml version="1.0" encoding="ISO-8859-1"?>
+<!DOCTYPE RTML SYSTEM "http://www.estar.org.uk/documents/rtml2.2.dtd">
+<RTML version="2.2" type="observation">
+  <IntelligentAgent host="144.173.229.20" port="2050">000106:UA:v1-15</IntelligentAgent>
+  <Observation>
+    <Target type="normal" ident="ExoPlanetMonitor">
+      <TargetName>OGLE-2005-blg-158</TargetName>
+      <Coordinates>
+        <RightAscension units="hms" format="hh mm ss.ss">18 06 04.24</RightAscension>
+        <Declination units="dms" format="sdd mm ss.ss">-28 30 51.50</Declination>
+        <Equinox>J2000</Equinox>
+      </Coordinates>
+    </Target>
+    <Schedule priority="2">
+      <Exposure type="time" units="seconds">
+        <Count>2</Count>63.5</Exposure>
+      <TimeConstraint>
+        <StartDateTime>2005-05-12T09:00:00</StartDateTime>
+        <EndDateTime>2005-05-13T03:00:00</EndDateTime>
+      </TimeConstraint>
+    </Schedule>
+    <ImageData type="FITS16" delivery="url" reduced="true">http://150.204.240.8/~estar/data/c_e_20050511_198_1_1_1.fits
+      <FITSHeader type="all">' . $header . '</FITSHeader>
+      <ObjectList type="votable">' . $catalogue . '</ObjectList>
+    </ImageData>
+  </Observation>
+</RTML>';
+
+my $object;
+ok( $object = new XML::Document::RTML( XML => $xml, Stream => 1 ),
+    "Created the object okay" );
+
+is( $object->role(), "observation", "Comparing type of document" );
+is( $object->ra(), "18 06 04.24", "Comparing the RA" );
+is( $object->dec(), "-28 30 51.50", "Comparing the Dec" );
+is( $object->target(), "OGLE-2005-blg-158", "Comparing the target name" );
+is( $object->priority(), 2, "Comparing the priority" );
+is( $object->group_count(), 2, "Comparing the group count" );
+cmp_ok( $object->exposure_time(), '==', 63.5, "Comparing the exposure time" );
+is( $object->start_time(), "2005-05-12T09:00:00", "Observation start time" );
+is( $object->end_time(), "2005-05-13T03:00:00", "Observation end time" );
+is( $object->host(), "144.173.229.20", "Comparing the agent host" );
+is( $object->id(), "000106:UA:v1-15", "Comparing the unique ID" );
+
+my @images = $object->images();
+is( $images[0], "http://150.204.240.8/~estar/data/c_e_20050511_198_1_1_1.fits",
+    "Comparing the image URL" );
+my @types = $object->catalogue_type();
+is( $types[0], "votable", "Comparing the catalogue type" );
+
+# the payloads are left in the document
+my @payloads = $object->payloads();
+is( scalar(@payloads), 2, "Number of payloads" );
+is( $payloads[0]->{Path}, "RTML/Observation/ImageData/FITSHeader",
+    "Path of the FITS header" );
+is( $payloads[0]->{Observation}, 0, "Observation of the FITS header" );
+is( $payloads[0]->{Attributes}->{type}, "all", "Type of the FITS header" );
+is( $object->payload( 0 ), $header, "Comparing the FITS header" );
+is( $payloads[1]->{Name}, "ObjectList", "Name of the catalogue" );
+is( $object->payload( 1 ), $catalogue, "Comparing the catalogue" );
+
+# and from a file
+my $file = "t/stream.xml";
+open( FILE, ">$file" ) or die "Cannot open $file: $!";
+print FILE $xml;
+close( FILE );
+my $object2 = new XML::Document::RTML( File => $file, Stream => 1 );
+is( $object2->ra(), "18 06 04.24", "Comparing the RA" );
+is( $object2->payload( 1 ), $catalogue, "Comparing the catalogue" );
+
+# and from a file bigger than one read of it
+open( FILE, ">$file" ) or die "Cannot open $file: $!";
+print FILE '<RTML version="2.2" type="score"><!--' . ( " x" x 50000 ) .
+           '--><Observation><Target><TargetName>M31</TargetName></Target>' .
+           '</Observation></RTML>';
+close( FILE );
+my $object3 = new XML::Document::RTML( File => $file, Stream => 1 );
+is( $object3->target(), "M31", "Reading a large file" );
+unlink( $file );
+
+# a broken document
+eval { new XML::Document::RTML( XML => "<RTML><Observation></RTML>",
+                                Stream => 1 ); };
+like( $@, qr/mismatched end tag/, "Broken documents are rejected" );
+
+# lists of elements with a name, key or id are folded as XML::Simple does
+my $folded = new XML::Document::RTML( Stream => 1, XML =>
+   '<RTML version="2.2" type="score"><Observation>' .
+   '<Device name="camera"><Filter>R</Filter></Device>' .
+   '<Device name="spectrograph"><Filter>V</Filter></Device>' .
+   '<Target><TargetName>a</TargetName></Target>' .
+   '<Target><TargetName>b</TargetName></Target></Observation></RTML>' );
+my $tree = $folded->dump_tree();
+is( $tree->{Observation}[0]{Device}{spectrograph}{Filter}, "V",
+    "Elements are folded on their name" );
+is( ref( $tree->{Observation}[0]{Target} ), "ARRAY",
+    "Elements without a name aren't folded" );
+
+# text is decoded as the document says it's encoded
+sub target_in {
+   my ( $encoding, $name ) = @_;
+   my $declaration = defined $encoding ?
+      "<?xml version=\"1.0\" encoding=\"$encoding\"?>\n" : "";
+   my $object = new XML::Document::RTML( Stream => 1, XML => $declaration .
+      '<RTML version="2.2" type="score"><Observation><Target>' .
+      "<TargetName>$name</TargetName></Target></Observation></RTML>" );
+   return $object->target();
+}
+is( target_in( undef, "M31 \xC3\xA9" ), "M31 \x{e9}", "UTF-8 by default" );
+is( target_in( "UTF-8", "\xE2\x98\xBA" ), "\x{263a}", "UTF-8" );
+is( target_in( "ISO-8859-1", "M31 \xE9" ), "M31 \x{e9}", "ISO-8859-1" );
+is( target_in( "US_ASCII", "M31 \xE9" ), "M31 \x{e9}",
+    "US_ASCII is read as ISO-8859-1" );
+is( target_in( "ISO-8859-1", "&#233;&#x263A;" ), "\x{e9}\x{263a}",
+    "Character references above 255" );
+is( target_in( "UTF-8", "&#xD800;" ), "&#xD800;",
+    "Surrogates aren't characters" );
+is( target_in( "UTF-8", "&#12x;&#;&#x;&#65;" ), "&#12x;&#;&#x;A",
+    "Only whole character references are replaced" );
+eval { target_in( "UTF-8", "M31 \xE9" ); };
+like( $@, qr/invalid UTF-8/, "Bad UTF-8 is rejected" );
+
+# line ends are read as an XML parser reads them
+require XML::Document::RTML::Stream;
+my $lines = new XML::Document::RTML::Stream( XML =>
+   "<RTML note=\"a\r\nb\tc\">one\r\ntwo\rthree&#13;</RTML>" );
+my @events = $lines->events();
+is( $events[0][2]{note}, "a b c", "Whitespace in attributes becomes spaces" );
+is( $events[1][1], "one\ntwo\nthree\r", "Line ends in text become newlines" );
@@ -2,27 +2,22 @@
 #include "perl.h"
 #include "XSUB.h"
 #include "string.h"
-#include "globus_common.h"
-#include "globus_io.h"
 #include "estar_io.h"
 
-static globus_io_handle_t handle;
+static eSTAR_IO_Handle_T handle;
     
 MODULE = eSTAR::IO::Client   PACKAGE = eSTAR::IO::Client
 
-globus_io_handle_t *
-open_client( hostname, port )
+eSTAR_IO_Handle_T *
+open_client( hostname, port, transport = ESTAR_IO_TRANSPORT_DEFAULT )
     char * hostname
     int port
+    int transport
   PREINIT:
     int status;
   CODE:
-    printf("open_clientXS globus_io_handle %p\n", &handle);
-    printf("open_clientXS handle->fd = %i\n", handle.fd);
-    status = eSTAR_IO_Open_Client( hostname, port, &handle );
+    status = eSTAR_IO_Open_Transport_Client( transport, hostname, port, &handle );
     RETVAL = &handle;  
-    printf("open_clientXS globus_io_handle %p\n", &handle);
-    printf("open_clientXS handle->fd = %i\n", handle.fd);
   OUTPUT:
     RETVAL 
   CLEANUP:
@@ -31,10 +26,44 @@ open_client( hostname, port )
 
 int
 close_client( handle )
-    globus_io_handle_t * handle
+    eSTAR_IO_Handle_T * handle
   CODE:
-    printf("close_clientXS globus_io_handle %p\n", &handle);
     RETVAL = eSTAR_IO_Close_Client( handle );
   OUTPUT:
     RETVAL    
 
+
+eSTAR_IO_Handle_T *
+checkout_client( hostname, port, transport = ESTAR_IO_TRANSPORT_DEFAULT )
+    char * hostname
+    int port
+    int transport
+  PREINIT:
+    int status;
+  CODE:
+    status = eSTAR_IO_Checkout_Client( transport, hostname, port, &RETVAL );
+    if (status == GLOBUS_FALSE )
+      XSRETURN_UNDEF;
+  OUTPUT:
+    RETVAL
+
+int
+checkin_client( handle, reusable = GLOBUS_TRUE )
+    eSTAR_IO_Handle_T * handle
+    int reusable
+  CODE:
+    RETVAL = eSTAR_IO_Checkin_Client( handle, reusable );
+  OUTPUT:
+    RETVAL
+
+void
+configure_client_pool( max_per_peer, idle_timeout )
+    int max_per_peer
+    int idle_timeout
+  CODE:
+    eSTAR_IO_Configure_Client_Pool( max_per_peer, idle_timeout );
+
+void
+close_client_pool()
+  CODE:
+    eSTAR_IO_Close_Client_Pool( );
@@ -16,7 +16,17 @@ our %EXPORT_TAGS = ( 'all' => [ qw(
                                     GLOBUS_SUCCESS GLOBUS_FAILURE
                                     GLOBUS_TRUE GLOBUS_FALSE GLOBUS_NULL
                                     module_activate module_deactivate
-                                    report_error read_message write_message
+                                    report_error last_error flush_log
+                                    read_message write_message
+                                    write_fragments read_messages write_messages
+                                    set_max_message_length get_max_message_length
+                                    TRANSPORT_GLOBUS TRANSPORT_TCP TRANSPORT_UNIX
+                                    TRANSPORT_DEFAULT
+                                    negotiate_compression get_compression
+                                    set_compression_threshold
+                                    get_compression_threshold
+                                    COMPRESSION_NONE COMPRESSION_ZLIB
+                                    COMPRESSION_LZ4
                                    ) ] );
 
 our @EXPORT_OK = ( @{ $EXPORT_TAGS{'all'} } );
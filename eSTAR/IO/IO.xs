@@ -2,8 +2,6 @@
 #include "perl.h"
 #include "XSUB.h"
 #include "string.h"
-#include "globus_common.h"
-#include "globus_io.h"
 #include "estar_io.h"
 
 MODULE = eSTAR::IO   PACKAGE = eSTAR::IO  PREFIX = eSTAR_IO_
@@ -13,10 +11,25 @@ eSTAR_IO_report_error()
   CODE:
     eSTAR_IO_Error();
 
+void
+eSTAR_IO_last_error()
+  PREINIT:
+    struct eSTAR_IO_Error_Struct * error;
+  PPCODE:
+    /* the error number and string of the calling thread's last error */
+    error = eSTAR_IO_Error_Get( );
+    EXTEND( SP, 2 );
+    PUSHs( sv_2mortal( newSViv( error->Number ) ) );
+    PUSHs( sv_2mortal( newSVpv( error->String, 0 ) ) );
+
+void
+eSTAR_IO_flush_log()
+  CODE:
+    eSTAR_IO_Log_Flush();
+
 int 
 eSTAR_IO_module_activate()
   CODE:
-    printf("module_activateXS\n");
     RETVAL = eSTAR_IO_Module_Activate( );
   OUTPUT:
     RETVAL
@@ -24,53 +37,225 @@ eSTAR_IO_module_activate()
 int 
 eSTAR_IO_module_deactivate()
   CODE:
-    printf("module_deactivateXS\n");
     RETVAL = eSTAR_IO_Module_Deactivate( );
   OUTPUT:
     RETVAL   
      
 int
 eSTAR_IO_write_message( handle, message )
-    globus_io_handle_t * handle
+    eSTAR_IO_Handle_T * handle
     char * message
   PREINIT: 
     int status;
   CODE:  
-    printf("write_messageXS globus_io_handle %p\n", handle);
-    printf("write_messageXS handle->fd = %i\n", handle->fd);
     RETVAL = eSTAR_IO_Write_Message( handle, message );
-    printf("write_messageXS globus_io_handle %p\n", handle);
-    printf("write_messageXS handle->fd = %i\n", handle->fd);
   OUTPUT:
     RETVAL         
 
+int
+eSTAR_IO_write_fragments( handle, fragments )
+    eSTAR_IO_Handle_T * handle
+    AV * fragments
+  PREINIT:
+    struct iovec * fragment_list;
+    STRLEN length;
+    SV ** element;
+    int count;
+    int i;
+  CODE:
+    /* check every fragment before anything is sent */
+    count = av_len( fragments ) + 1;
+    if ( count < 1 )
+      XSRETURN_UNDEF;
+    for ( i = 0; i < count; i++ ) {
+      element = av_fetch( fragments, i, 0 );
+      if ( element == NULL || ! SvOK( *element ) || sv_len( *element ) == 0 )
+        croak( "eSTAR::IO::write_fragments: fragment %d is undefined or empty", i );
+    }
+    /* point straight at the scalars' buffers, nothing is copied */
+    Newx( fragment_list, count, struct iovec );
+    for ( i = 0; i < count; i++ ) {
+      element = av_fetch( fragments, i, 0 );
+      fragment_list[i].iov_base = SvPV( *element, length );
+      fragment_list[i].iov_len = length;
+    }
+    RETVAL = eSTAR_IO_Write_Vector_Message( handle, fragment_list, count );
+    Safefree( fragment_list );
+  OUTPUT:
+    RETVAL
+
 
 AV *
 eSTAR_IO_read_message( handle )
-     globus_io_handle_t * handle
+     eSTAR_IO_Handle_T * handle
    PREINIT:
      int status;
-     char ** message;
-     char ** index;
+     char * message;
+     size_t length;
      AV * array;
    CODE:
-     printf("read_messageXS globus_io_handle %p\n", handle);
-     printf("read_messageXS handle->fd = %i\n", handle->fd);
-     printf("read_messageXS char** %p\n", message);
-     status = eSTAR_IO_Read_Message( handle, message );
-     printf("read_messageXS globus_io_handle %p\n", handle);
-     printf("read_messageXS handle->fd = %i\n", handle->fd);
-     printf("read_messageXS char** %p\n", message);
-     printf("read_messageXS return status %i (should be 1)\n", status);
+     /* the message is in the handle's read buffer, copy it straight into the scalar */
+     status = eSTAR_IO_Read_Pooled_Message( handle, &message, &length );
      if (status == GLOBUS_FALSE ) 
        XSRETURN_UNDEF;
               
      array = newAV();
-     index = message;
-     while (*index) {
-       av_push( array, newSVpv( *index, 0));
-       index++;
+     av_push( array, newSVpvn( message, length ));
+     RETVAL = array;
+   OUTPUT:
+     RETVAL
+
+void
+eSTAR_IO_set_max_message_length( length )
+    size_t length
+  CODE:
+    eSTAR_IO_Set_Max_Message_Length( length );
+
+size_t
+eSTAR_IO_get_max_message_length()
+  CODE:
+    RETVAL = eSTAR_IO_Get_Max_Message_Length( );
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_write_messages( handle, messages )
+    eSTAR_IO_Handle_T * handle
+    AV * messages
+  PREINIT:
+    char ** message_list;
+    size_t * message_length_list;
+    STRLEN length;
+    SV ** element;
+    int count;
+    int i;
+  CODE:
+    /* an empty frame is rejected by the reader, and loses the connection,
+       so check every message before anything is sent */
+    count = av_len( messages ) + 1;
+    if ( count < 1 )
+      XSRETURN_UNDEF;
+    for ( i = 0; i < count; i++ ) {
+      element = av_fetch( messages, i, 0 );
+      if ( element == NULL || ! SvOK( *element ) || sv_len( *element ) == 0 )
+        croak( "eSTAR::IO::write_messages: message %d is undefined or empty", i );
+    }
+    /* point straight at the scalars' buffers, nothing is copied */
+    Newx( message_list, count, char * );
+    Newx( message_length_list, count, size_t );
+    for ( i = 0; i < count; i++ ) {
+      element = av_fetch( messages, i, 0 );
+      message_list[i] = SvPV( *element, length );
+      message_length_list[i] = length;
+    }
+    RETVAL = eSTAR_IO_Write_Messages( handle, message_list,
+                                      message_length_list, count );
+    Safefree( message_list );
+    Safefree( message_length_list );
+  OUTPUT:
+    RETVAL
+
+AV *
+eSTAR_IO_read_messages( handle )
+     eSTAR_IO_Handle_T * handle
+   PREINIT:
+     int status;
+     char ** message_list;
+     size_t * message_length_list;
+     int count;
+     int i;
+     AV * array;
+   CODE:
+     status = eSTAR_IO_Read_Messages( handle, &message_list,
+                                      &message_length_list, &count );
+     if (status == GLOBUS_FALSE )
+       XSRETURN_UNDEF;
+
+     array = newAV();
+     av_extend( array, count );
+     for ( i = 0; i < count; i++ ) {
+       av_push( array, newSVpvn( message_list[i], message_length_list[i] ));
      }
+     eSTAR_IO_Free_Messages( message_list, count );
+     globus_libc_free( message_length_list );
      RETVAL = array;
    OUTPUT:
      RETVAL
+
+int
+eSTAR_IO_negotiate_compression( handle )
+    eSTAR_IO_Handle_T * handle
+  CODE:
+    RETVAL = eSTAR_IO_Negotiate_Compression( handle );
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_get_compression( handle )
+    eSTAR_IO_Handle_T * handle
+  CODE:
+    RETVAL = handle->Compression;
+  OUTPUT:
+    RETVAL
+
+void
+eSTAR_IO_set_compression_threshold( length )
+    size_t length
+  CODE:
+    eSTAR_IO_Set_Compression_Threshold( length );
+
+size_t
+eSTAR_IO_get_compression_threshold()
+  CODE:
+    RETVAL = eSTAR_IO_Get_Compression_Threshold( );
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_COMPRESSION_NONE()
+  CODE:
+    RETVAL = ESTAR_IO_COMPRESSION_NONE;
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_COMPRESSION_ZLIB()
+  CODE:
+    RETVAL = ESTAR_IO_COMPRESSION_ZLIB;
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_COMPRESSION_LZ4()
+  CODE:
+    RETVAL = ESTAR_IO_COMPRESSION_LZ4;
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_TRANSPORT_GLOBUS()
+  CODE:
+    RETVAL = ESTAR_IO_TRANSPORT_GLOBUS;
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_TRANSPORT_TCP()
+  CODE:
+    RETVAL = ESTAR_IO_TRANSPORT_TCP;
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_TRANSPORT_UNIX()
+  CODE:
+    RETVAL = ESTAR_IO_TRANSPORT_UNIX;
+  OUTPUT:
+    RETVAL
+
+int
+eSTAR_IO_TRANSPORT_DEFAULT()
+  CODE:
+    RETVAL = ESTAR_IO_TRANSPORT_DEFAULT;
+  OUTPUT:
+    RETVAL
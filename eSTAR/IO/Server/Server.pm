@@ -11,7 +11,8 @@ require Exporter;
 require DynaLoader;
 
 our @ISA = qw(Exporter DynaLoader);
-our %EXPORT_TAGS = ( 'all' => [ qw( ) ] );
+our %EXPORT_TAGS = ( 'all' => [ qw( ENGINE_THREAD ENGINE_POOL ENGINE_EVENT
+                                    POOL_OVERFLOW_BLOCK POOL_OVERFLOW_REJECT ) ] );
 
 our @EXPORT_OK = ( @{ $EXPORT_TAGS{'all'} } );
 
@@ -2,73 +2,175 @@
 #include "perl.h"
 #include "XSUB.h"
 #include "string.h"
-#include "globus_common.h"
-#include "globus_io.h"
 #include "estar_io.h"
 
-/* memory for callback */
-static SV * sv_callback;
+/* a server started by start_server: the callback, the perl interpreter
+   it runs in, and a lock to stop the server's pool workers or reactors
+   entering it at once */
+struct Server_Struct
+{
+   SV * Callback;
+   PerlInterpreter * Perl_Context;
+   globus_mutex_t Callback_Mutex;
+};
 
-/* static server context */
-static eSTAR_IO_Server_Context_T context;
+/* the server that is running, the library only runs one at a time */
+static struct Server_Struct * server;
 
 /* callback for sever */
-void c_callback(globus_io_handle_t *connection_handle)
+void c_callback(eSTAR_IO_Handle_T *connection_handle)
 {
-   dSP;
+   /* the interpreter has to be named before the stack is looked at, this
+      thread has no perl context of its own */
+   struct Server_Struct * this_server = server;
+   dTHXa( this_server->Perl_Context );
+   SV ** sp;
    int status;
    SV * svhandle;
 
-   printf("** connection_callbackXS ENTER\n");
+   /* the pool server calls us from several worker threads */
+   globus_mutex_lock( &this_server->Callback_Mutex );
+   PERL_SET_CONTEXT( this_server->Perl_Context );
+   SPAGAIN;
 
    ENTER;
    SAVETMPS;
    PUSHMARK(SP);
 
-   printf("connection_callbackXS globus_io_handle_tPtr %p\n", svhandle);
-   
    svhandle = sv_newmortal();
-   sv_setref_pv(svhandle, "globus_io_handle_tPtr", (void*)connection_handle);
+   sv_setref_pv(svhandle, "eSTAR_IO_Handle_TPtr", (void*)connection_handle);
 
-   XPUSHs(sv_2mortal( svhandle ));
+   XPUSHs( svhandle );
    PUTBACK;
     
-   printf("connection_callbackXS\n");
-   status = call_sv( sv_callback, G_SCALAR );
-   printf("connection_callbackXS status = %i (should be 1)\n", status);
+   status = call_sv( this_server->Callback, G_SCALAR );
 
    SPAGAIN;
    FREETMPS;
    LEAVE;
 
-   printf("** connection_callbackXS LEAVE\n");
-    
+   globus_mutex_unlock( &this_server->Callback_Mutex );
+
+   return;
+}
+
+/* callback for the event server, called once per message */
+void c_message_callback(eSTAR_IO_Handle_T *connection_handle, char *message,
+                        size_t message_length)
+{
+   struct Server_Struct * this_server = server;
+   dTHXa( this_server->Perl_Context );
+   SV ** sp;
+   int status;
+   SV * svhandle;
+
+   /* reactors other than the first run in their own threads */
+   globus_mutex_lock( &this_server->Callback_Mutex );
+   PERL_SET_CONTEXT( this_server->Perl_Context );
+   SPAGAIN;
+
+   ENTER;
+   SAVETMPS;
+   PUSHMARK(SP);
+
+   svhandle = sv_newmortal();
+   sv_setref_pv(svhandle, "eSTAR_IO_Handle_TPtr", (void*)connection_handle);
+
+   XPUSHs( svhandle );
+   XPUSHs( sv_2mortal( newSVpvn( message, message_length ) ) );
+   PUTBACK;
+
+   status = call_sv( this_server->Callback, G_SCALAR );
+
+   SPAGAIN;
+   FREETMPS;
+   LEAVE;
+
+   globus_mutex_unlock( &this_server->Callback_Mutex );
+
    return;
 }
 
 MODULE = eSTAR::IO::Server  PACKAGE = eSTAR::IO::Server	
 
 int
-start_server( port, callback )
+start_server( port, callback, pool_size=0, queue_depth=0, overflow_policy=ESTAR_IO_POOL_OVERFLOW_BLOCK, engine=ESTAR_IO_SERVER_ENGINE_THREAD, transport=ESTAR_IO_TRANSPORT_DEFAULT, address=NULL )
    int port
    SV * callback
+   int pool_size
+   int queue_depth
+   int overflow_policy
+   int engine
+   int transport
+   char * address
   PREINIT:
     int status;
     unsigned short sport;
+    struct Server_Struct this_server;
   CODE:
-    sv_callback = callback;
-    printf("start_serverXS storing sv_callback %p\n", sv_callback);
     sport = (unsigned short) port;
-    printf("start_serverXS context %p\n", &context);
-    RETVAL = eSTAR_IO_Start_Mono_Server( &sport, c_callback, &context );
-    printf("start_serverXS context %p\n", &context);
+    if ( ! eSTAR_IO_Set_Server_Transport( transport, address ) )
+       XSRETURN_UNDEF;
+    this_server.Callback = callback;
+    this_server.Perl_Context = PERL_GET_CONTEXT;
+    globus_mutex_init( &this_server.Callback_Mutex, NULL );
+    server = &this_server;
+    if ( engine == ESTAR_IO_SERVER_ENGINE_EVENT ) {
+       /* pool_size is the number of reactors for the event engine */
+       RETVAL = eSTAR_IO_Start_Event_Server( &sport, c_message_callback,
+                                             pool_size );
+    } else if ( engine == ESTAR_IO_SERVER_ENGINE_POOL || pool_size > 0 ) {
+       RETVAL = eSTAR_IO_Start_Pool_Server( &sport, c_callback, pool_size,
+                                            queue_depth, overflow_policy );
+    } else {
+       RETVAL = eSTAR_IO_Start_Server( &sport, c_callback );
+    }
+    /* wait for a callback still running in a connection thread, it may be the one that stopped us */
+    globus_mutex_lock( &this_server.Callback_Mutex );
+    globus_mutex_unlock( &this_server.Callback_Mutex );
+    globus_mutex_destroy( &this_server.Callback_Mutex );
+    server = NULL;
+  OUTPUT:
+    RETVAL
+
+int
+ENGINE_THREAD()
+  CODE:
+    RETVAL = ESTAR_IO_SERVER_ENGINE_THREAD;
+  OUTPUT:
+    RETVAL
+
+int
+ENGINE_POOL()
+  CODE:
+    RETVAL = ESTAR_IO_SERVER_ENGINE_POOL;
+  OUTPUT:
+    RETVAL
+
+int
+ENGINE_EVENT()
+  CODE:
+    RETVAL = ESTAR_IO_SERVER_ENGINE_EVENT;
+  OUTPUT:
+    RETVAL
+
+int
+POOL_OVERFLOW_BLOCK()
+  CODE:
+    RETVAL = ESTAR_IO_POOL_OVERFLOW_BLOCK;
+  OUTPUT:
+    RETVAL
+
+int
+POOL_OVERFLOW_REJECT()
+  CODE:
+    RETVAL = ESTAR_IO_POOL_OVERFLOW_REJECT;
   OUTPUT:
     RETVAL
       
 int 
 stop_server( )
   CODE:
-    printf("close_serverXS context %p\n", &context);
-    RETVAL = eSTAR_IO_Close_Server( &context );
+    RETVAL = eSTAR_IO_Close_Server( );
   OUTPUT:
     RETVAL  
@@ -4,6 +4,8 @@
 /**
  * This file contains basic wrappers of globus_io routines, and a simple text message passing protocol.
  * It includes standard error handlers.
+ * The connections are made through the transports in estar_io_transport.c, so the same protocol can also be
+ * run over plain TCP or Unix sockets.
  * <b>Note</b> the globus common and io modules should be activated prior to calling these routines as follows:
  * <pre>
  * rc = globus_module_activate(GLOBUS_COMMON_MODULE);
@@ -25,22 +27,137 @@
  * for time.
  */
 #define _POSIX_C_SOURCE 199309L
+#include <limits.h>
 #include <string.h>
 #include <time.h>
-#include "globus_common.h"
-#include "globus_io.h"
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/poll.h>
+#include <sys/epoll.h>
+#ifdef ESTAR_IO_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ESTAR_IO_LZ4
+#include <lz4.h>
+#endif
 #include "estar_io.h"
+#include "estar_io_transport.h"
 
 /* internal hash definition */
-/**
- * Length of eSTAR_IO_Error_String.
- * @see #eSTAR_IO_Error_String
- */
-#define ESTAR_IO_ERROR_STRING_LENGTH 	(512)
 /**
  * Length of the message size are prepended to messages sent over the connection.
  */
 #define ESTAR_IO_MESSAGE_SIZE_LENGTH	(sizeof(int))
+/**
+ * Bit set in a message length prefix when the message body is compressed. The body then starts with
+ * ESTAR_IO_COMPRESSED_HEADER_LENGTH bytes giving the codec and the uncompressed length.
+ * @see #IO_Compress
+ * @see #IO_Decompress
+ */
+#define ESTAR_IO_FRAME_COMPRESSED	(0x80000000U)
+/**
+ * Bit set in a message length prefix when the frame is a control frame, used to negotiate compression,
+ * rather than a message. Control frames are handled by the library and never returned to the caller.
+ * @see #IO_Control_Frame
+ */
+#define ESTAR_IO_FRAME_CONTROL		(0x40000000U)
+/**
+ * Mask giving the body length from a message length prefix, without the frame flags.
+ */
+#define ESTAR_IO_FRAME_LENGTH_MASK	(0x3fffffffU)
+/**
+ * Length of the header at the start of a compressed message body: one byte giving the codec, then the
+ * uncompressed length in network byte order.
+ */
+#define ESTAR_IO_COMPRESSED_HEADER_LENGTH	(1+ESTAR_IO_MESSAGE_SIZE_LENGTH)
+/**
+ * Length of a control frame body: one byte giving the control type, then one byte of data.
+ */
+#define ESTAR_IO_CONTROL_LENGTH		(2)
+/**
+ * Control frame type offering compression. The data byte is a mask with bit (1&lt;&lt;codec) set for each
+ * codec the sender can decompress.
+ */
+#define ESTAR_IO_CONTROL_OFFER		(1)
+/**
+ * Control frame type answering an offer. The data byte is the codec chosen, which may be
+ * ESTAR_IO_COMPRESSION_NONE.
+ */
+#define ESTAR_IO_CONTROL_ACCEPT		(2)
+/**
+ * Length of the buffer holding the address servers listen on, for transports that use one.
+ * @see #IO_Server_Address
+ */
+#define ESTAR_IO_SERVER_ADDRESS_LENGTH	(256)
+/**
+ * The number of milliseconds an event server reactor waits in epoll_wait, before checking whether the
+ * server has been closed.
+ */
+#define ESTAR_IO_EVENT_POLL_TIMEOUT	(500)
+/**
+ * The maximum number of ready connections an event server reactor handles per call to epoll_wait.
+ */
+#define ESTAR_IO_EVENT_MAX_EVENTS	(64)
+/**
+ * The number of fragments eSTAR_IO_Write_Vector_Message can send without allocating an iovec list.
+ */
+#define ESTAR_IO_WRITE_FRAGMENT_COUNT	(16)
+/**
+ * The maximum number of iovecs IO_Write_Framed passes to one transport write. writev (and globus_io_writev)
+ * fail with more than IOV_MAX, so a longer fragment list is sent in several writes.
+ */
+#ifdef IOV_MAX
+#define ESTAR_IO_WRITE_IOV_MAX		(IOV_MAX)
+#else
+#define ESTAR_IO_WRITE_IOV_MAX		(1024)
+#endif
+/**
+ * The maximum number of messages eSTAR_IO_Write_Messages sends with one transport write.
+ * Each message uses two iovecs, so this is half the usual IOV_MAX.
+ */
+#define ESTAR_IO_WRITE_BATCH_COUNT	(512)
+/**
+ * The length of the read-ahead buffer in each handle's read context. Messages whose framed length fits in this
+ * are returned straight from the read-ahead buffer, larger ones are read into a pooled buffer.
+ * @see #IO_Read_Context_Struct
+ */
+#define ESTAR_IO_READ_AHEAD_LENGTH	(65536)
+/**
+ * The number of size classes in the receive buffer pool. Class n holds buffers of
+ * ESTAR_IO_BUFFER_POOL_MIN_LENGTH<<n bytes, larger requests are allocated and freed directly.
+ * @see #IO_Buffer_Pool_Struct
+ */
+#define ESTAR_IO_BUFFER_POOL_CLASS_COUNT	(16)
+/**
+ * The length in bytes of the buffers in the smallest size class of the receive buffer pool.
+ */
+#define ESTAR_IO_BUFFER_POOL_MIN_LENGTH	(4096)
+/**
+ * The maximum number of free buffers the receive buffer pool keeps in each size class.
+ */
+#define ESTAR_IO_BUFFER_POOL_CLASS_LENGTH	(4)
+/**
+ * The maximum total length in bytes of the free buffers the receive buffer pool keeps.
+ */
+#define ESTAR_IO_BUFFER_POOL_MAX_CACHED	(64*1024*1024)
+/**
+ * The number of message pointers eSTAR_IO_Read_Messages allocates its message list with.
+ * The list is doubled in size each time it fills up.
+ */
+#define ESTAR_IO_READ_LIST_LENGTH	(16)
+/**
+ * The number of lines the error log ring buffer holds. This must be a power of two.
+ * @see #IO_Log_Struct
+ */
+#define ESTAR_IO_LOG_RING_LENGTH	(256)
+/**
+ * The length of each line in the error log ring buffer, enough for a time stamp, error number and error string.
+ */
+#define ESTAR_IO_LOG_LINE_LENGTH	(ESTAR_IO_ERROR_STRING_LENGTH+64)
+/**
+ * The number of milliseconds the error log thread sleeps for when the ring buffer is empty.
+ */
+#define ESTAR_IO_LOG_POLL_INTERVAL	(50)
 
 /* internal enumeration */
 /**
@@ -59,45 +176,346 @@ enum IO_SERVER_STATE
  * Typedef of the connection callback function declaration.
  * This is passed as a parameter when starting a server, and is called internally in each connection thread.
  */
-typedef void (*IO_Server_Connection_Callback_T)(globus_io_handle_t *connection_handle);
+typedef void (*IO_Server_Connection_Callback_T)(eSTAR_IO_Handle_T *connection_handle);
 
-/* external variables */
 /**
- * Internal error variable.
- * @see #eSTAR_IO_Error_String
+ * Typedef of the message callback function declaration.
+ * This is passed as a parameter when starting an event server, and is called once for each complete message
+ * received on any connection.
  */
-int eSTAR_IO_Error_Number = 0;
+typedef void (*IO_Server_Message_Callback_T)(eSTAR_IO_Handle_T *connection_handle,char *message,
+	size_t message_length);
+
 /**
- * Internal error string.
- * @see #eSTAR_IO_Error_Number
+ * Structure holding the state of the worker pool started by eSTAR_IO_Start_Pool_Server.
+ * Accepted connection handles are copied by value into a circular queue, which the pre-spawned
+ * worker threads take them from. All fields are protected by Mutex.
+ * <dl>
+ * <dt>Mutex</dt> <dd>Mutex protecting the rest of the structure.</dd>
+ * <dt>Not_Empty_Cond</dt> <dd>Signalled when a connection is added to the queue.</dd>
+ * <dt>Not_Full_Cond</dt> <dd>Signalled when a connection is removed from the queue.</dd>
+ * <dt>Finished_Cond</dt> <dd>Signalled when a worker thread exits.</dd>
+ * <dt>Queue</dt> <dd>Allocated array of Queue_Depth connection handles.</dd>
+ * <dt>Queue_Depth</dt> <dd>The number of connection handles Queue can hold.</dd>
+ * <dt>Queue_Head</dt> <dd>Index in Queue of the next connection to hand to a worker.</dd>
+ * <dt>Queue_Count</dt> <dd>The number of connections currently waiting in Queue.</dd>
+ * <dt>Overflow_Policy</dt> <dd>What to do with a new connection when Queue is full.</dd>
+ * <dt>Worker_Count</dt> <dd>The number of worker threads still running.</dd>
+ * <dt>Active</dt> <dd>GLOBUS_TRUE whilst eSTAR_IO_Start_Pool_Server is using the pool.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #ESTAR_IO_POOL_OVERFLOW
  */
-char eSTAR_IO_Error_String[ESTAR_IO_ERROR_STRING_LENGTH];
+struct IO_Server_Pool_Struct
+{
+	globus_mutex_t Mutex;
+	globus_cond_t Not_Empty_Cond;
+	globus_cond_t Not_Full_Cond;
+	globus_cond_t Finished_Cond;
+	eSTAR_IO_Handle_T *Queue;
+	int Queue_Depth;
+	int Queue_Head;
+	int Queue_Count;
+	enum ESTAR_IO_POOL_OVERFLOW Overflow_Policy;
+	int Worker_Count;
+	int Active;
+};
 
-/* internal functions */
-static void Get_Current_Time(char *time_string,int string_length);
-static void *IO_Server_Connection_Thread(void *user_arg);
+/**
+ * Structure holding the state of one connection handled by the event server. The length prefix and
+ * message body are read incrementally as data arrives, so a reactor never blocks on a slow connection.
+ * <dl>
+ * <dt>Handle</dt> <dd>The handle of the connection.</dd>
+ * <dt>Length_Buffer</dt> <dd>Buffer the message length prefix is read into.</dd>
+ * <dt>Length_Bytes_Read</dt> <dd>The number of bytes of the length prefix read so far.</dd>
+ * <dt>Message</dt> <dd>Pooled buffer for the message body, or NULL if the length prefix is being read.</dd>
+ * <dt>Message_Allocated_Length</dt> <dd>The length of the pooled buffer Message points to.</dd>
+ * <dt>Message_Length</dt> <dd>The length of the message body, from the length prefix.</dd>
+ * <dt>Message_Bytes_Read</dt> <dd>The number of bytes of the message body read so far.</dd>
+ * <dt>Message_Flags</dt> <dd>The frame flags from the length prefix, saying whether the body is compressed or
+ * 	a control frame.</dd>
+ * <dt>Control_Buffer</dt> <dd>A control frame (the answer to a compression offer) waiting to be sent.</dd>
+ * <dt>Control_Length</dt> <dd>The length of the frame in Control_Buffer, or zero if there is none. Nothing
+ * 	more is read from the connection until it has all been sent, so nothing the message callback writes
+ * 	can overtake it.</dd>
+ * <dt>Control_Bytes_Written</dt> <dd>The number of bytes of Control_Buffer sent so far.</dd>
+ * <dt>Previous</dt> <dd>The previous connection in the reactor's connection list.</dd>
+ * <dt>Next</dt> <dd>The next connection in the reactor's connection list.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #IO_Event_Connection_Read
+ */
+struct IO_Event_Connection_Struct
+{
+	eSTAR_IO_Handle_T Handle;
+	globus_byte_t Length_Buffer[ESTAR_IO_MESSAGE_SIZE_LENGTH];
+	globus_size_t Length_Bytes_Read;
+	char *Message;
+	size_t Message_Allocated_Length;
+	globus_size_t Message_Length;
+	globus_size_t Message_Bytes_Read;
+	unsigned int Message_Flags;
+	globus_byte_t Control_Buffer[ESTAR_IO_MESSAGE_SIZE_LENGTH+ESTAR_IO_CONTROL_LENGTH];
+	globus_size_t Control_Length;
+	globus_size_t Control_Bytes_Written;
+	struct IO_Event_Connection_Struct *Previous;
+	struct IO_Event_Connection_Struct *Next;
+};
+
+/**
+ * Structure holding the state of one event server reactor. Each reactor has its own epoll instance and
+ * list of connections.
+ * <dl>
+ * <dt>Epoll_Fd</dt> <dd>The epoll file descriptor the reactor waits on.</dd>
+ * <dt>Mutex</dt> <dd>Mutex protecting Connection_List and Connection_Count, as the listening reactor
+ * 	adds connections to the other reactors.</dd>
+ * <dt>Connection_List</dt> <dd>Doubly linked list of connections owned by this reactor.</dd>
+ * <dt>Connection_Count</dt> <dd>The number of connections in Connection_List.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #IO_Event_Reactor_Run
+ */
+struct IO_Event_Reactor_Struct
+{
+	int Epoll_Fd;
+	globus_mutex_t Mutex;
+	struct IO_Event_Connection_Struct *Connection_List;
+	int Connection_Count;
+};
+
+/**
+ * Structure holding the state of the event server started by eSTAR_IO_Start_Event_Server.
+ * <dl>
+ * <dt>Mutex</dt> <dd>Mutex protecting Running_Count.</dd>
+ * <dt>Finished_Cond</dt> <dd>Signalled when a reactor thread exits.</dd>
+ * <dt>Reactor_List</dt> <dd>Allocated array of Reactor_Count reactors. Reactor zero also owns the listener.</dd>
+ * <dt>Reactor_Count</dt> <dd>The number of reactors in Reactor_List.</dd>
+ * <dt>Running_Count</dt> <dd>The number of reactor threads (other than reactor zero) still running.</dd>
+ * <dt>Next_Reactor</dt> <dd>Index of the reactor the next accepted connection is given to.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Start_Event_Server
+ */
+struct IO_Event_Server_Struct
+{
+	globus_mutex_t Mutex;
+	globus_cond_t Finished_Cond;
+	struct IO_Event_Reactor_Struct *Reactor_List;
+	int Reactor_Count;
+	int Running_Count;
+	int Next_Reactor;
+};
+
+/**
+ * Structure holding one connection in the client connection pool. Connections are keyed by transport,
+ * hostname and port.
+ * <dl>
+ * <dt>Transport</dt> <dd>The transport the connection was made over.</dd>
+ * <dt>Hostname</dt> <dd>Allocated copy of the hostname (or socket path) the connection was made to.</dd>
+ * <dt>Port</dt> <dd>The port number the connection was made to.</dd>
+ * <dt>Handle</dt> <dd>The handle of the connection. Its address is what eSTAR_IO_Checkout_Client
+ * 	returns, so connections are never moved once created.</dd>
+ * <dt>Checked_Out</dt> <dd>GLOBUS_TRUE whilst the connection is in use (or still being connected).</dd>
+ * <dt>Last_Used</dt> <dd>The time the connection was last checked in.</dd>
+ * <dt>Next</dt> <dd>The next connection in the pool.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #IO_Client_Pool_Struct
+ */
+struct IO_Client_Connection_Struct
+{
+	enum ESTAR_IO_TRANSPORT Transport;
+	char *Hostname;
+	int Port;
+	eSTAR_IO_Handle_T Handle;
+	int Checked_Out;
+	time_t Last_Used;
+	struct IO_Client_Connection_Struct *Next;
+};
+
+/**
+ * Structure holding the client connection pool. All fields are protected by Mutex.
+ * <dl>
+ * <dt>Mutex</dt> <dd>Mutex protecting the rest of the structure.</dd>
+ * <dt>Checkin_Cond</dt> <dd>Signalled when a connection is checked in or removed from the pool.</dd>
+ * <dt>Connection_List</dt> <dd>Singly linked list of the connections in the pool.</dd>
+ * <dt>Max_Per_Peer</dt> <dd>The maximum number of connections to any one host and port.</dd>
+ * <dt>Idle_Timeout</dt> <dd>The number of seconds a connection can be unused before it is closed.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #eSTAR_IO_Checkin_Client
+ * @see #eSTAR_IO_Configure_Client_Pool
+ */
+struct IO_Client_Pool_Struct
+{
+	globus_mutex_t Mutex;
+	globus_cond_t Checkin_Cond;
+	struct IO_Client_Connection_Struct *Connection_List;
+	int Max_Per_Peer;
+	int Idle_Timeout;
+};
 
-/* internal variables */
 /**
- * Globus IO server attributes data.
+ * Structure holding the read context of one handle. Data is read ahead into Buffer, as much as is available
+ * up to ESTAR_IO_READ_AHEAD_LENGTH bytes per transport read, and messages are taken from it without copying.
+ * Unconsumed data is moved to the start of Buffer before each read.
+ * <dl>
+ * <dt>Fd</dt> <dd>The file descriptor of the handle the context belongs to.</dd>
+ * <dt>Buffer</dt> <dd>Allocated read-ahead buffer, ESTAR_IO_READ_AHEAD_LENGTH bytes long plus one spare byte,
+ * 	so a message ending at the end of the buffer can still be NULL terminated.</dd>
+ * <dt>Buffer_Start</dt> <dd>Index in Buffer of the first unconsumed byte.</dd>
+ * <dt>Buffer_End</dt> <dd>Index in Buffer one past the last byte read.</dd>
+ * <dt>Saved_Position</dt> <dd>Where the NULL terminator of the last message returned from Buffer was written,
+ * 	or NULL. This is the first byte of the next message, which is put back on the next read.</dd>
+ * <dt>Saved_Byte</dt> <dd>The byte overwritten at Saved_Position.</dd>
+ * <dt>Body</dt> <dd>Pooled buffer holding the last message returned that did not fit in Buffer, or NULL.</dd>
+ * <dt>Body_Length</dt> <dd>The allocated length of Body.</dd>
+ * </dl>
+ * @see #IO_Read_Context_Next
+ * @see #ESTAR_IO_READ_AHEAD_LENGTH
  */
-static globus_io_attr_t eSTAR_IO_Globus_IO_Server_Attr;
+struct IO_Read_Context_Struct
+{
+	int Fd;
+	globus_byte_t *Buffer;
+	globus_size_t Buffer_Start;
+	globus_size_t Buffer_End;
+	globus_byte_t *Saved_Position;
+	globus_byte_t Saved_Byte;
+	char *Body;
+	size_t Body_Length;
+};
+
+/**
+ * Structure holding the receive buffer pool. Free buffers are kept in a singly linked list per size class,
+ * the link being stored in the first bytes of each free buffer. All fields are protected by Mutex.
+ * <dl>
+ * <dt>Mutex</dt> <dd>Mutex protecting the rest of the structure.</dd>
+ * <dt>Free_List</dt> <dd>The first free buffer in each size class, or NULL.</dd>
+ * <dt>Free_Count</dt> <dd>The number of free buffers in each size class.</dd>
+ * <dt>Cached_Length</dt> <dd>The total length of all the free buffers.</dd>
+ * </dl>
+ * @see #IO_Buffer_Pool_Get
+ * @see #IO_Buffer_Pool_Put
+ * @see #ESTAR_IO_BUFFER_POOL_CLASS_COUNT
+ */
+struct IO_Buffer_Pool_Struct
+{
+	globus_mutex_t Mutex;
+	char *Free_List[ESTAR_IO_BUFFER_POOL_CLASS_COUNT];
+	int Free_Count[ESTAR_IO_BUFFER_POOL_CLASS_COUNT];
+	size_t Cached_Length;
+};
+
 /**
- * Globus IO client attributes data.
+ * Structure holding one line of the error log ring buffer.
+ * <dl>
+ * <dt>Sequence</dt> <dd>Sequence number saying whether the slot is free for the writer whose position
+ * 	equals it, or holds a line for the reader whose position is one less than it.</dd>
+ * <dt>Line</dt> <dd>The formatted log line.</dd>
+ * </dl>
+ * @see #IO_Log_Struct
  */
-static globus_io_attr_t eSTAR_IO_Globus_IO_Client_Attr;
+struct IO_Log_Slot_Struct
+{
+	volatile unsigned long Sequence;
+	char Line[ESTAR_IO_LOG_LINE_LENGTH];
+};
+
+/**
+ * Structure holding the error log. Errors reported with eSTAR_IO_Error are formatted into a bounded ring buffer
+ * without taking a lock, and written to Log_File by a background thread, so a connection thread reporting an
+ * error never waits for stderr. Writers claim a slot by advancing Write_Position with compare and swap. If the
+ * ring buffer is full the line is dropped and counted, rather than waiting.
+ * <dl>
+ * <dt>Slot_List</dt> <dd>The ring buffer.</dd>
+ * <dt>Write_Position</dt> <dd>The position the next line is written at.</dd>
+ * <dt>Read_Position</dt> <dd>The position the next line is read from. Protected by Drain_Mutex.</dd>
+ * <dt>Dropped_Count</dt> <dd>The number of lines dropped since the last were written out.</dd>
+ * <dt>Drain_Mutex</dt> <dd>Mutex held whilst lines are taken out of the ring buffer, by the log thread or
+ * 	eSTAR_IO_Log_Flush. Writers do not use it.</dd>
+ * <dt>Log_File</dt> <dd>Where the lines are written, stderr by default.</dd>
+ * <dt>Thread_Running</dt> <dd>GLOBUS_TRUE if the log thread was started. If not, lines are written out
+ * 	by the thread reporting the error.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Error
+ * @see #IO_Log_Thread
+ */
+struct IO_Log_Struct
+{
+	struct IO_Log_Slot_Struct Slot_List[ESTAR_IO_LOG_RING_LENGTH];
+	volatile unsigned long Write_Position;
+	unsigned long Read_Position;
+	volatile unsigned long Dropped_Count;
+	globus_mutex_t Drain_Mutex;
+	FILE *Log_File;
+	int Thread_Running;
+};
+
+/* internal functions */
+static void Get_Current_Time(char *time_string,int string_length);
+static void IO_Error_Initialise(void);
+static void IO_Log_Initialise(void);
+static void *IO_Log_Thread(void *user_arg);
+static int IO_Log_Drain(void);
+static void IO_Log_Exit(void);
+static void IO_Client_Pool_Initialise(void);
+static void IO_Client_Pool_Evict(struct IO_Client_Connection_Struct **dead_list);
+static int IO_Client_Connection_Alive(struct IO_Client_Connection_Struct *connection);
+static void IO_Client_Connection_Free(struct IO_Client_Connection_Struct *connection);
+static int IO_Server_Listener_Create(unsigned short *port);
+static void IO_Handle_Close(eSTAR_IO_Handle_T *handle);
+static void *IO_Server_Connection_Thread(void *user_arg);
+static void *IO_Server_Pool_Worker_Thread(void *user_arg);
+static int IO_Server_Pool_Enqueue(eSTAR_IO_Handle_T *connection_handle);
+static void IO_Event_Reactor_Run(struct IO_Event_Reactor_Struct *reactor);
+static void *IO_Event_Reactor_Thread(void *user_arg);
+static void IO_Event_Accept(void);
+static int IO_Event_Connection_Read(struct IO_Event_Reactor_Struct *reactor,
+	struct IO_Event_Connection_Struct *connection);
+static int IO_Event_Connection_Flush(struct IO_Event_Reactor_Struct *reactor,
+	struct IO_Event_Connection_Struct *connection);
+static void IO_Event_Connection_Close(struct IO_Event_Reactor_Struct *reactor,
+	struct IO_Event_Connection_Struct *connection);
+static int IO_Read_Messages_Add(char ***message_list,size_t **message_length_list,int *message_count,
+	int *allocated_count,char *message,size_t message_length);
+static void IO_Read_Initialise(void);
+static int IO_Read_Context_Get(eSTAR_IO_Handle_T *handle,struct IO_Read_Context_Struct **context);
+static int IO_Read_Context_Next(struct IO_Read_Context_Struct *context,eSTAR_IO_Handle_T *handle,int wait,
+	char **message,size_t *message_length);
+static int IO_Read_Context_Frame(struct IO_Read_Context_Struct *context,eSTAR_IO_Handle_T *handle,int wait,
+	unsigned int *flags,char **frame,size_t *frame_length);
+static int IO_Read_Context_Fill(struct IO_Read_Context_Struct *context,eSTAR_IO_Handle_T *handle,
+	globus_size_t bytes_needed);
+static void IO_Read_Context_Free(struct IO_Read_Context_Struct *context);
+static globus_size_t IO_Read_Context_Buffered(eSTAR_IO_Handle_T *handle);
+static char *IO_Buffer_Pool_Get(size_t length,size_t *allocated_length);
+static void IO_Buffer_Pool_Put(char *buffer,size_t allocated_length);
+static int IO_Write_Framed(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+	size_t message_length,globus_size_t *bytes_written,char **error_string);
+static int IO_Write_Control(eSTAR_IO_Handle_T *handle,int control_type,int control_data,char **error_string);
+static int IO_Control_Frame(eSTAR_IO_Handle_T *handle,unsigned char *frame,size_t frame_length,int *answer);
+static int IO_Compression_Mask(void);
+static int IO_Compress(enum ESTAR_IO_COMPRESSION codec,struct iovec *fragment_list,int fragment_count,
+	size_t message_length,char **frame,size_t *frame_length,size_t *allocated_length);
+static int IO_Decompress(char *frame,size_t frame_length,char **message,size_t *message_length,
+	size_t *allocated_length);
+
+/* internal variables */
 /**
- * Globus IO Authorization data.
+ * The handle the server listener port is on.
  */
-static globus_io_secure_authorization_data_t  eSTAR_IO_Globus_IO_Auth_Data;
+static eSTAR_IO_Handle_T IO_Server_Listener_Handle;
 /**
- * Globus IO Authorization mode data.
+ * The transport the next server started listens with.
+ * @see #eSTAR_IO_Set_Server_Transport
  */
-static globus_io_secure_authorization_mode_t  eSTAR_IO_Globus_IO_Auth_Mode;
+static enum ESTAR_IO_TRANSPORT IO_Server_Transport = ESTAR_IO_TRANSPORT_DEFAULT;
 /**
- * The globus io handle the server listener port is on.
+ * The address the next server started listens on, for transports that need one (the socket path of a Unix
+ * socket server). An empty string if no address has been set.
+ * @see #eSTAR_IO_Set_Server_Transport
  */
-static globus_io_handle_t IO_Server_Listener_Handle;
+static char IO_Server_Address[ESTAR_IO_SERVER_ADDRESS_LENGTH] = "";
 /**
  * Variable used in eSTAR_IO_Start_Server, to monitor the servers state.
  * @see IO_Server_State;
@@ -109,24 +527,131 @@ static enum IO_SERVER_STATE Server_State = IO_SERVER_STATE_NOT_STARTED;
  * @see #IO_Server_Connection_Callback_T
  */
 static IO_Server_Connection_Callback_T IO_Server_Connection_Callback;
+/**
+ * The worker pool used by eSTAR_IO_Start_Pool_Server.
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #IO_Server_Pool_Struct
+ */
+static struct IO_Server_Pool_Struct IO_Server_Pool;
+/**
+ * Copy of the message callback parameter passed into eSTAR_IO_Start_Event_Server.
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #IO_Server_Message_Callback_T
+ */
+static IO_Server_Message_Callback_T IO_Server_Message_Callback;
+/**
+ * The reactors used by eSTAR_IO_Start_Event_Server.
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #IO_Event_Server_Struct
+ */
+static struct IO_Event_Server_Struct IO_Event_Server;
+/**
+ * Used to initialise the client connection pool once, the first time it is used.
+ * @see #IO_Client_Pool_Initialise
+ */
+static globus_thread_once_t IO_Client_Pool_Once = GLOBUS_THREAD_ONCE_INIT;
+/**
+ * The client connection pool used by eSTAR_IO_Checkout_Client and eSTAR_IO_Checkin_Client.
+ * @see #IO_Client_Pool_Struct
+ */
+static struct IO_Client_Pool_Struct IO_Client_Pool;
+/**
+ * Used to initialise the read context list and receive buffer pool once, the first time either is used.
+ * @see #IO_Read_Initialise
+ */
+static globus_thread_once_t IO_Read_Once = GLOBUS_THREAD_ONCE_INIT;
+/**
+ * Mutex protecting IO_Read_Context_List and IO_Read_Context_List_Length.
+ */
+static globus_mutex_t IO_Read_Context_Mutex;
+/**
+ * Allocated list of read contexts, indexed by the file descriptor of the handle they belong to.
+ * @see #IO_Read_Context_Get
+ */
+static struct IO_Read_Context_Struct **IO_Read_Context_List = NULL;
+/**
+ * The number of entries allocated in IO_Read_Context_List.
+ */
+static int IO_Read_Context_List_Length = 0;
+/**
+ * The receive buffer pool, used for messages too large for a read context's read-ahead buffer, and by
+ * the event server.
+ * @see #IO_Buffer_Pool_Get
+ */
+static struct IO_Buffer_Pool_Struct IO_Buffer_Pool;
+/**
+ * The longest message body, in bytes, any of the read routines will accept. A length prefix larger than this
+ * is assumed to be corrupt, rather than being used to allocate memory.
+ * @see #eSTAR_IO_Set_Max_Message_Length
+ * @see #ESTAR_IO_DEFAULT_MAX_MESSAGE_LENGTH
+ */
+static size_t IO_Max_Message_Length = ESTAR_IO_DEFAULT_MAX_MESSAGE_LENGTH;
+/**
+ * The message length, in bytes, at or above which messages sent on a handle that has negotiated compression
+ * are compressed.
+ * @see #eSTAR_IO_Set_Compression_Threshold
+ * @see #ESTAR_IO_DEFAULT_COMPRESSION_THRESHOLD
+ */
+static size_t IO_Compression_Threshold = ESTAR_IO_DEFAULT_COMPRESSION_THRESHOLD;
+/**
+ * Used to create the thread specific error key once, the first time an error is set or read.
+ * @see #IO_Error_Initialise
+ */
+static globus_thread_once_t IO_Error_Once = GLOBUS_THREAD_ONCE_INIT;
+/**
+ * Thread specific data key holding each thread's eSTAR_IO_Error_Struct.
+ * @see #eSTAR_IO_Error_Get
+ */
+static globus_thread_key_t IO_Error_Key;
+/**
+ * Error structure shared by threads whose own one could not be allocated, so eSTAR_IO_Error_Get never
+ * returns NULL.
+ */
+static struct eSTAR_IO_Error_Struct IO_Error_Fallback;
+/**
+ * Used to initialise the error log once, the first time an error is reported.
+ * @see #IO_Log_Initialise
+ */
+static globus_thread_once_t IO_Log_Once = GLOBUS_THREAD_ONCE_INIT;
+/**
+ * The error log.
+ * @see #IO_Log_Struct
+ */
+static struct IO_Log_Struct IO_Log;
 
 /* -----------------------------------
 **  external routines 
 ** ----------------------------------- */
 /**
- * Routine to open a client connection.
+ * Routine to open a client connection, over the default transport.
  * @param hostname The FQDN of the host to connect to.
  * @param port The port number to connect to.
- * @param handle The address of a globus io handle to save the open connection data into.
+ * @param handle The address of a handle to save the open connection data into.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * @see #eSTAR_IO_Open_Transport_Client
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #ESTAR_IO_TRANSPORT_DEFAULT
+ */
+int eSTAR_IO_Open_Client(char *hostname,int port,eSTAR_IO_Handle_T *handle)
+{
+	return eSTAR_IO_Open_Transport_Client(ESTAR_IO_TRANSPORT_DEFAULT,hostname,port,handle);
+}
+
+/**
+ * Routine to open a client connection over a particular transport.
+ * @param transport The transport to connect over.
+ * @param hostname The FQDN of the host to connect to, or the socket path for ESTAR_IO_TRANSPORT_UNIX.
+ * @param port The port number to connect to. This is ignored for ESTAR_IO_TRANSPORT_UNIX.
+ * @param handle The address of a handle to save the open connection data into.
  * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
- * @see #eSTAR_IO_Globus_IO_Client_Attr
- * @see #eSTAR_IO_Globus_IO_Auth_Data
- * @see #eSTAR_IO_Globus_IO_Auth_Mode
+ * @see #eSTAR_IO_Open_Client
+ * @see #eSTAR_IO_Close_Client
+ * @see #eSTAR_IO_Transport_Get
+ * @see #ESTAR_IO_TRANSPORT
  */
-int eSTAR_IO_Open_Client(char *hostname,int port,globus_io_handle_t *handle)
+int eSTAR_IO_Open_Transport_Client(enum ESTAR_IO_TRANSPORT transport,char *hostname,int port,
+	eSTAR_IO_Handle_T *handle)
 {
-	globus_result_t result;
-	globus_object_t* globus_error = NULL;
 	char *error_string = NULL;
 
 	if(hostname == NULL)
@@ -141,60 +666,43 @@ int eSTAR_IO_Open_Client(char *hostname,int port,globus_io_handle_t *handle)
 		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Open_Client:handle was NULL.");
 		return GLOBUS_FALSE;
 	}
-	globus_io_tcpattr_init(&eSTAR_IO_Globus_IO_Client_Attr);
-	globus_io_secure_authorization_data_initialize(&eSTAR_IO_Globus_IO_Auth_Data);
-/* use GSI */
-	globus_io_attr_set_secure_channel_mode(&eSTAR_IO_Globus_IO_Client_Attr,GLOBUS_IO_SECURE_CHANNEL_MODE_GSI_WRAP);
-/* diddly don't lose data
-	globus_io_attr_set_socket_linger(&eSTAR_IO_Globus_IO_Client_Attr,GLOBUS_TRUE,5);
-	globus_io_attr_set_tcp_nodelay(&eSTAR_IO_Globus_IO_Client_Attr,GLOBUS_TRUE);
-*/
-/* authentication information */
-/* diddly
-	globus_io_attr_set_secure_authentication_mode(&eSTAR_IO_Globus_IO_Client_Attr,
-		GLOBUS_IO_SECURE_AUTHENTICATION_MODE_GSSAPI,GSS_C_NO_CREDENTIAL);
-*/
-/* diddly
-	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_SELF;
-or
-	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_IDENTITY;
-	globus_io_secure_authorization_data_set_identity(&eSTAR_IO_Globus_IO_Auth_Data,"DN string");
-*/
-/* diddly
-	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_NONE;
-	globus_io_attr_set_secure_authorization_mode(&eSTAR_IO_Globus_IO_Client_Attr,eSTAR_IO_Globus_IO_Auth_Mode,&
-		eSTAR_IO_Globus_IO_Auth_Data);
-*/
+	handle->Transport = eSTAR_IO_Transport_Get(transport);
+	if(handle->Transport == NULL)
+	{
+		eSTAR_IO_Error_Number = 87;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Open_Client:transport %d not available.",transport);
+		return GLOBUS_FALSE;
+	}
+	handle->Fd = -1;
+	handle->Compression = ESTAR_IO_COMPRESSION_NONE;
 #ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("eSTAR_IO_Open_Client:trying to connect to %s:%d\n",hostname,port);
+	globus_libc_printf("eSTAR_IO_Open_Client:trying to connect to %s:%d over %s\n",hostname,port,
+		handle->Transport->Name);
 #endif
-	result = globus_io_tcp_connect(hostname,(unsigned short)port,&eSTAR_IO_Globus_IO_Client_Attr,handle);
-	if(result != GLOBUS_SUCCESS)
+	if(!handle->Transport->Connect(hostname,port,handle,&error_string))
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
 		eSTAR_IO_Error_Number = 13;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Open_Client:connect error(%s:%d,%s).",
-			hostname,port,error_string);
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Open_Client:connect error(%.256s:%d,%s,%s).",
+			hostname,port,handle->Transport->Name,error_string);
 		return GLOBUS_FALSE;
 	}
 #ifdef ESTAR_IO_DEBUG
 	globus_libc_printf("eSTAR_IO_Open_Client:connected to %s:%d\n",hostname,port);
 #endif
+/* read contexts are found by file descriptor, throw away one left by a handle closed without being released */
+	eSTAR_IO_Release_Handle(handle);
 	return GLOBUS_TRUE;
 }
 
 /**
- * Close a client connection. Also destroys the tcpattr created in Open_Client.
- * @param handle The address of a globus io handle opened in eSTAR_IO_Open_Client.
+ * Close a client connection. Also frees the handle's read context.
+ * @param handle The address of a handle opened in eSTAR_IO_Open_Client.
  * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
  * @see #eSTAR_IO_Open_Client
- * @see #eSTAR_IO_Globus_IO_Client_Attr
+ * @see #eSTAR_IO_Release_Handle
  */
-int eSTAR_IO_Close_Client(globus_io_handle_t *handle)
+int eSTAR_IO_Close_Client(eSTAR_IO_Handle_T *handle)
 {
-	globus_result_t result;
-	globus_object_t* globus_error = NULL;
 	char *error_string = NULL;
 
 	if(handle == NULL)
@@ -203,228 +711,796 @@ int eSTAR_IO_Close_Client(globus_io_handle_t *handle)
 		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Client:handle was NULL.");
 		return GLOBUS_FALSE;
 	}
-	result = globus_io_close(handle);
-	if(result != GLOBUS_SUCCESS)
+	eSTAR_IO_Release_Handle(handle);
+	if(!handle->Transport->Close(handle,&error_string))
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
 		eSTAR_IO_Error_Number = 15;
 		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Client:close error(%s).",
 			error_string);
 		return GLOBUS_FALSE;
 	}
-	result = globus_io_tcpattr_destroy(&eSTAR_IO_Globus_IO_Client_Attr);
-	if(result != GLOBUS_SUCCESS)
-	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		eSTAR_IO_Error_Number = 16;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Client:tcpattr_destroy error(%s).",
-			error_string);
-		return GLOBUS_FALSE;
-	}
 	return GLOBUS_TRUE;
 }
 
 /**
- * Routine to start a server listening for connections.
- * <b>Note</b> The server is Multi-threaded. GLOBUS_DEVELOPMENT_PATH must be set for threaded libraries
- * when linking this code, e.g. <pre>$GLOBUS_PATH/globus-development-path -standard -threads -debug -32 -64</pre>
- * @param port The address of an integer holding the port number. If the port number is -1 and entry,
- * 	on return it will contain a port number selected by globus_io.
- * @param connection_callback The address of a routine to be called each time a connection is made.
- * 	The routine is passed the globus_io handle of the connection. The routine is called in a newly created
- * 	globus thread.
+ * Routine to get a connection to hostname:port from the client connection pool. An idle pooled connection to
+ * the same host and port over the same transport is re-used if it passes a health check, so the GSI handshake
+ * is only done when a new connection is needed. If the pool already holds the maximum number of connections
+ * to that host and port, and they are all in use, the routine waits for one to be checked in. Connections
+ * idle for longer than the idle timeout are closed whenever a connection is checked out or in.
+ * @param transport The transport to connect over.
+ * @param hostname The FQDN of the host to connect to, or the socket path for ESTAR_IO_TRANSPORT_UNIX.
+ * @param port The port number to connect to.
+ * @param handle The address of a pointer, set to the address of the connection's handle. This must be
+ * 	given back with eSTAR_IO_Checkin_Client, not closed with eSTAR_IO_Close_Client.
  * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
- * @see #eSTAR_IO_Globus_IO_Server_Attr
- * @see #eSTAR_IO_Globus_IO_Auth_Data
- * @see #eSTAR_IO_Globus_IO_Auth_Mode
- * @see #Server_State
- * @see #IO_Server_Connection_Callback
+ * @see #eSTAR_IO_Checkin_Client
+ * @see #eSTAR_IO_Configure_Client_Pool
+ * @see #IO_Client_Pool
+ * @see #eSTAR_IO_Open_Transport_Client
  */
-int eSTAR_IO_Start_Server(unsigned short *port,void (*connection_callback)(globus_io_handle_t *connection_handle))
+int eSTAR_IO_Checkout_Client(enum ESTAR_IO_TRANSPORT transport,char *hostname,int port,eSTAR_IO_Handle_T **handle)
 {
-	globus_result_t result;
-	globus_object_t* globus_error = NULL;
-	globus_io_handle_t connection_handle;
-	globus_thread_t new_thread;
-	char *error_string = NULL;
-	int retval;
+	struct IO_Client_Connection_Struct *connection = NULL;
+	struct IO_Client_Connection_Struct *connection_to_free = NULL;
+	struct IO_Client_Connection_Struct *dead_list = NULL;
+	struct IO_Client_Connection_Struct **previous = NULL;
+	int peer_count;
 
-	if(port == NULL)
-	{
-		eSTAR_IO_Error_Number = 17;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:port was NULL.");
-		return GLOBUS_FALSE;
-	}
-	if(connection_callback == NULL)
+	if(hostname == NULL)
 	{
-		eSTAR_IO_Error_Number = 19;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:connection_callback was NULL.");
+		eSTAR_IO_Error_Number = 82;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Checkout_Client:hostname was NULL.");
 		return GLOBUS_FALSE;
 	}
-	IO_Server_Connection_Callback = connection_callback;
-/* initialise */
-	globus_io_tcpattr_init(&eSTAR_IO_Globus_IO_Server_Attr);
-	globus_io_secure_authorization_data_initialize(&eSTAR_IO_Globus_IO_Auth_Data);
-/* use GSI */
-	globus_io_attr_set_secure_channel_mode(&eSTAR_IO_Globus_IO_Server_Attr,GLOBUS_IO_SECURE_CHANNEL_MODE_GSI_WRAP);
-/* diddly don't lose data
-	globus_io_attr_set_socket_linger(&eSTAR_IO_Globus_IO_Server_Attr,GLOBUS_TRUE,5);
-	globus_io_attr_set_tcp_nodelay(&eSTAR_IO_Globus_IO_Server_Attr,GLOBUS_TRUE);
-*/
-/* authentication information */
-/* diddly
-	globus_io_attr_set_secure_authentication_mode(&eSTAR_IO_Globus_IO_Server_Attr,
-		GLOBUS_IO_SECURE_AUTHENTICATION_MODE_GSSAPI,GSS_C_NO_CREDENTIAL);
-*/
-/* diddly
-	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_SELF;
-or
-	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_IDENTITY;
-	globus_io_secure_authorization_data_set_identity(&eSTAR_IO_Globus_IO_Auth_Data,"DN string");
-*/
-/* diddly
-	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_NONE;
-	globus_io_attr_set_secure_authorization_mode(&eSTAR_IO_Globus_IO_Server_Attr,eSTAR_IO_Globus_IO_Auth_Mode,&
-		eSTAR_IO_Globus_IO_Auth_Data);
-*/
-#ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("eSTAR_IO_Start_Server:trying to listen on port %hu\n",(*port));
-#endif
-	result = globus_io_tcp_create_listener(port,5,&eSTAR_IO_Globus_IO_Server_Attr,&IO_Server_Listener_Handle);
-	if(result != GLOBUS_SUCCESS)
+	if(handle == NULL)
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		eSTAR_IO_Error_Number = 20;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:connect error(%hu,%s).",
-			(*port),error_string);
-		globus_io_tcpattr_destroy(&eSTAR_IO_Globus_IO_Server_Attr);
+		eSTAR_IO_Error_Number = 83;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Checkout_Client:handle was NULL.");
 		return GLOBUS_FALSE;
 	}
-#ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("eSTAR_IO_Start_Server:listening on port %hu\n",(*port));
-#endif
-	Server_State = IO_SERVER_STATE_RUNNING;
-	while(Server_State == IO_SERVER_STATE_RUNNING)
+	(*handle) = NULL;
+	globus_thread_once(&IO_Client_Pool_Once,IO_Client_Pool_Initialise);
+	globus_mutex_lock(&(IO_Client_Pool.Mutex));
+	while((*handle) == NULL)
 	{
-		result = globus_io_tcp_listen(&IO_Server_Listener_Handle);
-		if (result != GLOBUS_SUCCESS)
+		IO_Client_Pool_Evict(&dead_list);
+		peer_count = 0;
+		previous = &(IO_Client_Pool.Connection_List);
+		while((*previous) != NULL)
 		{
-		/* if quit is set this error was because the server was closed from another thread,
-		** whilst the server thread was in globus_io_tcp_listen. */
-			if(Server_State == IO_SERVER_STATE_TERMINATING)
+			connection = (*previous);
+			if((connection->Transport != transport)||(connection->Port != port)||
+			   (strcmp(connection->Hostname,hostname) != 0))
+			{
+				previous = &(connection->Next);
 				continue;
-			else
+			}
+			if(connection->Checked_Out)
 			{
-				globus_error = globus_error_get(result);
-				error_string = globus_object_printable_to_string(globus_error);
-				eSTAR_IO_Error_Number = 21;
-				sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:listen failed(%hu,%s).",
-					(*port),error_string);
-				eSTAR_IO_Error();
+				peer_count++;
+				previous = &(connection->Next);
 				continue;
 			}
+			if(IO_Client_Connection_Alive(connection))
+			{
+				connection->Checked_Out = GLOBUS_TRUE;
+				(*handle) = &(connection->Handle);
+				break;
+			}
+		/* the peer has closed it, or it has data nobody asked for, so throw it away */
+			(*previous) = connection->Next;
+			connection->Next = dead_list;
+			dead_list = connection;
 		}
-		result = globus_io_tcp_accept(&IO_Server_Listener_Handle,&eSTAR_IO_Globus_IO_Server_Attr,&connection_handle);
-		if(result != GLOBUS_SUCCESS)
-		{
-			globus_error = globus_error_get(result);
-			error_string = globus_object_printable_to_string(globus_error);
-			eSTAR_IO_Error_Number = 22;
-			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:accept failed(%hu,%s).",
-				(*port),error_string);
-			eSTAR_IO_Error();
-			continue;
-		}
+		if((*handle) != NULL)
+			break;
+		if(peer_count < IO_Client_Pool.Max_Per_Peer)
+			break;
 #ifdef ESTAR_IO_DEBUG
-		globus_libc_printf("eSTAR_IO_Start_Server:connection accepted\n");
+		globus_libc_printf("eSTAR_IO_Checkout_Client:waiting for a connection to %s:%d\n",hostname,port);
 #endif
-/* create the thread with default attributes */
-		retval = globus_thread_create(&new_thread,NULL,IO_Server_Connection_Thread,&connection_handle);
-		if(retval != 0)
+		globus_cond_wait(&(IO_Client_Pool.Checkin_Cond),&(IO_Client_Pool.Mutex));
+	}
+	if((*handle) != NULL)
+	{
+		globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+		while(dead_list != NULL)
 		{
-			eSTAR_IO_Error_Number = 28;
-			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:creating thread failed(%d).",
-				retval);
-			return GLOBUS_FALSE;
+			connection = dead_list;
+			dead_list = connection->Next;
+			IO_Client_Connection_Free(connection);
 		}
 #ifdef ESTAR_IO_DEBUG
-		globus_libc_printf("eSTAR_IO_Start_Server:started thread\n");
+		globus_libc_printf("eSTAR_IO_Checkout_Client:re-using connection to %s:%d\n",hostname,port);
 #endif
-	}/* end while */
-	Server_State=IO_SERVER_STATE_TERMINATED;
+		return GLOBUS_TRUE;
+	}
+/* reserve a place in the pool, then connect without holding the mutex as the handshake is slow */
+	connection = (struct IO_Client_Connection_Struct *)globus_libc_malloc(sizeof(struct IO_Client_Connection_Struct));
+	if(connection != NULL)
+	{
+		connection->Hostname = (char *)globus_libc_malloc((strlen(hostname)+1)*sizeof(char));
+		if(connection->Hostname == NULL)
+		{
+			globus_libc_free(connection);
+			connection = NULL;
+		}
+	}
+	if(connection == NULL)
+	{
+		globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+		while(dead_list != NULL)
+		{
+			connection = dead_list;
+			dead_list = connection->Next;
+			IO_Client_Connection_Free(connection);
+		}
+		eSTAR_IO_Error_Number = 84;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Checkout_Client:memory allocation error(%s:%d).",
+			hostname,port);
+		return GLOBUS_FALSE;
+	}
+	strcpy(connection->Hostname,hostname);
+	connection->Transport = transport;
+	connection->Port = port;
+	connection->Checked_Out = GLOBUS_TRUE;
+	connection->Last_Used = time(NULL);
+	connection->Next = IO_Client_Pool.Connection_List;
+	IO_Client_Pool.Connection_List = connection;
+	globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+	while(dead_list != NULL)
+	{
+		connection_to_free = dead_list;
+		dead_list = connection_to_free->Next;
+		IO_Client_Connection_Free(connection_to_free);
+	}
+	if(!eSTAR_IO_Open_Transport_Client(transport,hostname,port,&(connection->Handle)))
+	{
+		globus_mutex_lock(&(IO_Client_Pool.Mutex));
+		previous = &(IO_Client_Pool.Connection_List);
+		while((*previous) != connection)
+			previous = &((*previous)->Next);
+		(*previous) = connection->Next;
+		globus_cond_broadcast(&(IO_Client_Pool.Checkin_Cond));
+		globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+		globus_libc_free(connection->Hostname);
+		globus_libc_free(connection);
+		return GLOBUS_FALSE;
+	}
+	(*handle) = &(connection->Handle);
 	return GLOBUS_TRUE;
 }
 
 /**
- * Close a server connection. Also destroys the tcpattr created in start server.
- * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
- * @see #eSTAR_IO_Start_Server
- * @see #eSTAR_IO_Globus_IO_Server_Attr
- * @see #Server_State
+ * Routine to give a connection back to the client connection pool.
+ * @param handle The address of the handle returned by eSTAR_IO_Checkout_Client.
+ * @param reusable GLOBUS_TRUE if the connection can be re-used. This should be GLOBUS_FALSE if a read or write
+ * 	on it failed, or a reply was not read, in which case the connection is closed.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE if the handle was not checked out
+ * 	from the pool.
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #IO_Client_Pool
  */
-int eSTAR_IO_Close_Server(void)
+int eSTAR_IO_Checkin_Client(eSTAR_IO_Handle_T *handle,int reusable)
 {
-	globus_result_t result;
-	globus_object_t* globus_error = NULL;
-	char *error_string = NULL;
+	struct IO_Client_Connection_Struct *connection = NULL;
+	struct IO_Client_Connection_Struct *dead_list = NULL;
+	struct IO_Client_Connection_Struct **previous = NULL;
 
-	if(Server_State != IO_SERVER_STATE_RUNNING)
+	if(handle == NULL)
 	{
-		eSTAR_IO_Error_Number = 18;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Server:Illegal Server State(%d).",
-			Server_State);
+		eSTAR_IO_Error_Number = 85;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Checkin_Client:handle was NULL.");
 		return GLOBUS_FALSE;
 	}
-/* set quit before closing handle, so server thread does not throw an error */
-	Server_State=IO_SERVER_STATE_TERMINATING;
-/* close server listener handle */
-	result = globus_io_close(&IO_Server_Listener_Handle);
-	if(result != GLOBUS_SUCCESS)
+	globus_thread_once(&IO_Client_Pool_Once,IO_Client_Pool_Initialise);
+	globus_mutex_lock(&(IO_Client_Pool.Mutex));
+	previous = &(IO_Client_Pool.Connection_List);
+	while(((*previous) != NULL)&&(&((*previous)->Handle) != handle))
+		previous = &((*previous)->Next);
+	connection = (*previous);
+	if((connection == NULL)||(!connection->Checked_Out))
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		eSTAR_IO_Error_Number = 26;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Server:close error(%s).",
-			error_string);
+		globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+		eSTAR_IO_Error_Number = 86;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Checkin_Client:handle was not checked out of the pool.");
 		return GLOBUS_FALSE;
 	}
-	result = globus_io_tcpattr_destroy(&eSTAR_IO_Globus_IO_Server_Attr);
-	if(result != GLOBUS_SUCCESS)
+	if(reusable)
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		eSTAR_IO_Error_Number = 27;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Server:tcpattr_destroy error(%s).",
-			error_string);
-		return GLOBUS_FALSE;
+		connection->Checked_Out = GLOBUS_FALSE;
+		connection->Last_Used = time(NULL);
+	}
+	else
+	{
+		(*previous) = connection->Next;
+		connection->Next = dead_list;
+		dead_list = connection;
+	}
+	IO_Client_Pool_Evict(&dead_list);
+	globus_cond_broadcast(&(IO_Client_Pool.Checkin_Cond));
+	globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+	while(dead_list != NULL)
+	{
+		connection = dead_list;
+		dead_list = connection->Next;
+		IO_Client_Connection_Free(connection);
 	}
 	return GLOBUS_TRUE;
 }
 
 /**
- * Routine to write the text message to a globus_io stream represented by handle.
- * The string is prepended with ESTAR_IO_MESSAGE_SIZE_LENGTH bytes giving it's length, and sent without a terminator.
- * eSTAR_IO_Read_Message will read a mesage sent with this routine.
- * @param handle The address of a globus_io handle opened by a connection being made to a server, or an Open_Client
- * 	call being made.
+ * Routine to set the limits of the client connection pool.
+ * @param max_per_peer The maximum number of connections the pool holds to any one host and port. If this is less
+ * 	than one, ESTAR_IO_CLIENT_POOL_DEFAULT_MAX_PER_PEER is used.
+ * @param idle_timeout The number of seconds a pooled connection can be unused before it is closed. If this is less
+ * 	than one, ESTAR_IO_CLIENT_POOL_DEFAULT_IDLE_TIMEOUT is used.
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #IO_Client_Pool
+ */
+void eSTAR_IO_Configure_Client_Pool(int max_per_peer,int idle_timeout)
+{
+	if(max_per_peer < 1)
+		max_per_peer = ESTAR_IO_CLIENT_POOL_DEFAULT_MAX_PER_PEER;
+	if(idle_timeout < 1)
+		idle_timeout = ESTAR_IO_CLIENT_POOL_DEFAULT_IDLE_TIMEOUT;
+	globus_thread_once(&IO_Client_Pool_Once,IO_Client_Pool_Initialise);
+	globus_mutex_lock(&(IO_Client_Pool.Mutex));
+	IO_Client_Pool.Max_Per_Peer = max_per_peer;
+	IO_Client_Pool.Idle_Timeout = idle_timeout;
+	globus_cond_broadcast(&(IO_Client_Pool.Checkin_Cond));
+	globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+}
+
+/**
+ * Routine to close all the idle connections in the client connection pool. Connections that are checked out
+ * are not affected, and go back into the pool when they are checked in.
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #IO_Client_Pool
+ */
+void eSTAR_IO_Close_Client_Pool(void)
+{
+	struct IO_Client_Connection_Struct *connection = NULL;
+	struct IO_Client_Connection_Struct *dead_list = NULL;
+	struct IO_Client_Connection_Struct **previous = NULL;
+
+	globus_thread_once(&IO_Client_Pool_Once,IO_Client_Pool_Initialise);
+	globus_mutex_lock(&(IO_Client_Pool.Mutex));
+	previous = &(IO_Client_Pool.Connection_List);
+	while((*previous) != NULL)
+	{
+		connection = (*previous);
+		if(connection->Checked_Out)
+		{
+			previous = &(connection->Next);
+			continue;
+		}
+		(*previous) = connection->Next;
+		connection->Next = dead_list;
+		dead_list = connection;
+	}
+	globus_cond_broadcast(&(IO_Client_Pool.Checkin_Cond));
+	globus_mutex_unlock(&(IO_Client_Pool.Mutex));
+	while(dead_list != NULL)
+	{
+		connection = dead_list;
+		dead_list = connection->Next;
+		IO_Client_Connection_Free(connection);
+	}
+}
+
+/**
+ * Routine to set the transport the servers listen with. This affects servers started after it is called.
+ * @param transport The transport to listen with.
+ * @param address The address to listen on. This is the socket path for ESTAR_IO_TRANSPORT_UNIX, and the
+ * 	interface address for ESTAR_IO_TRANSPORT_TCP, where NULL or an empty string means the loopback interface.
+ * 	It is ignored (and can be NULL) for the Globus transport.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * @see #eSTAR_IO_Start_Server
+ * @see #IO_Server_Transport
+ * @see #IO_Server_Address
+ * @see #ESTAR_IO_TRANSPORT
+ */
+int eSTAR_IO_Set_Server_Transport(enum ESTAR_IO_TRANSPORT transport,char *address)
+{
+	if(eSTAR_IO_Transport_Get(transport) == NULL)
+	{
+		eSTAR_IO_Error_Number = 88;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Set_Server_Transport:transport %d not available.",transport);
+		return GLOBUS_FALSE;
+	}
+	if(address == NULL)
+		address = "";
+	if(strlen(address) >= ESTAR_IO_SERVER_ADDRESS_LENGTH)
+	{
+		eSTAR_IO_Error_Number = 89;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Set_Server_Transport:address too long(%d).",
+			(int)strlen(address));
+		return GLOBUS_FALSE;
+	}
+	IO_Server_Transport = transport;
+	strcpy(IO_Server_Address,address);
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to start a server listening for connections.
+ * <b>Note</b> The server is Multi-threaded. GLOBUS_DEVELOPMENT_PATH must be set for threaded libraries
+ * when linking this code, e.g. <pre>$GLOBUS_PATH/globus-development-path -standard -threads -debug -32 -64</pre>
+ * @param port The address of an integer holding the port number. If the port number is -1 and entry,
+ * 	on return it will contain a port number selected by the transport.
+ * @param connection_callback The address of a routine to be called each time a connection is made.
+ * 	The routine is passed the handle of the connection. The routine is called in a newly created
+ * 	globus thread.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #IO_Server_Listener_Create
+ * @see #Server_State
+ * @see #IO_Server_Connection_Callback
+ */
+int eSTAR_IO_Start_Server(unsigned short *port,void (*connection_callback)(eSTAR_IO_Handle_T *connection_handle))
+{
+	eSTAR_IO_Handle_T *connection_handle = NULL;
+	globus_thread_t new_thread;
+	char *error_string = NULL;
+	int retval;
+
+	if(port == NULL)
+	{
+		eSTAR_IO_Error_Number = 17;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:port was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(connection_callback == NULL)
+	{
+		eSTAR_IO_Error_Number = 19;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:connection_callback was NULL.");
+		return GLOBUS_FALSE;
+	}
+	IO_Server_Connection_Callback = connection_callback;
+	if(!IO_Server_Listener_Create(port))
+		return GLOBUS_FALSE;
+	Server_State = IO_SERVER_STATE_RUNNING;
+	while(Server_State == IO_SERVER_STATE_RUNNING)
+	{
+/* each connection thread gets its own copy of the handle, which it frees when the connection closes.
+** Passing the address of a loop local handle would let the next accept overwrite it before the
+** thread had copied it. */
+		connection_handle = (eSTAR_IO_Handle_T *)globus_libc_malloc(sizeof(eSTAR_IO_Handle_T));
+		if(connection_handle == NULL)
+		{
+			eSTAR_IO_Error_Number = 30;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:memory allocation error(%d).",
+				(int)sizeof(eSTAR_IO_Handle_T));
+			eSTAR_IO_Error();
+			continue;
+		}
+		connection_handle->Transport = IO_Server_Listener_Handle.Transport;
+		connection_handle->Compression = ESTAR_IO_COMPRESSION_NONE;
+		if(!IO_Server_Listener_Handle.Transport->Accept(&IO_Server_Listener_Handle,connection_handle,&error_string))
+		{
+			globus_libc_free(connection_handle);
+		/* if quit is set this error was because the server was closed from another thread,
+		** whilst the server thread was waiting for a connection. */
+			if(Server_State == IO_SERVER_STATE_TERMINATING)
+				continue;
+			eSTAR_IO_Error_Number = 22;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:accept failed(%hu,%s).",
+				(*port),error_string);
+			eSTAR_IO_Error();
+			continue;
+		}
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("eSTAR_IO_Start_Server:connection accepted\n");
+#endif
+		eSTAR_IO_Release_Handle(connection_handle);
+/* create the thread with default attributes */
+		retval = globus_thread_create(&new_thread,NULL,IO_Server_Connection_Thread,connection_handle);
+		if(retval != 0)
+		{
+			connection_handle->Transport->Close(connection_handle,&error_string);
+			globus_libc_free(connection_handle);
+			eSTAR_IO_Error_Number = 28;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Server:creating thread failed(%d).",
+				retval);
+			return GLOBUS_FALSE;
+		}
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("eSTAR_IO_Start_Server:started thread\n");
+#endif
+	}/* end while */
+	Server_State=IO_SERVER_STATE_TERMINATED;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to start a server listening for connections, which are serviced by a fixed size pool of
+ * worker threads created before the server starts accepting connections. Accepted connection handles
+ * are copied into a queue of queue_depth entries, and each worker takes a handle from the queue, calls
+ * connection_callback, and closes the connection when the callback returns.
+ * This avoids creating a thread per connection, and bounds the number of threads and pending connections
+ * the server can consume under a burst of connections.
+ * <b>Note</b> The server is Multi-threaded. GLOBUS_DEVELOPMENT_PATH must be set for threaded libraries
+ * when linking this code, e.g. <pre>$GLOBUS_PATH/globus-development-path -standard -threads -debug -32 -64</pre>
+ * @param port The address of an integer holding the port number. If the port number is -1 and entry,
+ * 	on return it will contain a port number selected by the transport.
+ * @param connection_callback The address of a routine to be called each time a connection is made.
+ * 	The routine is passed the handle of the connection. The routine is called in one of the
+ * 	pool's worker threads, so up to pool_size calls can be in progress at once.
+ * @param pool_size The number of worker threads to create. If this is less than 1,
+ * 	ESTAR_IO_POOL_DEFAULT_SIZE is used.
+ * @param queue_depth The number of accepted connections that can wait for a free worker. If this is less
+ * 	than 1, ESTAR_IO_POOL_DEFAULT_QUEUE_DEPTH is used.
+ * @param overflow_policy What to do with a newly accepted connection when the queue is full:
+ * 	ESTAR_IO_POOL_OVERFLOW_BLOCK stops accepting connections until a worker frees a slot,
+ * 	ESTAR_IO_POOL_OVERFLOW_REJECT closes the new connection immediately.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * @see #eSTAR_IO_Start_Server
+ * @see #eSTAR_IO_Close_Server
+ * @see #IO_Server_Pool
+ * @see #IO_Server_Pool_Worker_Thread
+ * @see #IO_Server_Pool_Enqueue
+ * @see #ESTAR_IO_POOL_OVERFLOW
+ */
+int eSTAR_IO_Start_Pool_Server(unsigned short *port,
+	void (*connection_callback)(eSTAR_IO_Handle_T *connection_handle),
+	int pool_size,int queue_depth,enum ESTAR_IO_POOL_OVERFLOW overflow_policy)
+{
+	eSTAR_IO_Handle_T connection_handle;
+	globus_thread_t new_thread;
+	char *error_string = NULL;
+	int retval,i;
+
+	if(port == NULL)
+	{
+		eSTAR_IO_Error_Number = 31;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:port was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(connection_callback == NULL)
+	{
+		eSTAR_IO_Error_Number = 32;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:connection_callback was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if((overflow_policy != ESTAR_IO_POOL_OVERFLOW_BLOCK)&&(overflow_policy != ESTAR_IO_POOL_OVERFLOW_REJECT))
+	{
+		eSTAR_IO_Error_Number = 33;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:illegal overflow policy(%d).",
+			overflow_policy);
+		return GLOBUS_FALSE;
+	}
+	if(pool_size < 1)
+		pool_size = ESTAR_IO_POOL_DEFAULT_SIZE;
+	if(queue_depth < 1)
+		queue_depth = ESTAR_IO_POOL_DEFAULT_QUEUE_DEPTH;
+	IO_Server_Connection_Callback = connection_callback;
+/* initialise the pool */
+	IO_Server_Pool.Queue = (eSTAR_IO_Handle_T *)globus_libc_malloc(queue_depth*sizeof(eSTAR_IO_Handle_T));
+	if(IO_Server_Pool.Queue == NULL)
+	{
+		eSTAR_IO_Error_Number = 34;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:memory allocation error(%d).",
+			queue_depth*(int)sizeof(eSTAR_IO_Handle_T));
+		return GLOBUS_FALSE;
+	}
+	globus_mutex_init(&(IO_Server_Pool.Mutex),NULL);
+	globus_cond_init(&(IO_Server_Pool.Not_Empty_Cond),NULL);
+	globus_cond_init(&(IO_Server_Pool.Not_Full_Cond),NULL);
+	globus_cond_init(&(IO_Server_Pool.Finished_Cond),NULL);
+	IO_Server_Pool.Queue_Depth = queue_depth;
+	IO_Server_Pool.Queue_Head = 0;
+	IO_Server_Pool.Queue_Count = 0;
+	IO_Server_Pool.Overflow_Policy = overflow_policy;
+	IO_Server_Pool.Worker_Count = 0;
+	IO_Server_Pool.Active = GLOBUS_TRUE;
+	if(!IO_Server_Listener_Create(port))
+	{
+		IO_Server_Pool.Active = GLOBUS_FALSE;
+		globus_libc_free(IO_Server_Pool.Queue);
+		IO_Server_Pool.Queue = NULL;
+		return GLOBUS_FALSE;
+	}
+/* the server is running before the workers start, so they do not exit straight away */
+	Server_State = IO_SERVER_STATE_RUNNING;
+/* pre-spawn the workers */
+	for(i = 0; i < pool_size; i++)
+	{
+		globus_mutex_lock(&(IO_Server_Pool.Mutex));
+		IO_Server_Pool.Worker_Count++;
+		globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+		retval = globus_thread_create(&new_thread,NULL,IO_Server_Pool_Worker_Thread,NULL);
+		if(retval != 0)
+		{
+			globus_mutex_lock(&(IO_Server_Pool.Mutex));
+			IO_Server_Pool.Worker_Count--;
+			globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+			eSTAR_IO_Error_Number = 35;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:creating worker %d failed(%d).",
+				i,retval);
+			eSTAR_IO_Error();
+			break;
+		}
+	}
+	if(i == 0)
+	{
+		eSTAR_IO_Error_Number = 36;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:no worker threads could be created.");
+		eSTAR_IO_Close_Server();
+	}
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("eSTAR_IO_Start_Pool_Server:started %d workers, queue depth %d\n",i,queue_depth);
+#endif
+	while(Server_State == IO_SERVER_STATE_RUNNING)
+	{
+		connection_handle.Transport = IO_Server_Listener_Handle.Transport;
+		connection_handle.Compression = ESTAR_IO_COMPRESSION_NONE;
+		if(!IO_Server_Listener_Handle.Transport->Accept(&IO_Server_Listener_Handle,&connection_handle,&error_string))
+		{
+		/* if quit is set this error was because the server was closed from another thread,
+		** whilst the server thread was waiting for a connection. */
+			if(Server_State == IO_SERVER_STATE_TERMINATING)
+				continue;
+			eSTAR_IO_Error_Number = 38;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Pool_Server:accept failed(%hu,%s).",
+				(*port),error_string);
+			eSTAR_IO_Error();
+			continue;
+		}
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("eSTAR_IO_Start_Pool_Server:connection accepted\n");
+#endif
+		eSTAR_IO_Release_Handle(&connection_handle);
+		if(!IO_Server_Pool_Enqueue(&connection_handle))
+		{
+			connection_handle.Transport->Close(&connection_handle,&error_string);
+			if(Server_State == IO_SERVER_STATE_RUNNING)
+				eSTAR_IO_Error();
+		}
+	}/* end while */
+/* tell the workers to finish, and wait for them to do so. Connections still in the queue are closed unserved. */
+	globus_mutex_lock(&(IO_Server_Pool.Mutex));
+	globus_cond_broadcast(&(IO_Server_Pool.Not_Empty_Cond));
+	while(IO_Server_Pool.Worker_Count > 0)
+		globus_cond_wait(&(IO_Server_Pool.Finished_Cond),&(IO_Server_Pool.Mutex));
+	while(IO_Server_Pool.Queue_Count > 0)
+	{
+		IO_Handle_Close(&(IO_Server_Pool.Queue[IO_Server_Pool.Queue_Head]));
+		IO_Server_Pool.Queue_Head = (IO_Server_Pool.Queue_Head+1)%IO_Server_Pool.Queue_Depth;
+		IO_Server_Pool.Queue_Count--;
+	}
+	IO_Server_Pool.Active = GLOBUS_FALSE;
+	globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+	globus_cond_destroy(&(IO_Server_Pool.Not_Empty_Cond));
+	globus_cond_destroy(&(IO_Server_Pool.Not_Full_Cond));
+	globus_cond_destroy(&(IO_Server_Pool.Finished_Cond));
+	globus_mutex_destroy(&(IO_Server_Pool.Mutex));
+	globus_libc_free(IO_Server_Pool.Queue);
+	IO_Server_Pool.Queue = NULL;
+	Server_State=IO_SERVER_STATE_TERMINATED;
+	return (i > 0);
+}
+
+/**
+ * Routine to start an event driven server listening for connections. Rather than dedicating a thread to each
+ * connection, connections are shared between reactor_count reactors, each of which waits on an epoll
+ * instance for any of its connections to become readable. The length prefixed messages are read
+ * incrementally as data arrives, and message_callback is called once for each complete message.
+ * This allows a large number of mostly idle connections to be held open by a few threads.
+ * The calling thread is used as the first reactor, and also accepts new connections, which are given to
+ * the reactors in turn. The routine returns when eSTAR_IO_Close_Server is called.
+ * <b>Note</b> The GSI handshake of the Globus transport is done in the first reactor, so a slow client
+ * delays the connections owned by that reactor whilst it connects.
+ * @param port The address of an integer holding the port number. If the port number is -1 and entry,
+ * 	on return it will contain a port number selected by the transport.
+ * @param message_callback The address of a routine to be called each time a complete message has been received.
+ * 	The routine is passed the handle of the connection the message arrived on, which can be used to
+ * 	send a reply, and the message and its length. The message is NULL terminated, but may contain binary data.
+ * 	The message is freed when the routine returns, so must be copied if it is needed afterwards.
+ * 	The routine is called in the thread of the reactor owning the connection, and should not block for long
+ * 	as no other connection on that reactor is serviced whilst it runs.
+ * @param reactor_count The number of reactors to run. If this is less than 1, one reactor is used.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * @see #eSTAR_IO_Close_Server
+ * @see #IO_Event_Server
+ * @see #IO_Event_Reactor_Run
+ * @see #IO_Server_Message_Callback
+ */
+int eSTAR_IO_Start_Event_Server(unsigned short *port,
+	void (*message_callback)(eSTAR_IO_Handle_T *connection_handle,char *message,size_t message_length),
+	int reactor_count)
+{
+	struct epoll_event event;
+	globus_thread_t new_thread;
+	char *error_string = NULL;
+	int listening = GLOBUS_TRUE;
+	int retval,i;
+
+	if(port == NULL)
+	{
+		eSTAR_IO_Error_Number = 41;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Event_Server:port was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(message_callback == NULL)
+	{
+		eSTAR_IO_Error_Number = 42;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Event_Server:message_callback was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(reactor_count < 1)
+		reactor_count = 1;
+	IO_Server_Message_Callback = message_callback;
+/* initialise the reactors */
+	IO_Event_Server.Reactor_List = (struct IO_Event_Reactor_Struct *)globus_libc_malloc(reactor_count*
+		sizeof(struct IO_Event_Reactor_Struct));
+	if(IO_Event_Server.Reactor_List == NULL)
+	{
+		eSTAR_IO_Error_Number = 43;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Event_Server:memory allocation error(%d).",
+			reactor_count*(int)sizeof(struct IO_Event_Reactor_Struct));
+		return GLOBUS_FALSE;
+	}
+	for(i = 0; i < reactor_count; i++)
+	{
+		IO_Event_Server.Reactor_List[i].Epoll_Fd = epoll_create(ESTAR_IO_EVENT_MAX_EVENTS);
+		if(IO_Event_Server.Reactor_List[i].Epoll_Fd < 0)
+		{
+			eSTAR_IO_Error_Number = 44;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Event_Server:epoll_create failed(%d).",i);
+			while(--i >= 0)
+			{
+				close(IO_Event_Server.Reactor_List[i].Epoll_Fd);
+				globus_mutex_destroy(&(IO_Event_Server.Reactor_List[i].Mutex));
+			}
+			globus_libc_free(IO_Event_Server.Reactor_List);
+			IO_Event_Server.Reactor_List = NULL;
+			return GLOBUS_FALSE;
+		}
+		globus_mutex_init(&(IO_Event_Server.Reactor_List[i].Mutex),NULL);
+		IO_Event_Server.Reactor_List[i].Connection_List = NULL;
+		IO_Event_Server.Reactor_List[i].Connection_Count = 0;
+	}
+	globus_mutex_init(&(IO_Event_Server.Mutex),NULL);
+	globus_cond_init(&(IO_Event_Server.Finished_Cond),NULL);
+	IO_Event_Server.Reactor_Count = reactor_count;
+	IO_Event_Server.Running_Count = 0;
+	IO_Event_Server.Next_Reactor = 0;
+	if(!IO_Server_Listener_Create(port))
+		listening = GLOBUS_FALSE;
+	else
+	{
+	/* the listener is registered with the first reactor, with a NULL connection */
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		if(epoll_ctl(IO_Event_Server.Reactor_List[0].Epoll_Fd,EPOLL_CTL_ADD,IO_Server_Listener_Handle.Fd,
+			&event) != 0)
+		{
+			eSTAR_IO_Error_Number = 45;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Event_Server:epoll_ctl failed for listener(%hu).",
+				(*port));
+			IO_Server_Listener_Handle.Transport->Close(&IO_Server_Listener_Handle,&error_string);
+			listening = GLOBUS_FALSE;
+		}
+	}
+	if(listening)
+	{
+		Server_State = IO_SERVER_STATE_RUNNING;
+	/* start the other reactors in their own threads */
+		for(i = 1; i < reactor_count; i++)
+		{
+			globus_mutex_lock(&(IO_Event_Server.Mutex));
+			IO_Event_Server.Running_Count++;
+			globus_mutex_unlock(&(IO_Event_Server.Mutex));
+			retval = globus_thread_create(&new_thread,NULL,IO_Event_Reactor_Thread,
+				&(IO_Event_Server.Reactor_List[i]));
+			if(retval != 0)
+			{
+				globus_mutex_lock(&(IO_Event_Server.Mutex));
+				IO_Event_Server.Running_Count--;
+				globus_mutex_unlock(&(IO_Event_Server.Mutex));
+				eSTAR_IO_Error_Number = 46;
+				sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Start_Event_Server:creating reactor %d failed(%d).",
+					i,retval);
+				eSTAR_IO_Error();
+				break;
+			}
+		}
+	/* only hand connections to reactors that are running */
+		IO_Event_Server.Reactor_Count = i;
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("eSTAR_IO_Start_Event_Server:started %d reactors\n",i);
+#endif
+		IO_Event_Reactor_Run(&(IO_Event_Server.Reactor_List[0]));
+	/* wait for the other reactors to finish */
+		globus_mutex_lock(&(IO_Event_Server.Mutex));
+		while(IO_Event_Server.Running_Count > 0)
+			globus_cond_wait(&(IO_Event_Server.Finished_Cond),&(IO_Event_Server.Mutex));
+		globus_mutex_unlock(&(IO_Event_Server.Mutex));
+	}
+/* free the reactors */
+	for(i = 0; i < reactor_count; i++)
+	{
+		close(IO_Event_Server.Reactor_List[i].Epoll_Fd);
+		globus_mutex_destroy(&(IO_Event_Server.Reactor_List[i].Mutex));
+	}
+	globus_cond_destroy(&(IO_Event_Server.Finished_Cond));
+	globus_mutex_destroy(&(IO_Event_Server.Mutex));
+	globus_libc_free(IO_Event_Server.Reactor_List);
+	IO_Event_Server.Reactor_List = NULL;
+	if(!listening)
+		return GLOBUS_FALSE;
+	Server_State=IO_SERVER_STATE_TERMINATED;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Close a server connection.
+ * If the server was started with eSTAR_IO_Start_Pool_Server, the server thread is woken if it is waiting
+ * for space in the connection queue. The worker threads are shut down by the server thread itself, so this
+ * routine can be safely called from within a connection callback.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * An event server's reactors notice the server has been closed within ESTAR_IO_EVENT_POLL_TIMEOUT
+ * milliseconds, and close their connections.
+ * @see #eSTAR_IO_Start_Server
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #Server_State
+ * @see #IO_Server_Pool
+ */
+int eSTAR_IO_Close_Server(void)
+{
+	char *error_string = NULL;
+
+	if(Server_State != IO_SERVER_STATE_RUNNING)
+	{
+		eSTAR_IO_Error_Number = 18;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Server:Illegal Server State(%d).",
+			Server_State);
+		return GLOBUS_FALSE;
+	}
+/* set quit before closing handle, so server thread does not throw an error */
+	Server_State=IO_SERVER_STATE_TERMINATING;
+/* wake a pool server thread waiting for a free queue slot */
+	if(IO_Server_Pool.Active)
+	{
+		globus_mutex_lock(&(IO_Server_Pool.Mutex));
+		globus_cond_broadcast(&(IO_Server_Pool.Not_Full_Cond));
+		globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+	}
+/* close server listener handle */
+	if(!IO_Server_Listener_Handle.Transport->Close(&IO_Server_Listener_Handle,&error_string))
+	{
+		eSTAR_IO_Error_Number = 26;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Close_Server:close error(%s).",
+			error_string);
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to write the text message to a stream represented by handle.
+ * The string is prepended with ESTAR_IO_MESSAGE_SIZE_LENGTH bytes giving it's length, and sent without a terminator.
+ * The length and the string are sent together with one transport write, so the string is not copied.
+ * eSTAR_IO_Read_Message will read a mesage sent with this routine.
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
+ * 	call being made.
  * @param message A NULL terminated character string, that should not be NULL.
  * @return The routine returns GLOBUS_TRUE if the message was sent successfully, and GLOBUS_FALSE
  * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
  * 	if something failed.
  * @see #eSTAR_IO_Read_Message
+ * @see #IO_Write_Framed
  * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
  */
-int eSTAR_IO_Write_Message(globus_io_handle_t *handle,char *message)
+int eSTAR_IO_Write_Message(eSTAR_IO_Handle_T *handle,char *message)
 {
-	globus_byte_t *message_block = NULL;
-	globus_result_t result;
+	struct iovec iovec_list[2];
 	globus_size_t bytes_written;
-	globus_object_t* globus_error = NULL;
 	char *error_string = NULL;
-	globus_size_t message_length;
+	size_t message_length;
 
 	if(handle == GLOBUS_NULL)
 	{
@@ -438,47 +1514,32 @@ int eSTAR_IO_Write_Message(globus_io_handle_t *handle,char *message)
 		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Message:message was NULL.");
 		return GLOBUS_FALSE;
 	}
-/* allocate message block */
-	message_block = globus_libc_malloc((strlen(message)+ESTAR_IO_MESSAGE_SIZE_LENGTH)*sizeof(char));
-	if(message_block == GLOBUS_NULL)
-	{
-		eSTAR_IO_Error_Number = 2;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Message:memory allocation error(%d).",
-			(strlen(message)+ESTAR_IO_MESSAGE_SIZE_LENGTH));
-		return GLOBUS_FALSE;
-	}
-/* setup message block */
-	message_length = htonl(strlen(message));
-	memcpy(message_block,&message_length,ESTAR_IO_MESSAGE_SIZE_LENGTH);
-	globus_libc_sprintf(message_block+ESTAR_IO_MESSAGE_SIZE_LENGTH,"%s",message);
+	message_length = strlen(message);
 /* send message block */
 #ifdef ESTAR_IO_DEBUG
 	globus_libc_printf("eSTAR_IO_Write_Message: about to send '%s'.\n",message);
 #endif
-	result = globus_io_write(handle,message_block,strlen(message)+ESTAR_IO_MESSAGE_SIZE_LENGTH,&bytes_written);
-	if(result != GLOBUS_SUCCESS)
+	iovec_list[1].iov_base = message;
+	iovec_list[1].iov_len = message_length;
+	if(!IO_Write_Framed(handle,iovec_list,2,message_length,&bytes_written,&error_string))
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		globus_libc_free(message_block);
 		eSTAR_IO_Error_Number = 3;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Message:write error(%s,%d,%d,%s).",
-			message,strlen(message_block),bytes_written,error_string);
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Message:write error(%.256s,%d,%d,%s).",
+			message,(int)message_length,(int)bytes_written,error_string);
 		return GLOBUS_FALSE;
 	}
 #ifdef ESTAR_IO_DEBUG
 	globus_libc_printf("eSTAR_IO_Write_Message: sent '%s'.\n",message);
 #endif
-/* free allocated memory */
-	globus_libc_free(message_block);
 	return GLOBUS_TRUE;
 }
 
 /**
- * Routine to write a binary data message to a globus_io stream represented by handle.
+ * Routine to write a binary data message to a stream represented by handle.
  * The buffer is prepended with ESTAR_IO_MESSAGE_SIZE_LENGTH bytes giving it's length, and sent without a terminator.
+ * The length and the buffer are sent together with one transport write, so the buffer is not copied.
  * eSTAR_IO_Read_Message will read a mesage sent with this routine.
- * @param handle The address of a globus_io handle opened by a connection being made to a server, or an Open_Client
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
  * 	call being made.
  * @param data_buffer A pointer to memory of length data_buffer__length, 
  * 	that should not be NULL and contains the binary data to send.
@@ -487,17 +1548,16 @@ int eSTAR_IO_Write_Message(globus_io_handle_t *handle,char *message)
  * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
  * 	if something failed.
  * @see #eSTAR_IO_Write_Message
+ * @see #eSTAR_IO_Write_Vector_Message
  * @see #eSTAR_IO_Read_Message
+ * @see #IO_Write_Framed
  * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
  */
-int eSTAR_IO_Write_Binary_Message(globus_io_handle_t *handle,void *data_buffer,size_t data_buffer_length)
+int eSTAR_IO_Write_Binary_Message(eSTAR_IO_Handle_T *handle,void *data_buffer,size_t data_buffer_length)
 {
-	globus_byte_t *message_block = NULL;
-	globus_result_t result;
+	struct iovec iovec_list[2];
 	globus_size_t bytes_written;
-	globus_object_t* globus_error = NULL;
 	char *error_string = NULL;
-	globus_size_t message_length;
 
 	if(handle == GLOBUS_NULL)
 	{
@@ -511,63 +1571,135 @@ int eSTAR_IO_Write_Binary_Message(globus_io_handle_t *handle,void *data_buffer,s
 		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Binary_Message:data buffer was NULL.");
 		return GLOBUS_FALSE;
 	}
-/* allocate message block */
-	message_block = globus_libc_malloc((data_buffer_length+ESTAR_IO_MESSAGE_SIZE_LENGTH)*sizeof(char));
-	if(message_block == GLOBUS_NULL)
-	{
-		eSTAR_IO_Error_Number = 25;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Binary_Message:memory allocation error(%d).",
-			(data_buffer_length+ESTAR_IO_MESSAGE_SIZE_LENGTH));
-		return GLOBUS_FALSE;
-	}
-/* setup message block */
-	message_length = htonl(data_buffer_length);
-	memcpy(message_block,&message_length,ESTAR_IO_MESSAGE_SIZE_LENGTH);
-	memcpy(message_block+ESTAR_IO_MESSAGE_SIZE_LENGTH,data_buffer,data_buffer_length);
 /* send message block */
 #ifdef ESTAR_IO_DEBUG
 	globus_libc_printf("eSTAR_IO_Write_Binary_Message: about to send buffer of length '%d'.\n",
-		(data_buffer_length+ESTAR_IO_MESSAGE_SIZE_LENGTH)*sizeof(char));
+		(int)(data_buffer_length+ESTAR_IO_MESSAGE_SIZE_LENGTH));
 #endif
-	result = globus_io_write(handle,message_block,data_buffer_length+ESTAR_IO_MESSAGE_SIZE_LENGTH,&bytes_written);
-	if(result != GLOBUS_SUCCESS)
+	iovec_list[1].iov_base = data_buffer;
+	iovec_list[1].iov_len = data_buffer_length;
+	if(!IO_Write_Framed(handle,iovec_list,2,data_buffer_length,&bytes_written,&error_string))
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		globus_libc_free(message_block);
 		eSTAR_IO_Error_Number = 29;
 		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Binary_Message:write error(%d,%d,%s).",
-			data_buffer_length,bytes_written,error_string);
+			(int)data_buffer_length,(int)bytes_written,error_string);
 		return GLOBUS_FALSE;
 	}
 #ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("eSTAR_IO_Write_Binary_Message: sent buffer of length %d.\n",bytes_written);
+	globus_libc_printf("eSTAR_IO_Write_Binary_Message: sent buffer of length %d.\n",(int)bytes_written);
 #endif
-/* free allocated memory */
-	globus_libc_free(message_block);
 	return GLOBUS_TRUE;
 }
 
 /**
- * Routine to read a text message from a globus_io stream represented by handle.
- * Note this routine will also read a fixed length binary message, as it relies on the buffer length integer
- * prepended to the message rather than a NULL terminator (which will be added to binary data). 
- * @param handle The address of a globus_io handle opened by a connection being made to a server, or an Open_Client
+ * Routine to write several fragments of data to a stream represented by handle, as one message.
+ * The fragments are sent one after another, prepended with ESTAR_IO_MESSAGE_SIZE_LENGTH bytes giving their
+ * total length, so the receiver sees a single message. The fragments are sent with one transport write (one per
+ * ESTAR_IO_WRITE_IOV_MAX fragments for longer lists), so they do not have to be copied into one buffer first,
+ * e.g. a text header and a binary catalogue can be sent together.
+ * eSTAR_IO_Read_Message will read a mesage sent with this routine.
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
  * 	call being made.
- * @param message The address of a character pointer to store the read message into.
- * 	This should be freed with: <code>globus_libc_free(message);</code>
- * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
- * @see #eSTAR_IO_Write_Message
+ * @param fragment_list A list of fragment_count iovec structures, each pointing to a fragment of the message.
+ * 	Fragments of zero length are allowed, but the message as a whole cannot be empty.
+ * @param fragment_count The number of fragments in fragment_list, which should be at least 1.
+ * @return The routine returns GLOBUS_TRUE if the message was sent successfully, and GLOBUS_FALSE
+ * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
+ * 	if something failed.
  * @see #eSTAR_IO_Write_Binary_Message
- */
-int eSTAR_IO_Read_Message(globus_io_handle_t *handle,char **message)
+ * @see #eSTAR_IO_Read_Message
+ * @see #IO_Write_Framed
+ * @see #ESTAR_IO_WRITE_FRAGMENT_COUNT
+ * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
+ */
+int eSTAR_IO_Write_Vector_Message(eSTAR_IO_Handle_T *handle,struct iovec *fragment_list,int fragment_count)
 {
-	globus_result_t result;
-	globus_size_t bytes_read;
-	globus_object_t* globus_error = NULL;
+	struct iovec local_iovec_list[ESTAR_IO_WRITE_FRAGMENT_COUNT+1];
+	struct iovec *iovec_list = local_iovec_list;
+	globus_size_t bytes_written;
 	char *error_string = NULL;
-	globus_byte_t message_length_buffer[ESTAR_IO_MESSAGE_SIZE_LENGTH];
-	globus_size_t message_length;
+	int retval;
+	size_t message_length;
+	int i;
+
+	if(handle == GLOBUS_NULL)
+	{
+		eSTAR_IO_Error_Number = 53;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Vector_Message:handle was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(fragment_list == GLOBUS_NULL)
+	{
+		eSTAR_IO_Error_Number = 54;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Vector_Message:fragment list was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(fragment_count < 1)
+	{
+		eSTAR_IO_Error_Number = 55;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Vector_Message:illegal fragment count(%d).",
+			fragment_count);
+		return GLOBUS_FALSE;
+	}
+/* only allocate an iovec list if there are too many fragments to fit in the local one */
+	if(fragment_count > ESTAR_IO_WRITE_FRAGMENT_COUNT)
+	{
+		iovec_list = (struct iovec *)globus_libc_malloc((fragment_count+1)*sizeof(struct iovec));
+		if(iovec_list == NULL)
+		{
+			eSTAR_IO_Error_Number = 56;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Vector_Message:memory allocation error(%d).",
+				(fragment_count+1)*(int)sizeof(struct iovec));
+			return GLOBUS_FALSE;
+		}
+	}
+	message_length = 0;
+	for(i = 0; i < fragment_count; i++)
+	{
+		iovec_list[i+1] = fragment_list[i];
+		message_length += fragment_list[i].iov_len;
+	}
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("eSTAR_IO_Write_Vector_Message: about to send %d fragments of total length '%d'.\n",
+		fragment_count,(int)message_length);
+#endif
+	retval = IO_Write_Framed(handle,iovec_list,fragment_count+1,message_length,&bytes_written,&error_string);
+	if(iovec_list != local_iovec_list)
+		globus_libc_free(iovec_list);
+	if(!retval)
+	{
+		eSTAR_IO_Error_Number = 57;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Vector_Message:write error(%d,%d,%s).",
+			(int)message_length,(int)bytes_written,error_string);
+		return GLOBUS_FALSE;
+	}
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("eSTAR_IO_Write_Vector_Message: sent buffer of length %d.\n",(int)bytes_written);
+#endif
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to read a text message from a stream represented by handle.
+ * Note this routine will also read a fixed length binary message, as it relies on the buffer length integer
+ * prepended to the message rather than a NULL terminator (which will be added to binary data). 
+ * The message is read through the handle's read context, so any data read ahead is not lost, and this routine
+ * can be mixed with eSTAR_IO_Read_Pooled_Message and eSTAR_IO_Read_Messages on the same handle.
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
+ * 	call being made.
+ * @param message The address of a character pointer to store the read message into.
+ * 	This should be freed with: <code>globus_libc_free(message);</code>
+ * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
+ * @see #eSTAR_IO_Write_Message
+ * @see #eSTAR_IO_Write_Binary_Message
+ * @see #eSTAR_IO_Read_Pooled_Message
+ * @see #IO_Read_Context_Next
+ */
+int eSTAR_IO_Read_Message(eSTAR_IO_Handle_T *handle,char **message)
+{
+	struct IO_Read_Context_Struct *context = NULL;
+	char *buffered_message = NULL;
+	size_t message_length;
 
 	if(handle == GLOBUS_NULL)
 	{
@@ -583,109 +1715,2165 @@ int eSTAR_IO_Read_Message(globus_io_handle_t *handle,char **message)
 	}
 /* initialse message */
 	(*message) = NULL;
-/* read byes containing length of rest of message */
-	result = globus_io_read(handle,message_length_buffer,ESTAR_IO_MESSAGE_SIZE_LENGTH,
-		ESTAR_IO_MESSAGE_SIZE_LENGTH,&bytes_read);
-	if(result != GLOBUS_SUCCESS)
+	if(!IO_Read_Context_Get(handle,&context))
+		return GLOBUS_FALSE;
+	if(!IO_Read_Context_Next(context,handle,GLOBUS_TRUE,&buffered_message,&message_length))
+		return GLOBUS_FALSE;
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("eSTAR_IO_Read_Message: message length is '%d'\n",(int)message_length);
+#endif
+	if(buffered_message == context->Body)
+	{
+	/* the message was read into a pooled buffer of its own, hand it straight to the caller */
+		(*message) = context->Body;
+		context->Body = NULL;
+	}
+	else
+	{
+		(*message) = globus_libc_malloc((message_length+1)*sizeof(char));
+		if((*message) == NULL)
+		{
+			eSTAR_IO_Error_Number = 9;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Message:memory allocation error(%d).",
+				(int)message_length);
+			return GLOBUS_FALSE;
+		}
+		memcpy((*message),buffered_message,message_length+1);
+	}
+/* Note, this next debug line is dangerous with binary data */
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("eSTAR_IO_Read_Message: received '%s'\n",(*message));
+#endif
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to read a message from a stream represented by handle, without copying it.
+ * The message is returned in a buffer belonging to the handle's read context: either its read-ahead buffer,
+ * or for messages too large for that, a buffer from the receive buffer pool. Either way, the message is
+ * only valid until the next read on the same handle, or until the handle is closed or released.
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
+ * 	call being made.
+ * @param message The address of a character pointer, set to point to the message read.
+ * 	The message is NULL terminated, but may contain binary data. It must not be freed.
+ * @param message_length The address of a size_t, set to the length of the message read.
+ * @return The routine returns GLOBUS_TRUE if a message was read successfully, and GLOBUS_FALSE
+ * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
+ * 	if something failed.
+ * @see #eSTAR_IO_Read_Message
+ * @see #eSTAR_IO_Release_Handle
+ * @see #IO_Read_Context_Next
+ */
+int eSTAR_IO_Read_Pooled_Message(eSTAR_IO_Handle_T *handle,char **message,size_t *message_length)
+{
+	struct IO_Read_Context_Struct *context = NULL;
+
+	if(handle == GLOBUS_NULL)
+	{
+		eSTAR_IO_Error_Number = 80;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Pooled_Message:handle was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if((message == GLOBUS_NULL)||(message_length == GLOBUS_NULL))
+	{
+		eSTAR_IO_Error_Number = 81;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Pooled_Message:message or length was NULL.");
+		return GLOBUS_FALSE;
+	}
+	(*message) = NULL;
+	(*message_length) = 0;
+	if(!IO_Read_Context_Get(handle,&context))
+		return GLOBUS_FALSE;
+	return IO_Read_Context_Next(context,handle,GLOBUS_TRUE,message,message_length);
+}
+
+/**
+ * Routine to free the read context of a handle, and any data read ahead on it. The read context is created
+ * the first time the handle is read from. eSTAR_IO_Close_Client, and the servers when a connection callback
+ * returns, call this routine, but anything else that closes a handle that has been read from should call it
+ * first, as a new connection re-using the same file descriptor would otherwise see the old data.
+ * As a backstop, the library also calls it for every handle it connects or accepts, so a context left behind
+ * by a handle that was closed some other way is thrown away before the file descriptor is read from again.
+ * It is safe to call this routine for a handle that has no read context.
+ * @param handle The address of the handle.
+ * @see #eSTAR_IO_Close_Client
+ * @see #IO_Read_Context_Get
+ */
+void eSTAR_IO_Release_Handle(eSTAR_IO_Handle_T *handle)
+{
+	struct IO_Read_Context_Struct *context = NULL;
+
+	if(handle == GLOBUS_NULL)
+		return;
+	globus_thread_once(&IO_Read_Once,IO_Read_Initialise);
+	globus_mutex_lock(&IO_Read_Context_Mutex);
+	if((handle->Fd >= 0)&&(handle->Fd < IO_Read_Context_List_Length))
+	{
+		context = IO_Read_Context_List[handle->Fd];
+		IO_Read_Context_List[handle->Fd] = NULL;
+	}
+	globus_mutex_unlock(&IO_Read_Context_Mutex);
+	if(context != NULL)
+		IO_Read_Context_Free(context);
+}
+
+/**
+ * Routine to set the longest message body the read routines will accept. A length prefix larger than this is
+ * treated as an error, so a corrupt or hostile peer cannot make the reader allocate huge amounts of memory.
+ * @param max_message_length The maximum message length in bytes. If this is zero, the default
+ * 	ESTAR_IO_DEFAULT_MAX_MESSAGE_LENGTH is used. It cannot be more than ESTAR_IO_FRAME_LENGTH_MASK,
+ * 	as the top bits of the length prefix are used for the frame flags.
+ * @see #IO_Max_Message_Length
+ * @see #eSTAR_IO_Get_Max_Message_Length
+ */
+void eSTAR_IO_Set_Max_Message_Length(size_t max_message_length)
+{
+	if(max_message_length == 0)
+		max_message_length = ESTAR_IO_DEFAULT_MAX_MESSAGE_LENGTH;
+	if(max_message_length > ESTAR_IO_FRAME_LENGTH_MASK)
+		max_message_length = ESTAR_IO_FRAME_LENGTH_MASK;
+	IO_Max_Message_Length = max_message_length;
+}
+
+/**
+ * Routine to get the longest message body the read routines will accept.
+ * @return The maximum message length in bytes.
+ * @see #IO_Max_Message_Length
+ * @see #eSTAR_IO_Set_Max_Message_Length
+ */
+size_t eSTAR_IO_Get_Max_Message_Length(void)
+{
+	return IO_Max_Message_Length;
+}
+
+/**
+ * Routine to negotiate message compression with the peer of a newly opened connection. A control frame offering
+ * the codecs this library was built with is sent, and the peer answers with the codec it chose, which is stored
+ * in the handle. From then on both ends compress messages of at least the compression threshold with that
+ * codec. Messages below the threshold, or that do not get smaller, are still sent as plain frames.
+ * This should be called by the client, before any messages have been exchanged. Handles that have not
+ * negotiated compression only ever send plain frames, so they can talk to peers built before compression was
+ * added. Such a peer cannot answer the offer, and closes the connection, so only negotiate with peers known
+ * to support it.
+ * @param handle The address of a handle opened by an Open_Client call.
+ * @return The routine returns GLOBUS_TRUE if the negotiation succeeded, and GLOBUS_FALSE
+ * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
+ * 	if something failed. Success does not mean compression is in use: the handle's Compression is
+ * 	ESTAR_IO_COMPRESSION_NONE if the two ends have no codec in common.
+ * @see #eSTAR_IO_Set_Compression_Threshold
+ * @see #IO_Control_Frame
+ * @see #ESTAR_IO_CONTROL_OFFER
+ */
+int eSTAR_IO_Negotiate_Compression(eSTAR_IO_Handle_T *handle)
+{
+	struct IO_Read_Context_Struct *context = NULL;
+	char *frame = NULL;
+	char *error_string = NULL;
+	size_t frame_length;
+	unsigned int flags;
+	int codec_mask;
+
+	if(handle == GLOBUS_NULL)
 	{
-		globus_error = globus_error_get(result);
-		error_string = globus_object_printable_to_string(globus_error);
-		eSTAR_IO_Error_Number = 7;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Message:read error(%d,%s).",
-			bytes_read,error_string);
+		eSTAR_IO_Error_Number = 99;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Negotiate_Compression:handle was NULL.");
 		return GLOBUS_FALSE;
 	}
-/* convert to integer */
-	memcpy(&message_length,message_length_buffer,ESTAR_IO_MESSAGE_SIZE_LENGTH);
-	message_length = ntohl(message_length);
-	if(message_length < 1)
+	handle->Compression = ESTAR_IO_COMPRESSION_NONE;
+/* nothing to offer, the peer will never send compressed messages unless asked to */
+	codec_mask = IO_Compression_Mask();
+	if(codec_mask == 0)
+		return GLOBUS_TRUE;
+	if(!IO_Write_Control(handle,ESTAR_IO_CONTROL_OFFER,codec_mask,&error_string))
+	{
+		eSTAR_IO_Error_Number = 100;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Negotiate_Compression:write error(%s).",error_string);
+		return GLOBUS_FALSE;
+	}
+	if(!IO_Read_Context_Get(handle,&context))
+		return GLOBUS_FALSE;
+	if(!IO_Read_Context_Frame(context,handle,GLOBUS_TRUE,&flags,&frame,&frame_length))
+		return GLOBUS_FALSE;
+	if(((flags & ESTAR_IO_FRAME_CONTROL) == 0)||(((unsigned char *)frame)[0] != ESTAR_IO_CONTROL_ACCEPT))
+	{
+		eSTAR_IO_Error_Number = 101;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Negotiate_Compression:peer did not answer the offer(%#x,%d).",
+			flags,(int)frame_length);
+		return GLOBUS_FALSE;
+	}
+	return IO_Control_Frame(handle,(unsigned char *)frame,frame_length,NULL);
+}
+
+/**
+ * Routine to set the message length at or above which messages are compressed, on handles that have negotiated
+ * compression.
+ * @param compression_threshold The threshold in bytes. If this is zero, the default
+ * 	ESTAR_IO_DEFAULT_COMPRESSION_THRESHOLD is used.
+ * @see #IO_Compression_Threshold
+ * @see #eSTAR_IO_Negotiate_Compression
+ */
+void eSTAR_IO_Set_Compression_Threshold(size_t compression_threshold)
+{
+	if(compression_threshold == 0)
+		compression_threshold = ESTAR_IO_DEFAULT_COMPRESSION_THRESHOLD;
+	IO_Compression_Threshold = compression_threshold;
+}
+
+/**
+ * Routine to get the message length at or above which messages are compressed.
+ * @return The compression threshold in bytes.
+ * @see #IO_Compression_Threshold
+ * @see #eSTAR_IO_Set_Compression_Threshold
+ */
+size_t eSTAR_IO_Get_Compression_Threshold(void)
+{
+	return IO_Compression_Threshold;
+}
+
+/**
+ * Routine to write several messages to a stream represented by handle, with as few system calls as
+ * possible. Each message is prepended with ESTAR_IO_MESSAGE_SIZE_LENGTH bytes giving it's length, exactly as
+ * eSTAR_IO_Write_Message or eSTAR_IO_Write_Binary_Message would send it, but the framed messages are sent
+ * together with one transport write, up to ESTAR_IO_WRITE_BATCH_COUNT messages per call. The messages are not copied,
+ * unless the handle has negotiated compression, when those at or above the compression threshold are compressed.
+ * eSTAR_IO_Read_Message or eSTAR_IO_Read_Messages will read messages sent with this routine.
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
+ * 	call being made.
+ * @param message_list A list of message_count pointers to the messages to send, none of which should be NULL.
+ * @param message_length_list A list of message_count lengths, in bytes, of the messages in message_list.
+ * 	If this is NULL, the messages are assumed to be NULL terminated character strings.
+ * 	No message can be empty. The list is checked before anything is sent, so a bad message fails the
+ * 	whole call rather than leaving the peer with part of it.
+ * @param message_count The number of messages to send.
+ * @return The routine returns GLOBUS_TRUE if the messages were sent successfully, and GLOBUS_FALSE
+ * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
+ * 	if something failed.
+ * @see #eSTAR_IO_Write_Message
+ * @see #eSTAR_IO_Read_Messages
+ * @see #ESTAR_IO_WRITE_BATCH_COUNT
+ * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
+ */
+int eSTAR_IO_Write_Messages(eSTAR_IO_Handle_T *handle,char **message_list,size_t *message_length_list,
+	int message_count)
+{
+	struct iovec *iovec_list = NULL;
+	unsigned int *network_message_length_list = NULL;
+	char **frame_list = NULL;
+	size_t *frame_allocated_length_list = NULL;
+	char *scratch = NULL;
+	globus_size_t bytes_written;
+	char *error_string = NULL;
+	size_t message_length,frame_length,scratch_allocated_length;
+	int message_index,batch_count,frame_count,scratch_count,i;
+	int failed = GLOBUS_FALSE;
+
+	if(handle == GLOBUS_NULL)
+	{
+		eSTAR_IO_Error_Number = 58;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:handle was NULL.");
+		return GLOBUS_FALSE;
+	}
+	if(message_list == GLOBUS_NULL)
+	{
+		eSTAR_IO_Error_Number = 59;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:message list was NULL.");
+		return GLOBUS_FALSE;
+	}
+/* check every message before any are sent, the reader rejects an empty frame and the connection is lost */
+	for(i = 0; i < message_count; i++)
+	{
+		if(message_list[i] == GLOBUS_NULL)
+		{
+			eSTAR_IO_Error_Number = 60;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:message %d was NULL.",i);
+			return GLOBUS_FALSE;
+		}
+		if(message_length_list != GLOBUS_NULL)
+			message_length = message_length_list[i];
+		else
+			message_length = strlen(message_list[i]);
+		if(message_length < 1)
+		{
+			eSTAR_IO_Error_Number = 103;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:message %d was empty.",i);
+			return GLOBUS_FALSE;
+		}
+		if(message_length > ESTAR_IO_FRAME_LENGTH_MASK)
+		{
+			eSTAR_IO_Error_Number = 102;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:message %d too long(%lu).",
+				i,(unsigned long)message_length);
+			return GLOBUS_FALSE;
+		}
+	}
+	if(message_count < 1)
+		return GLOBUS_TRUE;
+/* the iovec and length lists for a batch are too big for a thread's stack, so they share one pool buffer */
+	scratch_count = message_count;
+	if(scratch_count > ESTAR_IO_WRITE_BATCH_COUNT)
+		scratch_count = ESTAR_IO_WRITE_BATCH_COUNT;
+	scratch = IO_Buffer_Pool_Get(scratch_count*((2*sizeof(struct iovec))+sizeof(char *)+sizeof(size_t)+
+		sizeof(unsigned int)),&scratch_allocated_length);
+	if(scratch == NULL)
 	{
-		eSTAR_IO_Error_Number = 8;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Message:message length error(%d).",
-			message_length);
+		eSTAR_IO_Error_Number = 106;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:memory allocation error(%d).",scratch_count);
 		return GLOBUS_FALSE;
 	}
+	iovec_list = (struct iovec *)scratch;
+	frame_list = (char **)(iovec_list+(2*scratch_count));
+	frame_allocated_length_list = (size_t *)(frame_list+scratch_count);
+	network_message_length_list = (unsigned int *)(frame_allocated_length_list+scratch_count);
+	for(message_index = 0; (message_index < message_count)&&(!failed); message_index += batch_count)
+	{
+		batch_count = message_count-message_index;
+		if(batch_count > ESTAR_IO_WRITE_BATCH_COUNT)
+			batch_count = ESTAR_IO_WRITE_BATCH_COUNT;
+		frame_count = 0;
+		for(i = 0; i < batch_count; i++)
+		{
+			if(message_length_list != GLOBUS_NULL)
+				message_length = message_length_list[message_index+i];
+			else
+				message_length = strlen(message_list[message_index+i]);
+			network_message_length_list[i] = htonl((unsigned int)message_length);
+			iovec_list[2*i].iov_base = (void *)&(network_message_length_list[i]);
+			iovec_list[2*i].iov_len = ESTAR_IO_MESSAGE_SIZE_LENGTH;
+			iovec_list[(2*i)+1].iov_base = message_list[message_index+i];
+			iovec_list[(2*i)+1].iov_len = message_length;
+			if((handle->Compression != ESTAR_IO_COMPRESSION_NONE)&&(message_length >= IO_Compression_Threshold)&&
+			   IO_Compress(handle->Compression,&(iovec_list[(2*i)+1]),1,message_length,&(frame_list[frame_count]),
+				   &frame_length,&(frame_allocated_length_list[frame_count])))
+			{
+				network_message_length_list[i] = htonl(((unsigned int)frame_length)|ESTAR_IO_FRAME_COMPRESSED);
+				iovec_list[(2*i)+1].iov_base = frame_list[frame_count];
+				iovec_list[(2*i)+1].iov_len = frame_length;
+				frame_count++;
+			}
+		}
 #ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("eSTAR_IO_Read_Message: message length is '%d'\n",message_length);
+		globus_libc_printf("eSTAR_IO_Write_Messages: about to send messages %d to %d.\n",
+			message_index,message_index+batch_count-1);
 #endif
-/* allocate message buffer */
-	(*message) = globus_libc_malloc((message_length+1)*sizeof(char));
-	if((*message) == NULL)
+		if(!handle->Transport->Write(handle,iovec_list,2*batch_count,&bytes_written,&error_string))
+		{
+			eSTAR_IO_Error_Number = 61;
+			sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Write_Messages:write error(%d,%d,%d,%s).",
+				message_index,batch_count,(int)bytes_written,error_string);
+			failed = GLOBUS_TRUE;
+		}
+		for(i = 0; i < frame_count; i++)
+			IO_Buffer_Pool_Put(frame_list[i],frame_allocated_length_list[i]);
+	}
+	IO_Buffer_Pool_Put(scratch,scratch_allocated_length);
+	if(failed)
+		return GLOBUS_FALSE;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to read all the messages currently available from a stream represented by handle.
+ * The routine blocks until at least one message has arrived. As much data as is available is read ahead into
+ * the handle's read context, and every complete message in it is returned. A partial message at the end of the
+ * data is left in the read context for the next read, rather than being waited for.
+ * @param handle The address of a handle opened by a connection being made to a server, or an Open_Client
+ * 	call being made.
+ * @param message_list The address of a list of character pointers, which is allocated and filled with the
+ * 	messages read. Each message is NULL terminated, but may contain binary data.
+ * 	The list should be freed with eSTAR_IO_Free_Messages.
+ * @param message_length_list The address of a list of lengths, which is allocated and filled with the length of
+ * 	each message read. This can be NULL if the lengths are not needed, otherwise it should be freed with
+ * 	<code>globus_libc_free(message_length_list);</code>
+ * @param message_count The address of an integer, which is set to the number of messages read.
+ * @return The routine returns GLOBUS_TRUE if at least one message was read successfully, and GLOBUS_FALSE
+ * 	if something failed. eSTAR_IO_Error_Number and eSTAR_IO_Error_String is filled in with the error
+ * 	if something failed, and no messages are returned.
+ * @see #eSTAR_IO_Read_Message
+ * @see #eSTAR_IO_Write_Messages
+ * @see #eSTAR_IO_Free_Messages
+ * @see #IO_Read_Messages_Add
+ * @see #IO_Read_Context_Next
+ */
+int eSTAR_IO_Read_Messages(eSTAR_IO_Handle_T *handle,char ***message_list,size_t **message_length_list,
+	int *message_count)
+{
+	struct IO_Read_Context_Struct *context = NULL;
+	char *buffered_message = NULL;
+	char *message = NULL;
+	size_t *length_list = NULL;
+	size_t message_length;
+	int allocated_count;
+	int failed = GLOBUS_FALSE;
+
+	if(handle == GLOBUS_NULL)
 	{
-		eSTAR_IO_Error_Number = 9;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Message:memory allocation error(%d).",
-			message_length);
+		eSTAR_IO_Error_Number = 62;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Messages:handle was NULL.");
 		return GLOBUS_FALSE;
 	}
-/* read actual message */
-	result = globus_io_read(handle,(*message),message_length,message_length,&bytes_read);
-	if(result != GLOBUS_SUCCESS)
+	if((message_list == GLOBUS_NULL)||(message_count == GLOBUS_NULL))
 	{
-		globus_error = globus_error_get(result);
-		globus_libc_free((*message));
-		(*message) = NULL;
-		error_string = globus_object_printable_to_string(globus_error);
-		eSTAR_IO_Error_Number = 10;
-		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Message:read error(%d,%d,%s).",
-			message_length,bytes_read,error_string);
+		eSTAR_IO_Error_Number = 63;
+		sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Messages:message list or count was NULL.");
+		return GLOBUS_FALSE;
+	}
+	(*message_list) = NULL;
+	(*message_count) = 0;
+	if(message_length_list != GLOBUS_NULL)
+		(*message_length_list) = NULL;
+	allocated_count = 0;
+	if(!IO_Read_Context_Get(handle,&context))
+		return GLOBUS_FALSE;
+/* wait for the first message, then take any others already read ahead */
+	if(!IO_Read_Context_Next(context,handle,GLOBUS_TRUE,&buffered_message,&message_length))
+		return GLOBUS_FALSE;
+	while(buffered_message != NULL)
+	{
+		if(buffered_message == context->Body)
+		{
+			message = context->Body;
+			context->Body = NULL;
+		}
+		else
+		{
+			message = globus_libc_malloc((message_length+1)*sizeof(char));
+			if(message == NULL)
+			{
+				eSTAR_IO_Error_Number = 64;
+				sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Read_Messages:memory allocation error(%d).",
+					(int)message_length);
+				failed = GLOBUS_TRUE;
+				break;
+			}
+			memcpy(message,buffered_message,message_length+1);
+		}
+		if(!IO_Read_Messages_Add(message_list,&length_list,message_count,&allocated_count,
+			message,message_length))
+		{
+			globus_libc_free(message);
+			failed = GLOBUS_TRUE;
+			break;
+		}
+		if(!IO_Read_Context_Next(context,handle,GLOBUS_FALSE,&buffered_message,&message_length))
+		{
+			failed = GLOBUS_TRUE;
+			break;
+		}
+	}
+/* if anything went wrong, the connection is out of step, so throw away what has been read */
+	if(failed)
+	{
+		eSTAR_IO_Free_Messages((*message_list),(*message_count));
+		if(length_list != NULL)
+			globus_libc_free(length_list);
+		(*message_list) = NULL;
+		(*message_count) = 0;
 		return GLOBUS_FALSE;
 	}
-/* do something with message */
-	(*message)[message_length] = '\0';
-/* Note, this next debug line is dangerous with binary data */
 #ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("eSTAR_IO_Read_Message: received '%s'\n",(*message));
+	globus_libc_printf("eSTAR_IO_Read_Messages: received %d messages.\n",(*message_count));
 #endif
+	if(message_length_list != GLOBUS_NULL)
+		(*message_length_list) = length_list;
+	else
+		globus_libc_free(length_list);
 	return GLOBUS_TRUE;
 }
 
 /**
- * Routine to print out the error to stderr.
+ * Routine to free a list of messages returned by eSTAR_IO_Read_Messages.
+ * @param message_list The list of messages to free, which can be NULL.
+ * @param message_count The number of messages in message_list.
+ * @see #eSTAR_IO_Read_Messages
+ */
+void eSTAR_IO_Free_Messages(char **message_list,int message_count)
+{
+	int i;
+
+	if(message_list == NULL)
+		return;
+	for(i = 0; i < message_count; i++)
+	{
+		if(message_list[i] != NULL)
+			globus_libc_free(message_list[i]);
+	}
+	globus_libc_free(message_list);
+}
+
+/**
+ * Routine to get the calling thread's error structure, which holds the last error set in that thread.
+ * eSTAR_IO_Error_Number and eSTAR_IO_Error_String are macros using this routine.
+ * @return The address of the calling thread's error structure. This is never NULL.
+ * @see #eSTAR_IO_Error_Struct
+ * @see #IO_Error_Key
+ */
+struct eSTAR_IO_Error_Struct *eSTAR_IO_Error_Get(void)
+{
+	struct eSTAR_IO_Error_Struct *error = NULL;
+
+	globus_thread_once(&IO_Error_Once,IO_Error_Initialise);
+	error = (struct eSTAR_IO_Error_Struct *)globus_thread_getspecific(IO_Error_Key);
+	if(error != NULL)
+		return error;
+	error = (struct eSTAR_IO_Error_Struct *)globus_libc_malloc(sizeof(struct eSTAR_IO_Error_Struct));
+	if(error == NULL)
+		return &IO_Error_Fallback;
+	error->Number = 0;
+	error->String[0] = '\0';
+	if(globus_thread_setspecific(IO_Error_Key,error) != 0)
+	{
+		globus_libc_free(error);
+		return &IO_Error_Fallback;
+	}
+	return error;
+}
+
+/**
+ * Routine to report the calling thread's last error. The error is time stamped and added to the error log,
+ * which a background thread writes to the log file (stderr by default). This routine does not wait for the
+ * log file, so it is safe to call from connection threads. If the log is full the error is dropped, and the
+ * number of dropped errors reported once there is room.
+ * @see #eSTAR_IO_Log_Flush
+ * @see #eSTAR_IO_Set_Log_File
+ * @see #IO_Log
  * @see #Get_Current_Time
- * @see #eSTAR_IO_Error_Number
- * @see #eSTAR_IO_Error_String
  */
 void eSTAR_IO_Error(void)
 {
+	struct eSTAR_IO_Error_Struct *error = NULL;
+	struct IO_Log_Slot_Struct *slot = NULL;
 	char time_string[32];
+	unsigned long position;
+	long difference;
 
+	error = eSTAR_IO_Error_Get();
+	if(error->Number == 0)
+		globus_libc_sprintf(error->String,"eSTAR_IO_Error:Internal Error:Error code was zero.");
+	globus_thread_once(&IO_Log_Once,IO_Log_Initialise);
+/* claim a slot */
+	position = IO_Log.Write_Position;
+	while(GLOBUS_TRUE)
+	{
+		slot = &(IO_Log.Slot_List[position&(ESTAR_IO_LOG_RING_LENGTH-1)]);
+		difference = (long)slot->Sequence-(long)position;
+		if(difference == 0)
+		{
+			if(__sync_bool_compare_and_swap(&(IO_Log.Write_Position),position,position+1))
+				break;
+		}
+		else if(difference < 0)
+		{
+		/* the log is full */
+			__sync_fetch_and_add(&(IO_Log.Dropped_Count),1);
+			return;
+		}
+		position = IO_Log.Write_Position;
+	}
 	Get_Current_Time(time_string,32);
-	if(eSTAR_IO_Error_Number == 0)
-		globus_libc_sprintf(eSTAR_IO_Error_String,"eSTAR_IO_Error:Internal Error:Error code was zero.\n");
-	globus_libc_fprintf(stderr,"%s Error (%d) : %s\n",time_string,eSTAR_IO_Error_Number,eSTAR_IO_Error_String);
+	snprintf(slot->Line,ESTAR_IO_LOG_LINE_LENGTH,"%s Error (%d) : %s\n",time_string,error->Number,
+		error->String);
+/* publish the line */
+	__sync_synchronize();
+	slot->Sequence = position+1;
+	if(!IO_Log.Thread_Running)
+		IO_Log_Drain();
+}
+
+/**
+ * Routine to set where the error log is written.
+ * @param log_file An open file to write errors to. If this is NULL, errors are written to stderr.
+ * @see #eSTAR_IO_Error
+ * @see #IO_Log
+ */
+void eSTAR_IO_Set_Log_File(FILE *log_file)
+{
+	globus_thread_once(&IO_Log_Once,IO_Log_Initialise);
+	globus_mutex_lock(&(IO_Log.Drain_Mutex));
+	if(log_file == NULL)
+		IO_Log.Log_File = stderr;
+	else
+		IO_Log.Log_File = log_file;
+	globus_mutex_unlock(&(IO_Log.Drain_Mutex));
+}
+
+/**
+ * Routine to write out any errors still waiting in the error log, without waiting for the log thread.
+ * This is also called when the program exits.
+ * @see #eSTAR_IO_Error
+ * @see #IO_Log_Drain
+ */
+void eSTAR_IO_Log_Flush(void)
+{
+	globus_thread_once(&IO_Log_Once,IO_Log_Initialise);
+	IO_Log_Drain();
 }
 /* ----------------------------------------------
 **	 internal function definitions 
 ** ---------------------------------------------- */
 /**
- * Connection thread routine.
- * @param user_arg The thread specific data for this thread. In this case, this is the globus_io connection handle
- * 	for this thread.
- * @see #IO_Server_Connection_Callback
- * @see #Server_State
+ * Internal routine to create the listener handle, used by the server start routines. The listener uses the
+ * transport and address set by eSTAR_IO_Set_Server_Transport.
+ * @param port The address of an integer holding the port number. If the port number is -1 and entry,
+ * 	on return it will contain a port number selected by the transport.
+ * @return The routine returns GLOBUS_TRUE on success, GLOBUS_FALSE on failure.
+ * @see #eSTAR_IO_Start_Server
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #eSTAR_IO_Set_Server_Transport
+ * @see #IO_Server_Listener_Handle
  */
-static void *IO_Server_Connection_Thread(void *user_arg)
+static int IO_Server_Listener_Create(unsigned short *port)
 {
-	globus_io_handle_t *connection_handle_ptr;
-	globus_io_handle_t connection_handle;
+	char *error_string = NULL;
 
-	connection_handle_ptr = (globus_io_handle_t*)user_arg;
-/* take a local copy of the connection handle, so we are not re-using the connection threads variable.
-** Note there is potential for problems here, so this whilst spawning the thread? */
-	connection_handle = (*connection_handle_ptr);
-/* Call the connection callback.
-** This should return GLOBUS_TRUE on exit, if the server is to keep running, 
-** and GLOBUS_FALSE if the server is to terminate. */
+	IO_Server_Listener_Handle.Transport = eSTAR_IO_Transport_Get(IO_Server_Transport);
+	IO_Server_Listener_Handle.Fd = -1;
+	IO_Server_Listener_Handle.Compression = ESTAR_IO_COMPRESSION_NONE;
 #ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("IO_Server_Connection_Thread:connection callback about to be called\n");
+	globus_libc_printf("IO_Server_Listener_Create:trying to listen on port %hu over %s\n",(*port),
+		IO_Server_Listener_Handle.Transport->Name);
 #endif
-	IO_Server_Connection_Callback(&connection_handle);
+	if(!IO_Server_Listener_Handle.Transport->Listen(IO_Server_Address,port,&IO_Server_Listener_Handle,
+		&error_string))
+	{
+		eSTAR_IO_Error_Number = 20;
+		sprintf(eSTAR_IO_Error_String,"IO_Server_Listener_Create:connect error(%hu,%s,%s).",
+			(*port),IO_Server_Listener_Handle.Transport->Name,error_string);
+		return GLOBUS_FALSE;
+	}
 #ifdef ESTAR_IO_DEBUG
-	globus_libc_printf("IO_Server_Connection_Thread:connection callback finished (Server_State=%d)\n",
-				Server_State);
+	globus_libc_printf("IO_Server_Listener_Create:listening on port %hu\n",(*port));
 #endif
-	globus_io_close(&connection_handle);
-	return NULL;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to close a connection handle the library opened, ignoring any error. The handle's read
+ * context is freed first.
+ * @param handle The address of the handle to close.
+ * @see #eSTAR_IO_Release_Handle
+ */
+static void IO_Handle_Close(eSTAR_IO_Handle_T *handle)
+{
+	char *error_string = NULL;
+
+	eSTAR_IO_Release_Handle(handle);
+	handle->Transport->Close(handle,&error_string);
+}
+
+/**
+ * Internal routine to initialise the client connection pool. This is called once, through globus_thread_once,
+ * the first time the pool is used.
+ * @see #IO_Client_Pool_Once
+ * @see #IO_Client_Pool
+ */
+static void IO_Client_Pool_Initialise(void)
+{
+	globus_mutex_init(&(IO_Client_Pool.Mutex),NULL);
+	globus_cond_init(&(IO_Client_Pool.Checkin_Cond),NULL);
+	IO_Client_Pool.Connection_List = NULL;
+	IO_Client_Pool.Max_Per_Peer = ESTAR_IO_CLIENT_POOL_DEFAULT_MAX_PER_PEER;
+	IO_Client_Pool.Idle_Timeout = ESTAR_IO_CLIENT_POOL_DEFAULT_IDLE_TIMEOUT;
+}
+
+/**
+ * Internal routine to remove connections that have been idle for longer than the idle timeout from the client
+ * connection pool. The pool's mutex must be held. The connections are not closed, but added to dead_list, so the
+ * caller can close them once it has released the mutex.
+ * @param dead_list The address of a list of connections to add the removed connections to.
+ * @see #IO_Client_Pool
+ * @see #IO_Client_Connection_Free
+ */
+static void IO_Client_Pool_Evict(struct IO_Client_Connection_Struct **dead_list)
+{
+	struct IO_Client_Connection_Struct *connection = NULL;
+	struct IO_Client_Connection_Struct **previous = NULL;
+	time_t now;
+
+	now = time(NULL);
+	previous = &(IO_Client_Pool.Connection_List);
+	while((*previous) != NULL)
+	{
+		connection = (*previous);
+		if(connection->Checked_Out||(now-connection->Last_Used <= IO_Client_Pool.Idle_Timeout))
+		{
+			previous = &(connection->Next);
+			continue;
+		}
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("IO_Client_Pool_Evict:closing idle connection to %s:%d\n",connection->Hostname,
+			connection->Port);
+#endif
+		(*previous) = connection->Next;
+		connection->Next = (*dead_list);
+		(*dead_list) = connection;
+	}
+}
+
+/**
+ * Internal routine to check an idle pooled connection is still usable, before it is re-used. As the protocol is
+ * request/reply, nothing should be waiting to be read on an idle connection. If the socket is readable the peer
+ * has either closed it or sent data nobody asked for, and either way it cannot be re-used.
+ * @param connection The connection to check.
+ * @return The routine returns GLOBUS_TRUE if the connection looks usable, GLOBUS_FALSE otherwise.
+ * @see #eSTAR_IO_Checkout_Client
+ * @see #IO_Read_Context_Buffered
+ */
+static int IO_Client_Connection_Alive(struct IO_Client_Connection_Struct *connection)
+{
+	struct pollfd poll_fd;
+
+	if(IO_Read_Context_Buffered(&(connection->Handle)) > 0)
+		return GLOBUS_FALSE;
+	poll_fd.fd = connection->Handle.Fd;
+	poll_fd.events = POLLIN;
+	poll_fd.revents = 0;
+	if(poll(&poll_fd,1,0) != 0)
+		return GLOBUS_FALSE;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to close a pooled connection and free it. The connection must already have been removed from
+ * the pool.
+ * @param connection The connection to free.
+ * @see #IO_Client_Pool
+ */
+static void IO_Client_Connection_Free(struct IO_Client_Connection_Struct *connection)
+{
+	IO_Handle_Close(&(connection->Handle));
+	globus_libc_free(connection->Hostname);
+	globus_libc_free(connection);
+}
+
+/**
+ * Connection thread routine.
+ * @param user_arg The thread specific data for this thread. In this case, this is a copy of the
+ * 	connection handle for this thread, allocated by eSTAR_IO_Start_Server. It is freed when the connection
+ * 	is closed.
+ * @see #eSTAR_IO_Start_Server
+ * @see #IO_Server_Connection_Callback
+ * @see #Server_State
+ */
+static void *IO_Server_Connection_Thread(void *user_arg)
+{
+	eSTAR_IO_Handle_T *connection_handle;
+
+	connection_handle = (eSTAR_IO_Handle_T*)user_arg;
+/* Call the connection callback.
+** This should return GLOBUS_TRUE on exit, if the server is to keep running, 
+** and GLOBUS_FALSE if the server is to terminate. */
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("IO_Server_Connection_Thread:connection callback about to be called\n");
+#endif
+	IO_Server_Connection_Callback(connection_handle);
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("IO_Server_Connection_Thread:connection callback finished (Server_State=%d)\n",
+				Server_State);
+#endif
+	IO_Handle_Close(connection_handle);
+	globus_libc_free(connection_handle);
+	return NULL;
+}
+
+/**
+ * Worker thread routine for the pool server. Takes connection handles from the pool's queue, and calls
+ * the connection callback for each one, until the server stops running.
+ * @param user_arg Not used.
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #IO_Server_Pool
+ * @see #IO_Server_Connection_Callback
+ * @see #Server_State
+ */
+static void *IO_Server_Pool_Worker_Thread(void *user_arg)
+{
+	eSTAR_IO_Handle_T connection_handle;
+
+	globus_mutex_lock(&(IO_Server_Pool.Mutex));
+	while(Server_State == IO_SERVER_STATE_RUNNING)
+	{
+		if(IO_Server_Pool.Queue_Count == 0)
+		{
+			globus_cond_wait(&(IO_Server_Pool.Not_Empty_Cond),&(IO_Server_Pool.Mutex));
+			continue;
+		}
+	/* take a copy of the handle at the head of the queue, so the slot can be re-used straight away */
+		connection_handle = IO_Server_Pool.Queue[IO_Server_Pool.Queue_Head];
+		IO_Server_Pool.Queue_Head = (IO_Server_Pool.Queue_Head+1)%IO_Server_Pool.Queue_Depth;
+		IO_Server_Pool.Queue_Count--;
+		globus_cond_signal(&(IO_Server_Pool.Not_Full_Cond));
+		globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("IO_Server_Pool_Worker_Thread:connection callback about to be called\n");
+#endif
+		IO_Server_Connection_Callback(&connection_handle);
+#ifdef ESTAR_IO_DEBUG
+		globus_libc_printf("IO_Server_Pool_Worker_Thread:connection callback finished (Server_State=%d)\n",
+				Server_State);
+#endif
+		IO_Handle_Close(&connection_handle);
+		globus_mutex_lock(&(IO_Server_Pool.Mutex));
+	}
+	IO_Server_Pool.Worker_Count--;
+	globus_cond_signal(&(IO_Server_Pool.Finished_Cond));
+	globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+	return NULL;
+}
+
+/**
+ * Internal routine to add an accepted connection to the pool server's queue. The handle is copied into the
+ * queue. If the queue is full, the pool's overflow policy decides whether to wait for a worker to free a slot,
+ * or to fail.
+ * @param connection_handle The address of the accepted connection handle.
+ * @return The routine returns GLOBUS_TRUE if the connection was queued, and GLOBUS_FALSE if it was not,
+ * 	in which case the caller should close it. eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in
+ * 	if the connection was not queued.
+ * @see #eSTAR_IO_Start_Pool_Server
+ * @see #IO_Server_Pool
+ */
+static int IO_Server_Pool_Enqueue(eSTAR_IO_Handle_T *connection_handle)
+{
+	int index;
+
+	globus_mutex_lock(&(IO_Server_Pool.Mutex));
+	if((IO_Server_Pool.Queue_Count == IO_Server_Pool.Queue_Depth)&&
+		(IO_Server_Pool.Overflow_Policy == ESTAR_IO_POOL_OVERFLOW_REJECT))
+	{
+		globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+		eSTAR_IO_Error_Number = 39;
+		sprintf(eSTAR_IO_Error_String,"IO_Server_Pool_Enqueue:queue full(%d), connection rejected.",
+			IO_Server_Pool.Queue_Depth);
+		return GLOBUS_FALSE;
+	}
+	while((IO_Server_Pool.Queue_Count == IO_Server_Pool.Queue_Depth)&&
+		(Server_State == IO_SERVER_STATE_RUNNING))
+	{
+		globus_cond_wait(&(IO_Server_Pool.Not_Full_Cond),&(IO_Server_Pool.Mutex));
+	}
+	if(Server_State != IO_SERVER_STATE_RUNNING)
+	{
+		globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+		eSTAR_IO_Error_Number = 40;
+		sprintf(eSTAR_IO_Error_String,"IO_Server_Pool_Enqueue:server stopped, connection not queued.");
+		return GLOBUS_FALSE;
+	}
+	index = (IO_Server_Pool.Queue_Head+IO_Server_Pool.Queue_Count)%IO_Server_Pool.Queue_Depth;
+	IO_Server_Pool.Queue[index] = (*connection_handle);
+	IO_Server_Pool.Queue_Count++;
+	globus_cond_signal(&(IO_Server_Pool.Not_Empty_Cond));
+	globus_mutex_unlock(&(IO_Server_Pool.Mutex));
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine run by each event server reactor. Waits for the reactor's connections (and for the first reactor,
+ * the listener) to become readable, and reads any data that has arrived, until the server stops running.
+ * Connections with a control frame waiting to be sent are waited on until they are writable instead.
+ * All the reactor's connections are then closed.
+ * @param reactor The address of the reactor to run.
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #IO_Event_Accept
+ * @see #IO_Event_Connection_Read
+ * @see #IO_Event_Connection_Flush
+ * @see #IO_Event_Connection_Close
+ * @see #Server_State
+ */
+static void IO_Event_Reactor_Run(struct IO_Event_Reactor_Struct *reactor)
+{
+	struct epoll_event event_list[ESTAR_IO_EVENT_MAX_EVENTS];
+	struct IO_Event_Connection_Struct *connection = NULL;
+	int event_count,i;
+
+	while(Server_State == IO_SERVER_STATE_RUNNING)
+	{
+		event_count = epoll_wait(reactor->Epoll_Fd,event_list,ESTAR_IO_EVENT_MAX_EVENTS,
+			ESTAR_IO_EVENT_POLL_TIMEOUT);
+		for(i = 0; (i < event_count)&&(Server_State == IO_SERVER_STATE_RUNNING); i++)
+		{
+			connection = (struct IO_Event_Connection_Struct *)(event_list[i].data.ptr);
+			if(connection == NULL)
+				IO_Event_Accept();
+			else if(connection->Control_Length > 0)
+			{
+				if(!IO_Event_Connection_Flush(reactor,connection))
+					IO_Event_Connection_Close(reactor,connection);
+			}
+			else if(!IO_Event_Connection_Read(reactor,connection))
+				IO_Event_Connection_Close(reactor,connection);
+		}
+	}
+/* close any connections still open */
+	while(reactor->Connection_List != NULL)
+		IO_Event_Connection_Close(reactor,reactor->Connection_List);
+}
+
+/**
+ * Thread routine for event server reactors other than the first.
+ * @param user_arg The address of the reactor this thread runs.
+ * @see #eSTAR_IO_Start_Event_Server
+ * @see #IO_Event_Reactor_Run
+ * @see #IO_Event_Server
+ */
+static void *IO_Event_Reactor_Thread(void *user_arg)
+{
+	IO_Event_Reactor_Run((struct IO_Event_Reactor_Struct *)user_arg);
+	globus_mutex_lock(&(IO_Event_Server.Mutex));
+	IO_Event_Server.Running_Count--;
+	globus_cond_signal(&(IO_Event_Server.Finished_Cond));
+	globus_mutex_unlock(&(IO_Event_Server.Mutex));
+	return NULL;
+}
+
+/**
+ * Internal routine called by the first event server reactor when the listener is readable.
+ * Accepts the new connection, and adds it to the next reactor in turn.
+ * @see #IO_Event_Reactor_Run
+ * @see #IO_Event_Server
+ * @see #IO_Server_Listener_Handle
+ */
+static void IO_Event_Accept(void)
+{
+	struct IO_Event_Connection_Struct *connection = NULL;
+	struct IO_Event_Reactor_Struct *reactor = NULL;
+	struct epoll_event event;
+	char *error_string = NULL;
+
+	connection = (struct IO_Event_Connection_Struct *)globus_libc_malloc(sizeof(struct IO_Event_Connection_Struct));
+	if(connection == NULL)
+	{
+		eSTAR_IO_Error_Number = 48;
+		sprintf(eSTAR_IO_Error_String,"IO_Event_Accept:memory allocation error(%d).",
+			(int)sizeof(struct IO_Event_Connection_Struct));
+		eSTAR_IO_Error();
+		return;
+	}
+	connection->Handle.Transport = IO_Server_Listener_Handle.Transport;
+	connection->Handle.Compression = ESTAR_IO_COMPRESSION_NONE;
+	if(!IO_Server_Listener_Handle.Transport->Accept(&IO_Server_Listener_Handle,&(connection->Handle),&error_string))
+	{
+		globus_libc_free(connection);
+		if(Server_State != IO_SERVER_STATE_RUNNING)
+			return;
+		eSTAR_IO_Error_Number = 49;
+		sprintf(eSTAR_IO_Error_String,"IO_Event_Accept:accept failed(%s).",error_string);
+		eSTAR_IO_Error();
+		return;
+	}
+#ifdef ESTAR_IO_DEBUG
+	globus_libc_printf("IO_Event_Accept:connection accepted\n");
+#endif
+	eSTAR_IO_Release_Handle(&(connection->Handle));
+	connection->Length_Bytes_Read = 0;
+	connection->Message = NULL;
+	connection->Message_Allocated_Length = 0;
+	connection->Message_Length = 0;
+	connection->Message_Bytes_Read = 0;
+	connection->Control_Length = 0;
+	connection->Control_Bytes_Written = 0;
+	connection->Previous = NULL;
+/* give the connection to the next reactor */
+	reactor = &(IO_Event_Server.Reactor_List[IO_Event_Server.Next_Reactor]);
+	IO_Event_Server.Next_Reactor = (IO_Event_Server.Next_Reactor+1)%IO_Event_Server.Reactor_Count;
+	globus_mutex_lock(&(reactor->Mutex));
+	connection->Next = reactor->Connection_List;
+	if(reactor->Connection_List != NULL)
+		reactor->Connection_List->Previous = connection;
+	reactor->Connection_List = connection;
+	reactor->Connection_Count++;
+	globus_mutex_unlock(&(reactor->Mutex));
+	event.events = EPOLLIN;
+	event.data.ptr = connection;
+	if(epoll_ctl(reactor->Epoll_Fd,EPOLL_CTL_ADD,connection->Handle.Fd,&event) != 0)
+	{
+		eSTAR_IO_Error_Number = 50;
+		sprintf(eSTAR_IO_Error_String,"IO_Event_Accept:epoll_ctl failed(%d).",connection->Handle.Fd);
+		eSTAR_IO_Error();
+		IO_Event_Connection_Close(reactor,connection);
+	}
+}
+
+/**
+ * Internal routine to read whatever data is available on an event server connection, without blocking.
+ * The length prefix and message body are accumulated in the connection structure, the body in a buffer from the
+ * receive buffer pool, and the message callback is called for each message completed.
+ * The transport's non-blocking read is called until it returns no data, so data already decoded by the transport
+ * (e.g. globus_io's GSI unwrapping) but not yet returned does not wait for the socket to become readable again.
+ * The answer to a compression offer is sent with IO_Event_Connection_Flush, and reading stops until it has
+ * all gone.
+ * @param reactor The address of the reactor owning the connection.
+ * @param connection The address of the connection to read from.
+ * @return The routine returns GLOBUS_TRUE if the connection is still usable, and GLOBUS_FALSE if the
+ * 	connection was closed by the client or something failed, in which case the caller should close it.
+ * @see #IO_Event_Reactor_Run
+ * @see #IO_Event_Connection_Flush
+ * @see #IO_Server_Message_Callback
+ * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
+ */
+static int IO_Event_Connection_Read(struct IO_Event_Reactor_Struct *reactor,
+	struct IO_Event_Connection_Struct *connection)
+{
+	globus_size_t bytes_read;
+	char *error_string = NULL;
+	char *message = NULL;
+	size_t decompressed_length;
+	size_t allocated_length = 0;
+	size_t message_length;
+	unsigned int network_length;
+	int answer;
+
+	while(GLOBUS_TRUE)
+	{
+		if(connection->Message == NULL)
+		{
+			if(!connection->Handle.Transport->Try_Read(&(connection->Handle),
+				connection->Length_Buffer+connection->Length_Bytes_Read,
+				ESTAR_IO_MESSAGE_SIZE_LENGTH-connection->Length_Bytes_Read,&bytes_read,&error_string))
+				return GLOBUS_FALSE;
+			if(bytes_read == 0)
+				return GLOBUS_TRUE;
+			connection->Length_Bytes_Read += bytes_read;
+			if(connection->Length_Bytes_Read < ESTAR_IO_MESSAGE_SIZE_LENGTH)
+				continue;
+		/* convert to integer, a size_t so message_length+1 cannot wrap */
+			memcpy(&network_length,connection->Length_Buffer,ESTAR_IO_MESSAGE_SIZE_LENGTH);
+			network_length = ntohl(network_length);
+			connection->Message_Flags = network_length&(~ESTAR_IO_FRAME_LENGTH_MASK);
+			message_length = (size_t)(network_length&ESTAR_IO_FRAME_LENGTH_MASK);
+			if((message_length < 1)||(message_length > IO_Max_Message_Length)||
+			   (connection->Message_Flags == (ESTAR_IO_FRAME_COMPRESSED|ESTAR_IO_FRAME_CONTROL)))
+			{
+				eSTAR_IO_Error_Number = 51;
+				sprintf(eSTAR_IO_Error_String,"IO_Event_Connection_Read:message length error(%lu,%#x,%lu).",
+					(unsigned long)message_length,connection->Message_Flags,
+					(unsigned long)IO_Max_Message_Length);
+				eSTAR_IO_Error();
+				return GLOBUS_FALSE;
+			}
+			connection->Message = IO_Buffer_Pool_Get(message_length+1,
+				&(connection->Message_Allocated_Length));
+			if(connection->Message == NULL)
+			{
+				eSTAR_IO_Error_Number = 52;
+				sprintf(eSTAR_IO_Error_String,"IO_Event_Connection_Read:memory allocation error(%lu).",
+					(unsigned long)message_length);
+				eSTAR_IO_Error();
+				return GLOBUS_FALSE;
+			}
+			connection->Message_Length = message_length;
+			connection->Message_Bytes_Read = 0;
+			connection->Length_Bytes_Read = 0;
+		}
+		else
+		{
+			if(!connection->Handle.Transport->Try_Read(&(connection->Handle),
+				(globus_byte_t *)(connection->Message+connection->Message_Bytes_Read),
+				connection->Message_Length-connection->Message_Bytes_Read,&bytes_read,&error_string))
+				return GLOBUS_FALSE;
+			if(bytes_read == 0)
+				return GLOBUS_TRUE;
+			connection->Message_Bytes_Read += bytes_read;
+			if(connection->Message_Bytes_Read < connection->Message_Length)
+				continue;
+			connection->Message[connection->Message_Length] = '\0';
+#ifdef ESTAR_IO_DEBUG
+			globus_libc_printf("IO_Event_Connection_Read:received message of length %d.\n",
+				(int)connection->Message_Length);
+#endif
+			if(connection->Message_Flags & ESTAR_IO_FRAME_CONTROL)
+			{
+				if(!IO_Control_Frame(&(connection->Handle),(unsigned char *)connection->Message,
+					connection->Message_Length,&answer))
+				{
+					eSTAR_IO_Error();
+					return GLOBUS_FALSE;
+				}
+				if(answer >= 0)
+				{
+					IO_Buffer_Pool_Put(connection->Message,connection->Message_Allocated_Length);
+					connection->Message = NULL;
+					network_length = htonl(ESTAR_IO_CONTROL_LENGTH|ESTAR_IO_FRAME_CONTROL);
+					memcpy(connection->Control_Buffer,&network_length,ESTAR_IO_MESSAGE_SIZE_LENGTH);
+					connection->Control_Buffer[ESTAR_IO_MESSAGE_SIZE_LENGTH] = ESTAR_IO_CONTROL_ACCEPT;
+					connection->Control_Buffer[ESTAR_IO_MESSAGE_SIZE_LENGTH+1] = (globus_byte_t)answer;
+					connection->Control_Length = ESTAR_IO_MESSAGE_SIZE_LENGTH+ESTAR_IO_CONTROL_LENGTH;
+					connection->Control_Bytes_Written = 0;
+					return IO_Event_Connection_Flush(reactor,connection);
+				}
+			}
+			else if(connection->Message_Flags & ESTAR_IO_FRAME_COMPRESSED)
+			{
+				if(!IO_Decompress(connection->Message,connection->Message_Length,&message,
+					&decompressed_length,&allocated_length))
+				{
+					eSTAR_IO_Error();
+					return GLOBUS_FALSE;
+				}
+				IO_Server_Message_Callback(&(connection->Handle),message,decompressed_length);
+				IO_Buffer_Pool_Put(message,allocated_length);
+			}
+			else
+			{
+				IO_Server_Message_Callback(&(connection->Handle),connection->Message,
+					connection->Message_Length);
+			}
+			IO_Buffer_Pool_Put(connection->Message,connection->Message_Allocated_Length);
+			connection->Message = NULL;
+		}
+	}
+}
+
+/**
+ * Internal routine to send what it can of the control frame waiting on an event server connection, without
+ * blocking. If it can't all be sent the connection is waited on until it is writable, and once it has all
+ * gone it is waited on until it is readable again, and anything already read by the transport is read.
+ * @param reactor The address of the reactor owning the connection.
+ * @param connection The address of the connection to write to.
+ * @return The routine returns GLOBUS_TRUE if the connection is still usable, and GLOBUS_FALSE if the write
+ * 	failed, in which case the caller should close it.
+ * @see #IO_Event_Reactor_Run
+ * @see #IO_Event_Connection_Read
+ */
+static int IO_Event_Connection_Flush(struct IO_Event_Reactor_Struct *reactor,
+	struct IO_Event_Connection_Struct *connection)
+{
+	struct epoll_event event;
+	globus_size_t bytes_written;
+	char *error_string = NULL;
+
+	while(connection->Control_Bytes_Written < connection->Control_Length)
+	{
+		if(!connection->Handle.Transport->Try_Write(&(connection->Handle),
+			connection->Control_Buffer+connection->Control_Bytes_Written,
+			connection->Control_Length-connection->Control_Bytes_Written,&bytes_written,&error_string))
+		{
+			eSTAR_IO_Error_Number = 104;
+			sprintf(eSTAR_IO_Error_String,"IO_Event_Connection_Flush:write error(%s).",error_string);
+			eSTAR_IO_Error();
+			return GLOBUS_FALSE;
+		}
+		if(bytes_written == 0)
+			break;
+		connection->Control_Bytes_Written += bytes_written;
+	}
+	event.data.ptr = connection;
+	if(connection->Control_Bytes_Written < connection->Control_Length)
+		event.events = EPOLLOUT;
+	else
+	{
+		connection->Control_Length = 0;
+		connection->Control_Bytes_Written = 0;
+		event.events = EPOLLIN;
+	}
+	if(epoll_ctl(reactor->Epoll_Fd,EPOLL_CTL_MOD,connection->Handle.Fd,&event) != 0)
+	{
+		eSTAR_IO_Error_Number = 105;
+		sprintf(eSTAR_IO_Error_String,"IO_Event_Connection_Flush:epoll_ctl failed(%d).",connection->Handle.Fd);
+		eSTAR_IO_Error();
+		return GLOBUS_FALSE;
+	}
+	if(connection->Control_Length == 0)
+		return IO_Event_Connection_Read(reactor,connection);
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to close an event server connection, remove it from its reactor, and free it.
+ * @param reactor The address of the reactor owning the connection.
+ * @param connection The address of the connection to close.
+ * @see #IO_Event_Reactor_Run
+ */
+static void IO_Event_Connection_Close(struct IO_Event_Reactor_Struct *reactor,
+	struct IO_Event_Connection_Struct *connection)
+{
+	epoll_ctl(reactor->Epoll_Fd,EPOLL_CTL_DEL,connection->Handle.Fd,NULL);
+	globus_mutex_lock(&(reactor->Mutex));
+	if(connection->Previous != NULL)
+		connection->Previous->Next = connection->Next;
+	else
+		reactor->Connection_List = connection->Next;
+	if(connection->Next != NULL)
+		connection->Next->Previous = connection->Previous;
+	reactor->Connection_Count--;
+	globus_mutex_unlock(&(reactor->Mutex));
+	IO_Handle_Close(&(connection->Handle));
+	if(connection->Message != NULL)
+		IO_Buffer_Pool_Put(connection->Message,connection->Message_Allocated_Length);
+	globus_libc_free(connection);
+}
+
+/**
+ * Internal routine to add a message to the lists being built by eSTAR_IO_Read_Messages, growing them if needed.
+ * @param message_list The address of the list of messages.
+ * @param message_length_list The address of the list of message lengths.
+ * @param message_count The address of the number of messages in the lists, which is incremented.
+ * @param allocated_count The address of the number of entries allocated in the lists.
+ * @param message The message to add.
+ * @param message_length The length of the message to add.
+ * @return The routine returns GLOBUS_TRUE if the message was added, and GLOBUS_FALSE if the lists could not
+ * 	be grown, in which case eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #eSTAR_IO_Read_Messages
+ * @see #ESTAR_IO_READ_LIST_LENGTH
+ */
+static int IO_Read_Messages_Add(char ***message_list,size_t **message_length_list,int *message_count,
+	int *allocated_count,char *message,size_t message_length)
+{
+	char **new_message_list = NULL;
+	size_t *new_message_length_list = NULL;
+	int new_allocated_count;
+
+	if((*message_count) == (*allocated_count))
+	{
+		if((*allocated_count) == 0)
+			new_allocated_count = ESTAR_IO_READ_LIST_LENGTH;
+		else
+			new_allocated_count = 2*(*allocated_count);
+		new_message_list = (char **)globus_libc_realloc((*message_list),new_allocated_count*sizeof(char *));
+		if(new_message_list == NULL)
+		{
+			eSTAR_IO_Error_Number = 70;
+			sprintf(eSTAR_IO_Error_String,"IO_Read_Messages_Add:memory allocation error(%d).",
+				new_allocated_count);
+			return GLOBUS_FALSE;
+		}
+		(*message_list) = new_message_list;
+		new_message_length_list = (size_t *)globus_libc_realloc((*message_length_list),
+			new_allocated_count*sizeof(size_t));
+		if(new_message_length_list == NULL)
+		{
+			eSTAR_IO_Error_Number = 71;
+			sprintf(eSTAR_IO_Error_String,"IO_Read_Messages_Add:memory allocation error(%d).",
+				new_allocated_count);
+			return GLOBUS_FALSE;
+		}
+		(*message_length_list) = new_message_length_list;
+		(*allocated_count) = new_allocated_count;
+	}
+	(*message_list)[(*message_count)] = message;
+	(*message_length_list)[(*message_count)] = message_length;
+	(*message_count)++;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to initialise the read context list and receive buffer pool. This is called once,
+ * through globus_thread_once, the first time either is used.
+ * @see #IO_Read_Once
+ * @see #IO_Read_Context_Mutex
+ * @see #IO_Buffer_Pool
+ */
+static void IO_Read_Initialise(void)
+{
+	int i;
+
+	globus_mutex_init(&IO_Read_Context_Mutex,NULL);
+	globus_mutex_init(&(IO_Buffer_Pool.Mutex),NULL);
+	for(i = 0; i < ESTAR_IO_BUFFER_POOL_CLASS_COUNT; i++)
+	{
+		IO_Buffer_Pool.Free_List[i] = NULL;
+		IO_Buffer_Pool.Free_Count[i] = 0;
+	}
+	IO_Buffer_Pool.Cached_Length = 0;
+}
+
+/**
+ * Internal routine to find the read context of a handle, creating it if this is the first read on the handle.
+ * @param handle The address of the handle.
+ * @param context The address of a pointer, set to the handle's read context.
+ * @return The routine returns GLOBUS_TRUE on success, and GLOBUS_FALSE if the context could not be created,
+ * 	in which case eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #IO_Read_Context_List
+ * @see #eSTAR_IO_Release_Handle
+ */
+static int IO_Read_Context_Get(eSTAR_IO_Handle_T *handle,struct IO_Read_Context_Struct **context)
+{
+	struct IO_Read_Context_Struct **new_context_list = NULL;
+	struct IO_Read_Context_Struct *new_context = NULL;
+	int new_list_length,i;
+
+	globus_thread_once(&IO_Read_Once,IO_Read_Initialise);
+	if(handle->Fd < 0)
+	{
+		eSTAR_IO_Error_Number = 76;
+		sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Get:handle has no file descriptor(%d).",handle->Fd);
+		return GLOBUS_FALSE;
+	}
+	globus_mutex_lock(&IO_Read_Context_Mutex);
+	if((handle->Fd < IO_Read_Context_List_Length)&&(IO_Read_Context_List[handle->Fd] != NULL))
+	{
+		(*context) = IO_Read_Context_List[handle->Fd];
+		globus_mutex_unlock(&IO_Read_Context_Mutex);
+		return GLOBUS_TRUE;
+	}
+	if(handle->Fd >= IO_Read_Context_List_Length)
+	{
+		new_list_length = 2*(handle->Fd+1);
+		new_context_list = (struct IO_Read_Context_Struct **)globus_libc_realloc(IO_Read_Context_List,
+			new_list_length*sizeof(struct IO_Read_Context_Struct *));
+		if(new_context_list == NULL)
+		{
+			globus_mutex_unlock(&IO_Read_Context_Mutex);
+			eSTAR_IO_Error_Number = 77;
+			sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Get:memory allocation error(%d).",
+				new_list_length);
+			return GLOBUS_FALSE;
+		}
+		for(i = IO_Read_Context_List_Length; i < new_list_length; i++)
+			new_context_list[i] = NULL;
+		IO_Read_Context_List = new_context_list;
+		IO_Read_Context_List_Length = new_list_length;
+	}
+	new_context = (struct IO_Read_Context_Struct *)globus_libc_malloc(sizeof(struct IO_Read_Context_Struct));
+	if(new_context == NULL)
+	{
+		globus_mutex_unlock(&IO_Read_Context_Mutex);
+		eSTAR_IO_Error_Number = 78;
+		sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Get:memory allocation error(%d).",handle->Fd);
+		return GLOBUS_FALSE;
+	}
+	new_context->Buffer = (globus_byte_t *)globus_libc_malloc(ESTAR_IO_READ_AHEAD_LENGTH+1);
+	if(new_context->Buffer == NULL)
+	{
+		globus_mutex_unlock(&IO_Read_Context_Mutex);
+		globus_libc_free(new_context);
+		eSTAR_IO_Error_Number = 79;
+		sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Get:memory allocation error(%d).",
+			ESTAR_IO_READ_AHEAD_LENGTH+1);
+		return GLOBUS_FALSE;
+	}
+	new_context->Fd = handle->Fd;
+	new_context->Buffer_Start = 0;
+	new_context->Buffer_End = 0;
+	new_context->Saved_Position = NULL;
+	new_context->Saved_Byte = 0;
+	new_context->Body = NULL;
+	new_context->Body_Length = 0;
+	IO_Read_Context_List[handle->Fd] = new_context;
+	globus_mutex_unlock(&IO_Read_Context_Mutex);
+	(*context) = new_context;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to get the next message from a read context.
+ * Control frames are handled as they arrive, and compressed messages are decompressed straight into a buffer
+ * from the receive buffer pool, which is kept in the context's Body until the next call.
+ * Otherwise the message is returned where IO_Read_Context_Frame read it.
+ * @param context The read context.
+ * @param handle The address of the handle the context belongs to.
+ * @param wait If GLOBUS_TRUE, block until a message has been read. If GLOBUS_FALSE, only return a message that
+ * 	has already been read ahead completely, and set message to NULL if there isn't one.
+ * @param message The address of a character pointer, set to the message, or NULL.
+ * @param message_length The address of a size_t, set to the length of the message.
+ * @return The routine returns GLOBUS_TRUE on success, and GLOBUS_FALSE if something failed, in which case
+ * 	eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #IO_Read_Context_Frame
+ * @see #IO_Control_Frame
+ * @see #IO_Decompress
+ */
+static int IO_Read_Context_Next(struct IO_Read_Context_Struct *context,eSTAR_IO_Handle_T *handle,int wait,
+	char **message,size_t *message_length)
+{
+	char *frame = NULL;
+	char *body = NULL;
+	size_t frame_length;
+	size_t body_length = 0;
+	unsigned int flags;
+
+	(*message) = NULL;
+	(*message_length) = 0;
+	while(GLOBUS_TRUE)
+	{
+		if(!IO_Read_Context_Frame(context,handle,wait,&flags,&frame,&frame_length))
+			return GLOBUS_FALSE;
+		if(frame == NULL)
+			return GLOBUS_TRUE;
+		if(flags & ESTAR_IO_FRAME_CONTROL)
+		{
+			if(!IO_Control_Frame(handle,(unsigned char *)frame,frame_length,NULL))
+				return GLOBUS_FALSE;
+			continue;
+		}
+		if(flags & ESTAR_IO_FRAME_COMPRESSED)
+		{
+			if(!IO_Decompress(frame,frame_length,&body,message_length,&body_length))
+				return GLOBUS_FALSE;
+		/* the compressed frame may itself have been read into Body */
+			if(context->Body != NULL)
+				IO_Buffer_Pool_Put(context->Body,context->Body_Length);
+			context->Body = body;
+			context->Body_Length = body_length;
+			(*message) = body;
+			return GLOBUS_TRUE;
+		}
+		(*message) = frame;
+		(*message_length) = frame_length;
+		return GLOBUS_TRUE;
+	}
+}
+
+/**
+ * Internal routine to get the next frame from a read context, with the frame flags taken out of its length prefix.
+ * A frame whose framed length fits in the read-ahead buffer is returned in place, NULL terminated by
+ * temporarily overwriting the first byte after it. A larger frame is read straight into a buffer from the
+ * receive buffer pool, which is kept in the context's Body until the next call.
+ * @param context The read context.
+ * @param handle The address of the handle the context belongs to.
+ * @param wait If GLOBUS_TRUE, block until a frame has been read. If GLOBUS_FALSE, only return a frame that
+ * 	has already been read ahead completely, and set frame to NULL if there isn't one.
+ * @param flags The address of an unsigned integer, set to the frame flags (ESTAR_IO_FRAME_COMPRESSED or
+ * 	ESTAR_IO_FRAME_CONTROL), or zero for a plain message.
+ * @param frame The address of a character pointer, set to the frame body, or NULL.
+ * @param frame_length The address of a size_t, set to the length of the frame body.
+ * @return The routine returns GLOBUS_TRUE on success, and GLOBUS_FALSE if something failed, in which case
+ * 	eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #IO_Read_Context_Next
+ * @see #IO_Read_Context_Fill
+ * @see #IO_Max_Message_Length
+ * @see #ESTAR_IO_READ_AHEAD_LENGTH
+ */
+static int IO_Read_Context_Frame(struct IO_Read_Context_Struct *context,eSTAR_IO_Handle_T *handle,int wait,
+	unsigned int *flags,char **frame,size_t *frame_length)
+{
+	globus_size_t bytes_read,bytes_available,bytes_needed;
+	char *error_string = NULL;
+	unsigned int network_length;
+	size_t length;
+
+	(*flags) = 0;
+	(*frame) = NULL;
+	(*frame_length) = 0;
+/* put back the byte the last message's NULL terminator overwrote, and give back the last large message */
+	if(context->Saved_Position != NULL)
+	{
+		(*context->Saved_Position) = context->Saved_Byte;
+		context->Saved_Position = NULL;
+	}
+	if(context->Body != NULL)
+	{
+		IO_Buffer_Pool_Put(context->Body,context->Body_Length);
+		context->Body = NULL;
+	}
+/* get the length prefix */
+	bytes_available = context->Buffer_End-context->Buffer_Start;
+	if(bytes_available < ESTAR_IO_MESSAGE_SIZE_LENGTH)
+	{
+		if(!wait)
+			return GLOBUS_TRUE;
+		if(!IO_Read_Context_Fill(context,handle,ESTAR_IO_MESSAGE_SIZE_LENGTH-bytes_available))
+			return GLOBUS_FALSE;
+		bytes_available = context->Buffer_End-context->Buffer_Start;
+	}
+/* convert to integer, a size_t so length+1 cannot wrap */
+	memcpy(&network_length,context->Buffer+context->Buffer_Start,ESTAR_IO_MESSAGE_SIZE_LENGTH);
+	network_length = ntohl(network_length);
+	(*flags) = network_length&(~ESTAR_IO_FRAME_LENGTH_MASK);
+	length = (size_t)(network_length&ESTAR_IO_FRAME_LENGTH_MASK);
+	if((length < 1)||(length > IO_Max_Message_Length)||
+	   ((*flags) == (ESTAR_IO_FRAME_COMPRESSED|ESTAR_IO_FRAME_CONTROL)))
+	{
+		eSTAR_IO_Error_Number = 72;
+		sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Frame:message length error(%lu,%#x,%lu).",
+			(unsigned long)length,(*flags),(unsigned long)IO_Max_Message_Length);
+		return GLOBUS_FALSE;
+	}
+	if(ESTAR_IO_MESSAGE_SIZE_LENGTH+length <= ESTAR_IO_READ_AHEAD_LENGTH)
+	{
+		if(bytes_available < ESTAR_IO_MESSAGE_SIZE_LENGTH+length)
+		{
+			if(!wait)
+				return GLOBUS_TRUE;
+			if(!IO_Read_Context_Fill(context,handle,ESTAR_IO_MESSAGE_SIZE_LENGTH+length-bytes_available))
+				return GLOBUS_FALSE;
+		}
+		(*frame) = (char *)(context->Buffer+context->Buffer_Start+ESTAR_IO_MESSAGE_SIZE_LENGTH);
+		context->Buffer_Start += ESTAR_IO_MESSAGE_SIZE_LENGTH+length;
+	/* the spare byte at the end of the buffer means this is always in range */
+		context->Saved_Position = context->Buffer+context->Buffer_Start;
+		context->Saved_Byte = (*context->Saved_Position);
+		(*context->Saved_Position) = '\0';
+	}
+	else
+	{
+		if(!wait)
+			return GLOBUS_TRUE;
+		context->Body = IO_Buffer_Pool_Get(length+1,&(context->Body_Length));
+		if(context->Body == NULL)
+		{
+			eSTAR_IO_Error_Number = 73;
+			sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Frame:memory allocation error(%lu).",
+				(unsigned long)length);
+			return GLOBUS_FALSE;
+		}
+	/* copy what has been read ahead, then read the rest straight into the pooled buffer */
+		bytes_available -= ESTAR_IO_MESSAGE_SIZE_LENGTH;
+		memcpy(context->Body,context->Buffer+context->Buffer_Start+ESTAR_IO_MESSAGE_SIZE_LENGTH,
+			bytes_available);
+		context->Buffer_Start = 0;
+		context->Buffer_End = 0;
+		bytes_needed = length-bytes_available;
+		if(!handle->Transport->Read(handle,(globus_byte_t *)(context->Body+bytes_available),bytes_needed,
+			bytes_needed,&bytes_read,&error_string))
+		{
+			IO_Buffer_Pool_Put(context->Body,context->Body_Length);
+			context->Body = NULL;
+			eSTAR_IO_Error_Number = 74;
+			sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Frame:read error(%lu,%d,%s).",
+				(unsigned long)length,(int)bytes_read,error_string);
+			return GLOBUS_FALSE;
+		}
+		context->Body[length] = '\0';
+		(*frame) = context->Body;
+	}
+	(*frame_length) = length;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to read more data into a read context's read-ahead buffer. Unconsumed data is first moved to
+ * the start of the buffer, then as much data as is available is read into the rest of it, waiting for at
+ * least bytes_needed bytes.
+ * @param context The read context.
+ * @param handle The address of the handle the context belongs to.
+ * @param bytes_needed The number of bytes to wait for.
+ * @return The routine returns GLOBUS_TRUE on success, and GLOBUS_FALSE if the read failed, in which case
+ * 	eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #IO_Read_Context_Next
+ */
+static int IO_Read_Context_Fill(struct IO_Read_Context_Struct *context,eSTAR_IO_Handle_T *handle,
+	globus_size_t bytes_needed)
+{
+	globus_size_t bytes_read;
+	char *error_string = NULL;
+
+	if(context->Buffer_Start > 0)
+	{
+		memmove(context->Buffer,context->Buffer+context->Buffer_Start,
+			context->Buffer_End-context->Buffer_Start);
+		context->Buffer_End -= context->Buffer_Start;
+		context->Buffer_Start = 0;
+	}
+	if(!handle->Transport->Read(handle,context->Buffer+context->Buffer_End,
+		ESTAR_IO_READ_AHEAD_LENGTH-context->Buffer_End,bytes_needed,&bytes_read,&error_string))
+	{
+		eSTAR_IO_Error_Number = 75;
+		sprintf(eSTAR_IO_Error_String,"IO_Read_Context_Fill:read error(%d,%d,%s).",
+			(int)bytes_needed,(int)bytes_read,error_string);
+		return GLOBUS_FALSE;
+	}
+	context->Buffer_End += bytes_read;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to free a read context, and the buffers it holds.
+ * @param context The read context.
+ * @see #eSTAR_IO_Release_Handle
+ */
+static void IO_Read_Context_Free(struct IO_Read_Context_Struct *context)
+{
+	if(context->Body != NULL)
+		IO_Buffer_Pool_Put(context->Body,context->Body_Length);
+	globus_libc_free(context->Buffer);
+	globus_libc_free(context);
+}
+
+/**
+ * Internal routine to get the number of bytes read ahead on a handle, but not yet returned by a read routine.
+ * @param handle The address of the handle.
+ * @return The number of bytes read ahead, which is zero if the handle has no read context.
+ * @see #IO_Client_Connection_Alive
+ */
+static globus_size_t IO_Read_Context_Buffered(eSTAR_IO_Handle_T *handle)
+{
+	struct IO_Read_Context_Struct *context = NULL;
+	globus_size_t bytes_buffered = 0;
+
+	globus_thread_once(&IO_Read_Once,IO_Read_Initialise);
+	globus_mutex_lock(&IO_Read_Context_Mutex);
+	if((handle->Fd >= 0)&&(handle->Fd < IO_Read_Context_List_Length))
+		context = IO_Read_Context_List[handle->Fd];
+	if(context != NULL)
+		bytes_buffered = context->Buffer_End-context->Buffer_Start;
+	globus_mutex_unlock(&IO_Read_Context_Mutex);
+	return bytes_buffered;
+}
+
+/**
+ * Internal routine to get a buffer from the receive buffer pool. The length is rounded up to the next size class,
+ * and a free buffer of that class is re-used if there is one. Lengths larger than the largest size class are
+ * allocated directly.
+ * @param length The number of bytes needed.
+ * @param allocated_length The address of a size_t, set to the length actually allocated, which must be passed
+ * 	to IO_Buffer_Pool_Put.
+ * @return The routine returns the buffer, or NULL if it could not be allocated.
+ * 	The buffer is allocated with globus_libc_malloc, so it can also be freed with globus_libc_free.
+ * @see #IO_Buffer_Pool_Put
+ * @see #IO_Buffer_Pool
+ */
+static char *IO_Buffer_Pool_Get(size_t length,size_t *allocated_length)
+{
+	char *buffer = NULL;
+	size_t class_length;
+	int class_index;
+
+	globus_thread_once(&IO_Read_Once,IO_Read_Initialise);
+	class_length = ESTAR_IO_BUFFER_POOL_MIN_LENGTH;
+	for(class_index = 0; class_index < ESTAR_IO_BUFFER_POOL_CLASS_COUNT; class_index++)
+	{
+		if(length <= class_length)
+			break;
+		class_length <<= 1;
+	}
+	if(class_index == ESTAR_IO_BUFFER_POOL_CLASS_COUNT)
+	{
+		(*allocated_length) = length;
+		return (char *)globus_libc_malloc(length);
+	}
+	globus_mutex_lock(&(IO_Buffer_Pool.Mutex));
+	buffer = IO_Buffer_Pool.Free_List[class_index];
+	if(buffer != NULL)
+	{
+		memcpy(&(IO_Buffer_Pool.Free_List[class_index]),buffer,sizeof(char *));
+		IO_Buffer_Pool.Free_Count[class_index]--;
+		IO_Buffer_Pool.Cached_Length -= class_length;
+	}
+	globus_mutex_unlock(&(IO_Buffer_Pool.Mutex));
+	if(buffer == NULL)
+		buffer = (char *)globus_libc_malloc(class_length);
+	(*allocated_length) = class_length;
+	return buffer;
+}
+
+/**
+ * Internal routine to give a buffer back to the receive buffer pool. The buffer is kept for re-use if its size class
+ * has room for it and the pool is not holding too much memory, otherwise it is freed.
+ * @param buffer The buffer, returned by IO_Buffer_Pool_Get.
+ * @param allocated_length The allocated length of the buffer, as returned by IO_Buffer_Pool_Get.
+ * @see #IO_Buffer_Pool_Get
+ * @see #ESTAR_IO_BUFFER_POOL_CLASS_LENGTH
+ * @see #ESTAR_IO_BUFFER_POOL_MAX_CACHED
+ */
+static void IO_Buffer_Pool_Put(char *buffer,size_t allocated_length)
+{
+	size_t class_length;
+	int class_index;
+
+	if(buffer == NULL)
+		return;
+	class_length = ESTAR_IO_BUFFER_POOL_MIN_LENGTH;
+	for(class_index = 0; class_index < ESTAR_IO_BUFFER_POOL_CLASS_COUNT; class_index++)
+	{
+		if(allocated_length == class_length)
+			break;
+		class_length <<= 1;
+	}
+	if(class_index < ESTAR_IO_BUFFER_POOL_CLASS_COUNT)
+	{
+		globus_mutex_lock(&(IO_Buffer_Pool.Mutex));
+		if((IO_Buffer_Pool.Free_Count[class_index] < ESTAR_IO_BUFFER_POOL_CLASS_LENGTH)&&
+		   (IO_Buffer_Pool.Cached_Length+class_length <= ESTAR_IO_BUFFER_POOL_MAX_CACHED))
+		{
+			memcpy(buffer,&(IO_Buffer_Pool.Free_List[class_index]),sizeof(char *));
+			IO_Buffer_Pool.Free_List[class_index] = buffer;
+			IO_Buffer_Pool.Free_Count[class_index]++;
+			IO_Buffer_Pool.Cached_Length += class_length;
+			buffer = NULL;
+		}
+		globus_mutex_unlock(&(IO_Buffer_Pool.Mutex));
+	}
+	if(buffer != NULL)
+		globus_libc_free(buffer);
+}
+
+/**
+ * Internal routine to write a message made up of several fragments, prepended with its length.
+ * The first element of iovec_list is filled in with the length prefix, and the whole list is sent with one
+ * transport write, so the message is not copied. Lists longer than ESTAR_IO_WRITE_IOV_MAX are sent with one
+ * write per ESTAR_IO_WRITE_IOV_MAX iovecs. If the handle has negotiated compression and the message
+ * is at least the compression threshold, it is compressed and sent as a compressed frame instead.
+ * @param handle The address of a handle to write to.
+ * @param iovec_list A list of iovec_count iovec structures. The first element is used for the length prefix,
+ * 	the others should point to the fragments of the message.
+ * @param iovec_count The number of elements in iovec_list, including the length prefix.
+ * @param message_length The total length of the message fragments, in bytes.
+ * @param bytes_written The address of a globus_size_t to store the number of bytes written, including the
+ * 	length prefix.
+ * @param error_string The address of a character pointer, set to a description of the error if the write failed.
+ * @return The routine returns GLOBUS_TRUE if the message was written, and GLOBUS_FALSE if the write failed.
+ * @see #eSTAR_IO_Write_Message
+ * @see #eSTAR_IO_Write_Binary_Message
+ * @see #eSTAR_IO_Write_Vector_Message
+ * @see #IO_Compress
+ * @see #ESTAR_IO_MESSAGE_SIZE_LENGTH
+ * @see #ESTAR_IO_WRITE_IOV_MAX
+ */
+static int IO_Write_Framed(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+	size_t message_length,globus_size_t *bytes_written,char **error_string)
+{
+	struct iovec compressed_iovec_list[2];
+	char *frame = NULL;
+	size_t frame_length,allocated_length;
+	unsigned int network_message_length;
+	globus_size_t group_bytes_written;
+	int retval,group_count,i;
+
+	(*bytes_written) = 0;
+/* the reader rejects an empty frame, and the connection is lost */
+	if(message_length < 1)
+	{
+		(*error_string) = "empty message";
+		return GLOBUS_FALSE;
+	}
+	if(message_length > ESTAR_IO_FRAME_LENGTH_MASK)
+	{
+		(*error_string) = "message too long";
+		return GLOBUS_FALSE;
+	}
+	if((handle->Compression != ESTAR_IO_COMPRESSION_NONE)&&(message_length >= IO_Compression_Threshold)&&
+	   IO_Compress(handle->Compression,iovec_list+1,iovec_count-1,message_length,&frame,&frame_length,
+		   &allocated_length))
+	{
+		network_message_length = htonl(((unsigned int)frame_length)|ESTAR_IO_FRAME_COMPRESSED);
+		compressed_iovec_list[0].iov_base = (void *)&network_message_length;
+		compressed_iovec_list[0].iov_len = ESTAR_IO_MESSAGE_SIZE_LENGTH;
+		compressed_iovec_list[1].iov_base = frame;
+		compressed_iovec_list[1].iov_len = frame_length;
+		retval = handle->Transport->Write(handle,compressed_iovec_list,2,bytes_written,error_string);
+		IO_Buffer_Pool_Put(frame,allocated_length);
+		return retval;
+	}
+	network_message_length = htonl((unsigned int)message_length);
+	iovec_list[0].iov_base = (void *)&network_message_length;
+	iovec_list[0].iov_len = ESTAR_IO_MESSAGE_SIZE_LENGTH;
+	for(i = 0; i < iovec_count; i += group_count)
+	{
+		group_count = iovec_count-i;
+		if(group_count > ESTAR_IO_WRITE_IOV_MAX)
+			group_count = ESTAR_IO_WRITE_IOV_MAX;
+		group_bytes_written = 0;
+		retval = handle->Transport->Write(handle,iovec_list+i,group_count,&group_bytes_written,error_string);
+		(*bytes_written) += group_bytes_written;
+		if(!retval)
+			return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to write a control frame.
+ * @param handle The address of a handle to write to.
+ * @param control_type The control frame type, ESTAR_IO_CONTROL_OFFER or ESTAR_IO_CONTROL_ACCEPT.
+ * @param control_data The data byte of the control frame.
+ * @param error_string The address of a character pointer, set to a description of the error if the write failed.
+ * @return The routine returns GLOBUS_TRUE if the frame was written, and GLOBUS_FALSE if the write failed.
+ * @see #IO_Control_Frame
+ * @see #ESTAR_IO_FRAME_CONTROL
+ */
+static int IO_Write_Control(eSTAR_IO_Handle_T *handle,int control_type,int control_data,char **error_string)
+{
+	struct iovec iovec_list[2];
+	unsigned char control[ESTAR_IO_CONTROL_LENGTH];
+	unsigned int network_message_length;
+	globus_size_t bytes_written;
+
+	network_message_length = htonl(ESTAR_IO_CONTROL_LENGTH|ESTAR_IO_FRAME_CONTROL);
+	control[0] = (unsigned char)control_type;
+	control[1] = (unsigned char)control_data;
+	iovec_list[0].iov_base = (void *)&network_message_length;
+	iovec_list[0].iov_len = ESTAR_IO_MESSAGE_SIZE_LENGTH;
+	iovec_list[1].iov_base = (void *)control;
+	iovec_list[1].iov_len = ESTAR_IO_CONTROL_LENGTH;
+	return handle->Transport->Write(handle,iovec_list,2,&bytes_written,error_string);
+}
+
+/**
+ * Internal routine to act on a control frame received on a handle. An offer is answered with the fastest codec
+ * both ends have, which is then used for messages sent on the handle. An answer sets the codec the peer chose.
+ * @param handle The address of the handle the frame was received on.
+ * @param frame The control frame body.
+ * @param frame_length The length of the control frame body.
+ * @param answer If non-NULL, the address of an integer set to the codec an offer should be answered with, or -1
+ * 	if no answer is needed. The caller then sends the answer itself, rather than the routine blocking on it.
+ * @return The routine returns GLOBUS_TRUE on success, and GLOBUS_FALSE if the frame was not understood or the
+ * 	answer could not be sent, in which case eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #eSTAR_IO_Negotiate_Compression
+ * @see #IO_Write_Control
+ */
+static int IO_Control_Frame(eSTAR_IO_Handle_T *handle,unsigned char *frame,size_t frame_length,int *answer)
+{
+	char *error_string = NULL;
+	int codec_mask;
+
+	if(answer != NULL)
+		(*answer) = -1;
+	if(frame_length != ESTAR_IO_CONTROL_LENGTH)
+	{
+		eSTAR_IO_Error_Number = 95;
+		sprintf(eSTAR_IO_Error_String,"IO_Control_Frame:control frame length error(%d).",(int)frame_length);
+		return GLOBUS_FALSE;
+	}
+	codec_mask = IO_Compression_Mask();
+	switch(frame[0])
+	{
+		case ESTAR_IO_CONTROL_OFFER:
+			codec_mask &= frame[1];
+			if(codec_mask & (1<<ESTAR_IO_COMPRESSION_LZ4))
+				handle->Compression = ESTAR_IO_COMPRESSION_LZ4;
+			else if(codec_mask & (1<<ESTAR_IO_COMPRESSION_ZLIB))
+				handle->Compression = ESTAR_IO_COMPRESSION_ZLIB;
+			else
+				handle->Compression = ESTAR_IO_COMPRESSION_NONE;
+			if(answer != NULL)
+			{
+				(*answer) = handle->Compression;
+				return GLOBUS_TRUE;
+			}
+			if(!IO_Write_Control(handle,ESTAR_IO_CONTROL_ACCEPT,handle->Compression,&error_string))
+			{
+				handle->Compression = ESTAR_IO_COMPRESSION_NONE;
+				eSTAR_IO_Error_Number = 98;
+				sprintf(eSTAR_IO_Error_String,"IO_Control_Frame:write error(%s).",error_string);
+				return GLOBUS_FALSE;
+			}
+			return GLOBUS_TRUE;
+		case ESTAR_IO_CONTROL_ACCEPT:
+			if((frame[1] != ESTAR_IO_COMPRESSION_NONE)&&((frame[1] > ESTAR_IO_COMPRESSION_LZ4)||
+			   ((codec_mask & (1<<frame[1])) == 0)))
+			{
+				eSTAR_IO_Error_Number = 97;
+				sprintf(eSTAR_IO_Error_String,"IO_Control_Frame:peer chose a codec not offered(%d).",
+					frame[1]);
+				return GLOBUS_FALSE;
+			}
+			handle->Compression = (enum ESTAR_IO_COMPRESSION)frame[1];
+			return GLOBUS_TRUE;
+		default:
+			eSTAR_IO_Error_Number = 96;
+			sprintf(eSTAR_IO_Error_String,"IO_Control_Frame:unknown control type(%d).",frame[0]);
+			return GLOBUS_FALSE;
+	}
+}
+
+/**
+ * Internal routine to get the codecs this library was built with.
+ * @return A mask with bit (1&lt;&lt;codec) set for each codec available.
+ * @see #ESTAR_IO_CONTROL_OFFER
+ */
+static int IO_Compression_Mask(void)
+{
+	int codec_mask = 0;
+
+#ifdef ESTAR_IO_ZLIB
+	codec_mask |= (1<<ESTAR_IO_COMPRESSION_ZLIB);
+#endif
+#ifdef ESTAR_IO_LZ4
+	codec_mask |= (1<<ESTAR_IO_COMPRESSION_LZ4);
+#endif
+	return codec_mask;
+}
+
+/**
+ * Internal routine to compress a message into a compressed frame body. Fragmented messages are gathered into
+ * one buffer first. Compression is an optimisation, so if anything fails, or the frame would be no smaller than
+ * the message, the routine returns GLOBUS_FALSE and the message should be sent as a plain frame.
+ * @param codec The codec to compress with.
+ * @param fragment_list A list of fragment_count iovec structures, each pointing to a fragment of the message.
+ * @param fragment_count The number of fragments in fragment_list.
+ * @param message_length The total length of the message fragments, in bytes.
+ * @param frame The address of a character pointer, set to a buffer from the receive buffer pool holding the
+ * 	compressed frame body, which should be given back with IO_Buffer_Pool_Put.
+ * @param frame_length The address of a size_t, set to the length of the compressed frame body.
+ * @param allocated_length The address of a size_t, set to the allocated length of the frame buffer.
+ * @return The routine returns GLOBUS_TRUE if the message was compressed, and GLOBUS_FALSE if it was not.
+ * @see #IO_Decompress
+ * @see #ESTAR_IO_COMPRESSED_HEADER_LENGTH
+ */
+static int IO_Compress(enum ESTAR_IO_COMPRESSION codec,struct iovec *fragment_list,int fragment_count,
+	size_t message_length,char **frame,size_t *frame_length,size_t *allocated_length)
+{
+#if defined(ESTAR_IO_ZLIB)||defined(ESTAR_IO_LZ4)
+	char *source = NULL;
+	char *gather_buffer = NULL;
+	size_t gather_allocated_length = 0,bound_length,compressed_length,offset;
+	unsigned int network_message_length;
+	int i;
+
+	(*frame) = NULL;
+	(*frame_length) = 0;
+	switch(codec)
+	{
+#ifdef ESTAR_IO_ZLIB
+		case ESTAR_IO_COMPRESSION_ZLIB:
+			bound_length = compressBound((uLong)message_length);
+			break;
+#endif
+#ifdef ESTAR_IO_LZ4
+		case ESTAR_IO_COMPRESSION_LZ4:
+			bound_length = LZ4_compressBound((int)message_length);
+			break;
+#endif
+		default:
+			return GLOBUS_FALSE;
+	}
+	if(fragment_count == 1)
+		source = fragment_list[0].iov_base;
+	else
+	{
+		gather_buffer = IO_Buffer_Pool_Get(message_length,&gather_allocated_length);
+		if(gather_buffer == NULL)
+			return GLOBUS_FALSE;
+		offset = 0;
+		for(i = 0; i < fragment_count; i++)
+		{
+			memcpy(gather_buffer+offset,fragment_list[i].iov_base,fragment_list[i].iov_len);
+			offset += fragment_list[i].iov_len;
+		}
+		source = gather_buffer;
+	}
+	(*frame) = IO_Buffer_Pool_Get(ESTAR_IO_COMPRESSED_HEADER_LENGTH+bound_length,allocated_length);
+	if((*frame) == NULL)
+	{
+		IO_Buffer_Pool_Put(gather_buffer,gather_allocated_length);
+		return GLOBUS_FALSE;
+	}
+	compressed_length = 0;
+	switch(codec)
+	{
+#ifdef ESTAR_IO_ZLIB
+		case ESTAR_IO_COMPRESSION_ZLIB:
+		{
+			uLongf zlib_length = (uLongf)bound_length;
+
+			if(compress2((Bytef *)((*frame)+ESTAR_IO_COMPRESSED_HEADER_LENGTH),&zlib_length,(Bytef *)source,
+				(uLong)message_length,Z_BEST_SPEED) == Z_OK)
+				compressed_length = zlib_length;
+			break;
+		}
+#endif
+#ifdef ESTAR_IO_LZ4
+		case ESTAR_IO_COMPRESSION_LZ4:
+		{
+			int lz4_length;
+
+			lz4_length = LZ4_compress_default(source,(*frame)+ESTAR_IO_COMPRESSED_HEADER_LENGTH,
+				(int)message_length,(int)bound_length);
+			if(lz4_length > 0)
+				compressed_length = lz4_length;
+			break;
+		}
+#endif
+		default:
+			break;
+	}
+	IO_Buffer_Pool_Put(gather_buffer,gather_allocated_length);
+	if((compressed_length == 0)||(ESTAR_IO_COMPRESSED_HEADER_LENGTH+compressed_length >= message_length))
+	{
+		IO_Buffer_Pool_Put((*frame),(*allocated_length));
+		(*frame) = NULL;
+		return GLOBUS_FALSE;
+	}
+	(*frame)[0] = (char)codec;
+	network_message_length = htonl((unsigned int)message_length);
+	memcpy((*frame)+1,&network_message_length,ESTAR_IO_MESSAGE_SIZE_LENGTH);
+	(*frame_length) = ESTAR_IO_COMPRESSED_HEADER_LENGTH+compressed_length;
+	return GLOBUS_TRUE;
+#else
+	(*frame) = NULL;
+	(*frame_length) = 0;
+	return GLOBUS_FALSE;
+#endif
+}
+
+/**
+ * Internal routine to decompress a compressed frame body. The message is decompressed straight into a buffer
+ * from the receive buffer pool, which is NULL terminated like any other message.
+ * @param frame The compressed frame body.
+ * @param frame_length The length of the compressed frame body.
+ * @param message The address of a character pointer, set to the pooled buffer holding the message.
+ * 	It should be given back with IO_Buffer_Pool_Put.
+ * @param message_length The address of a size_t, set to the length of the message.
+ * @param allocated_length The address of a size_t, set to the allocated length of the message buffer.
+ * @return The routine returns GLOBUS_TRUE on success, and GLOBUS_FALSE if something failed, in which case
+ * 	eSTAR_IO_Error_Number and eSTAR_IO_Error_String are filled in.
+ * @see #IO_Compress
+ * @see #IO_Max_Message_Length
+ */
+static int IO_Decompress(char *frame,size_t frame_length,char **message,size_t *message_length,
+	size_t *allocated_length)
+{
+	unsigned int length;
+	int codec;
+	int decompressed = GLOBUS_FALSE;
+
+	(*message) = NULL;
+	(*message_length) = 0;
+	if(frame_length <= ESTAR_IO_COMPRESSED_HEADER_LENGTH)
+	{
+		eSTAR_IO_Error_Number = 90;
+		sprintf(eSTAR_IO_Error_String,"IO_Decompress:compressed frame too short(%d).",(int)frame_length);
+		return GLOBUS_FALSE;
+	}
+	codec = (unsigned char)frame[0];
+	if((codec > ESTAR_IO_COMPRESSION_LZ4)||(((1<<codec)&IO_Compression_Mask()) == 0))
+	{
+		eSTAR_IO_Error_Number = 91;
+		sprintf(eSTAR_IO_Error_String,"IO_Decompress:codec not available(%d).",codec);
+		return GLOBUS_FALSE;
+	}
+	memcpy(&length,frame+1,ESTAR_IO_MESSAGE_SIZE_LENGTH);
+	length = ntohl(length);
+	if((length < 1)||(length > IO_Max_Message_Length))
+	{
+		eSTAR_IO_Error_Number = 92;
+		sprintf(eSTAR_IO_Error_String,"IO_Decompress:message length error(%u,%lu).",
+			length,(unsigned long)IO_Max_Message_Length);
+		return GLOBUS_FALSE;
+	}
+	(*message) = IO_Buffer_Pool_Get(length+1,allocated_length);
+	if((*message) == NULL)
+	{
+		eSTAR_IO_Error_Number = 93;
+		sprintf(eSTAR_IO_Error_String,"IO_Decompress:memory allocation error(%u).",length);
+		return GLOBUS_FALSE;
+	}
+	frame += ESTAR_IO_COMPRESSED_HEADER_LENGTH;
+	frame_length -= ESTAR_IO_COMPRESSED_HEADER_LENGTH;
+	switch(codec)
+	{
+#ifdef ESTAR_IO_ZLIB
+		case ESTAR_IO_COMPRESSION_ZLIB:
+		{
+			uLongf zlib_length = (uLongf)length;
+
+			decompressed = ((uncompress((Bytef *)(*message),&zlib_length,(Bytef *)frame,
+				(uLong)frame_length) == Z_OK)&&(zlib_length == length));
+			break;
+		}
+#endif
+#ifdef ESTAR_IO_LZ4
+		case ESTAR_IO_COMPRESSION_LZ4:
+			decompressed = (LZ4_decompress_safe(frame,(*message),(int)frame_length,(int)length) ==
+				(int)length);
+			break;
+#endif
+		default:
+			break;
+	}
+	if(!decompressed)
+	{
+		IO_Buffer_Pool_Put((*message),(*allocated_length));
+		(*message) = NULL;
+		eSTAR_IO_Error_Number = 94;
+		sprintf(eSTAR_IO_Error_String,"IO_Decompress:decompression failed(%d,%d,%u).",codec,
+			(int)frame_length,length);
+		return GLOBUS_FALSE;
+	}
+	(*message)[length] = '\0';
+	(*message_length) = length;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Internal routine to create the thread specific error key. This is called once, through globus_thread_once,
+ * the first time an error is set or read. Each thread's error structure is freed when the thread exits.
+ * @see #IO_Error_Once
+ * @see #IO_Error_Key
+ */
+static void IO_Error_Initialise(void)
+{
+	globus_thread_key_create(&IO_Error_Key,globus_libc_free);
+	IO_Error_Fallback.Number = 0;
+	IO_Error_Fallback.String[0] = '\0';
+}
+
+/**
+ * Internal routine to initialise the error log, and start the log thread. This is called once, through
+ * globus_thread_once, the first time an error is reported. If the log thread cannot be started, errors are
+ * written out by the threads reporting them instead.
+ * @see #IO_Log_Once
+ * @see #IO_Log
+ * @see #IO_Log_Thread
+ */
+static void IO_Log_Initialise(void)
+{
+	globus_thread_t new_thread;
+	unsigned long i;
+
+	for(i = 0; i < ESTAR_IO_LOG_RING_LENGTH; i++)
+		IO_Log.Slot_List[i].Sequence = i;
+	IO_Log.Write_Position = 0;
+	IO_Log.Read_Position = 0;
+	IO_Log.Dropped_Count = 0;
+	IO_Log.Log_File = stderr;
+	globus_mutex_init(&(IO_Log.Drain_Mutex),NULL);
+	IO_Log.Thread_Running = (globus_thread_create(&new_thread,NULL,IO_Log_Thread,NULL) == 0);
+	atexit(IO_Log_Exit);
+}
+
+/**
+ * Error log thread routine. Writes out lines as they are added to the error log, sleeping for
+ * ESTAR_IO_LOG_POLL_INTERVAL milliseconds whenever it is empty. The thread runs until the program exits.
+ * @param user_arg Not used.
+ * @see #IO_Log_Drain
+ * @see #ESTAR_IO_LOG_POLL_INTERVAL
+ */
+static void *IO_Log_Thread(void *user_arg)
+{
+	struct timespec sleep_time;
+
+	while(GLOBUS_TRUE)
+	{
+		if(IO_Log_Drain() == 0)
+		{
+			sleep_time.tv_sec = 0;
+			sleep_time.tv_nsec = ESTAR_IO_LOG_POLL_INTERVAL*1000000L;
+			nanosleep(&sleep_time,NULL);
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Internal routine to write out all the lines currently in the error log, and the number of lines dropped
+ * because it was full, if any.
+ * @return The number of lines written.
+ * @see #IO_Log
+ */
+static int IO_Log_Drain(void)
+{
+	struct IO_Log_Slot_Struct *slot = NULL;
+	unsigned long dropped_count;
+	int line_count = 0;
+
+	globus_mutex_lock(&(IO_Log.Drain_Mutex));
+	while(GLOBUS_TRUE)
+	{
+		slot = &(IO_Log.Slot_List[IO_Log.Read_Position&(ESTAR_IO_LOG_RING_LENGTH-1)]);
+		if(slot->Sequence != IO_Log.Read_Position+1)
+			break;
+		__sync_synchronize();
+		fputs(slot->Line,IO_Log.Log_File);
+		__sync_synchronize();
+	/* give the slot back to the writers, for the next time round the ring */
+		slot->Sequence = IO_Log.Read_Position+ESTAR_IO_LOG_RING_LENGTH;
+		IO_Log.Read_Position++;
+		line_count++;
+	}
+	dropped_count = __sync_fetch_and_and(&(IO_Log.Dropped_Count),0);
+	if(dropped_count > 0)
+		fprintf(IO_Log.Log_File,"eSTAR_IO_Error:%lu errors dropped as the error log was full.\n",dropped_count);
+	if((line_count > 0)||(dropped_count > 0))
+		fflush(IO_Log.Log_File);
+	globus_mutex_unlock(&(IO_Log.Drain_Mutex));
+	return line_count;
+}
+
+/**
+ * Internal routine registered with atexit, to write out any errors still in the error log when the program exits.
+ * @see #IO_Log_Drain
+ */
+static void IO_Log_Exit(void)
+{
+	IO_Log_Drain();
 }
 
 /**
@@ -697,12 +3885,11 @@ static void *IO_Server_Connection_Thread(void *user_arg)
 static void Get_Current_Time(char *time_string,int string_length)
 {
 	time_t current_time;
-	struct tm *utc_time = GLOBUS_NULL;
+	struct tm utc_time;
 
-	if(time(&current_time) > -1)
+	if((time(&current_time) > -1)&&(gmtime_r(&current_time,&utc_time) != NULL))
 	{
-		utc_time = gmtime(&current_time);
-		strftime(time_string,string_length,"%d/%m/%Y %H:%M:%S",utc_time);
+		strftime(time_string,string_length,"%d/%m/%Y %H:%M:%S",&utc_time);
 	}
 	else
 		strncpy(time_string,"Unknown time",string_length);
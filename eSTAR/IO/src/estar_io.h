@@ -3,20 +3,214 @@
  */
 #ifndef ESTAR_IO_H
 #define ESTAR_IO_H
-/* external variables */
-extern int eSTAR_IO_Error_Number;
-extern char eSTAR_IO_Error_String[];
+#include <stdio.h>
+#include <sys/uio.h>
+#ifdef ESTAR_IO_NO_GLOBUS
+#include "estar_io_compat.h"
+#else
+#include "globus_common.h"
+#include "globus_io.h"
+#endif
+
+/* hash defines */
+/**
+ * Length of the error string held for each thread.
+ * @see #eSTAR_IO_Error_Struct
+ */
+#define ESTAR_IO_ERROR_STRING_LENGTH 	(512)
+/**
+ * The default number of worker threads created by eSTAR_IO_Start_Pool_Server.
+ */
+#define ESTAR_IO_POOL_DEFAULT_SIZE		(8)
+/**
+ * The default number of accepted connections that can wait for a worker in eSTAR_IO_Start_Pool_Server.
+ */
+#define ESTAR_IO_POOL_DEFAULT_QUEUE_DEPTH	(64)
+/**
+ * The default longest message body, in bytes, the read routines will accept. See eSTAR_IO_Set_Max_Message_Length.
+ */
+#define ESTAR_IO_DEFAULT_MAX_MESSAGE_LENGTH	(128*1024*1024)
+/**
+ * The default message length, in bytes, at or above which messages sent on a handle that has negotiated
+ * compression are compressed. See eSTAR_IO_Set_Compression_Threshold.
+ */
+#define ESTAR_IO_DEFAULT_COMPRESSION_THRESHOLD	(8192)
+/**
+ * The default maximum number of connections the client connection pool holds to any one host and port.
+ */
+#define ESTAR_IO_CLIENT_POOL_DEFAULT_MAX_PER_PEER	(4)
+/**
+ * The default number of seconds a pooled client connection can be unused before it is closed.
+ */
+#define ESTAR_IO_CLIENT_POOL_DEFAULT_IDLE_TIMEOUT	(300)
+
+/* enumerations */
+/**
+ * Enumerated type describing what eSTAR_IO_Start_Pool_Server does with a new connection when
+ * its connection queue is full.
+ * <ul>
+ * <li>ESTAR_IO_POOL_OVERFLOW_BLOCK stops accepting connections until a worker frees a slot.
+ * <li>ESTAR_IO_POOL_OVERFLOW_REJECT closes the new connection immediately.
+ * </ul>
+ */
+enum ESTAR_IO_POOL_OVERFLOW
+{
+	ESTAR_IO_POOL_OVERFLOW_BLOCK=0,ESTAR_IO_POOL_OVERFLOW_REJECT=1
+};
+
+/**
+ * Enumerated type describing the concurrency model used by a server.
+ * <ul>
+ * <li>ESTAR_IO_SERVER_ENGINE_THREAD creates a thread per connection, see eSTAR_IO_Start_Server.
+ * <li>ESTAR_IO_SERVER_ENGINE_POOL uses a fixed pool of worker threads, see eSTAR_IO_Start_Pool_Server.
+ * <li>ESTAR_IO_SERVER_ENGINE_EVENT multiplexes connections over epoll reactors, and calls back once per
+ * 	message, see eSTAR_IO_Start_Event_Server.
+ * </ul>
+ */
+enum ESTAR_IO_SERVER_ENGINE
+{
+	ESTAR_IO_SERVER_ENGINE_THREAD=0,ESTAR_IO_SERVER_ENGINE_POOL=1,ESTAR_IO_SERVER_ENGINE_EVENT=2
+};
+
+/**
+ * Enumerated type describing the transport a connection is made over.
+ * <ul>
+ * <li>ESTAR_IO_TRANSPORT_GLOBUS uses GSI wrapped globus_io connections. It is not available if the library was
+ * 	built with ESTAR_IO_NO_GLOBUS.
+ * <li>ESTAR_IO_TRANSPORT_TCP uses plain TCP sockets with TCP_NODELAY set, for trusted networks.
+ * <li>ESTAR_IO_TRANSPORT_UNIX uses AF_UNIX stream sockets, for agents on the same host. The hostname is the
+ * 	path of the socket, and the port is ignored.
+ * </ul>
+ * @see #ESTAR_IO_TRANSPORT_DEFAULT
+ */
+enum ESTAR_IO_TRANSPORT
+{
+	ESTAR_IO_TRANSPORT_GLOBUS=0,ESTAR_IO_TRANSPORT_TCP=1,ESTAR_IO_TRANSPORT_UNIX=2
+};
+
+/**
+ * Enumerated type describing the codec used to compress messages sent on a handle.
+ * <ul>
+ * <li>ESTAR_IO_COMPRESSION_NONE sends plain frames, as all handles do until compression is negotiated.
+ * <li>ESTAR_IO_COMPRESSION_ZLIB uses zlib at its fastest level. It is only available if the library was built
+ * 	with ESTAR_IO_ZLIB.
+ * <li>ESTAR_IO_COMPRESSION_LZ4 uses lz4. It is only available if the library was built with ESTAR_IO_LZ4.
+ * </ul>
+ * @see #eSTAR_IO_Negotiate_Compression
+ */
+enum ESTAR_IO_COMPRESSION
+{
+	ESTAR_IO_COMPRESSION_NONE=0,ESTAR_IO_COMPRESSION_ZLIB=1,ESTAR_IO_COMPRESSION_LZ4=2
+};
+
+/**
+ * The transport eSTAR_IO_Open_Client and the servers use unless told otherwise.
+ */
+#ifdef ESTAR_IO_NO_GLOBUS
+#define ESTAR_IO_TRANSPORT_DEFAULT	(ESTAR_IO_TRANSPORT_TCP)
+#else
+#define ESTAR_IO_TRANSPORT_DEFAULT	(ESTAR_IO_TRANSPORT_GLOBUS)
+#endif
+
+/* structures */
+/**
+ * Structure holding a connection (or listener) handle. Handles can be copied by value.
+ * <dl>
+ * <dt>Transport</dt> <dd>The operations of the transport the handle was opened with.</dd>
+ * <dt>Fd</dt> <dd>The file descriptor of the underlying socket.</dd>
+ * <dt>Globus_Handle</dt> <dd>The globus_io handle, for the Globus transport.</dd>
+ * <dt>Globus_Attr</dt> <dd>The globus_io attributes the handle was opened with, for the Globus transport.</dd>
+ * <dt>Globus_Attr_Initialised</dt> <dd>GLOBUS_TRUE if Globus_Attr belongs to this handle, and should be
+ * 	destroyed when it is closed. Accepted connections share the listener's attributes.</dd>
+ * <dt>Compression</dt> <dd>The codec negotiated with the peer, used to compress large messages sent on
+ * 	the handle.</dd>
+ * </dl>
+ */
+struct eSTAR_IO_Handle_Struct
+{
+	struct eSTAR_IO_Transport_Struct *Transport;
+	int Fd;
+	enum ESTAR_IO_COMPRESSION Compression;
+#ifndef ESTAR_IO_NO_GLOBUS
+	globus_io_handle_t Globus_Handle;
+	globus_io_attr_t Globus_Attr;
+	int Globus_Attr_Initialised;
+#endif
+};
+/**
+ * Typedef of a connection handle.
+ * @see #eSTAR_IO_Handle_Struct
+ */
+typedef struct eSTAR_IO_Handle_Struct eSTAR_IO_Handle_T;
+
+/**
+ * Structure holding the last error of one thread.
+ * <dl>
+ * <dt>Number</dt> <dd>The error number, which identifies the routine and kind of error, or zero.</dd>
+ * <dt>String</dt> <dd>A description of the error, starting with the name of the routine it occured in,
+ * 	and including its context (hostnames, lengths, the underlying system or Globus error).</dd>
+ * </dl>
+ * @see #eSTAR_IO_Error_Get
+ */
+struct eSTAR_IO_Error_Struct
+{
+	int Number;
+	char String[ESTAR_IO_ERROR_STRING_LENGTH];
+};
+
+/* error macros */
+/**
+ * The calling thread's last error number. Each thread has its own, so concurrent connection threads do not
+ * overwrite each other's errors. This can be assigned to, as the global variable it replaces could.
+ * @see #eSTAR_IO_Error_Get
+ */
+#define eSTAR_IO_Error_Number	(eSTAR_IO_Error_Get()->Number)
+/**
+ * The calling thread's last error string.
+ * @see #eSTAR_IO_Error_Get
+ */
+#define eSTAR_IO_Error_String	(eSTAR_IO_Error_Get()->String)
 
 /* external functions */
-extern int eSTAR_IO_Open_Client(char *hostname,int port,globus_io_handle_t *handle);
-extern int eSTAR_IO_Close_Client(globus_io_handle_t *handle);
+extern int eSTAR_IO_Open_Client(char *hostname,int port,eSTAR_IO_Handle_T *handle);
+extern int eSTAR_IO_Open_Transport_Client(enum ESTAR_IO_TRANSPORT transport,char *hostname,int port,
+	eSTAR_IO_Handle_T *handle);
+extern int eSTAR_IO_Close_Client(eSTAR_IO_Handle_T *handle);
+extern int eSTAR_IO_Checkout_Client(enum ESTAR_IO_TRANSPORT transport,char *hostname,int port,
+	eSTAR_IO_Handle_T **handle);
+extern int eSTAR_IO_Checkin_Client(eSTAR_IO_Handle_T *handle,int reusable);
+extern void eSTAR_IO_Configure_Client_Pool(int max_per_peer,int idle_timeout);
+extern void eSTAR_IO_Close_Client_Pool(void);
+extern int eSTAR_IO_Set_Server_Transport(enum ESTAR_IO_TRANSPORT transport,char *address);
 extern int eSTAR_IO_Start_Server(unsigned short *port,
-	void (*connection_callback)(globus_io_handle_t *connection_handle));
+	void (*connection_callback)(eSTAR_IO_Handle_T *connection_handle));
+extern int eSTAR_IO_Start_Pool_Server(unsigned short *port,
+	void (*connection_callback)(eSTAR_IO_Handle_T *connection_handle),
+	int pool_size,int queue_depth,enum ESTAR_IO_POOL_OVERFLOW overflow_policy);
+extern int eSTAR_IO_Start_Event_Server(unsigned short *port,
+	void (*message_callback)(eSTAR_IO_Handle_T *connection_handle,char *message,size_t message_length),
+	int reactor_count);
 extern int eSTAR_IO_Close_Server(void);
-extern int eSTAR_IO_Write_Message(globus_io_handle_t *handle,char *message);
-extern int eSTAR_IO_Write_Binary_Message(globus_io_handle_t *handle,void *data_buffer,size_t data_buffer_length);
-extern int eSTAR_IO_Read_Message(globus_io_handle_t *handle,char **message);
+extern int eSTAR_IO_Write_Message(eSTAR_IO_Handle_T *handle,char *message);
+extern int eSTAR_IO_Write_Binary_Message(eSTAR_IO_Handle_T *handle,void *data_buffer,size_t data_buffer_length);
+extern int eSTAR_IO_Write_Vector_Message(eSTAR_IO_Handle_T *handle,struct iovec *fragment_list,int fragment_count);
+extern int eSTAR_IO_Write_Messages(eSTAR_IO_Handle_T *handle,char **message_list,size_t *message_length_list,
+	int message_count);
+extern int eSTAR_IO_Read_Message(eSTAR_IO_Handle_T *handle,char **message);
+extern int eSTAR_IO_Read_Pooled_Message(eSTAR_IO_Handle_T *handle,char **message,size_t *message_length);
+extern void eSTAR_IO_Release_Handle(eSTAR_IO_Handle_T *handle);
+extern void eSTAR_IO_Set_Max_Message_Length(size_t max_message_length);
+extern size_t eSTAR_IO_Get_Max_Message_Length(void);
+extern int eSTAR_IO_Negotiate_Compression(eSTAR_IO_Handle_T *handle);
+extern void eSTAR_IO_Set_Compression_Threshold(size_t compression_threshold);
+extern size_t eSTAR_IO_Get_Compression_Threshold(void);
+extern int eSTAR_IO_Read_Messages(eSTAR_IO_Handle_T *handle,char ***message_list,size_t **message_length_list,
+	int *message_count);
+extern void eSTAR_IO_Free_Messages(char **message_list,int message_count);
+extern struct eSTAR_IO_Error_Struct *eSTAR_IO_Error_Get(void);
 extern void eSTAR_IO_Error(void);
+extern void eSTAR_IO_Set_Log_File(FILE *log_file);
+extern void eSTAR_IO_Log_Flush(void);
 /*
 ** $Log: estar_io.h,v $
 ** Revision 1.1  2002/03/04 23:29:22  aa
@@ -0,0 +1,712 @@
+/* eSTAR IO benchmark source file -*- mode: Fundamental;-*-
+ * $Headers$
+ */
+/**
+ * This file contains a loopback benchmark of the eSTAR IO message layer. A server is started in this process
+ * on the loopback interface, echoing every message it receives, and a number of concurrent clients send messages
+ * to it and wait for the echo. The message length is swept from the minimum to the maximum length, and for each
+ * length the messages per second, MB per second and round trip latency percentiles are printed.
+ * <pre>
+ * estar_io_bench [-clients &lt;n&gt;] [-transport globus|tcp|unix] [-engine thread|pool|event]
+ * 	[-min_length &lt;bytes&gt;] [-max_length &lt;bytes&gt;] [-factor &lt;n&gt;] [-messages &lt;n&gt;] [-bytes &lt;n&gt;]
+ * 	[-pattern random|text] [-compress] [-address &lt;path&gt;] [-json &lt;filename&gt;|-]
+ * </pre>
+ * With -json, one JSON object per message length is also written to the file (or stdout for "-"), one per line,
+ * so results can be compared between releases.
+ * @version $Revision: 1.1 $
+ */
+/**
+ * This hash define is needed before including source files give us POSIX.4/IEEE1003.1b-1993 prototypes
+ * for time.
+ */
+#define _POSIX_SOURCE 1
+/**
+ * This hash define is needed before including source files give us POSIX.4/IEEE1003.1b-1993 prototypes
+ * for time.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "estar_io.h"
+
+/* hash defines */
+/**
+ * The default number of concurrent clients.
+ */
+#define BENCH_DEFAULT_CLIENT_COUNT	(4)
+/**
+ * The default shortest message length, in bytes.
+ */
+#define BENCH_DEFAULT_MIN_LENGTH	(64)
+/**
+ * The default longest message length, in bytes.
+ */
+#define BENCH_DEFAULT_MAX_LENGTH	(64*1024*1024)
+/**
+ * The default factor the message length is multiplied by at each step of the sweep.
+ */
+#define BENCH_DEFAULT_FACTOR		(4)
+/**
+ * The default maximum number of round trips each client makes at each message length.
+ */
+#define BENCH_DEFAULT_MESSAGE_COUNT	(10000)
+/**
+ * The default maximum number of payload bytes each client sends at each message length. Long messages make
+ * fewer round trips, so the sweep finishes in reasonable time.
+ */
+#define BENCH_DEFAULT_BYTE_COUNT	(256*1024*1024)
+/**
+ * The least number of round trips each client makes at each message length, whatever the byte count.
+ */
+#define BENCH_MIN_MESSAGE_COUNT		(4)
+/**
+ * The number of times to check whether the server is listening, before giving up.
+ */
+#define BENCH_SERVER_START_RETRIES	(200)
+/**
+ * The number of milliseconds to wait between checks that the server is listening.
+ */
+#define BENCH_SERVER_START_INTERVAL	(25)
+
+/* enumerations */
+/**
+ * Enumerated type describing the payload the clients send.
+ * <ul>
+ * <li>BENCH_PATTERN_RANDOM is pseudo-random bytes, which do not compress.
+ * <li>BENCH_PATTERN_TEXT is lines of catalogue-like text, which compress well.
+ * </ul>
+ */
+enum BENCH_PATTERN
+{
+	BENCH_PATTERN_RANDOM=0,BENCH_PATTERN_TEXT=1
+};
+
+/* structures */
+/**
+ * Structure holding one benchmark client.
+ * <dl>
+ * <dt>Handle</dt> <dd>The client's connection to the server.</dd>
+ * <dt>Message_Count</dt> <dd>The number of round trips to make at the current message length.</dd>
+ * <dt>Latency_List</dt> <dd>The round trip time of each message, in seconds.</dd>
+ * <dt>Start_Time</dt> <dd>When the client started sending at the current message length.</dd>
+ * <dt>End_Time</dt> <dd>When the client received its last echo at the current message length.</dd>
+ * <dt>Failed</dt> <dd>GLOBUS_TRUE if a read or write failed, or an echo was the wrong length.</dd>
+ * </dl>
+ * @see #Bench_Client_Thread
+ */
+struct Bench_Client_Struct
+{
+	eSTAR_IO_Handle_T Handle;
+	int Message_Count;
+	double *Latency_List;
+	double Start_Time;
+	double End_Time;
+	int Failed;
+};
+
+/* internal variables */
+/**
+ * The transport the server and clients use.
+ */
+static enum ESTAR_IO_TRANSPORT Transport = ESTAR_IO_TRANSPORT_DEFAULT;
+/**
+ * The server engine the benchmark runs against.
+ */
+static enum ESTAR_IO_SERVER_ENGINE Engine = ESTAR_IO_SERVER_ENGINE_THREAD;
+/**
+ * The path of the Unix socket, for the Unix transport.
+ */
+static char Address[256] = "";
+/**
+ * The port the server is listening on, zero until it is.
+ */
+static unsigned short Port = 0;
+/**
+ * The number of concurrent clients.
+ */
+static int Client_Count = BENCH_DEFAULT_CLIENT_COUNT;
+/**
+ * The list of clients.
+ */
+static struct Bench_Client_Struct *Client_List = NULL;
+/**
+ * The payload sent by every client, Max_Length bytes long.
+ */
+static char *Payload = NULL;
+/**
+ * The length of the messages being sent at the current step of the sweep.
+ */
+static size_t Message_Length = 0;
+/**
+ * Mutex protecting Clients_Running.
+ */
+static globus_mutex_t Bench_Mutex;
+/**
+ * Condition signalled when a client finishes.
+ */
+static globus_cond_t Bench_Cond;
+/**
+ * The number of clients still running at the current message length.
+ */
+static int Clients_Running = 0;
+
+/* internal functions */
+static int Parse_Arguments(int argc,char *argv[],size_t *min_length,size_t *max_length,int *factor,
+	int *message_count,size_t *byte_count,enum BENCH_PATTERN *pattern,int *compress,char **json_filename);
+static void Help(void);
+static void *Bench_Server_Thread(void *user_arg);
+static void Bench_Connection_Callback(eSTAR_IO_Handle_T *connection_handle);
+static void Bench_Message_Callback(eSTAR_IO_Handle_T *connection_handle,char *message,size_t message_length);
+static int Bench_Server_Wait(void);
+static void *Bench_Client_Thread(void *user_arg);
+static void Bench_Payload_Fill(char *payload,size_t length,enum BENCH_PATTERN pattern);
+static int Latency_Compare(const void *a,const void *b);
+static double Percentile(double *latency_list,int count,double percentile);
+static double Bench_Time(void);
+
+/* ------------------------------------------------------------------
+** 		External functions
+** ------------------------------------------------------------------ */
+/**
+ * Main program. Parses the arguments, starts the server and connects the clients, then runs the sweep.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The program returns 0 if every round trip succeeded, and 1 otherwise.
+ */
+int main(int argc,char *argv[])
+{
+	globus_thread_t thread;
+	FILE *json_fp = NULL;
+	char *json_filename = NULL;
+	double *latency_list = NULL;
+	double start_time,end_time,elapsed_time,messages_per_second,mb_per_second;
+	size_t min_length,max_length,byte_count;
+	enum BENCH_PATTERN pattern;
+	int factor,message_count,compress,total_count,failed,i,j,k;
+
+	min_length = BENCH_DEFAULT_MIN_LENGTH;
+	max_length = BENCH_DEFAULT_MAX_LENGTH;
+	factor = BENCH_DEFAULT_FACTOR;
+	message_count = BENCH_DEFAULT_MESSAGE_COUNT;
+	byte_count = BENCH_DEFAULT_BYTE_COUNT;
+	pattern = BENCH_PATTERN_RANDOM;
+	compress = GLOBUS_FALSE;
+	sprintf(Address,"/tmp/estar_io_bench.%d",(int)getpid());
+	if(!Parse_Arguments(argc,argv,&min_length,&max_length,&factor,&message_count,&byte_count,&pattern,
+		&compress,&json_filename))
+		return 1;
+#ifndef ESTAR_IO_NO_GLOBUS
+	globus_module_activate(GLOBUS_COMMON_MODULE);
+	globus_module_activate(GLOBUS_IO_MODULE);
+#endif
+	if(max_length > eSTAR_IO_Get_Max_Message_Length())
+		eSTAR_IO_Set_Max_Message_Length(max_length);
+	if(json_filename != NULL)
+	{
+		if(strcmp(json_filename,"-") == 0)
+			json_fp = stdout;
+		else
+			json_fp = fopen(json_filename,"a");
+		if(json_fp == NULL)
+		{
+			fprintf(stderr,"estar_io_bench:failed to open %s.\n",json_filename);
+			return 1;
+		}
+	}
+	Payload = (char *)malloc(max_length);
+	Client_List = (struct Bench_Client_Struct *)calloc(Client_Count,sizeof(struct Bench_Client_Struct));
+	latency_list = (double *)malloc(Client_Count*message_count*sizeof(double));
+	if((Payload == NULL)||(Client_List == NULL)||(latency_list == NULL))
+	{
+		fprintf(stderr,"estar_io_bench:memory allocation error.\n");
+		return 1;
+	}
+	Bench_Payload_Fill(Payload,max_length,pattern);
+	for(i = 0; i < Client_Count; i++)
+	{
+		Client_List[i].Latency_List = (double *)malloc(message_count*sizeof(double));
+		if(Client_List[i].Latency_List == NULL)
+		{
+			fprintf(stderr,"estar_io_bench:memory allocation error.\n");
+			return 1;
+		}
+	}
+	globus_mutex_init(&Bench_Mutex,NULL);
+	globus_cond_init(&Bench_Cond,NULL);
+/* start the server, and connect the clients */
+	if(!eSTAR_IO_Set_Server_Transport(Transport,Address))
+	{
+		eSTAR_IO_Error();
+		eSTAR_IO_Log_Flush();
+		return 1;
+	}
+	globus_thread_create(&thread,NULL,Bench_Server_Thread,NULL);
+	if(!Bench_Server_Wait())
+	{
+		fprintf(stderr,"estar_io_bench:server did not start.\n");
+		eSTAR_IO_Log_Flush();
+		return 1;
+	}
+	for(i = 0; i < Client_Count; i++)
+	{
+		if(!eSTAR_IO_Open_Transport_Client(Transport,(Transport == ESTAR_IO_TRANSPORT_UNIX) ? Address :
+			"localhost",Port,&(Client_List[i].Handle)))
+		{
+			eSTAR_IO_Error();
+			eSTAR_IO_Log_Flush();
+			return 1;
+		}
+		if(compress && (!eSTAR_IO_Negotiate_Compression(&(Client_List[i].Handle))))
+		{
+			eSTAR_IO_Error();
+			eSTAR_IO_Log_Flush();
+			return 1;
+		}
+	}
+	fprintf(stdout,"# transport %d engine %d clients %d pattern %d compression %d\n",Transport,Engine,
+		Client_Count,pattern,Client_List[0].Handle.Compression);
+	fprintf(stdout,"# %10s %8s %12s %10s %10s %10s %10s\n","length","messages","msgs/s","MB/s","p50(us)",
+		"p99(us)","p999(us)");
+	failed = GLOBUS_FALSE;
+/* the sweep */
+	for(Message_Length = min_length; Message_Length <= max_length; Message_Length *= factor)
+	{
+		globus_mutex_lock(&Bench_Mutex);
+		Clients_Running = Client_Count;
+		globus_mutex_unlock(&Bench_Mutex);
+		for(i = 0; i < Client_Count; i++)
+		{
+			Client_List[i].Message_Count = message_count;
+			if(Message_Length*message_count > byte_count)
+				Client_List[i].Message_Count = byte_count/Message_Length;
+			if(Client_List[i].Message_Count < BENCH_MIN_MESSAGE_COUNT)
+				Client_List[i].Message_Count = BENCH_MIN_MESSAGE_COUNT;
+			if(Client_List[i].Message_Count > message_count)
+				Client_List[i].Message_Count = message_count;
+			globus_thread_create(&thread,NULL,Bench_Client_Thread,&(Client_List[i]));
+		}
+		globus_mutex_lock(&Bench_Mutex);
+		while(Clients_Running > 0)
+			globus_cond_wait(&Bench_Cond,&Bench_Mutex);
+		globus_mutex_unlock(&Bench_Mutex);
+	/* gather the results */
+		start_time = Client_List[0].Start_Time;
+		end_time = Client_List[0].End_Time;
+		total_count = 0;
+		for(i = 0; i < Client_Count; i++)
+		{
+			if(Client_List[i].Failed)
+				failed = GLOBUS_TRUE;
+			if(Client_List[i].Start_Time < start_time)
+				start_time = Client_List[i].Start_Time;
+			if(Client_List[i].End_Time > end_time)
+				end_time = Client_List[i].End_Time;
+			for(j = 0; j < Client_List[i].Message_Count; j++)
+				latency_list[total_count++] = Client_List[i].Latency_List[j];
+		}
+		if(failed)
+		{
+			eSTAR_IO_Log_Flush();
+			fprintf(stderr,"estar_io_bench:round trip failed at length %lu.\n",(unsigned long)Message_Length);
+			break;
+		}
+		qsort(latency_list,total_count,sizeof(double),Latency_Compare);
+		elapsed_time = end_time-start_time;
+		messages_per_second = ((double)total_count)/elapsed_time;
+		mb_per_second = (((double)total_count)*((double)Message_Length))/(elapsed_time*1024.0*1024.0);
+		fprintf(stdout,"  %10lu %8d %12.1f %10.2f %10.1f %10.1f %10.1f\n",(unsigned long)Message_Length,
+			total_count,messages_per_second,mb_per_second,Percentile(latency_list,total_count,0.5)*1.0e6,
+			Percentile(latency_list,total_count,0.99)*1.0e6,Percentile(latency_list,total_count,0.999)*1.0e6);
+		fflush(stdout);
+		if(json_fp != NULL)
+		{
+			fprintf(json_fp,"{\"transport\":%d,\"engine\":%d,\"clients\":%d,\"pattern\":%d,\"compression\":%d,"
+				"\"message_length\":%lu,\"messages\":%d,\"seconds\":%.6f,\"messages_per_second\":%.1f,"
+				"\"mb_per_second\":%.3f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f}\n",
+				Transport,Engine,Client_Count,pattern,Client_List[0].Handle.Compression,
+				(unsigned long)Message_Length,total_count,elapsed_time,messages_per_second,mb_per_second,
+				Percentile(latency_list,total_count,0.5)*1.0e6,Percentile(latency_list,total_count,0.99)*1.0e6,
+				Percentile(latency_list,total_count,0.999)*1.0e6);
+			fflush(json_fp);
+		}
+	/* stop before the length overflows */
+		if(Message_Length > max_length/factor)
+			break;
+	}
+/* tidy up */
+	for(k = 0; k < Client_Count; k++)
+	{
+		eSTAR_IO_Close_Client(&(Client_List[k].Handle));
+		free(Client_List[k].Latency_List);
+	}
+	eSTAR_IO_Close_Server();
+	if((json_fp != NULL)&&(json_fp != stdout))
+		fclose(json_fp);
+	free(latency_list);
+	free(Client_List);
+	free(Payload);
+	eSTAR_IO_Log_Flush();
+	return failed ? 1 : 0;
+}
+
+/* ------------------------------------------------------------------
+** 		Internal functions
+** ------------------------------------------------------------------ */
+/**
+ * Routine to parse the command line arguments.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @param min_length The address of a size_t to store the shortest message length in.
+ * @param max_length The address of a size_t to store the longest message length in.
+ * @param factor The address of an integer to store the sweep factor in.
+ * @param message_count The address of an integer to store the maximum round trips per client per length in.
+ * @param byte_count The address of a size_t to store the maximum payload bytes per client per length in.
+ * @param pattern The address of an enum to store the payload pattern in.
+ * @param compress The address of an integer, set to GLOBUS_TRUE if the clients should negotiate compression.
+ * @param json_filename The address of a character pointer, set to the JSON results filename, if any.
+ * @return The routine returns GLOBUS_TRUE if the arguments were parsed, and GLOBUS_FALSE if they were not,
+ * 	or help was asked for.
+ * @see #Help
+ */
+static int Parse_Arguments(int argc,char *argv[],size_t *min_length,size_t *max_length,int *factor,
+	int *message_count,size_t *byte_count,enum BENCH_PATTERN *pattern,int *compress,char **json_filename)
+{
+	int i;
+
+	for(i = 1; i < argc; i++)
+	{
+		if((strcmp(argv[i],"-help") == 0)||(strcmp(argv[i],"-h") == 0))
+		{
+			Help();
+			return GLOBUS_FALSE;
+		}
+		else if(strcmp(argv[i],"-compress") == 0)
+		{
+			(*compress) = GLOBUS_TRUE;
+			continue;
+		}
+		if(i+1 >= argc)
+		{
+			fprintf(stderr,"Parse_Arguments:%s requires a value.\n",argv[i]);
+			return GLOBUS_FALSE;
+		}
+		if(strcmp(argv[i],"-clients") == 0)
+			Client_Count = atoi(argv[++i]);
+		else if(strcmp(argv[i],"-transport") == 0)
+		{
+			i++;
+			if(strcmp(argv[i],"globus") == 0)
+				Transport = ESTAR_IO_TRANSPORT_GLOBUS;
+			else if(strcmp(argv[i],"tcp") == 0)
+				Transport = ESTAR_IO_TRANSPORT_TCP;
+			else if(strcmp(argv[i],"unix") == 0)
+				Transport = ESTAR_IO_TRANSPORT_UNIX;
+			else
+			{
+				fprintf(stderr,"Parse_Arguments:unknown transport %s.\n",argv[i]);
+				return GLOBUS_FALSE;
+			}
+		}
+		else if(strcmp(argv[i],"-engine") == 0)
+		{
+			i++;
+			if(strcmp(argv[i],"thread") == 0)
+				Engine = ESTAR_IO_SERVER_ENGINE_THREAD;
+			else if(strcmp(argv[i],"pool") == 0)
+				Engine = ESTAR_IO_SERVER_ENGINE_POOL;
+			else if(strcmp(argv[i],"event") == 0)
+				Engine = ESTAR_IO_SERVER_ENGINE_EVENT;
+			else
+			{
+				fprintf(stderr,"Parse_Arguments:unknown engine %s.\n",argv[i]);
+				return GLOBUS_FALSE;
+			}
+		}
+		else if(strcmp(argv[i],"-min_length") == 0)
+			(*min_length) = strtoul(argv[++i],NULL,0);
+		else if(strcmp(argv[i],"-max_length") == 0)
+			(*max_length) = strtoul(argv[++i],NULL,0);
+		else if(strcmp(argv[i],"-factor") == 0)
+			(*factor) = atoi(argv[++i]);
+		else if(strcmp(argv[i],"-messages") == 0)
+			(*message_count) = atoi(argv[++i]);
+		else if(strcmp(argv[i],"-bytes") == 0)
+			(*byte_count) = strtoul(argv[++i],NULL,0);
+		else if(strcmp(argv[i],"-pattern") == 0)
+		{
+			i++;
+			if(strcmp(argv[i],"random") == 0)
+				(*pattern) = BENCH_PATTERN_RANDOM;
+			else if(strcmp(argv[i],"text") == 0)
+				(*pattern) = BENCH_PATTERN_TEXT;
+			else
+			{
+				fprintf(stderr,"Parse_Arguments:unknown pattern %s.\n",argv[i]);
+				return GLOBUS_FALSE;
+			}
+		}
+		else if(strcmp(argv[i],"-address") == 0)
+		{
+			strncpy(Address,argv[++i],sizeof(Address)-1);
+			Address[sizeof(Address)-1] = '\0';
+		}
+		else if(strcmp(argv[i],"-json") == 0)
+			(*json_filename) = argv[++i];
+		else
+		{
+			fprintf(stderr,"Parse_Arguments:unknown argument %s.\n",argv[i]);
+			Help();
+			return GLOBUS_FALSE;
+		}
+	}
+	if((Client_Count < 1)||((*min_length) < 1)||((*max_length) < (*min_length))||((*factor) < 2)||
+	   ((*message_count) < BENCH_MIN_MESSAGE_COUNT))
+	{
+		fprintf(stderr,"Parse_Arguments:illegal clients(%d), lengths(%lu,%lu), factor(%d) or messages(%d).\n",
+			Client_Count,(unsigned long)(*min_length),(unsigned long)(*max_length),(*factor),(*message_count));
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Routine to print the program's arguments.
+ */
+static void Help(void)
+{
+	fprintf(stdout,"estar_io_bench: loopback benchmark of the eSTAR IO message layer.\n");
+	fprintf(stdout,"estar_io_bench [-clients <n>][-transport globus|tcp|unix][-engine thread|pool|event]\n");
+	fprintf(stdout,"\t[-min_length <bytes>][-max_length <bytes>][-factor <n>][-messages <n>][-bytes <n>]\n");
+	fprintf(stdout,"\t[-pattern random|text][-compress][-address <path>][-json <filename>|-]\n");
+	fprintf(stdout,"-clients is the number of concurrent clients (%d).\n",BENCH_DEFAULT_CLIENT_COUNT);
+	fprintf(stdout,"-min_length and -max_length are the message lengths swept (%d to %d),\n",
+		BENCH_DEFAULT_MIN_LENGTH,BENCH_DEFAULT_MAX_LENGTH);
+	fprintf(stdout,"\tthe length being multiplied by -factor at each step (%d).\n",BENCH_DEFAULT_FACTOR);
+	fprintf(stdout,"-messages and -bytes limit the round trips each client makes at each length (%d, %d bytes).\n",
+		BENCH_DEFAULT_MESSAGE_COUNT,BENCH_DEFAULT_BYTE_COUNT);
+	fprintf(stdout,"-compress makes the clients negotiate compression, best used with -pattern text.\n");
+	fprintf(stdout,"-address is the socket path for the unix transport.\n");
+	fprintf(stdout,"-json appends one JSON object per message length to the file, or stdout for -.\n");
+}
+
+/**
+ * Thread that runs the server. The routine returns when the server is closed.
+ * @param user_arg Not used.
+ * @return The routine returns NULL.
+ * @see #Bench_Connection_Callback
+ * @see #Bench_Message_Callback
+ */
+static void *Bench_Server_Thread(void *user_arg)
+{
+	int retval;
+
+	if(Engine == ESTAR_IO_SERVER_ENGINE_EVENT)
+		retval = eSTAR_IO_Start_Event_Server(&Port,Bench_Message_Callback,2);
+	else if(Engine == ESTAR_IO_SERVER_ENGINE_POOL)
+		retval = eSTAR_IO_Start_Pool_Server(&Port,Bench_Connection_Callback,Client_Count,
+			ESTAR_IO_POOL_DEFAULT_QUEUE_DEPTH,ESTAR_IO_POOL_OVERFLOW_BLOCK);
+	else
+		retval = eSTAR_IO_Start_Server(&Port,Bench_Connection_Callback);
+	if(!retval)
+		eSTAR_IO_Error();
+	return NULL;
+}
+
+/**
+ * Connection callback for the thread and pool servers, which echoes every message received on the connection
+ * until it is closed.
+ * @param connection_handle The address of the connection's handle.
+ */
+static void Bench_Connection_Callback(eSTAR_IO_Handle_T *connection_handle)
+{
+	char *message = NULL;
+	size_t message_length;
+
+	while(eSTAR_IO_Read_Pooled_Message(connection_handle,&message,&message_length))
+	{
+		if(!eSTAR_IO_Write_Binary_Message(connection_handle,message,message_length))
+			break;
+	}
+}
+
+/**
+ * Message callback for the event server, which echoes the message.
+ * @param connection_handle The address of the connection's handle.
+ * @param message The message.
+ * @param message_length The length of the message.
+ */
+static void Bench_Message_Callback(eSTAR_IO_Handle_T *connection_handle,char *message,size_t message_length)
+{
+	if(!eSTAR_IO_Write_Binary_Message(connection_handle,message,message_length))
+		eSTAR_IO_Error();
+}
+
+/**
+ * Routine to wait for the server to start listening.
+ * @return The routine returns GLOBUS_TRUE if the server is listening, and GLOBUS_FALSE if it did not start in time.
+ * @see #BENCH_SERVER_START_RETRIES
+ */
+static int Bench_Server_Wait(void)
+{
+	struct timespec sleep_time;
+	int i;
+
+	sleep_time.tv_sec = 0;
+	sleep_time.tv_nsec = BENCH_SERVER_START_INTERVAL*1000000;
+	for(i = 0; i < BENCH_SERVER_START_RETRIES; i++)
+	{
+		if(Transport == ESTAR_IO_TRANSPORT_UNIX)
+		{
+			if(access(Address,F_OK) == 0)
+				return GLOBUS_TRUE;
+		}
+		else if(Port != 0)
+			return GLOBUS_TRUE;
+		nanosleep(&sleep_time,NULL);
+	}
+	return GLOBUS_FALSE;
+}
+
+/**
+ * Thread that runs one client at the current message length. Each round trip writes the payload, and waits for
+ * the echo, which is read without copying.
+ * @param user_arg The address of the client's Bench_Client_Struct.
+ * @return The routine returns NULL.
+ * @see #Bench_Client_Struct
+ */
+static void *Bench_Client_Thread(void *user_arg)
+{
+	struct Bench_Client_Struct *client = (struct Bench_Client_Struct *)user_arg;
+	char *message = NULL;
+	size_t message_length;
+	double send_time,receive_time;
+	int i;
+
+	client->Failed = GLOBUS_FALSE;
+	client->Start_Time = Bench_Time();
+	receive_time = client->Start_Time;
+	for(i = 0; i < client->Message_Count; i++)
+	{
+		send_time = receive_time;
+		if(!eSTAR_IO_Write_Binary_Message(&(client->Handle),Payload,Message_Length))
+		{
+			eSTAR_IO_Error();
+			client->Failed = GLOBUS_TRUE;
+			break;
+		}
+		if(!eSTAR_IO_Read_Pooled_Message(&(client->Handle),&message,&message_length))
+		{
+			eSTAR_IO_Error();
+			client->Failed = GLOBUS_TRUE;
+			break;
+		}
+		receive_time = Bench_Time();
+		if(message_length != Message_Length)
+		{
+			client->Failed = GLOBUS_TRUE;
+			break;
+		}
+		client->Latency_List[i] = receive_time-send_time;
+	}
+	client->End_Time = receive_time;
+	globus_mutex_lock(&Bench_Mutex);
+	Clients_Running--;
+	globus_cond_signal(&Bench_Cond);
+	globus_mutex_unlock(&Bench_Mutex);
+	return NULL;
+}
+
+/**
+ * Routine to fill the payload.
+ * @param payload The payload buffer.
+ * @param length The length of the payload buffer.
+ * @param pattern What to fill it with.
+ * @see #BENCH_PATTERN
+ */
+static void Bench_Payload_Fill(char *payload,size_t length,enum BENCH_PATTERN pattern)
+{
+	char line[128];
+	unsigned int seed = 1;
+	size_t i,line_length;
+	int line_number;
+
+	if(pattern == BENCH_PATTERN_TEXT)
+	{
+		line_number = 0;
+		for(i = 0; i < length; i += line_length)
+		{
+			line_number++;
+			seed = (seed*1103515245)+12345;
+			sprintf(line,"%6d %10.6f %10.6f %7.3f %6.3f %d\n",line_number,(seed%36000000)/100000.0,
+				((seed>>8)%18000000)/100000.0-90.0,10.0+(seed%10000)/1000.0,(seed%1000)/10000.0,
+				(int)(seed%4));
+			line_length = strlen(line);
+			if(line_length > length-i)
+				line_length = length-i;
+			memcpy(payload+i,line,line_length);
+		}
+	}
+	else
+	{
+		for(i = 0; i < length; i++)
+		{
+			seed = (seed*1103515245)+12345;
+			payload[i] = (char)(seed>>16);
+		}
+	}
+}
+
+/**
+ * qsort comparison routine for latencies.
+ * @param a The address of the first latency.
+ * @param b The address of the second latency.
+ * @return Less than, equal to, or greater than zero as the first latency is less than, equal to or greater than
+ * 	the second.
+ */
+static int Latency_Compare(const void *a,const void *b)
+{
+	double latency_a = *((const double *)a);
+	double latency_b = *((const double *)b);
+
+	if(latency_a < latency_b)
+		return -1;
+	if(latency_a > latency_b)
+		return 1;
+	return 0;
+}
+
+/**
+ * Routine to get a percentile from a sorted list of latencies, using the nearest rank.
+ * @param latency_list The sorted list of latencies.
+ * @param count The number of latencies in the list.
+ * @param percentile The percentile wanted, between 0 and 1.
+ * @return The latency at that percentile.
+ */
+static double Percentile(double *latency_list,int count,double percentile)
+{
+	int index;
+
+	if(count < 1)
+		return 0.0;
+	index = (int)((percentile*count)+0.999999)-1;
+	if(index < 0)
+		index = 0;
+	if(index >= count)
+		index = count-1;
+	return latency_list[index];
+}
+
+/**
+ * Routine to get the time from a monotonic clock.
+ * @return The time in seconds.
+ */
+static double Bench_Time(void)
+{
+	struct timespec current_time;
+
+	clock_gettime(CLOCK_MONOTONIC,&current_time);
+	return ((double)current_time.tv_sec)+(((double)current_time.tv_nsec)/1.0e9);
+}
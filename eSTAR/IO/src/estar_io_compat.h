@@ -0,0 +1,62 @@
+/* eSTAR IO compatibility header file -*- mode: Fundamental;-*-
+ * $Headers$
+ */
+/**
+ * When the eSTAR IO library is built without Globus (with ESTAR_IO_NO_GLOBUS defined), this header
+ * provides the small part of globus_common the library uses, on top of POSIX threads and the C library.
+ * Only the plain TCP and Unix socket transports are available in such a build.
+ */
+#ifndef ESTAR_IO_COMPAT_H
+#define ESTAR_IO_COMPAT_H
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+
+/* hash defines */
+#define GLOBUS_TRUE		(1)
+#define GLOBUS_FALSE		(0)
+#define GLOBUS_NULL		(NULL)
+#define GLOBUS_SUCCESS		(0)
+#define GLOBUS_THREAD_ONCE_INIT	PTHREAD_ONCE_INIT
+
+/* typedefs */
+typedef int globus_bool_t;
+typedef int globus_result_t;
+typedef unsigned char globus_byte_t;
+typedef size_t globus_size_t;
+typedef pthread_t globus_thread_t;
+typedef pthread_mutex_t globus_mutex_t;
+typedef pthread_cond_t globus_cond_t;
+typedef pthread_once_t globus_thread_once_t;
+typedef pthread_key_t globus_thread_key_t;
+
+/* threads */
+#define globus_thread_create(thread,attr,function,arg)	eSTAR_IO_Compat_Thread_Create((thread),(function),(arg))
+#define globus_thread_once(once,function)	pthread_once((once),(function))
+#define globus_thread_key_create(key,destructor)	pthread_key_create((key),(destructor))
+#define globus_thread_getspecific(key)		pthread_getspecific(key)
+#define globus_thread_setspecific(key,value)	pthread_setspecific((key),(value))
+#define globus_mutex_init(mutex,attr)		pthread_mutex_init((mutex),NULL)
+#define globus_mutex_destroy(mutex)		pthread_mutex_destroy(mutex)
+#define globus_mutex_lock(mutex)		pthread_mutex_lock(mutex)
+#define globus_mutex_unlock(mutex)		pthread_mutex_unlock(mutex)
+#define globus_cond_init(cond,attr)		pthread_cond_init((cond),NULL)
+#define globus_cond_destroy(cond)		pthread_cond_destroy(cond)
+#define globus_cond_wait(cond,mutex)		pthread_cond_wait((cond),(mutex))
+#define globus_cond_signal(cond)		pthread_cond_signal(cond)
+#define globus_cond_broadcast(cond)		pthread_cond_broadcast(cond)
+
+/* C library */
+#define globus_libc_malloc	malloc
+#define globus_libc_realloc	realloc
+#define globus_libc_free	free
+#define globus_libc_printf	printf
+#define globus_libc_fprintf	fprintf
+#define globus_libc_sprintf	sprintf
+
+/* external functions */
+extern int eSTAR_IO_Compat_Thread_Create(globus_thread_t *thread,void *(*function)(void *),void *arg);
+#endif
@@ -0,0 +1,801 @@
+/* eSTAR IO transport source file -*- mode: Fundamental;-*-
+ * $Headers$
+ */
+/**
+ * This file contains the transports the eSTAR IO message layer runs over. Each transport provides the same
+ * small set of operations (connect, listen, accept, read, write and close), and a handle remembers the
+ * transport it was opened with, so the framing and server code in estar_io.c does not depend on any of them.
+ * <ul>
+ * <li>The Globus transport uses GSI wrapped globus_io connections, as eSTAR IO always has.
+ * <li>The TCP transport uses plain sockets with TCP_NODELAY set, for trusted networks.
+ * <li>The Unix transport uses AF_UNIX stream sockets, for agents on the same host.
+ * </ul>
+ * If ESTAR_IO_NO_GLOBUS is defined the Globus transport is left out, and the library can be built without
+ * a Globus installation.
+ * @version $Revision: 1.1 $
+ */
+/**
+ * This hash define is needed before including source files give us POSIX.4/IEEE1003.1b-1993 prototypes
+ * for time.
+ */
+#define _POSIX_SOURCE 1
+/**
+ * This hash define is needed before including source files give us POSIX.4/IEEE1003.1b-1993 prototypes
+ * for time.
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "estar_io.h"
+#include "estar_io_transport.h"
+
+/* internal hash definitions */
+/**
+ * Length of the listen backlog passed when creating a listener.
+ */
+#define ESTAR_IO_TRANSPORT_LISTEN_BACKLOG	(5)
+/**
+ * The maximum number of iovecs passed to one sendmsg call by the socket transports.
+ */
+#define ESTAR_IO_TRANSPORT_IOV_MAX		(1024)
+/**
+ * Length of the buffer a socket transport's port number is printed into, for getaddrinfo.
+ */
+#define ESTAR_IO_TRANSPORT_PORT_LENGTH		(16)
+
+/* internal functions */
+#ifndef ESTAR_IO_NO_GLOBUS
+static void Globus_Attr_Init(globus_io_attr_t *attr);
+static char *Globus_Error_String(globus_result_t result);
+static int Globus_Connect(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string);
+static int Globus_Listen(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string);
+static int Globus_Accept(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string);
+static int Globus_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t wait_length,globus_size_t *bytes_read,char **error_string);
+static int Globus_Try_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t *bytes_read,char **error_string);
+static int Globus_Write(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+	globus_size_t *bytes_written,char **error_string);
+static int Globus_Try_Write(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t length,
+	globus_size_t *bytes_written,char **error_string);
+static int Globus_Close(eSTAR_IO_Handle_T *handle,char **error_string);
+#endif
+static int TCP_Connect(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string);
+static int TCP_Listen(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string);
+static int TCP_Accept(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string);
+static int Unix_Connect(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string);
+static int Unix_Listen(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string);
+static int Unix_Close(eSTAR_IO_Handle_T *handle,char **error_string);
+static int Socket_Accept(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string);
+static int Socket_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t wait_length,globus_size_t *bytes_read,char **error_string);
+static int Socket_Try_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t *bytes_read,char **error_string);
+static int Socket_Write(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+	globus_size_t *bytes_written,char **error_string);
+static int Socket_Try_Write(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t length,
+	globus_size_t *bytes_written,char **error_string);
+static int Socket_Close(eSTAR_IO_Handle_T *handle,char **error_string);
+
+/* internal variables */
+#ifndef ESTAR_IO_NO_GLOBUS
+/**
+ * Globus IO Authorization data.
+ */
+static globus_io_secure_authorization_data_t  eSTAR_IO_Globus_IO_Auth_Data;
+/**
+ * Globus IO Authorization mode data.
+ */
+static globus_io_secure_authorization_mode_t  eSTAR_IO_Globus_IO_Auth_Mode;
+/**
+ * The Globus transport.
+ */
+static struct eSTAR_IO_Transport_Struct Globus_Transport =
+{
+	"globus",Globus_Connect,Globus_Listen,Globus_Accept,Globus_Read,Globus_Try_Read,Globus_Write,Globus_Try_Write,
+	Globus_Close
+};
+#endif
+/**
+ * The plain TCP transport.
+ */
+static struct eSTAR_IO_Transport_Struct TCP_Transport =
+{
+	"tcp",TCP_Connect,TCP_Listen,TCP_Accept,Socket_Read,Socket_Try_Read,Socket_Write,Socket_Try_Write,
+	Socket_Close
+};
+/**
+ * The Unix socket transport.
+ */
+static struct eSTAR_IO_Transport_Struct Unix_Transport =
+{
+	"unix",Unix_Connect,Unix_Listen,Socket_Accept,Socket_Read,Socket_Try_Read,Socket_Write,Socket_Try_Write,
+	Unix_Close
+};
+
+/* -----------------------------------
+**  external routines
+** ----------------------------------- */
+/**
+ * Routine to get the operations of a transport.
+ * @param transport Which transport to get.
+ * @return The routine returns the address of the transport's operations, or NULL if the transport is unknown,
+ * 	or was not built into the library.
+ * @see #ESTAR_IO_TRANSPORT
+ */
+struct eSTAR_IO_Transport_Struct *eSTAR_IO_Transport_Get(enum ESTAR_IO_TRANSPORT transport)
+{
+	switch(transport)
+	{
+#ifndef ESTAR_IO_NO_GLOBUS
+		case ESTAR_IO_TRANSPORT_GLOBUS:
+			return &Globus_Transport;
+#endif
+		case ESTAR_IO_TRANSPORT_TCP:
+			return &TCP_Transport;
+		case ESTAR_IO_TRANSPORT_UNIX:
+			return &Unix_Transport;
+		default:
+			return NULL;
+	}
+}
+
+#ifdef ESTAR_IO_NO_GLOBUS
+/**
+ * Routine to create a detached thread, standing in for globus_thread_create when the library is built without
+ * Globus. As with globus threads, the thread cannot be joined.
+ * @param thread The address of a thread id to fill in.
+ * @param function The routine to run in the thread.
+ * @param arg The argument to pass to function.
+ * @return The routine returns zero on success, or an error number.
+ * @see #globus_thread_create
+ */
+int eSTAR_IO_Compat_Thread_Create(globus_thread_t *thread,void *(*function)(void *),void *arg)
+{
+	pthread_attr_t attr;
+	int retval;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+	retval = pthread_create(thread,&attr,function,arg);
+	pthread_attr_destroy(&attr);
+	return retval;
+}
+#endif
+
+/* -----------------------------------
+**  internal routines
+** ----------------------------------- */
+#ifndef ESTAR_IO_NO_GLOBUS
+/**
+ * Internal routine to initialise the attributes of a Globus connection or listener. The connection is GSI wrapped.
+ * @param attr The address of the attributes to initialise.
+ * @see #eSTAR_IO_Globus_IO_Auth_Data
+ * @see #eSTAR_IO_Globus_IO_Auth_Mode
+ */
+static void Globus_Attr_Init(globus_io_attr_t *attr)
+{
+	globus_io_tcpattr_init(attr);
+	globus_io_secure_authorization_data_initialize(&eSTAR_IO_Globus_IO_Auth_Data);
+/* use GSI */
+	globus_io_attr_set_secure_channel_mode(attr,GLOBUS_IO_SECURE_CHANNEL_MODE_GSI_WRAP);
+/* diddly don't lose data
+	globus_io_attr_set_socket_linger(attr,GLOBUS_TRUE,5);
+	globus_io_attr_set_tcp_nodelay(attr,GLOBUS_TRUE);
+*/
+/* authentication information */
+/* diddly
+	globus_io_attr_set_secure_authentication_mode(attr,
+		GLOBUS_IO_SECURE_AUTHENTICATION_MODE_GSSAPI,GSS_C_NO_CREDENTIAL);
+*/
+/* diddly
+	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_SELF;
+or
+	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_IDENTITY;
+	globus_io_secure_authorization_data_set_identity(&eSTAR_IO_Globus_IO_Auth_Data,"DN string");
+*/
+/* diddly
+	eSTAR_IO_Globus_IO_Auth_Mode = GLOBUS_IO_SECURE_AUTHORIZATION_MODE_NONE;
+	globus_io_attr_set_secure_authorization_mode(attr,eSTAR_IO_Globus_IO_Auth_Mode,&
+		eSTAR_IO_Globus_IO_Auth_Data);
+*/
+}
+
+/**
+ * Internal routine to turn a failed globus result into a string.
+ * @param result The globus result.
+ * @return The description of the error.
+ */
+static char *Globus_Error_String(globus_result_t result)
+{
+	globus_object_t* globus_error = NULL;
+
+	globus_error = globus_error_get(result);
+	return globus_object_printable_to_string(globus_error);
+}
+
+/**
+ * Globus transport connect operation.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Connect(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	globus_result_t result;
+
+	Globus_Attr_Init(&(handle->Globus_Attr));
+	handle->Globus_Attr_Initialised = GLOBUS_TRUE;
+	result = globus_io_tcp_connect(address,(unsigned short)port,&(handle->Globus_Attr),&(handle->Globus_Handle));
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		globus_io_tcpattr_destroy(&(handle->Globus_Attr));
+		handle->Globus_Attr_Initialised = GLOBUS_FALSE;
+		return GLOBUS_FALSE;
+	}
+	handle->Fd = handle->Globus_Handle.fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport listen operation. The address is ignored.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Listen(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string)
+{
+	globus_result_t result;
+
+	Globus_Attr_Init(&(listener->Globus_Attr));
+	listener->Globus_Attr_Initialised = GLOBUS_TRUE;
+	result = globus_io_tcp_create_listener(port,ESTAR_IO_TRANSPORT_LISTEN_BACKLOG,&(listener->Globus_Attr),
+		&(listener->Globus_Handle));
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		globus_io_tcpattr_destroy(&(listener->Globus_Attr));
+		listener->Globus_Attr_Initialised = GLOBUS_FALSE;
+		return GLOBUS_FALSE;
+	}
+	listener->Fd = listener->Globus_Handle.fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport accept operation. The accepted connection uses the listener's attributes.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Accept(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	globus_result_t result;
+
+	result = globus_io_tcp_listen(&(listener->Globus_Handle));
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	result = globus_io_tcp_accept(&(listener->Globus_Handle),&(listener->Globus_Attr),&(handle->Globus_Handle));
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	handle->Globus_Attr_Initialised = GLOBUS_FALSE;
+	handle->Fd = handle->Globus_Handle.fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport read operation.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t wait_length,globus_size_t *bytes_read,char **error_string)
+{
+	globus_result_t result;
+
+	result = globus_io_read(&(handle->Globus_Handle),buffer,max_length,wait_length,bytes_read);
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport non-blocking read operation.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Try_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t *bytes_read,char **error_string)
+{
+	globus_result_t result;
+
+	result = globus_io_try_read(&(handle->Globus_Handle),buffer,max_length,bytes_read);
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport write operation.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Write(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+	globus_size_t *bytes_written,char **error_string)
+{
+	globus_result_t result;
+
+	result = globus_io_writev(&(handle->Globus_Handle),iovec_list,iovec_count,bytes_written);
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport non-blocking write operation.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Try_Write(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t length,
+	globus_size_t *bytes_written,char **error_string)
+{
+	globus_result_t result;
+
+	result = globus_io_try_write(&(handle->Globus_Handle),buffer,length,bytes_written);
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Globus transport close operation. Also destroys the handle's attributes, if it owns them.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Globus_Close(eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	globus_result_t result;
+
+	result = globus_io_close(&(handle->Globus_Handle));
+	if(result != GLOBUS_SUCCESS)
+	{
+		(*error_string) = Globus_Error_String(result);
+		return GLOBUS_FALSE;
+	}
+	if(handle->Globus_Attr_Initialised)
+	{
+		handle->Globus_Attr_Initialised = GLOBUS_FALSE;
+		result = globus_io_tcpattr_destroy(&(handle->Globus_Attr));
+		if(result != GLOBUS_SUCCESS)
+		{
+			(*error_string) = Globus_Error_String(result);
+			return GLOBUS_FALSE;
+		}
+	}
+	return GLOBUS_TRUE;
+}
+#endif
+
+/**
+ * TCP transport connect operation. Each address the hostname resolves to is tried in turn.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int TCP_Connect(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	struct addrinfo hints;
+	struct addrinfo *address_list = NULL;
+	struct addrinfo *address_info = NULL;
+	char port_string[ESTAR_IO_TRANSPORT_PORT_LENGTH];
+	int fd,retval,on = 1;
+
+	memset(&hints,0,sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	sprintf(port_string,"%d",port);
+	retval = getaddrinfo(address,port_string,&hints,&address_list);
+	if(retval != 0)
+	{
+		(*error_string) = (char *)gai_strerror(retval);
+		return GLOBUS_FALSE;
+	}
+	fd = -1;
+	(*error_string) = "no addresses";
+	for(address_info = address_list; address_info != NULL; address_info = address_info->ai_next)
+	{
+		fd = socket(address_info->ai_family,address_info->ai_socktype,address_info->ai_protocol);
+		if(fd < 0)
+		{
+			(*error_string) = strerror(errno);
+			continue;
+		}
+		if(connect(fd,address_info->ai_addr,address_info->ai_addrlen) == 0)
+			break;
+		(*error_string) = strerror(errno);
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(address_list);
+	if(fd < 0)
+		return GLOBUS_FALSE;
+	setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+	handle->Fd = fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * TCP transport listen operation. The listener is bound to the interface address (a hostname or numeric address),
+ * the first one it resolves to that can be bound being used. If the address is NULL or empty, the listener is bound
+ * to the IPv4 loopback interface (INADDR_LOOPBACK), so a server is only reachable from other hosts if asked to be.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int TCP_Listen(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string)
+{
+	struct addrinfo hints;
+	struct addrinfo *address_list = NULL;
+	struct addrinfo *address_info = NULL;
+	struct sockaddr_storage socket_address;
+	socklen_t socket_address_length;
+	char port_string[ESTAR_IO_TRANSPORT_PORT_LENGTH];
+	int fd,retval,on = 1;
+
+	memset(&hints,0,sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+/* getaddrinfo gives the loopback address for a NULL hostname without AI_PASSIVE */
+	if((address == NULL)||(address[0] == '\0'))
+	{
+		address = NULL;
+		hints.ai_family = AF_INET;
+	}
+	sprintf(port_string,"%d",(int)(*port));
+	retval = getaddrinfo(address,port_string,&hints,&address_list);
+	if(retval != 0)
+	{
+		(*error_string) = (char *)gai_strerror(retval);
+		return GLOBUS_FALSE;
+	}
+	fd = -1;
+	(*error_string) = "no addresses";
+	for(address_info = address_list; address_info != NULL; address_info = address_info->ai_next)
+	{
+		fd = socket(address_info->ai_family,address_info->ai_socktype,address_info->ai_protocol);
+		if(fd < 0)
+		{
+			(*error_string) = strerror(errno);
+			continue;
+		}
+		setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+		if((bind(fd,address_info->ai_addr,address_info->ai_addrlen) == 0)&&
+		   (listen(fd,ESTAR_IO_TRANSPORT_LISTEN_BACKLOG) == 0))
+			break;
+		(*error_string) = strerror(errno);
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(address_list);
+	if(fd < 0)
+		return GLOBUS_FALSE;
+	socket_address_length = sizeof(socket_address);
+	if(getsockname(fd,(struct sockaddr *)&socket_address,&socket_address_length) == 0)
+	{
+		if(socket_address.ss_family == AF_INET6)
+			(*port) = ntohs(((struct sockaddr_in6 *)&socket_address)->sin6_port);
+		else
+			(*port) = ntohs(((struct sockaddr_in *)&socket_address)->sin_port);
+	}
+	listener->Fd = fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * TCP transport accept operation. TCP_NODELAY is set on the accepted connection.
+ * @see #eSTAR_IO_Transport_Struct
+ * @see #Socket_Accept
+ */
+static int TCP_Accept(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	int on = 1;
+
+	if(!Socket_Accept(listener,handle,error_string))
+		return GLOBUS_FALSE;
+	setsockopt(handle->Fd,IPPROTO_TCP,TCP_NODELAY,&on,sizeof(on));
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Unix socket transport connect operation. The address is the path of the socket, and the port is ignored.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Unix_Connect(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	struct sockaddr_un socket_address;
+	int fd;
+
+	if(strlen(address) >= sizeof(socket_address.sun_path))
+	{
+		(*error_string) = "socket path too long";
+		return GLOBUS_FALSE;
+	}
+	fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(fd < 0)
+	{
+		(*error_string) = strerror(errno);
+		return GLOBUS_FALSE;
+	}
+	memset(&socket_address,0,sizeof(socket_address));
+	socket_address.sun_family = AF_UNIX;
+	strcpy(socket_address.sun_path,address);
+	if(connect(fd,(struct sockaddr *)&socket_address,sizeof(socket_address)) != 0)
+	{
+		(*error_string) = strerror(errno);
+		close(fd);
+		return GLOBUS_FALSE;
+	}
+	handle->Fd = fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Unix socket transport listen operation. The address is the path of the socket, which is removed first if it
+ * already exists. The port is not used.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Unix_Listen(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string)
+{
+	struct sockaddr_un socket_address;
+	int fd;
+
+	if(address == NULL)
+	{
+		(*error_string) = "no socket path";
+		return GLOBUS_FALSE;
+	}
+	if(strlen(address) >= sizeof(socket_address.sun_path))
+	{
+		(*error_string) = "socket path too long";
+		return GLOBUS_FALSE;
+	}
+	fd = socket(AF_UNIX,SOCK_STREAM,0);
+	if(fd < 0)
+	{
+		(*error_string) = strerror(errno);
+		return GLOBUS_FALSE;
+	}
+	memset(&socket_address,0,sizeof(socket_address));
+	socket_address.sun_family = AF_UNIX;
+	strcpy(socket_address.sun_path,address);
+	unlink(address);
+	if((bind(fd,(struct sockaddr *)&socket_address,sizeof(socket_address)) != 0)||
+	   (listen(fd,ESTAR_IO_TRANSPORT_LISTEN_BACKLOG) != 0))
+	{
+		(*error_string) = strerror(errno);
+		close(fd);
+		return GLOBUS_FALSE;
+	}
+	listener->Fd = fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Unix socket transport close operation. If the handle is a listener, its socket path is removed.
+ * @see #eSTAR_IO_Transport_Struct
+ * @see #Socket_Close
+ */
+static int Unix_Close(eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	struct sockaddr_un socket_address;
+	socklen_t length;
+	int listening = 0;
+
+	length = sizeof(listening);
+	if((getsockopt(handle->Fd,SOL_SOCKET,SO_ACCEPTCONN,&listening,&length) == 0)&&listening)
+	{
+		length = sizeof(socket_address);
+		if((getsockname(handle->Fd,(struct sockaddr *)&socket_address,&length) == 0)&&
+		   (length > offsetof(struct sockaddr_un,sun_path))&&(socket_address.sun_path[0] != '\0'))
+			unlink(socket_address.sun_path);
+	}
+	return Socket_Close(handle,error_string);
+}
+
+/**
+ * Socket transport accept operation, shared by the TCP and Unix socket transports.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Socket_Accept(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	int fd;
+
+	do
+	{
+		fd = accept(listener->Fd,NULL,NULL);
+	}
+	while((fd < 0)&&(errno == EINTR));
+	if(fd < 0)
+	{
+		(*error_string) = strerror(errno);
+		return GLOBUS_FALSE;
+	}
+	handle->Fd = fd;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Socket transport read operation, shared by the TCP and Unix socket transports.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Socket_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t wait_length,globus_size_t *bytes_read,char **error_string)
+{
+	ssize_t retval;
+
+	(*bytes_read) = 0;
+	while(((*bytes_read) < wait_length)||(((*bytes_read) == 0)&&(max_length > 0)))
+	{
+		retval = recv(handle->Fd,buffer+(*bytes_read),max_length-(*bytes_read),0);
+		if(retval < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			(*error_string) = strerror(errno);
+			return GLOBUS_FALSE;
+		}
+		if(retval == 0)
+		{
+			(*error_string) = "end of file";
+			return GLOBUS_FALSE;
+		}
+		(*bytes_read) += retval;
+		if((*bytes_read) >= wait_length)
+			break;
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Socket transport non-blocking read operation, shared by the TCP and Unix socket transports.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Socket_Try_Read(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+	globus_size_t *bytes_read,char **error_string)
+{
+	ssize_t retval;
+
+	(*bytes_read) = 0;
+	do
+	{
+		retval = recv(handle->Fd,buffer,max_length,MSG_DONTWAIT);
+	}
+	while((retval < 0)&&(errno == EINTR));
+	if(retval < 0)
+	{
+		if((errno == EAGAIN)||(errno == EWOULDBLOCK))
+			return GLOBUS_TRUE;
+		(*error_string) = strerror(errno);
+		return GLOBUS_FALSE;
+	}
+	if(retval == 0)
+	{
+		(*error_string) = "end of file";
+		return GLOBUS_FALSE;
+	}
+	(*bytes_read) = retval;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Socket transport non-blocking write operation, shared by the TCP and Unix socket transports.
+ * MSG_NOSIGNAL is used as for Socket_Write.
+ * @see #eSTAR_IO_Transport_Struct
+ * @see #Socket_Write
+ */
+static int Socket_Try_Write(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t length,
+	globus_size_t *bytes_written,char **error_string)
+{
+	ssize_t retval;
+
+	(*bytes_written) = 0;
+	do
+	{
+		retval = send(handle->Fd,buffer,length,MSG_DONTWAIT|MSG_NOSIGNAL);
+	}
+	while((retval < 0)&&(errno == EINTR));
+	if(retval < 0)
+	{
+		if((errno == EAGAIN)||(errno == EWOULDBLOCK))
+			return GLOBUS_TRUE;
+		(*error_string) = strerror(errno);
+		return GLOBUS_FALSE;
+	}
+	(*bytes_written) = retval;
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Socket transport write operation, shared by the TCP and Unix socket transports. The iovec list is sent with
+ * sendmsg, with MSG_NOSIGNAL so a closed connection is reported as an error rather than raising SIGPIPE.
+ * The iovec list is modified as partial writes are completed.
+ * @see #eSTAR_IO_Transport_Struct
+ * @see #ESTAR_IO_TRANSPORT_IOV_MAX
+ */
+static int Socket_Write(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+	globus_size_t *bytes_written,char **error_string)
+{
+	struct msghdr message_header;
+	ssize_t retval;
+	size_t length;
+
+	(*bytes_written) = 0;
+	while(iovec_count > 0)
+	{
+	/* skip empty fragments, so a completed list is never sent */
+		if(iovec_list->iov_len == 0)
+		{
+			iovec_list++;
+			iovec_count--;
+			continue;
+		}
+		memset(&message_header,0,sizeof(message_header));
+		message_header.msg_iov = iovec_list;
+		message_header.msg_iovlen = iovec_count;
+		if(message_header.msg_iovlen > ESTAR_IO_TRANSPORT_IOV_MAX)
+			message_header.msg_iovlen = ESTAR_IO_TRANSPORT_IOV_MAX;
+		retval = sendmsg(handle->Fd,&message_header,MSG_NOSIGNAL);
+		if(retval < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			(*error_string) = strerror(errno);
+			return GLOBUS_FALSE;
+		}
+		(*bytes_written) += retval;
+	/* move past what was sent */
+		while((iovec_count > 0)&&((size_t)retval >= iovec_list->iov_len))
+		{
+			retval -= iovec_list->iov_len;
+			iovec_list++;
+			iovec_count--;
+		}
+		if(iovec_count > 0)
+		{
+			length = (size_t)retval;
+			iovec_list->iov_base = (char *)iovec_list->iov_base+length;
+			iovec_list->iov_len -= length;
+		}
+	}
+	return GLOBUS_TRUE;
+}
+
+/**
+ * Socket transport close operation, shared by the TCP and Unix socket transports. The socket is shut down before
+ * it is closed, so a thread blocked in accept or recv on it returns.
+ * @see #eSTAR_IO_Transport_Struct
+ */
+static int Socket_Close(eSTAR_IO_Handle_T *handle,char **error_string)
+{
+	shutdown(handle->Fd,SHUT_RDWR);
+	if(close(handle->Fd) != 0)
+	{
+		(*error_string) = strerror(errno);
+		return GLOBUS_FALSE;
+	}
+	return GLOBUS_TRUE;
+}
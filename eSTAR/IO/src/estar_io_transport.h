@@ -0,0 +1,48 @@
+/* eSTAR IO transport header file -*- mode: Fundamental;-*-
+ * $Headers$
+ */
+#ifndef ESTAR_IO_TRANSPORT_H
+#define ESTAR_IO_TRANSPORT_H
+#include <sys/uio.h>
+
+/* structures */
+/**
+ * Structure holding the operations of one transport. Every operation returns GLOBUS_TRUE on success and
+ * GLOBUS_FALSE on failure, in which case error_string is set to a description of the error, which
+ * should not be freed.
+ * <dl>
+ * <dt>Name</dt> <dd>The name of the transport, for error messages.</dd>
+ * <dt>Connect</dt> <dd>Connect handle to address (a hostname, or a socket path) and port.</dd>
+ * <dt>Listen</dt> <dd>Create a listener on port at the interface address, or on the socket path address.
+ * 	If the port is zero, one is chosen and returned in port.</dd>
+ * <dt>Accept</dt> <dd>Wait for a connection on listener, and accept it into handle. This fails once the listener
+ * 	has been closed by another thread.</dd>
+ * <dt>Read</dt> <dd>Read up to max_length bytes, waiting until at least wait_length have been read.</dd>
+ * <dt>Try_Read</dt> <dd>Read up to max_length bytes without blocking, which may read none.
+ * 	Fails if the connection has been closed.</dd>
+ * <dt>Write</dt> <dd>Write all the data in iovec_list.</dd>
+ * <dt>Try_Write</dt> <dd>Write up to length bytes without blocking, which may write none.</dd>
+ * <dt>Close</dt> <dd>Close handle, which may be a connection or a listener.</dd>
+ * </dl>
+ * @see #eSTAR_IO_Transport_Get
+ */
+struct eSTAR_IO_Transport_Struct
+{
+	char *Name;
+	int (*Connect)(char *address,int port,eSTAR_IO_Handle_T *handle,char **error_string);
+	int (*Listen)(char *address,unsigned short *port,eSTAR_IO_Handle_T *listener,char **error_string);
+	int (*Accept)(eSTAR_IO_Handle_T *listener,eSTAR_IO_Handle_T *handle,char **error_string);
+	int (*Read)(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+		globus_size_t wait_length,globus_size_t *bytes_read,char **error_string);
+	int (*Try_Read)(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t max_length,
+		globus_size_t *bytes_read,char **error_string);
+	int (*Write)(eSTAR_IO_Handle_T *handle,struct iovec *iovec_list,int iovec_count,
+		globus_size_t *bytes_written,char **error_string);
+	int (*Try_Write)(eSTAR_IO_Handle_T *handle,globus_byte_t *buffer,globus_size_t length,
+		globus_size_t *bytes_written,char **error_string);
+	int (*Close)(eSTAR_IO_Handle_T *handle,char **error_string);
+};
+
+/* external functions */
+extern struct eSTAR_IO_Transport_Struct *eSTAR_IO_Transport_Get(enum ESTAR_IO_TRANSPORT transport);
+#endif
@@ -0,0 +1,82 @@
+# eSTAR::IO::Server engine test harness
+
+# strict
+use strict;
+
+# load test
+use Test;
+BEGIN { plan tests => 10 };
+
+# load modules
+use eSTAR::IO qw / :all /;
+use eSTAR::IO::Server qw / :all start_server stop_server /;
+use eSTAR::IO::Client;
+
+# debugging
+use Data::Dumper;
+
+
+# ----------------------------------------------------------------------------
+
+# test the test system
+ok( 1 );
+
+# each engine is started in a child over a Unix socket, sent a message,
+# replies to it, and is shut down by the client asking it to
+my $path = "/tmp/estar_io_engines.$$";
+
+foreach my $engine ( ENGINE_THREAD, ENGINE_POOL, ENGINE_EVENT ) {
+
+   # start server -------------------------------------------------------------
+
+   unlink( $path );
+   my $pid = fork();
+   die "Cannot fork: $!" unless defined $pid;
+   if ( $pid == 0 ) {
+      my $callback = sub {
+         my $handle = shift;
+         my $message = shift;
+
+         # the event engine hands us the message, the others read it
+         unless ( defined $message ) {
+            my $reply = read_message( $handle );
+            return GLOBUS_FALSE unless defined $reply;
+            $message = ${$reply}[0];
+         }
+         write_message( $handle, "ok $message" );
+         stop_server( ) if $message eq "shutdown";
+         return GLOBUS_TRUE;
+      };
+      my $status = start_server( 0, $callback, 2, 0, POOL_OVERFLOW_BLOCK,
+                                 $engine, TRANSPORT_UNIX, $path );
+      exit( $status ? 0 : 1 );
+   }
+
+   # wait for the socket to appear
+   foreach ( 1 .. 50 ) {
+      last if -S $path;
+      select( undef, undef, undef, 0.1 );
+   }
+
+   # talk to the server -------------------------------------------------------
+
+   my $handle = open_client( $path, 0, TRANSPORT_UNIX );
+   ok( defined $handle );
+
+   my $reply;
+   if ( defined $handle ) {
+      write_message( $handle, "shutdown" );
+      $reply = read_message( $handle );
+      close_client( $handle );
+   }
+   ok( defined $reply ? ${$reply}[0] : undef, "ok shutdown" );
+
+   # the server returns once it's been stopped
+   waitpid( $pid, 0 );
+   ok( $?, 0 );
+}
+unlink( $path );
+
+exit;
+
+# ----------------------------------------------------------------------------
@@ -0,0 +1,63 @@
+# eSTAR::IO write_fragments test harness
+
+# strict
+use strict;
+
+# load test
+use Test;
+BEGIN { plan tests => 5 };
+
+# load modules
+use eSTAR::IO qw / :all /;
+use eSTAR::IO::Server qw / :all start_server stop_server /;
+use eSTAR::IO::Client;
+
+# debugging
+use Data::Dumper;
+
+
+# ----------------------------------------------------------------------------
+
+# test the test system
+ok( 1 );
+
+# an event server that echoes each message back, until it's told to stop
+my $path = "/tmp/estar_io_fragments.$$";
+unlink( $path );
+my $pid = fork();
+die "Cannot fork: $!" unless defined $pid;
+if ( $pid == 0 ) {
+   my $callback = sub {
+      my ( $handle, $message ) = @_;
+      write_message( $handle, $message );
+      stop_server( ) if $message eq "shutdown";
+      return GLOBUS_TRUE;
+   };
+   my $status = start_server( 0, $callback, 1, 0, POOL_OVERFLOW_BLOCK,
+                              ENGINE_EVENT, TRANSPORT_UNIX, $path );
+   exit( $status ? 0 : 1 );
+}
+foreach ( 1 .. 50 ) {
+   last if -S $path;
+   select( undef, undef, undef, 0.1 );
+}
+
+my $handle = open_client( $path, 0, TRANSPORT_UNIX );
+ok( defined $handle );
+
+# more fragments than writev takes in one call
+my @fragments = map { sprintf( "%05d,", $_ ) } ( 1 .. 5000 );
+ok( write_fragments( $handle, \@fragments ), GLOBUS_TRUE );
+my $reply = read_message( $handle );
+ok( defined $reply ? ${$reply}[0] : undef, join( "", @fragments ) );
+
+write_message( $handle, "shutdown" );
+read_message( $handle );
+close_client( $handle );
+waitpid( $pid, 0 );
+ok( $?, 0 );
+unlink( $path );
+
+exit;
+
+# ----------------------------------------------------------------------------
@@ -0,0 +1,83 @@
+# eSTAR::IO write_messages and read_messages test harness
+
+# strict
+use strict;
+
+# load test
+use Test;
+BEGIN { plan tests => 11 };
+
+# load modules
+use eSTAR::IO qw / :all /;
+use eSTAR::IO::Server qw / :all start_server stop_server /;
+use eSTAR::IO::Client;
+
+# debugging
+use Data::Dumper;
+
+
+# ----------------------------------------------------------------------------
+
+# test the test system
+ok( 1 );
+
+# an event server that echoes each message back, until it's told to stop
+my $path = "/tmp/estar_io_messages.$$";
+unlink( $path );
+my $pid = fork();
+die "Cannot fork: $!" unless defined $pid;
+if ( $pid == 0 ) {
+   my $callback = sub {
+      my ( $handle, $message ) = @_;
+      write_message( $handle, $message );
+      stop_server( ) if $message eq "shutdown";
+      return GLOBUS_TRUE;
+   };
+   my $status = start_server( 0, $callback, 1, 0, POOL_OVERFLOW_BLOCK,
+                              ENGINE_EVENT, TRANSPORT_UNIX, $path );
+   exit( $status ? 0 : 1 );
+}
+foreach ( 1 .. 50 ) {
+   last if -S $path;
+   select( undef, undef, undef, 0.1 );
+}
+
+my $handle = open_client( $path, 0, TRANSPORT_UNIX );
+ok( defined $handle );
+
+# a batch comes back as it was sent
+my @messages = map { "message $_" } ( 1 .. 1000 );
+ok( write_messages( $handle, \@messages ), GLOBUS_TRUE );
+my @replies;
+while ( @replies < @messages ) {
+   my $replies = read_messages( $handle );
+   last unless defined $replies;
+   push @replies, @$replies;
+}
+ok( scalar(@replies), scalar(@messages) );
+ok( join( "\n", @replies ), join( "\n", @messages ) );
+
+# undefined and empty messages are refused before anything is sent
+eval { write_messages( $handle, [ "first", undef, "third" ] ); };
+ok( $@ =~ /message 1 is undefined or empty/ );
+eval { write_messages( $handle, [ "first", "second", "" ] ); };
+ok( $@ =~ /message 2 is undefined or empty/ );
+eval { write_fragments( $handle, [ "header", "" ] ); };
+ok( $@ =~ /fragment 1 is undefined or empty/ );
+
+# and the connection is still in step
+write_message( $handle, "after" );
+my $reply = read_message( $handle );
+ok( defined $reply ? ${$reply}[0] : undef, "after" );
+
+write_message( $handle, "shutdown" );
+$reply = read_message( $handle );
+ok( defined $reply ? ${$reply}[0] : undef, "shutdown" );
+close_client( $handle );
+waitpid( $pid, 0 );
+ok( $?, 0 );
+unlink( $path );
+
+exit;
+
+# ----------------------------------------------------------------------------
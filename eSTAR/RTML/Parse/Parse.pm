@@ -36,6 +36,8 @@ eSTAR::RTML::Parse - module which parses valid RTML messages
 =head1 SYNOPSIS
 
    $message = new eSTAR::RTML::Parse( RTML => $rtml );
+   $message = new eSTAR::RTML::Parse( File => $rtml_file );
+   $message = new eSTAR::RTML::Parse( Source => $rtml_document );
 
 
 =head1 DESCRIPTION
@@ -45,6 +47,16 @@ gent from the discovery node, it takes an eSTAR::RTML object as input
 returning an object with parsed RTML. The object has various query
 methods enabled allowing the user to grab tag values simply.
 
+Documents can also be parsed directly from a file or a scalar, in which
+case they are read in a single pass by L<XML::Document::RTML::Stream>
+rather than being turned into a document tree first, and any embedded
+FITS headers and catalogues are left where they are.
+
+The values are the same either way, except that the document tree is
+always read as US-ASCII, while a document read in a single pass is
+decoded from UTF-8, or ISO-8859-1 if its XML declaration says so, and
+only the predefined and numeric character entities are replaced.
+
 =cut
 
 # L O A D   M O D U L E S --------------------------------------------------
@@ -75,6 +87,8 @@ $Id: Parse.pm,v 1.24 2006/06/08 22:45:17 aa Exp $
 Create a new instance from a hash of options
 
   $message = new eSTAR::RTML::Parse( RTML => $rtml );
+  $message = new eSTAR::RTML::Parse( File => $rtml_file );
+  $message = new eSTAR::RTML::Parse( Source => $rtml_document );
 
 returns a reference to an message object.
 
@@ -87,7 +101,9 @@ sub new {
   # bless the query hash into the class
   my $block = bless { BUFFER      => undef,
                       DTD         => undef,
-                      TYPE        => undef  }, $class;
+                      TYPE        => undef,
+                      STREAM      => undef,
+                      PAYLOADS    => [] }, $class;
 
   # Configure the object
   $block->configure( @_ );
@@ -499,6 +515,52 @@ sub end_time {
 
 }
 
+=item B<payloads>
+
+Return the payloads left in the document when it was parsed from a File
+or a Source
+
+  @payloads = $rtml->payloads();
+
+as a list of hashes, e.g.
+
+  { Name       => 'FITSHeader',
+    Path       => 'RTML/Observation/FITSHeader',
+    Attributes => { type => 'all' },
+    Offset     => 2048,
+    Length     => 8640 }
+
+where the Offset and Length are those of the element's content in the
+document. The ObjectList and FITSHeader elements are always left as
+payloads, as is any other text longer than 4096 bytes, and so aren't
+available from fitsheaders() and catalogue().
+
+=cut
+
+sub payloads {
+  my $self = shift;
+  return @{$self->{PAYLOADS}};
+}
+
+=item B<payload>
+
+Return the content of one of the payloads listed by payloads()
+
+  $header = $rtml->payload( $n );
+
+as it is in the document, the entities aren't replaced.
+
+=cut
+
+sub payload {
+  my $self = shift;
+  my $n = shift;
+
+  my $payload = $self->{PAYLOADS}[$n];
+  return undef unless defined $payload;
+  return $self->{STREAM}->payload( $payload->{Offset}, $payload->{Length} );
+}
+
 
 # C O N F I G U R E ----------------------------------------------------------
 
@@ -533,7 +595,7 @@ sub configure {
   my %args = @_;
 
   # Loop over the allowed keys and modify the default query options
-  for my $key (qw / RTML / ) {
+  for my $key (qw / RTML File Source / ) {
       my $method = lc($key);
          # normal configuration methods (if needed)
          $self->$method( $args{$key} ) if exists $args{$key};
@@ -566,6 +628,48 @@ sub rtml {
 
 }
 
+=item B<file>
+
+Parse an RTML document in a file, in a single pass
+
+   $message->file( $rtml_file );
+
+without building a document tree first. This method is called directly
+from the configure method if a File key and value is supplied to the
+%options hash.
+
+=cut
+
+sub file {
+  my $self = shift;
+  my $file = shift;
+
+  require XML::Document::RTML::Stream;
+  $self->_stream_rtml( new XML::Document::RTML::Stream( File => $file ) );
+
+}
+
+=item B<source>
+
+Parse an RTML document held in a scalar, in a single pass
+
+   $message->source( $rtml_document );
+
+without building a document tree first. This method is called directly
+from the configure method if a Source key and value is supplied to the
+%options hash.
+
+=cut
+
+sub source {
+  my $self = shift;
+  my $rtml = shift;
+
+  require XML::Document::RTML::Stream;
+  $self->_stream_rtml( new XML::Document::RTML::Stream( XML => $rtml ) );
+
+}
+
 =item B<freeze>
 
 Method to return a blessed reference to the object so that we can store
@@ -642,6 +746,112 @@ sub _parse_rtml {
 
 }
 
+=item B<_stream_rtml>
+
+Private method to parse the RTML document from the events returned by an
+C<XML::Document::RTML::Stream> object, called from the file() and source()
+methods. It fills in the object exactly as C<_parse_rtml> does, down to
+the same depth in the document, but without needing the document tree.
+
+=cut
+
+sub _stream_rtml {
+  my $self = shift;
+  my $stream = shift;
+
+  # for each element we're inside, starting with <RTML>, its name and
+  # attributes, the hash its attributes and value go into, and whether
+  # we're past its value (the text before its first sub-tag)
+  my ( @name, @attributes, @hash, @done );
+  my @payloads;
+
+  foreach my $event ( $stream->events() ) {
+     my ( $type, @args ) = @$event;
+
+     if ( $type eq 'start' || $type eq 'payload' ) {
+        my ( $name, $attributes ) = @args;
+        my $depth = scalar( @name );
+        $done[-1] = 1 if @done;
+
+        # set DTD version and document type tags in object
+        if ( $depth == 0 ) {
+           $self->{DTD} = $attributes->{version};
+           $self->{TYPE} = $attributes->{type};
+        }
+
+        # where this tag's attributes and value go
+        my $hash;
+        if ( $depth == 1 ) {
+           $self->{uc($name)} = {} unless defined $self->{uc($name)};
+           $hash = $self->{uc($name)};
+        } elsif ( $depth <= 3 && defined $hash[-1] ) {
+           $hash[-1]->{ucfirst(lc($name))} = {}
+              unless ref( $hash[-1]->{ucfirst(lc($name))} ) eq "HASH";
+           $hash = $hash[-1]->{ucfirst(lc($name))};
+        } elsif ( $depth == 4 && defined $hash[-1] ) {
+           $hash[-1]->{$name} = undef;
+        }
+        if ( defined $hash ) {
+           foreach my $key ( sort keys %$attributes ) {
+              $hash->{$key} = $attributes->{$key};
+           }
+        }
+
+        if ( $type eq 'payload' ) {
+           push @payloads, { Name       => $name,
+                             Path       => join( "/", @name, $name ),
+                             Attributes => $attributes,
+                             Offset     => $args[2],
+                             Length     => $args[3] };
+        } else {
+           push @name, $name;
+           push @attributes, $attributes;
+           push @hash, $hash;
+           push @done, 0;
+        }
+
+     } elsif ( $type eq 'text' ) {
+        next if $done[-1];
+        $done[-1] = 1;
+
+        my $entry = $args[0];
+        $entry =~ s/^\s+//;
+        $entry =~ s/\s+$//;
+
+        # tags below the third level only have their value kept
+        my $depth = $#name;
+        if ( $depth >= 1 && $depth <= 3 && defined $hash[-1] ) {
+           $hash[-1]->{tag_value} = $entry if $entry ne '';
+        } elsif ( $depth == 4 && defined $hash[-2] ) {
+           $hash[-2]->{$name[-1]} = $entry;
+        }
+
+     } elsif ( $type eq 'range' ) {
+        $done[-1] = 1;
+        push @payloads, { Name       => $name[-1],
+                          Path       => join( "/", @name ),
+                          Attributes => $attributes[-1],
+                          Offset     => $args[0],
+                          Length     => $args[1] };
+
+     } elsif ( $type eq 'end' ) {
+        # a fourth level tag with sub-tags but no value of its own
+        if ( $#name == 4 && $done[-1] && defined $hash[-2] &&
+             !defined $hash[-2]->{$name[-1]} ) {
+           $hash[-2]->{$name[-1]} = '';
+        }
+        pop @name;
+        pop @attributes;
+        pop @hash;
+        pop @done;
+     }
+  }
+
+  $self->{STREAM} = $stream;
+  $self->{PAYLOADS} = \@payloads;
+
+}
+
 =item B<_parse_tag>
 
 Private method to parse individual tags within the RTML, called from the
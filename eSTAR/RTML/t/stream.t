@@ -0,0 +1,113 @@
+# eSTAR::RTML::Parse test harness
+
+# strict
+use strict;
+
+#load test
+use Test;
+BEGIN { plan tests => 162 };
+
+# load modules
+use eSTAR::RTML;
+use eSTAR::RTML::Parse;
+
+# debugging
+use Data::Dumper;
+
+# T E S T   H A R N E S S --------------------------------------------------
+
+# test the test system
+ok(1);
+
+# the same answers as parsing the document tree
+my @methods = qw / dtd type score time id name user institution email
+                   target targetident targettype priority ra dec exposure
+                   snr flux equinox filter host port group_count
+                   series_count interval tolerance start_time end_time /;
+
+foreach my $file ( qw{ t/rtml/ia_score_request.xml
+                       t/rtml/ers_observation_accepted.xml
+                       t/rtml2.2/example_score.xml
+                       t/rtml2.2/problem.xml
+                       t/rtml2.2/observe.xml } ) {
+   my $rtml = new eSTAR::RTML( File => $file );
+   my $tree = new eSTAR::RTML::Parse( RTML => $rtml );
+   my $stream = new eSTAR::RTML::Parse( File => $file );
+   foreach my $method ( @methods ) {
+      ok( $stream->$method(), $tree->$method() );
+   }
+}
+
+# an observation with an embedded FITS header and catalogue
+my $header = "";
+foreach my $i ( 1 .. 100 ) {
+   $header = $header . sprintf( "%-80s", "COMMENT card $i" ) . "\n";
+}
+my $catalogue = "<VOTABLE><RESOURCE><TABLE><DATA><TABLEDATA>";
+foreach my $i ( 1 .. 100 ) {
+   $catalogue = $catalogue . "<TR><TD>$i</TD><TD>18.5</TD></TR>";
+}
+$catalogue = $catalogue . "</TABLEDATA></DATA></TABLE></RESOURCE></VOTABLE>";
+
+my $document = '<?xml version="1.0" encoding="US-ASCII"?>
+<!DOCTYPE RTML SYSTEM "http://www.estar.org.uk/documents/rtml2.2.dtd">
+<RTML version="2.2" type="observation">
+    <IntelligentAgent host="localhost" port="1234">12345</IntelligentAgent>
+    <Observation status="ok">
+        <Target type="normal" ident="test-ident">
+            <TargetName>test</TargetName>
+            <Coordinates type="equatorial">
+                <RightAscension format="hh mm ss.s" units="hms">01 02 03.0</RightAscension>
+                <Declination format="sdd mm ss.s" units="dms">+45 56 01.0</Declination>
+                <Equinox>J2000</Equinox>
+            </Coordinates>
+        </Target>
+        <Schedule priority="3">
+            <Exposure type="time" units="seconds">
+                <Count>2</Count>120
+            </Exposure>
+        </Schedule>
+        <ImageData type="FITS16" delivery="url" reduced="true">
+            http://www.estar.org.uk/test.fits
+        </ImageData>
+        <FITSHeader type="all">' . $header . '</FITSHeader>
+        <ObjectList type="votable">' . $catalogue . '</ObjectList>
+    </Observation>
+</RTML>';
+
+my $message = new eSTAR::RTML::Parse( Source => $document );
+ok( $message->dtd(), '2.2' );
+ok( $message->type(), 'observation' );
+ok( $message->id(), '12345' );
+ok( $message->host(), 'localhost' );
+ok( $message->target(), 'test' );
+ok( $message->targetident(), 'test-ident' );
+ok( $message->ra(), '01 02 03.0' );
+ok( $message->dec(), '45 56 01.0' );
+ok( $message->priority(), 3 );
+ok( $message->group_count(), 2 );
+ok( $message->dataimage(), 'http://www.estar.org.uk/test.fits' );
+
+# the payloads are left in the document
+my @payloads = $message->payloads();
+ok( scalar(@payloads), 2 );
+ok( $payloads[0]->{Path}, 'RTML/Observation/FITSHeader' );
+ok( $payloads[0]->{Attributes}->{type}, 'all' );
+ok( $message->payload( 0 ), $header );
+ok( $payloads[1]->{Name}, 'ObjectList' );
+ok( $message->payload( 1 ), $catalogue );
+ok( $message->fitsheaders(), undef );
+
+# and from a file
+my $file = "t/stream.xml";
+open( FILE, ">$file" ) or die "Cannot open $file: $!";
+print FILE $document;
+close( FILE );
+my $message2 = new eSTAR::RTML::Parse( File => $file );
+ok( $message2->ra(), '01 02 03.0' );
+ok( $message2->payload( 0 ), $header );
+unlink( $file );
+
+# a broken document
+eval { new eSTAR::RTML::Parse( Source => "<RTML><Observation></RTML>" ); };
+ok( $@ =~ /mismatched end tag/ );